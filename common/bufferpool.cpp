@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bufferpool.h"
+
+BufferPool::BufferPool(int bufferSize, int maxBuffers) :
+    m_bufferSize(bufferSize),
+    m_maxBuffers(maxBuffers)
+{
+
+}
+
+int BufferPool::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+int BufferPool::maxBuffers() const
+{
+    return m_maxBuffers;
+}
+
+int BufferPool::buffersCount() const
+{
+    return m_buffers.count();
+}
+
+int BufferPool::freeBuffersCount() const
+{
+    int count = 0;
+    foreach (const QByteArray &buffer, m_buffers) {
+        if (buffer.isDetached()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+quint64 BufferPool::allocationsCount() const
+{
+    return m_allocationsCount;
+}
+
+QByteArray BufferPool::read(QIODevice *device)
+{
+    qint64 bytesAvailable = device->bytesAvailable();
+    if (bytesAvailable <= 0)
+        return QByteArray();
+
+    int readSize = static_cast<int>(qMin(bytesAvailable, static_cast<qint64>(m_bufferSize)));
+
+    // A buffer is free once the pool holds the only reference
+    int index = -1;
+    for (int i = 0; i < m_buffers.count(); i++) {
+        if (m_buffers.at(i).isDetached()) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        m_allocationsCount++;
+        if (m_buffers.count() >= m_maxBuffers)
+            return device->read(readSize);
+
+        m_buffers.append(QByteArray(m_bufferSize, Qt::Uninitialized));
+        index = m_buffers.count() - 1;
+    }
+
+    // Resizing within the capacity of an unshared buffer does not reallocate
+    QByteArray &buffer = m_buffers[index];
+    buffer.resize(m_bufferSize);
+    qint64 bytesRead = device->read(buffer.data(), readSize);
+    if (bytesRead <= 0) {
+        buffer.resize(0);
+        return QByteArray();
+    }
+
+    buffer.resize(static_cast<int>(bytesRead));
+    return buffer;
+}
+
+int BufferPool::trim(int keepFree)
+{
+    int releasedBytes = 0;
+    int freeCount = 0;
+    for (int i = 0; i < m_buffers.count(); ) {
+        if (m_buffers.at(i).isDetached() && ++freeCount > keepFree) {
+            releasedBytes += m_buffers.at(i).capacity();
+            m_buffers.removeAt(i);
+            continue;
+        }
+
+        i++;
+    }
+
+    return releasedBytes;
+}
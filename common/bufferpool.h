@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QList>
+#include <QIODevice>
+#include <QByteArray>
+
+// Pool of fixed size read buffers. A read returns an implicitly shared slice of a pooled
+// buffer, which can be used for the next read once the last slice has been released.
+// Reads fall back to a regular allocation if all buffers are still in use.
+
+class BufferPool
+{
+public:
+    explicit BufferPool(int bufferSize = 16384, int maxBuffers = 16);
+
+    int bufferSize() const;
+    int maxBuffers() const;
+
+    int buffersCount() const;
+    int freeBuffersCount() const;
+
+    // Heap allocations for buffers, including the fallback reads
+    quint64 allocationsCount() const;
+
+    // Reads up to bufferSize bytes, returns an empty byte array if there is nothing to read
+    QByteArray read(QIODevice *device);
+
+    // Releases free buffers exceeding the given count, returns the released bytes
+    int trim(int keepFree = 1);
+
+private:
+    int m_bufferSize = 16384;
+    int m_maxBuffers = 16;
+    QList<QByteArray> m_buffers;
+    quint64 m_allocationsCount = 0;
+
+};
+
+#endif // BUFFERPOOL_H
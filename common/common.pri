@@ -1,7 +1,13 @@
 #INCLUDEPATH += $$PWD
 
 HEADERS += \
-    $$PWD/slipdataprocessor.h
+    $$PWD/bufferpool.h \
+    $$PWD/jsonstreamsplitter.h \
+    $$PWD/slipdataprocessor.h \
+    $$PWD/tunnelcompression.h
 
 SOURCES += \
-    $$PWD/slipdataprocessor.cpp
+    $$PWD/bufferpool.cpp \
+    $$PWD/jsonstreamsplitter.cpp \
+    $$PWD/slipdataprocessor.cpp \
+    $$PWD/tunnelcompression.cpp
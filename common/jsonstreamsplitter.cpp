@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "jsonstreamsplitter.h"
+
+void JsonStreamSplitter::append(const QByteArray &data)
+{
+    compact();
+    m_buffer.append(data);
+}
+
+QByteArray JsonStreamSplitter::takeMessage()
+{
+    while (m_position < m_buffer.size()) {
+        int delimiterIndex = m_buffer.indexOf('\n', m_position);
+        if (delimiterIndex < 0) {
+            // Transports with message boundaries (i.e. websockets) might deliver
+            // the last message without delimiter, accept it if it looks complete
+            if (m_buffer.endsWith('}')) {
+                QByteArray message = m_buffer.mid(m_position);
+                m_position = m_buffer.size();
+                return message;
+            }
+
+            return QByteArray();
+        }
+
+        int messageStart = m_position;
+        m_position = delimiterIndex + 1;
+
+        // Skip empty lines between messages
+        if (delimiterIndex > messageStart)
+            return m_buffer.mid(messageStart, delimiterIndex - messageStart);
+    }
+
+    return QByteArray();
+}
+
+QByteArray JsonStreamSplitter::takeAll()
+{
+    QByteArray data = m_buffer.mid(m_position);
+    clear();
+    return data;
+}
+
+void JsonStreamSplitter::compact()
+{
+    if (m_position == 0)
+        return;
+
+    if (m_position >= m_buffer.size()) {
+        m_buffer.clear();
+    } else {
+        m_buffer.remove(0, m_position);
+    }
+
+    m_position = 0;
+}
+
+int JsonStreamSplitter::squeeze()
+{
+    compact();
+
+    int capacity = m_buffer.capacity();
+    if (m_buffer.isEmpty()) {
+        m_buffer = QByteArray();
+    } else {
+        m_buffer.squeeze();
+    }
+
+    return capacity - m_buffer.capacity();
+}
+
+int JsonStreamSplitter::size() const
+{
+    return m_buffer.size() - m_position;
+}
+
+bool JsonStreamSplitter::isEmpty() const
+{
+    return size() == 0;
+}
+
+void JsonStreamSplitter::clear()
+{
+    m_buffer.clear();
+    m_position = 0;
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef JSONSTREAMSPLITTER_H
+#define JSONSTREAMSPLITTER_H
+
+#include <QByteArray>
+
+// Splits a newline delimited JSON stream into messages. The buffer gets consumed
+// using a read cursor and is compacted only once for each appended chunk, so
+// splitting n pipelined messages stays linear in the amount of received data.
+
+class JsonStreamSplitter
+{
+public:
+    explicit JsonStreamSplitter() = default;
+
+    // Compacts the already consumed data and appends the new data
+    void append(const QByteArray &data);
+
+    // Returns the next complete message without the delimiter, or a null byte array if there is none
+    QByteArray takeMessage();
+
+    // Returns all unconsumed data, i.e. data following the last message which is not JSON any more
+    QByteArray takeAll();
+
+    // Drops the already consumed data from the buffer
+    void compact();
+
+    // Compacts the buffer and releases the unused capacity, returns the released bytes
+    int squeeze();
+
+    // The amount of unconsumed bytes
+    int size() const;
+    bool isEmpty() const;
+
+    void clear();
+
+private:
+    QByteArray m_buffer;
+    int m_position = 0;
+
+};
+
+#endif // JSONSTREAMSPLITTER_H
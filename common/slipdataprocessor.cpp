@@ -98,6 +98,57 @@ QByteArray SlipDataProcessor::serializeData(const QByteArray &data)
     return serializedData;
 }
 
+QByteArray SlipDataProcessor::escapeData(const QByteArray &data)
+{
+    int specialBytes = 0;
+    for (int i = 0; i < data.length(); i++) {
+        quint8 byte = static_cast<quint8>(data.at(i));
+        if (byte == ProtocolByteEnd || byte == ProtocolByteEsc) {
+            specialBytes++;
+        }
+    }
+
+    if (specialBytes == 0)
+        return data;
+
+    QByteArray escapedData;
+    escapedData.reserve(data.length() + specialBytes);
+    for (int i = 0; i < data.length(); i++) {
+        quint8 byte = static_cast<quint8>(data.at(i));
+        if (byte == ProtocolByteEnd) {
+            escapedData.append(static_cast<char>(ProtocolByteEsc));
+            escapedData.append(static_cast<char>(ProtocolByteTransposedEnd));
+        } else if (byte == ProtocolByteEsc) {
+            escapedData.append(static_cast<char>(ProtocolByteEsc));
+            escapedData.append(static_cast<char>(ProtocolByteTransposedEsc));
+        } else {
+            escapedData.append(static_cast<char>(byte));
+        }
+    }
+
+    return escapedData;
+}
+
+QList<QByteArray> SlipDataProcessor::serializeFrameSlices(quint16 socketAddress, const QList<QByteArray> &dataSlices)
+{
+    QList<QByteArray> slices;
+
+    // Socket address, big endian
+    QByteArray address;
+    address.append(static_cast<char>(socketAddress >> 8));
+    address.append(static_cast<char>(socketAddress & 0xFF));
+    slices.append(escapeData(address));
+
+    foreach (const QByteArray &data, dataSlices) {
+        if (!data.isEmpty()) {
+            slices.append(escapeData(data));
+        }
+    }
+
+    slices.append(QByteArray(1, static_cast<char>(ProtocolByteEnd)));
+    return slices;
+}
+
 SlipDataProcessor::Frame SlipDataProcessor::parseFrame(const QByteArray &data)
 {
     Frame frame;
@@ -125,3 +176,37 @@ QByteArray SlipDataProcessor::buildFrame(const Frame &frame)
     }
     return data;
 }
+
+QByteArray SlipDataProcessor::buildControlFrame(ControlOpcode opcode, quint64 timestamp)
+{
+    QByteArray data;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    QDataStream stream(&data, QDataStream::WriteOnly);
+#else
+    QDataStream stream(&data, QIODevice::WriteOnly);
+#endif
+    stream << static_cast<quint8>(opcode);
+    stream << timestamp;
+
+    Frame frame;
+    frame.socketAddress = SocketAddressControl;
+    frame.data = data;
+    return serializeData(buildFrame(frame));
+}
+
+bool SlipDataProcessor::parseControlFrame(const QByteArray &data, ControlOpcode *opcode, quint64 *timestamp)
+{
+    if (data.size() != 9)
+        return false;
+
+    quint8 opcodeByte = 0;
+    QDataStream stream(data);
+    stream >> opcodeByte;
+    stream >> *timestamp;
+
+    if (opcodeByte != ControlOpcodePing && opcodeByte != ControlOpcodePong)
+        return false;
+
+    *opcode = static_cast<ControlOpcode>(opcodeByte);
+    return true;
+}
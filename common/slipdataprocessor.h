@@ -46,6 +46,21 @@ public:
     };
     Q_ENUM(ProtocolByte)
 
+    // Reserved socket addresses, never assigned to a tunnel client
+    enum SocketAddress {
+        SocketAddressJsonRpc = 0x0000,
+        SocketAddressControl = 0xFFFF
+    };
+    Q_ENUM(SocketAddress)
+
+    // Frames on the control address carry an opcode (1 byte) and
+    // a timestamp in ms since epoch (8 bytes, big endian)
+    enum ControlOpcode {
+        ControlOpcodePing = 0x01,
+        ControlOpcodePong = 0x02
+    };
+    Q_ENUM(ControlOpcode)
+
     typedef struct Frame {
         quint16 socketAddress;
         QByteArray data;
@@ -56,9 +71,18 @@ public:
     static QByteArray deserializeData(const QByteArray &data);
     static QByteArray serializeData(const QByteArray &data);
 
+    // Escapes the data without the END byte, the data is shared if nothing needs to be escaped
+    static QByteArray escapeData(const QByteArray &data);
+
+    // Serialized frame as a list of slices for vectored writes. The slices end with the END byte.
+    static QList<QByteArray> serializeFrameSlices(quint16 socketAddress, const QList<QByteArray> &dataSlices);
+
     static Frame parseFrame(const QByteArray &data);
     static QByteArray buildFrame(const Frame &frame);
 
+    static QByteArray buildControlFrame(ControlOpcode opcode, quint64 timestamp);
+    static bool parseControlFrame(const QByteArray &data, ControlOpcode *opcode, quint64 *timestamp);
+
 };
 
 #endif // SLIPDATAPROCESSOR_H
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "tunnelcompression.h"
+
+#include <QtEndian>
+
+#include <limits>
+
+QByteArray TunnelCompression::encodePayload(const QByteArray &data, bool compress)
+{
+    if (compress && data.size() >= minimumSize) {
+        QByteArray compressedData = qCompress(data);
+        if (compressedData.size() < data.size()) {
+            compressedData.prepend(static_cast<char>(PayloadFlagCompressed));
+            return compressedData;
+        }
+    }
+
+    QByteArray payload;
+    payload.reserve(data.size() + 1);
+    payload.append(static_cast<char>(PayloadFlagRaw));
+    payload.append(data);
+    return payload;
+}
+
+bool TunnelCompression::decodePayload(const QByteArray &payload, QByteArray *data, int maximumSize)
+{
+    if (payload.isEmpty())
+        return false;
+
+    // The size header of compressed data comes from the peer, check it before allocating the buffer
+    if (maximumSize >= 0 && decodedSize(payload) > maximumSize)
+        return false;
+
+    switch (static_cast<quint8>(payload.at(0))) {
+    case PayloadFlagRaw:
+        *data = payload.mid(1);
+        return true;
+    case PayloadFlagCompressed:
+        // Note: qUncompress returns an empty array on corrupted data, compressed payloads are never empty
+        *data = qUncompress(reinterpret_cast<const uchar *>(payload.constData() + 1), payload.size() - 1);
+        return !data->isEmpty();
+    default:
+        return false;
+    }
+}
+
+bool TunnelCompression::payloadCompressed(const QByteArray &payload)
+{
+    return !payload.isEmpty() && static_cast<quint8>(payload.at(0)) == PayloadFlagCompressed;
+}
+
+int TunnelCompression::decodedSize(const QByteArray &payload)
+{
+    if (payloadCompressed(payload)) {
+        if (payload.size() < 5)
+            return 0;
+
+        quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(payload.constData() + 1));
+        return static_cast<int>(qMin<quint32>(size, std::numeric_limits<int>::max()));
+    }
+
+    return qMax(0, payload.size() - 1);
+}
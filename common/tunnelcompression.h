@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TUNNELCOMPRESSION_H
+#define TUNNELCOMPRESSION_H
+
+#include <QObject>
+
+// Tunnel data frames of connections which negotiated compression carry a flag byte
+// in front of the payload. Compressed payloads use the zlib based qCompress() format,
+// which starts with the uncompressed size (4 bytes, big endian).
+
+class TunnelCompression
+{
+    Q_GADGET
+
+public:
+    enum PayloadFlag {
+        PayloadFlagRaw = 0x00,
+        PayloadFlagCompressed = 0x01
+    };
+    Q_ENUM(PayloadFlag)
+
+    // Payloads smaller than this are not worth compressing
+    static const int minimumSize = 256;
+
+    explicit TunnelCompression() = default;
+
+    // Adds the flag byte, compresses the data if enabled and worth it
+    static QByteArray encodePayload(const QByteArray &data, bool compress = true);
+
+    // Removes the flag byte and decompresses the data if required. Returns false on invalid payloads
+    // and on payloads which would decode to more than the maximum size, if given.
+    static bool decodePayload(const QByteArray &payload, QByteArray *data, int maximumSize = -1);
+
+    static bool payloadCompressed(const QByteArray &payload);
+
+    // The size of the data once decoded, without decompressing it
+    static int decodedSize(const QByteArray &payload);
+
+};
+
+#endif // TUNNELCOMPRESSION_H
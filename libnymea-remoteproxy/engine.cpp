@@ -29,6 +29,16 @@
 #include "loggingcategories.h"
 #include "../version.h"
 
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
 namespace remoteproxy {
 
 Engine *Engine::s_instance = nullptr;
@@ -69,6 +79,9 @@ void Engine::start(ProxyConfiguration *configuration)
     m_configuration = configuration;
     qCDebug(dcEngine()) << "Using configuration" << m_configuration;
 
+    // The memory report attributes the heap growth from here on to the connections
+    m_baselineHeapInUse = heapInUse();
+
 
     // Tunnel proxy
     // -------------------------------------
@@ -91,6 +104,19 @@ void Engine::start(ProxyConfiguration *configuration)
     tcpSocketServerTunnelProxyUrl.setPort(m_configuration->tcpServerTunnelProxyPort());
     m_tcpSocketServerTunnelProxy->setServerUrl(tcpSocketServerTunnelProxyUrl);
 
+    // Admission control for incoming tcp connections
+    m_admissionController = new AdmissionController(this);
+    m_admissionController->setAcceptRate(m_configuration->admissionAcceptRate());
+    m_admissionController->setAcceptBurst(m_configuration->admissionAcceptBurst());
+    m_admissionController->setMaxPendingHandshakes(m_configuration->admissionMaxPendingHandshakes());
+    m_admissionController->setMaxConnectionsPerAddress(m_configuration->admissionMaxConnectionsPerAddress());
+    m_admissionController->setMaxDeferredConnections(m_configuration->admissionMaxDeferredConnections());
+    m_tcpSocketServerTunnelProxy->setAdmissionController(m_admissionController);
+    connect(m_tunnelProxyServer, &TunnelProxyServer::serverRegistered, m_admissionController, [this](const QUuid &serverUuid, const QHostAddress &address){
+        Q_UNUSED(serverUuid)
+        m_admissionController->addKnownServerAddress(address);
+    });
+
     // Register the transport interfaces in the proxy server
     m_tunnelProxyServer->registerTransportInterface(m_webSocketServerTunnelProxy);
     m_tunnelProxyServer->registerTransportInterface(m_tcpSocketServerTunnelProxy);
@@ -105,6 +131,13 @@ void Engine::start(ProxyConfiguration *configuration)
     m_monitorServer = new MonitorServer(configuration->monitorSocketFileName(), this);
     m_monitorServer->startServer();
 
+    // Metrics server
+    // -------------------------------------
+    if (configuration->metricsEnabled()) {
+        m_metricsServer = new MetricsServer(configuration->metricsHost(), configuration->metricsPort(), this);
+        m_metricsServer->startServer();
+    }
+
     if (configuration->logEngineEnabled())
         m_logEngine->enable();
 
@@ -156,26 +189,82 @@ WebSocketServer *Engine::webSocketServerTunnelProxy() const
     return m_webSocketServerTunnelProxy;
 }
 
+AdmissionController *Engine::admissionController() const
+{
+    return m_admissionController;
+}
+
 MonitorServer *Engine::monitorServer() const
 {
     return m_monitorServer;
 }
 
+MetricsServer *Engine::metricsServer() const
+{
+    return m_metricsServer;
+}
+
 LogEngine *Engine::logEngine() const
 {
     return m_logEngine;
 }
 
 QVariantMap Engine::buildMonitorData(bool printAll)
+{
+    QVariantMap monitorData = buildMonitorStatistics();
+    monitorData.insert("tunnelProxyStatistic", tunnelProxyServer()->currentStatistics(printAll));
+    return monitorData;
+}
+
+QVariantMap Engine::buildMonitorData(const TunnelProxyServerQuery &query)
+{
+    QVariantMap monitorData = buildMonitorStatistics();
+    monitorData.insert("tunnelProxyStatistic", tunnelProxyServer()->queryStatistics(query));
+    return monitorData;
+}
+
+QVariantMap Engine::buildMonitorUpdate(const QVariantMap &tunnelChanges)
+{
+    QVariantMap monitorData = buildMonitorStatistics();
+    monitorData.insert("tunnelProxyStatistic", tunnelProxyServer()->summaryStatistics());
+    foreach (const QString &key, tunnelChanges.keys()) {
+        monitorData.insert(key, tunnelChanges.value(key));
+    }
+    return monitorData;
+}
+
+QVariantMap Engine::buildMonitorStatistics()
 {
     QVariantMap monitorData;
     monitorData.insert("serverName", m_configuration->serverName());
     monitorData.insert("serverVersion", SERVER_VERSION_STRING);
     monitorData.insert("apiVersion", API_VERSION_STRING);
-    monitorData.insert("tunnelProxyStatistic", tunnelProxyServer()->currentStatistics(printAll));
+    monitorData.insert("drain", tunnelProxyServer()->drainStatistics());
+    monitorData.insert("compression", tunnelProxyServer()->compressionStatistics());
+    monitorData.insert("compaction", tunnelProxyServer()->compactionStatistics());
+    monitorData.insert("admission", admissionController()->statistics());
     return monitorData;
 }
 
+QVariantMap Engine::buildMemoryReport()
+{
+    QVariantMap memoryReport = tunnelProxyServer()->memoryStatistics();
+    memoryReport.insert("residentBytes", residentMemory());
+
+    // Average heap growth since the engine started per transport connection. With only idle
+    // servers connected, this is the footprint of one idle server connection including its socket.
+    qint64 heap = heapInUse();
+    int connectionsCount = memoryReport.value("totalClientCount").toInt();
+    qint64 bytesPerConnection = -1;
+    if (heap >= 0 && connectionsCount > 0) {
+        bytesPerConnection = qMax<qint64>(0, heap - m_baselineHeapInUse) / connectionsCount;
+    }
+
+    memoryReport.insert("heapInUse", heap);
+    memoryReport.insert("bytesPerConnection", bytesPerConnection);
+    return memoryReport;
+}
+
 Engine::Engine(QObject *parent) :
     QObject(parent)
 {
@@ -194,6 +283,34 @@ Engine::~Engine()
     stop();
 }
 
+qint64 Engine::residentMemory() const
+{
+#ifdef Q_OS_LINUX
+    // The second field of statm is the resident set size in pages
+    QFile statmFile("/proc/self/statm");
+    if (!statmFile.open(QIODevice::ReadOnly))
+        return -1;
+
+    QList<QByteArray> fields = statmFile.readAll().simplified().split(' ');
+    if (fields.count() < 2)
+        return -1;
+
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+qint64 Engine::heapInUse() const
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<qint64>(info.uordblks + info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
 void Engine::onTimerTick()
 {
     qint64 timestamp = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
@@ -212,6 +329,12 @@ void Engine::onTimerTick()
 
 void Engine::clean()
 {
+    if (m_metricsServer) {
+        m_metricsServer->stopServer();
+        delete m_metricsServer;
+        m_metricsServer = nullptr;
+    }
+
     if (m_monitorServer) {
         m_monitorServer->stopServer();
         delete m_monitorServer;
@@ -239,6 +362,11 @@ void Engine::clean()
         m_unixSocketServerTunnelProxy = nullptr;
     }
 
+    if (m_admissionController) {
+        delete m_admissionController;
+        m_admissionController = nullptr;
+    }
+
     if (m_configuration) {
         delete m_configuration;
         m_configuration = nullptr;
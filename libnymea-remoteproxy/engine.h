@@ -38,7 +38,9 @@
 #include "logengine.h"
 #include "proxyconfiguration.h"
 #include "server/monitorserver.h"
+#include "server/metricsserver.h"
 #include "server/jsonrpcserver.h"
+#include "server/admissioncontroller.h"
 #include "server/tcpsocketserver.h"
 #include "server/websocketserver.h"
 #include "server/unixsocketserver.h"
@@ -70,10 +72,18 @@ public:
     TcpSocketServer *tcpSocketServerTunnelProxy() const;
     WebSocketServer *webSocketServerTunnelProxy() const;
 
+    AdmissionController *admissionController() const;
+
     MonitorServer *monitorServer() const;
+    MetricsServer *metricsServer() const;
     LogEngine *logEngine() const;
 
     QVariantMap buildMonitorData(bool printAll = false);
+    QVariantMap buildMonitorData(const TunnelProxyServerQuery &query);
+
+    // Monitor data for subscribed monitors: the statistics without the tunnel list, together with the tunnel changes
+    QVariantMap buildMonitorUpdate(const QVariantMap &tunnelChanges);
+    QVariantMap buildMemoryReport();
 
 private:
     explicit Engine(QObject *parent = nullptr);
@@ -86,6 +96,12 @@ private:
     qint64 m_runTime = 0;
 
     bool m_running = false;
+    qint64 m_baselineHeapInUse = 0;
+
+    QVariantMap buildMonitorStatistics();
+
+    qint64 residentMemory() const;
+    qint64 heapInUse() const;
 
     ProxyConfiguration *m_configuration = nullptr;
     TunnelProxyServer *m_tunnelProxyServer = nullptr;
@@ -94,7 +110,10 @@ private:
     TcpSocketServer *m_tcpSocketServerTunnelProxy = nullptr;
     WebSocketServer *m_webSocketServerTunnelProxy = nullptr;
 
+    AdmissionController *m_admissionController = nullptr;
+
     MonitorServer *m_monitorServer = nullptr;
+    MetricsServer *m_metricsServer = nullptr;
     LogEngine *m_logEngine = nullptr;
 
 signals:
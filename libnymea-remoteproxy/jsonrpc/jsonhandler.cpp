@@ -87,16 +87,41 @@ bool JsonHandler::hasMethod(const QString &methodName)
     return m_descriptions.contains(methodName) && m_params.contains(methodName) && m_returns.contains(methodName);
 }
 
+QHash<QString, JsonHandler::Method> JsonHandler::methods() const
+{
+    return m_methods;
+}
+
+QHash<QString, JsonHandler::ObjectMethod> JsonHandler::objectMethods() const
+{
+    return m_objectMethods;
+}
+
 QPair<bool, QString> JsonHandler::validateParams(const QString &methodName, const QVariantMap &params)
 {
-    QVariantMap paramTemplate = m_params.value(methodName);
-    return JsonTypes::validateMap(paramTemplate, params);
+    QHash<QString, JsonValidator>::const_iterator it = m_paramsValidators.constFind(methodName);
+    if (it == m_paramsValidators.constEnd())
+        return JsonTypes::validateMap(QVariantMap(), params);
+
+    return JsonTypes::validateMap(it.value(), params);
+}
+
+bool JsonHandler::validateParams(const QString &methodName, const QJsonObject &params)
+{
+    QHash<QString, JsonValidator>::const_iterator it = m_paramsValidators.constFind(methodName);
+    if (it == m_paramsValidators.constEnd())
+        return params.isEmpty();
+
+    return JsonTypes::validateObject(it.value(), params);
 }
 
 QPair<bool, QString> JsonHandler::validateReturns(const QString &methodName, const QVariantMap &returns)
 {
-    QVariantMap returnsTemplate = m_returns.value(methodName);
-    return JsonTypes::validateMap(returnsTemplate, returns);
+    QHash<QString, JsonValidator>::const_iterator it = m_returnsValidators.constFind(methodName);
+    if (it == m_returnsValidators.constEnd())
+        return JsonTypes::validateMap(QVariantMap(), returns);
+
+    return JsonTypes::validateMap(it.value(), returns);
 }
 
 void JsonHandler::setDescription(const QString &methodName, const QString &description)
@@ -117,6 +142,7 @@ void JsonHandler::setParams(const QString &methodName, const QVariantMap &params
         QMetaMethod method = metaObject()->method(i);
         if (method.name() == methodName) {
             m_params.insert(methodName, params);
+            m_paramsValidators.insert(methodName, JsonTypes::compileValidator(params));
             return;
         }
     }
@@ -129,6 +155,7 @@ void JsonHandler::setReturns(const QString &methodName, const QVariantMap &retur
         QMetaMethod method = metaObject()->method(i);
         if (method.name() == methodName) {
             m_returns.insert(methodName, returns);
+            m_returnsValidators.insert(methodName, JsonTypes::compileValidator(returns));
             return;
         }
     }
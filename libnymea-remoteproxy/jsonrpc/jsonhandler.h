@@ -32,16 +32,26 @@
 #include <QTimer>
 #include <QObject>
 #include <QVariantMap>
+#include <QJsonObject>
 #include <QMetaMethod>
 
+#include <functional>
+
+#include "jsonvalidator.h"
+
 namespace remoteproxy {
 
 class JsonReply;
+class TransportClient;
 
 class JsonHandler : public QObject
 {
     Q_OBJECT
 public:
+    typedef std::function<JsonReply *(const QVariantMap &params, TransportClient *transportClient)> Method;
+    // Hot path methods read the request params straight from the parsed JSON object
+    typedef std::function<JsonReply *(const QJsonObject &params, TransportClient *transportClient)> ObjectMethod;
+
     explicit JsonHandler(QObject *parent = nullptr);
 
     virtual QString name() const = 0;
@@ -49,13 +59,20 @@ public:
     QVariantMap introspect(const QMetaMethod::MethodType &type);
 
     bool hasMethod(const QString &methodName);
+    QHash<QString, Method> methods() const;
+    QHash<QString, ObjectMethod> objectMethods() const;
     QPair<bool, QString> validateParams(const QString &methodName, const QVariantMap &params);
+    bool validateParams(const QString &methodName, const QJsonObject &params);
     QPair<bool, QString> validateReturns(const QString &methodName, const QVariantMap &returns);
 
 private:
     QHash<QString, QString> m_descriptions;
     QHash<QString, QVariantMap> m_params;
     QHash<QString, QVariantMap> m_returns;
+    QHash<QString, JsonValidator> m_paramsValidators;
+    QHash<QString, JsonValidator> m_returnsValidators;
+    QHash<QString, Method> m_methods;
+    QHash<QString, ObjectMethod> m_objectMethods;
 
 signals:
     void asyncReply(int id, const QVariantMap &params);
@@ -65,10 +82,44 @@ protected:
     void setParams(const QString &methodName, const QVariantMap &params);
     void setReturns(const QString &methodName, const QVariantMap &returns);
 
+    template <typename Handler>
+    void registerMethod(const QString &methodName, JsonReply *(Handler::*method)(const QVariantMap &, TransportClient *));
+    template <typename Handler>
+    void registerMethod(const QString &methodName, JsonReply *(Handler::*method)(const QVariantMap &, TransportClient *) const);
+    template <typename Handler>
+    void registerMethod(const QString &methodName, JsonReply *(Handler::*method)(const QJsonObject &, TransportClient *));
+
     JsonReply *createReply(const QString &method, const QVariantMap &data) const;
     JsonReply *createAsyncReply(const QString &method) const;
 };
 
+template <typename Handler>
+void JsonHandler::registerMethod(const QString &methodName, JsonReply *(Handler::*method)(const QVariantMap &, TransportClient *))
+{
+    Handler *handler = static_cast<Handler *>(this);
+    m_methods.insert(methodName, [handler, method](const QVariantMap &params, TransportClient *transportClient) {
+        return (handler->*method)(params, transportClient);
+    });
+}
+
+template <typename Handler>
+void JsonHandler::registerMethod(const QString &methodName, JsonReply *(Handler::*method)(const QVariantMap &, TransportClient *) const)
+{
+    const Handler *handler = static_cast<const Handler *>(this);
+    m_methods.insert(methodName, [handler, method](const QVariantMap &params, TransportClient *transportClient) {
+        return (handler->*method)(params, transportClient);
+    });
+}
+
+template <typename Handler>
+void JsonHandler::registerMethod(const QString &methodName, JsonReply *(Handler::*method)(const QJsonObject &, TransportClient *))
+{
+    Handler *handler = static_cast<Handler *>(this);
+    m_objectMethods.insert(methodName, [handler, method](const QJsonObject &params, TransportClient *transportClient) {
+        return (handler->*method)(params, transportClient);
+    });
+}
+
 }
 
 #endif // JSONHANDLER_H
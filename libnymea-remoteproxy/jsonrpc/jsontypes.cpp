@@ -27,6 +27,7 @@
 
 #include "jsontypes.h"
 #include <QStringList>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QDebug>
 #include <QRegularExpression>
@@ -246,6 +247,273 @@ QPair<bool, QString> JsonTypes::validateBasicType(const QVariant &variant)
     return report(false, QString("Error validating basic type %1.").arg(variant.toString()));
 }
 
+JsonValidator JsonTypes::compileValidator(const QVariant &templateVariant)
+{
+    if (!s_initialized)
+        init();
+
+    JsonValidator validator;
+    validator.name = templateVariant.toString();
+
+    switch(templateVariant.type()) {
+    case QVariant::String: {
+        QString templateString = templateVariant.toString();
+        if (templateString.startsWith("$ref:")) {
+            if (templateString == basicTypeRef()) {
+                validator.type = JsonValidator::TypeBasicType;
+            } else if (templateString == tunnelProxyErrorRef()) {
+                validator.type = JsonValidator::TypeEnum;
+                foreach (const QVariant &enumValue, s_tunnelProxyError) {
+                    validator.enumValues.append(enumValue.toString());
+                }
+            } else {
+                Q_ASSERT_X(false, "JsonTypes", QString("Unhandled ref: %1").arg(templateString).toLatin1().data());
+            }
+        } else if (templateString == basicTypeToString(JsonTypes::Variant)) {
+            validator.type = JsonValidator::TypeVariant;
+        } else if (templateString == basicTypeToString(JsonTypes::Object)) {
+            validator.type = JsonValidator::TypeObject;
+        } else if (templateString == basicTypeToString(QVariant::Uuid)) {
+            validator.type = JsonValidator::TypeUuid;
+        } else if (templateString == basicTypeToString(QVariant::String)) {
+            validator.type = JsonValidator::TypeString;
+        } else if (templateString == basicTypeToString(QVariant::Int)) {
+            validator.type = JsonValidator::TypeInt;
+        } else if (templateString == basicTypeToString(QVariant::UInt)) {
+            validator.type = JsonValidator::TypeUInt;
+        } else if (templateString == basicTypeToString(QVariant::Double)) {
+            validator.type = JsonValidator::TypeDouble;
+        } else if (templateString == basicTypeToString(QVariant::Bool)) {
+            validator.type = JsonValidator::TypeBool;
+        }
+        break;
+    }
+    case QVariant::Map: {
+        validator.type = JsonValidator::TypeMap;
+        QVariantMap templateMap = templateVariant.toMap();
+        foreach (const QString &key, templateMap.keys()) {
+            JsonValidator entryValidator = compileValidator(templateMap.value(key));
+            entryValidator.optional = key.startsWith("o:");
+            entryValidator.key = entryValidator.optional ? key.mid(2) : key;
+            validator.children.append(entryValidator);
+        }
+        break;
+    }
+    case QVariant::List: {
+        validator.type = JsonValidator::TypeList;
+        QVariantList templateList = templateVariant.toList();
+        Q_ASSERT(templateList.count() == 1);
+        if (!templateList.isEmpty())
+            validator.children.append(compileValidator(templateList.first()));
+
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (validator.type == JsonValidator::TypeInvalid)
+        qCWarning(dcJsonRpc()) << "Unhandled template value" << templateVariant;
+
+    return validator;
+}
+
+QPair<bool, QString> JsonTypes::validateMap(const JsonValidator &validator, const QVariantMap &map)
+{
+    // Make sure all values defined in the template are around
+    for (int i = 0; i < validator.children.count(); i++) {
+        const JsonValidator &entryValidator = validator.children.at(i);
+        QVariantMap::const_iterator it = map.constFind(entryValidator.key);
+        if (it == map.constEnd()) {
+            if (entryValidator.optional)
+                continue;
+
+            qCWarning(dcJsonRpc()) << "*** missing key" << entryValidator.key;
+            qCWarning(dcJsonRpc()) << "Got:           " << map;
+            QJsonDocument jsonDoc = QJsonDocument::fromVariant(map);
+            return report(false, QString("Missing key %1 in %2").arg(entryValidator.key).arg(QString(jsonDoc.toJson())));
+        }
+
+        QPair<bool, QString> result = validateVariant(entryValidator, it.value());
+        if (!result.first) {
+            qCWarning(dcJsonRpc()) << "Object not matching template" << entryValidator.name << it.value();
+            return result;
+        }
+    }
+
+    // Make sure there aren't any other parameters than the allowed ones
+    for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        bool allowed = false;
+        for (int i = 0; i < validator.children.count(); i++) {
+            if (validator.children.at(i).key == it.key()) {
+                allowed = true;
+                break;
+            }
+        }
+
+        if (!allowed) {
+            qCWarning(dcJsonRpc()) << "Forbidden param" << it.key() << "in params";
+            QJsonDocument jsonDoc = QJsonDocument::fromVariant(map);
+            return report(false, QString("Forbidden key \"%1\" in %2").arg(it.key()).arg(QString(jsonDoc.toJson())));
+        }
+    }
+
+    return report(true, QString());
+}
+
+QPair<bool, QString> JsonTypes::validateVariant(const JsonValidator &validator, const QVariant &variant)
+{
+    switch (validator.type) {
+    case JsonValidator::TypeVariant:
+    case JsonValidator::TypeObject:
+        return report(true, QString());
+    case JsonValidator::TypeUuid:
+        if (!variant.canConvert(QVariant::Uuid))
+            return report(false, QString("Param %1 is not a uuid.").arg(variant.toString()));
+
+        return report(true, QString());
+    case JsonValidator::TypeString:
+        if (!variant.canConvert(QVariant::String))
+            return report(false, QString("Param %1 is not a string.").arg(variant.toString()));
+
+        return report(true, QString());
+    case JsonValidator::TypeInt:
+        if (!variant.canConvert(QVariant::Int))
+            return report(false, QString("Param %1 is not a int.").arg(variant.toString()));
+
+        return report(true, QString());
+    case JsonValidator::TypeUInt:
+        if (!variant.canConvert(QVariant::UInt))
+            return report(false, QString("Param %1 is not a int.").arg(variant.toString()));
+
+        return report(true, QString());
+    case JsonValidator::TypeDouble:
+        if (!variant.canConvert(QVariant::Double))
+            return report(false, QString("Param %1 is not a double.").arg(variant.toString()));
+
+        return report(true, QString());
+    case JsonValidator::TypeBool:
+        if (!variant.canConvert(QVariant::Bool))
+            return report(false, QString("Param %1 is not a bool.").arg(variant.toString()));
+
+        return report(true, QString());
+    case JsonValidator::TypeBasicType: {
+        QPair<bool, QString> result = validateBasicType(variant);
+        if (!result.first)
+            qCWarning(dcJsonRpc()) << QString("Value %1 not allowed in %2").arg(variant.toString()).arg(basicTypeRef());
+
+        return result;
+    }
+    case JsonValidator::TypeEnum:
+        if (!validator.enumValues.contains(variant.toString())) {
+            QString errorMessage = QString("Value %1 not allowed in %2").arg(variant.toString()).arg(validator.enumValues.join(", "));
+            qCWarning(dcJsonRpc()) << errorMessage;
+            return report(false, errorMessage);
+        }
+
+        return report(true, QString());
+    case JsonValidator::TypeMap:
+        return validateMap(validator, variant.toMap());
+    case JsonValidator::TypeList: {
+        if (validator.children.isEmpty())
+            return report(true, QString());
+
+        const QVariantList list = variant.toList();
+        for (int i = 0; i < list.count(); ++i) {
+            QPair<bool, QString> result = validateVariant(validator.children.first(), list.at(i));
+            if (!result.first) {
+                qCWarning(dcJsonRpc()) << "List entry not matching template";
+                return result;
+            }
+        }
+
+        return report(true, QString());
+    }
+    case JsonValidator::TypeInvalid:
+        break;
+    }
+
+    qCWarning(dcJsonRpc()) << QString("Unhandled property type: %1 (expected: %2)").arg(variant.toString()).arg(validator.name);
+    return report(false, QString("Unhandled property type: %1 (expected: %2)").arg(variant.toString()).arg(validator.name));
+}
+
+bool JsonTypes::validateObject(const JsonValidator &validator, const QJsonObject &object)
+{
+    // Make sure all values defined in the template are around
+    for (int i = 0; i < validator.children.count(); i++) {
+        const JsonValidator &entryValidator = validator.children.at(i);
+        QJsonObject::const_iterator it = object.constFind(entryValidator.key);
+        if (it == object.constEnd()) {
+            if (entryValidator.optional)
+                continue;
+
+            return false;
+        }
+
+        if (!validateValue(entryValidator, it.value()))
+            return false;
+    }
+
+    // Make sure there aren't any other parameters than the allowed ones
+    for (QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it) {
+        bool allowed = false;
+        for (int i = 0; i < validator.children.count(); i++) {
+            if (validator.children.at(i).key == it.key()) {
+                allowed = true;
+                break;
+            }
+        }
+
+        if (!allowed)
+            return false;
+    }
+
+    return true;
+}
+
+bool JsonTypes::validateValue(const JsonValidator &validator, const QJsonValue &value)
+{
+    // Note: this is stricter than the QVariant based validation, a value rejected
+    // here gets validated once more the generic way in order to report the error.
+    switch (validator.type) {
+    case JsonValidator::TypeVariant:
+    case JsonValidator::TypeObject:
+        return true;
+    case JsonValidator::TypeUuid:
+        return value.isString();
+    case JsonValidator::TypeString:
+    case JsonValidator::TypeInt:
+    case JsonValidator::TypeUInt:
+    case JsonValidator::TypeDouble:
+    case JsonValidator::TypeBool:
+        return value.isString() || value.isDouble() || value.isBool();
+    case JsonValidator::TypeEnum:
+        return value.isString() && validator.enumValues.contains(value.toString());
+    case JsonValidator::TypeMap:
+        return value.isObject() && validateObject(validator, value.toObject());
+    case JsonValidator::TypeList: {
+        if (!value.isArray())
+            return false;
+
+        if (validator.children.isEmpty())
+            return true;
+
+        const QJsonArray array = value.toArray();
+        for (QJsonArray::const_iterator it = array.constBegin(); it != array.constEnd(); ++it) {
+            if (!validateValue(validator.children.first(), *it)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case JsonValidator::TypeBasicType:
+    case JsonValidator::TypeInvalid:
+        break;
+    }
+
+    return false;
+}
+
 QString JsonTypes::basicTypeToString(const QVariant::Type &type)
 {
     switch (type) {
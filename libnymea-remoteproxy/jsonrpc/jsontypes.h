@@ -30,9 +30,12 @@
 
 #include <QObject>
 #include <QVariant>
+#include <QJsonValue>
+#include <QJsonObject>
 #include <QMetaEnum>
 #include <QStringList>
 
+#include "jsonvalidator.h"
 #include "tunnelproxy/tunnelproxyserver.h"
 
 namespace remoteproxy {
@@ -102,6 +105,13 @@ public:
     static QPair<bool, QString> validateList(const QVariantList &templateList, const QVariantList &list);
     static QPair<bool, QString> validateBasicType(const QVariant &variant);
 
+    // Pre-compiled validation
+    static JsonValidator compileValidator(const QVariant &templateVariant);
+    static QPair<bool, QString> validateMap(const JsonValidator &validator, const QVariantMap &map);
+    static QPair<bool, QString> validateVariant(const JsonValidator &validator, const QVariant &variant);
+    static bool validateObject(const JsonValidator &validator, const QJsonObject &object);
+    static bool validateValue(const JsonValidator &validator, const QJsonValue &value);
+
     // Converter
     static QString basicTypeToString(const QVariant::Type &type);
 
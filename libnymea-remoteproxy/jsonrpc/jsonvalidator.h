@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONVALIDATOR_H
+#define JSONVALIDATOR_H
+
+#include <QString>
+#include <QVector>
+#include <QStringList>
+
+namespace remoteproxy {
+
+// Validator tree compiled once from a params or returns template by JsonTypes::compileValidator().
+// Validating a value against it only walks the tree and does not allocate unless validation fails.
+struct JsonValidator
+{
+    enum Type {
+        TypeInvalid,
+        TypeUuid,
+        TypeString,
+        TypeInt,
+        TypeUInt,
+        TypeDouble,
+        TypeBool,
+        TypeVariant,
+        TypeObject,
+        TypeBasicType,
+        TypeEnum,
+        TypeMap,
+        TypeList
+    };
+
+    Type type = TypeInvalid;
+
+    // Map entries only
+    QString key;
+    bool optional = false;
+
+    // The template string for error reporting
+    QString name;
+
+    // TypeEnum: allowed values, TypeMap: entries, TypeList: the entry template
+    QStringList enumValues;
+    QVector<JsonValidator> children;
+};
+
+}
+
+#endif // JSONVALIDATOR_H
@@ -32,6 +32,7 @@
 #include "loggingcategories.h"
 
 #include "tunnelproxy/tunnelproxyserver.h"
+#include "tunnelproxy/tunnelproxyclient.h"
 
 namespace remoteproxy {
 
@@ -42,13 +43,20 @@ TunnelProxyHandler::TunnelProxyHandler(QObject *parent) : JsonHandler(parent)
 
     // Server
     params.clear(); returns.clear();
-    setDescription("RegisterServer", "Register a new TunnelProxy server on this instance. Multiple TunnelProxy clients can be connected to the registered server on success.");
+    setDescription("RegisterServer", "Register a new TunnelProxy server on this instance. Multiple TunnelProxy clients can be connected to the registered server on success. "
+                                     "Once registered, additional servers can be registered on the same connection using SLIP frames on socket address 0x0000. "
+                                     "All servers of a connection share the socket address space. "
+                                     "If compression is requested and enabled on this instance, the tunnel data frames carry a flag byte "
+                                     "(0x00 raw, 0x01 qCompress) in front of the payload.");
     params.insert("serverName", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("serverUuid", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("o:compression", JsonTypes::basicTypeToString(JsonTypes::Bool));
     setParams("RegisterServer", params);
     returns.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorRef());
     returns.insert("slipEnabled", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    returns.insert("o:compression", JsonTypes::basicTypeToString(JsonTypes::Bool));
     setReturns("RegisterServer", returns);
+    registerMethod("RegisterServer", &TunnelProxyHandler::RegisterServer);
 
     params.clear(); returns.clear();
     setDescription("DisconnectClient", "A registered server can ask the remote proxy connection to disconnect a client for whatever reason.");
@@ -56,6 +64,7 @@ TunnelProxyHandler::TunnelProxyHandler(QObject *parent) : JsonHandler(parent)
     setParams("DisconnectClient", params);
     returns.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorRef());
     setReturns("DisconnectClient", returns);
+    registerMethod("DisconnectClient", &TunnelProxyHandler::DisconnectClient);
 
     params.clear(); returns.clear();
     setDescription("Ping", "In order to keep a connection alive when no client is connected, this Ping method can be used. The sent timestamp will be returned as sent in the response for speed measuements on the client side.");
@@ -63,28 +72,47 @@ TunnelProxyHandler::TunnelProxyHandler(QObject *parent) : JsonHandler(parent)
     setParams("Ping", params);
     returns.insert("timestamp", JsonTypes::basicTypeToString(JsonTypes::UInt));
     setReturns("Ping", returns);
+    registerMethod("Ping", &TunnelProxyHandler::Ping);
 
     // Client
     params.clear(); returns.clear();
     setDescription("RegisterClient", "Register a new TunnelProxy client on TunnelProxy server with the given serverUuid. "
-                                     "On success, the remote connection has been accepted and any further data will come from the connected server.");
+                                     "On success, the remote connection has been accepted and any further data will come from the connected server. "
+                                     "If multiplexed is set, the connection switches to SLIP frames and the tunnel data uses the returned channel as socket address. "
+                                     "Additional tunnels can then be registered on the same connection using SLIP frames on socket address 0x0000, "
+                                     "each with its own clientUuid. Multiplexed connections can request compression like servers do.");
     params.insert("clientName", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("clientUuid", JsonTypes::basicTypeToString(JsonTypes::Uuid));
     params.insert("serverUuid", JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    params.insert("o:multiplexed", JsonTypes::basicTypeToString(JsonTypes::Bool));
+    params.insert("o:compression", JsonTypes::basicTypeToString(JsonTypes::Bool));
     setParams("RegisterClient", params);
     returns.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorRef());
+    returns.insert("o:channel", JsonTypes::basicTypeToString(JsonTypes::UInt));
+    returns.insert("o:compression", JsonTypes::basicTypeToString(JsonTypes::Bool));
     setReturns("RegisterClient", returns);
+    registerMethod("RegisterClient", &TunnelProxyHandler::RegisterClient);
+
+    params.clear(); returns.clear();
+    setDescription("CloseTunnel", "A multiplexed client can close one of its tunnels. The other tunnels on the connection stay open.");
+    params.insert("channel", JsonTypes::basicTypeToString(JsonTypes::UInt));
+    setParams("CloseTunnel", params);
+    returns.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorRef());
+    setReturns("CloseTunnel", returns);
+    registerMethod("CloseTunnel", &TunnelProxyHandler::CloseTunnel);
 
     // Notifications
 
     // Server
     params.clear(); returns.clear();
     setDescription("ClientConnected", "Emitted whenever a new client has been connected to a registered server. "
-                   "Only tunnel proxy clients registered as server will receive this notification. The socket address will be used for framing.");
+                   "Only tunnel proxy clients registered as server will receive this notification. The socket address will be used for framing "
+                   "and is unique for all servers registered on the same connection. The serverUuid identifies the server the client connected to.");
     params.insert("clientName", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("clientUuid", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("clientPeerAddress", JsonTypes::basicTypeToString(JsonTypes::String));
     params.insert("socketAddress", JsonTypes::basicTypeToString(JsonTypes::UInt));
+    params.insert("serverUuid", JsonTypes::basicTypeToString(JsonTypes::Uuid));
     setParams("ClientConnected", params);
 
     params.clear(); returns.clear();
@@ -92,6 +120,19 @@ TunnelProxyHandler::TunnelProxyHandler(QObject *parent) : JsonHandler(parent)
                    "Only tunnel proxy clients registered as server will receive this notification.");
     params.insert("socketAddress", JsonTypes::basicTypeToString(JsonTypes::UInt));
     setParams("ClientDisconnected", params);
+
+    params.clear(); returns.clear();
+    setDescription("ReconnectRequested", "Emitted when this proxy instance is draining. The server should reconnect, ideally to another instance, "
+                   "once the currently connected clients are gone. The proxy closes the server connection as soon as there are no clients left.");
+    params.insert("reason", JsonTypes::basicTypeToString(JsonTypes::String));
+    setParams("ReconnectRequested", params);
+
+    // Client
+    params.clear(); returns.clear();
+    setDescription("TunnelClosed", "Emitted whenever a tunnel of a multiplexed client connection has been closed by the server. "
+                   "Only tunnel proxy clients registered as multiplexed client will receive this notification.");
+    params.insert("channel", JsonTypes::basicTypeToString(JsonTypes::UInt));
+    setParams("TunnelClosed", params);
 }
 
 QString TunnelProxyHandler::name() const
@@ -99,22 +140,26 @@ QString TunnelProxyHandler::name() const
     return "TunnelProxy";
 }
 
-JsonReply *TunnelProxyHandler::RegisterServer(const QVariantMap &params, TransportClient *transportClient)
+JsonReply *TunnelProxyHandler::RegisterServer(const QJsonObject &params, TransportClient *transportClient)
 {
     qCDebug(dcJsonRpc()) << name() << "register server" << params << transportClient;
-    QUuid serverUuid = params.value("serverUuid").toUuid();
+    QUuid serverUuid = QUuid(params.value(QLatin1String("serverUuid")).toString());
     TunnelProxyServer::TunnelProxyError error = TunnelProxyServer::TunnelProxyErrorNoError;
     if (serverUuid.isNull()) {
-        qCWarning(dcJsonRpc()) << "Invalid uuid received" << params.value("serverUuid").toString() << serverUuid;
+        qCWarning(dcJsonRpc()) << "Invalid uuid received" << params.value(QLatin1String("serverUuid")).toString() << serverUuid;
         error = TunnelProxyServer::TunnelProxyErrorInvalidUuid;
     } else {
-        QString serverName = params.value("serverName").toString();
-        error = Engine::instance()->tunnelProxyServer()->registerServer(transportClient->clientId(), serverUuid, serverName);
+        QString serverName = params.value(QLatin1String("serverName")).toString();
+        bool compression = params.value(QLatin1String("compression")).toBool(false);
+        error = Engine::instance()->tunnelProxyServer()->registerServer(transportClient->clientId(), serverUuid, serverName, compression);
     }
 
     QVariantMap response;
     response.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorToString(error));
     response.insert("slipEnabled", error == TunnelProxyServer::TunnelProxyErrorNoError);
+    if (error == TunnelProxyServer::TunnelProxyErrorNoError) {
+        response.insert("compression", static_cast<TunnelProxyClient *>(transportClient)->compressionEnabled());
+    }
     return createReply("RegisterServer", response);
 }
 
@@ -138,26 +183,45 @@ JsonReply *TunnelProxyHandler::Ping(const QVariantMap &params, TransportClient *
     return createReply("Ping", response);
 }
 
-JsonReply *TunnelProxyHandler::RegisterClient(const QVariantMap &params, TransportClient *transportClient)
+JsonReply *TunnelProxyHandler::RegisterClient(const QJsonObject &params, TransportClient *transportClient)
 {
     qCDebug(dcJsonRpc()) << name() << "register client" << params << transportClient;
-    QString clientName = params.value("clientName").toString();
-    QUuid clientUuid = params.value("clientUuid").toUuid();
-    QUuid serverUuid = params.value("serverUuid").toUuid();
+    QString clientName = params.value(QLatin1String("clientName")).toString();
+    QUuid clientUuid = QUuid(params.value(QLatin1String("clientUuid")).toString());
+    QUuid serverUuid = QUuid(params.value(QLatin1String("serverUuid")).toString());
+    bool multiplexed = params.value(QLatin1String("multiplexed")).toBool(false);
+    bool compression = params.value(QLatin1String("compression")).toBool(false);
+    quint16 channel = 0;
     TunnelProxyServer::TunnelProxyError error = TunnelProxyServer::TunnelProxyErrorNoError;
     if (serverUuid.isNull()) {
-        qCWarning(dcJsonRpc()) << "Invalid server uuid received" << params.value("serverUuid").toString() << serverUuid;
+        qCWarning(dcJsonRpc()) << "Invalid server uuid received" << params.value(QLatin1String("serverUuid")).toString() << serverUuid;
         error = TunnelProxyServer::TunnelProxyErrorInvalidUuid;
     } else if (clientUuid.isNull()) {
-        qCWarning(dcJsonRpc()) << "Invalid client uuid received" << params.value("clientUuid").toString() << clientUuid;
+        qCWarning(dcJsonRpc()) << "Invalid client uuid received" << params.value(QLatin1String("clientUuid")).toString() << clientUuid;
         error = TunnelProxyServer::TunnelProxyErrorInvalidUuid;
     } else {
-        error = Engine::instance()->tunnelProxyServer()->registerClient(transportClient->clientId(), clientUuid, clientName, serverUuid);
+        error = Engine::instance()->tunnelProxyServer()->registerClient(transportClient->clientId(), clientUuid, clientName, serverUuid, multiplexed, compression, &channel);
     }
 
     QVariantMap response;
     response.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorToString(error));
+    if (error == TunnelProxyServer::TunnelProxyErrorNoError && channel != 0) {
+        response.insert("channel", channel);
+        response.insert("compression", static_cast<TunnelProxyClient *>(transportClient)->compressionEnabled());
+    }
+
     return createReply("RegisterClient", response);
 }
 
+JsonReply *TunnelProxyHandler::CloseTunnel(const QVariantMap &params, TransportClient *transportClient)
+{
+    qCDebug(dcJsonRpc()) << name() << "close tunnel requested" << params << transportClient;
+    quint16 channel = static_cast<quint16>(params.value("channel").toUInt());
+    TunnelProxyServer::TunnelProxyError error = Engine::instance()->tunnelProxyServer()->closeTunnel(transportClient->clientId(), channel);
+
+    QVariantMap response;
+    response.insert("tunnelProxyError", JsonTypes::tunnelProxyErrorToString(error));
+    return createReply("CloseTunnel", response);
+}
+
 }
@@ -12,18 +12,26 @@ HEADERS += \
     jsonrpc/jsonhandler.h \
     jsonrpc/jsonreply.h \
     jsonrpc/jsontypes.h \
+    jsonrpc/jsonvalidator.h \
     jsonrpc/tunnelproxyhandler.h \
     server/tcpsocketserver.h \
     server/transportinterface.h \
     server/unixsocketserver.h \
     server/websocketserver.h \
     server/jsonrpcserver.h \
+    server/admissioncontroller.h \
+    server/loghistogram.h \
+    server/heavyhitters.h \
+    server/metricsserver.h \
     server/transportclient.h \
+    server/monitorfeed.h \
     server/monitorserver.h \
+    server/slaballocator.h \
     tunnelproxy/tunnelproxyclient.h \
     tunnelproxy/tunnelproxyclientconnection.h \
     tunnelproxy/tunnelproxyserver.h \
-    tunnelproxy/tunnelproxyserverconnection.h
+    tunnelproxy/tunnelproxyserverconnection.h \
+    tunnelproxy/tunnelproxyserverindex.h
 
 SOURCES += \
     engine.cpp \
@@ -40,11 +48,17 @@ SOURCES += \
     server/unixsocketserver.cpp \
     server/websocketserver.cpp \
     server/jsonrpcserver.cpp \
+    server/admissioncontroller.cpp \
+    server/loghistogram.cpp \
+    server/heavyhitters.cpp \
+    server/metricsserver.cpp \
+    server/monitorfeed.cpp \
     server/monitorserver.cpp \
     tunnelproxy/tunnelproxyclient.cpp \
     tunnelproxy/tunnelproxyclientconnection.cpp \
     tunnelproxy/tunnelproxyserver.cpp \
-    tunnelproxy/tunnelproxyserverconnection.cpp
+    tunnelproxy/tunnelproxyserverconnection.cpp \
+    tunnelproxy/tunnelproxyserverindex.cpp
 
 
 # install header file with relative subdirectory
@@ -38,6 +38,7 @@ Q_LOGGING_CATEGORY(dcWebSocketServerTraffic, "WebSocketServerTraffic")
 Q_LOGGING_CATEGORY(dcTunnelProxyServer, "TunnelProxyServer")
 Q_LOGGING_CATEGORY(dcTunnelProxyServerTraffic, "TunnelProxyServerTraffic")
 Q_LOGGING_CATEGORY(dcMonitorServer, "MonitorServer")
+Q_LOGGING_CATEGORY(dcMetricsServer, "MetricsServer")
 Q_LOGGING_CATEGORY(dcUnixSocketServer, "UnixSocketServer")
 Q_LOGGING_CATEGORY(dcUnixSocketServerTraffic, "UnixSocketServerTraffic")
 
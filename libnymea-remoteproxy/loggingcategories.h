@@ -42,6 +42,7 @@ Q_DECLARE_LOGGING_CATEGORY(dcTcpSocketServerTraffic)
 Q_DECLARE_LOGGING_CATEGORY(dcTunnelProxyServer)
 Q_DECLARE_LOGGING_CATEGORY(dcTunnelProxyServerTraffic)
 Q_DECLARE_LOGGING_CATEGORY(dcMonitorServer)
+Q_DECLARE_LOGGING_CATEGORY(dcMetricsServer)
 Q_DECLARE_LOGGING_CATEGORY(dcUnixSocketServer)
 Q_DECLARE_LOGGING_CATEGORY(dcUnixSocketServerTraffic)
 
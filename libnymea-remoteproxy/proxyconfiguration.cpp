@@ -58,8 +58,25 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
     setLogFileName(settings.value("logFile", "/var/log/nymea-remoteproxy.log").toString());
     setLogEngineEnabled(settings.value("logEngineEnabled", false).toBool());
     setMonitorSocketFileName(settings.value("monitorSocket", "/tmp/nymea-remoteproxy.monitor").toString());
+    setMonitorUpdateInterval(settings.value("monitorUpdateInterval", 1000).toInt());
     setJsonRpcTimeout(settings.value("jsonRpcTimeout", 10000).toInt());
     setInactiveTimeout(settings.value("inactiveTimeout", 8000).toInt());
+    setDrainWindow(settings.value("drainWindow", 60000).toInt());
+    setTunnelCompressionEnabled(settings.value("tunnelCompression", true).toBool());
+    setMaxFrameSize(settings.value("maxFrameSize", 4194304).toInt());
+    setOutputCorkSize(settings.value("outputCorkSize", 16384).toInt());
+    setOutputCorkTime(settings.value("outputCorkTime", 0).toInt());
+    setIdleCompactionTime(settings.value("idleCompactionTime", 30000).toInt());
+    setRateAlertThreshold(settings.value("rateAlertThreshold", 0).toLongLong());
+    setProbeInterval(settings.value("probeInterval", 30000).toInt());
+    settings.endGroup();
+
+    settings.beginGroup("AdmissionControl");
+    setAdmissionAcceptRate(settings.value("acceptRate", 100).toInt());
+    setAdmissionAcceptBurst(settings.value("acceptBurst", 200).toInt());
+    setAdmissionMaxPendingHandshakes(settings.value("maxPendingHandshakes", 100).toInt());
+    setAdmissionMaxConnectionsPerAddress(settings.value("maxConnectionsPerAddress", 0).toInt());
+    setAdmissionMaxDeferredConnections(settings.value("maxDeferredConnections", 1000).toInt());
     settings.endGroup();
 
     settings.beginGroup("SSL");
@@ -83,6 +100,12 @@ bool ProxyConfiguration::loadConfiguration(const QString &fileName)
     setTcpServerTunnelProxyPort(static_cast<quint16>(settings.value("port", 2213).toInt()));
     settings.endGroup();
 
+    settings.beginGroup("Metrics");
+    setMetricsEnabled(settings.value("enabled", false).toBool());
+    setMetricsHost(QHostAddress(settings.value("host", "127.0.0.1").toString()));
+    setMetricsPort(static_cast<quint16>(settings.value("port", 9187).toInt()));
+    settings.endGroup();
+
     // Load SSL configuration
     QSslConfiguration sslConfiguration;
     sslConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
@@ -183,6 +206,16 @@ void ProxyConfiguration::setMonitorSocketFileName(const QString &fileName)
     m_monitorSocketFileName = fileName;
 }
 
+int ProxyConfiguration::monitorUpdateInterval() const
+{
+    return m_monitorUpdateInterval;
+}
+
+void ProxyConfiguration::setMonitorUpdateInterval(int monitorUpdateInterval)
+{
+    m_monitorUpdateInterval = monitorUpdateInterval;
+}
+
 int ProxyConfiguration::jsonRpcTimeout() const
 {
     return m_jsonRpcTimeout;
@@ -203,6 +236,136 @@ void ProxyConfiguration::setInactiveTimeout(int timeout)
     m_inactiveTimeout = timeout;
 }
 
+int ProxyConfiguration::drainWindow() const
+{
+    return m_drainWindow;
+}
+
+void ProxyConfiguration::setDrainWindow(int drainWindow)
+{
+    m_drainWindow = drainWindow;
+}
+
+bool ProxyConfiguration::tunnelCompressionEnabled() const
+{
+    return m_tunnelCompressionEnabled;
+}
+
+void ProxyConfiguration::setTunnelCompressionEnabled(bool enabled)
+{
+    m_tunnelCompressionEnabled = enabled;
+}
+
+int ProxyConfiguration::maxFrameSize() const
+{
+    return m_maxFrameSize;
+}
+
+void ProxyConfiguration::setMaxFrameSize(int maxFrameSize)
+{
+    m_maxFrameSize = maxFrameSize;
+}
+
+int ProxyConfiguration::outputCorkSize() const
+{
+    return m_outputCorkSize;
+}
+
+void ProxyConfiguration::setOutputCorkSize(int outputCorkSize)
+{
+    m_outputCorkSize = outputCorkSize;
+}
+
+int ProxyConfiguration::outputCorkTime() const
+{
+    return m_outputCorkTime;
+}
+
+void ProxyConfiguration::setOutputCorkTime(int outputCorkTime)
+{
+    m_outputCorkTime = outputCorkTime;
+}
+
+int ProxyConfiguration::idleCompactionTime() const
+{
+    return m_idleCompactionTime;
+}
+
+void ProxyConfiguration::setIdleCompactionTime(int idleCompactionTime)
+{
+    m_idleCompactionTime = idleCompactionTime;
+}
+
+qint64 ProxyConfiguration::rateAlertThreshold() const
+{
+    return m_rateAlertThreshold;
+}
+
+void ProxyConfiguration::setRateAlertThreshold(qint64 rateAlertThreshold)
+{
+    m_rateAlertThreshold = rateAlertThreshold;
+}
+
+int ProxyConfiguration::probeInterval() const
+{
+    return m_probeInterval;
+}
+
+void ProxyConfiguration::setProbeInterval(int probeInterval)
+{
+    m_probeInterval = probeInterval;
+}
+
+int ProxyConfiguration::admissionAcceptRate() const
+{
+    return m_admissionAcceptRate;
+}
+
+void ProxyConfiguration::setAdmissionAcceptRate(int acceptRate)
+{
+    m_admissionAcceptRate = acceptRate;
+}
+
+int ProxyConfiguration::admissionAcceptBurst() const
+{
+    return m_admissionAcceptBurst;
+}
+
+void ProxyConfiguration::setAdmissionAcceptBurst(int acceptBurst)
+{
+    m_admissionAcceptBurst = acceptBurst;
+}
+
+int ProxyConfiguration::admissionMaxPendingHandshakes() const
+{
+    return m_admissionMaxPendingHandshakes;
+}
+
+void ProxyConfiguration::setAdmissionMaxPendingHandshakes(int maxPendingHandshakes)
+{
+    m_admissionMaxPendingHandshakes = maxPendingHandshakes;
+}
+
+int ProxyConfiguration::admissionMaxConnectionsPerAddress() const
+{
+    return m_admissionMaxConnectionsPerAddress;
+}
+
+void ProxyConfiguration::setAdmissionMaxConnectionsPerAddress(int maxConnectionsPerAddress)
+{
+    m_admissionMaxConnectionsPerAddress = maxConnectionsPerAddress;
+}
+
+int ProxyConfiguration::admissionMaxDeferredConnections() const
+{
+    return m_admissionMaxDeferredConnections;
+}
+
+void ProxyConfiguration::setAdmissionMaxDeferredConnections(int maxDeferredConnections)
+{
+    m_admissionMaxDeferredConnections = maxDeferredConnections;
+}
+
 bool ProxyConfiguration::sslEnabled() const
 {
     return m_sslEnabled;
@@ -298,6 +461,36 @@ void ProxyConfiguration::setTcpServerTunnelProxyPort(quint16 port)
     m_tcpServerTunnelProxyPort = port;
 }
 
+bool ProxyConfiguration::metricsEnabled() const
+{
+    return m_metricsEnabled;
+}
+
+void ProxyConfiguration::setMetricsEnabled(bool metricsEnabled)
+{
+    m_metricsEnabled = metricsEnabled;
+}
+
+QHostAddress ProxyConfiguration::metricsHost() const
+{
+    return m_metricsHost;
+}
+
+void ProxyConfiguration::setMetricsHost(const QHostAddress &address)
+{
+    m_metricsHost = address;
+}
+
+quint16 ProxyConfiguration::metricsPort() const
+{
+    return m_metricsPort;
+}
+
+void ProxyConfiguration::setMetricsPort(quint16 port)
+{
+    m_metricsPort = port;
+}
+
 QDebug operator<<(QDebug debug, ProxyConfiguration *configuration)
 {
     QDebugStateSaver saver(debug);
@@ -308,8 +501,23 @@ QDebug operator<<(QDebug debug, ProxyConfiguration *configuration)
     debug.nospace() << "  - Write logfile:" << configuration->writeLogFile() << "\n";
     debug.nospace() << "  - Logfile:" << configuration->logFileName() << "\n";
     debug.nospace() << "  - Log engine enabled:" << configuration->logEngineEnabled() << "\n";
+    debug.nospace() << "  - Monitor update interval:" << configuration->monitorUpdateInterval() << " [ms]" << "\n";
     debug.nospace() << "  - JSON RPC timeout:" << configuration->jsonRpcTimeout() << " [ms]" << "\n";
     debug.nospace() << "  - Inactive timeout:" << configuration->inactiveTimeout() << " [ms]" << "\n";
+    debug.nospace() << "  - Drain window:" << configuration->drainWindow() << " [ms]" << "\n";
+    debug.nospace() << "  - Tunnel compression:" << configuration->tunnelCompressionEnabled() << "\n";
+    debug.nospace() << "  - Max frame size:" << configuration->maxFrameSize() << " [B]" << "\n";
+    debug.nospace() << "  - Output cork size:" << configuration->outputCorkSize() << " [B]" << "\n";
+    debug.nospace() << "  - Output cork time:" << configuration->outputCorkTime() << " [ms]" << "\n";
+    debug.nospace() << "  - Idle compaction time:" << configuration->idleCompactionTime() << " [ms]" << "\n";
+    debug.nospace() << "  - Rate alert threshold:" << configuration->rateAlertThreshold() << " [B/s]" << "\n";
+    debug.nospace() << "  - Probe interval:" << configuration->probeInterval() << " [ms]" << "\n";
+    debug.nospace() << "AdmissionControl configuration" << "\n";
+    debug.nospace() << "  - Accept rate:" << configuration->admissionAcceptRate() << " [1/s]" << "\n";
+    debug.nospace() << "  - Accept burst:" << configuration->admissionAcceptBurst() << "\n";
+    debug.nospace() << "  - Max pending handshakes:" << configuration->admissionMaxPendingHandshakes() << "\n";
+    debug.nospace() << "  - Max connections per address:" << configuration->admissionMaxConnectionsPerAddress() << "\n";
+    debug.nospace() << "  - Max deferred connections:" << configuration->admissionMaxDeferredConnections() << "\n";
     debug.nospace() << "SSL configuration" << "\n";
     debug.nospace() << "  - Enabled:" << configuration->sslEnabled() << "\n";
     debug.nospace() << "  - Certificate:" << configuration->sslCertificateFileName() << "\n";
@@ -339,6 +547,10 @@ QDebug operator<<(QDebug debug, ProxyConfiguration *configuration)
     debug.nospace() << "TcpServer TunnelProxy" << "\n";
     debug.nospace() << "  - Host:" << configuration->tcpServerTunnelProxyHost().toString() << "\n";
     debug.nospace() << "  - Port:" << configuration->tcpServerTunnelProxyPort() << "\n";
+    debug.nospace() << "Metrics" << "\n";
+    debug.nospace() << "  - Enabled:" << configuration->metricsEnabled() << "\n";
+    debug.nospace() << "  - Host:" << configuration->metricsHost().toString() << "\n";
+    debug.nospace() << "  - Port:" << configuration->metricsPort() << "\n";
     debug.nospace() << "========== ProxyConfiguration ==========";
     return debug;
 }
@@ -62,12 +62,63 @@ public:
     QString monitorSocketFileName() const;
     void setMonitorSocketFileName(const QString &fileName);
 
+    // Interval in ms for the updates sent to subscribed monitors
+    int monitorUpdateInterval() const;
+    void setMonitorUpdateInterval(int monitorUpdateInterval);
+
     int jsonRpcTimeout() const;
     void setJsonRpcTimeout(int timeout);
 
     int inactiveTimeout() const;
     void setInactiveTimeout(int timeout);
 
+    int drainWindow() const;
+    void setDrainWindow(int drainWindow);
+
+    bool tunnelCompressionEnabled() const;
+    void setTunnelCompressionEnabled(bool enabled);
+
+    // Maximum size of a tunnel frame the proxy buffers or decompresses
+    int maxFrameSize() const;
+    void setMaxFrameSize(int maxFrameSize);
+
+    // Data for a connection gets collected until the event loop is idle, the cork size
+    // or the cork time has been reached. A cork size of 0 disables the output cork.
+    int outputCorkSize() const;
+    void setOutputCorkSize(int outputCorkSize);
+
+    int outputCorkTime() const;
+    void setOutputCorkTime(int outputCorkTime);
+
+    // Buffers of connections without received data for this time get compacted, 0 disables the compaction
+    int idleCompactionTime() const;
+    void setIdleCompactionTime(int idleCompactionTime);
+
+    // Tunnels with a smoothed rate above this value in B/s get logged, 0 disables the alert
+    qint64 rateAlertThreshold() const;
+    void setRateAlertThreshold(qint64 rateAlertThreshold);
+
+    // Servers which sent a control frame get probed with control pings in this interval, 0 disables the probes
+    int probeInterval() const;
+    void setProbeInterval(int probeInterval);
+
+    // AdmissionControl
+    int admissionAcceptRate() const;
+    void setAdmissionAcceptRate(int acceptRate);
+
+    int admissionAcceptBurst() const;
+    void setAdmissionAcceptBurst(int acceptBurst);
+
+    int admissionMaxPendingHandshakes() const;
+    void setAdmissionMaxPendingHandshakes(int maxPendingHandshakes);
+
+    // Opt-in per address limit, disabled with 0 since clients behind a NAT share one address
+    int admissionMaxConnectionsPerAddress() const;
+    void setAdmissionMaxConnectionsPerAddress(int maxConnectionsPerAddress);
+
+    int admissionMaxDeferredConnections() const;
+    void setAdmissionMaxDeferredConnections(int maxDeferredConnections);
+
     // Ssl
     bool sslEnabled() const;
     void setSslEnabled(bool enabled);
@@ -101,6 +152,16 @@ public:
     quint16 tcpServerTunnelProxyPort() const;
     void setTcpServerTunnelProxyPort(quint16 port);
 
+    // Metrics (OpenMetrics over HTTP)
+    bool metricsEnabled() const;
+    void setMetricsEnabled(bool metricsEnabled);
+
+    QHostAddress metricsHost() const;
+    void setMetricsHost(const QHostAddress &address);
+
+    quint16 metricsPort() const;
+    void setMetricsPort(quint16 port);
+
 private:
     // ProxyServer
     QString m_fileName;
@@ -109,9 +170,25 @@ private:
     QString m_logFileName = "/var/log/nymea-remoteproxy.log";
     bool m_logEngineEnabled = false;
     QString m_monitorSocketFileName;
+    int m_monitorUpdateInterval = 1000;
 
     int m_jsonRpcTimeout = 10000;
     int m_inactiveTimeout = 8000;
+    int m_drainWindow = 60000;
+    bool m_tunnelCompressionEnabled = true;
+    int m_maxFrameSize = 4194304;
+    int m_outputCorkSize = 16384;
+    int m_outputCorkTime = 0;
+    int m_idleCompactionTime = 30000;
+    qint64 m_rateAlertThreshold = 0;
+    int m_probeInterval = 30000;
+
+    // AdmissionControl
+    int m_admissionAcceptRate = 100;
+    int m_admissionAcceptBurst = 200;
+    int m_admissionMaxPendingHandshakes = 100;
+    int m_admissionMaxConnectionsPerAddress = 0;
+    int m_admissionMaxDeferredConnections = 1000;
 
     // Ssl
     bool m_sslEnabled = true;
@@ -131,6 +208,11 @@ private:
     QHostAddress m_tcpServerTunnelProxyHost = QHostAddress::LocalHost;
     quint16 m_tcpServerTunnelProxyPort = 2213;
 
+    // Metrics
+    bool m_metricsEnabled = false;
+    QHostAddress m_metricsHost = QHostAddress::LocalHost;
+    quint16 m_metricsPort = 9187;
+
 };
 
 QDebug operator<< (QDebug debug, ProxyConfiguration *configuration);
@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "admissioncontroller.h"
+#include "loggingcategories.h"
+
+namespace remoteproxy {
+
+static const int s_maxKnownServerAddresses = 10000;
+
+AdmissionController::AdmissionController(QObject *parent) :
+    QObject(parent)
+{
+    m_clock.start();
+    m_tokens = m_acceptBurst;
+
+    m_deferTimer = new QTimer(this);
+    m_deferTimer->setSingleShot(false);
+    m_deferTimer->setInterval(20);
+    connect(m_deferTimer, &QTimer::timeout, this, &AdmissionController::processQueue);
+}
+
+int AdmissionController::acceptRate() const
+{
+    return m_acceptRate;
+}
+
+void AdmissionController::setAcceptRate(int acceptRate)
+{
+    m_acceptRate = qMax(0, acceptRate);
+}
+
+int AdmissionController::acceptBurst() const
+{
+    return m_acceptBurst;
+}
+
+void AdmissionController::setAcceptBurst(int acceptBurst)
+{
+    m_acceptBurst = qMax(1, acceptBurst);
+    m_tokens = qMin(m_tokens, static_cast<double>(m_acceptBurst));
+}
+
+int AdmissionController::maxPendingHandshakes() const
+{
+    return m_maxPendingHandshakes;
+}
+
+void AdmissionController::setMaxPendingHandshakes(int maxPendingHandshakes)
+{
+    m_maxPendingHandshakes = qMax(0, maxPendingHandshakes);
+}
+
+int AdmissionController::maxConnectionsPerAddress() const
+{
+    return m_maxConnectionsPerAddress;
+}
+
+void AdmissionController::setMaxConnectionsPerAddress(int maxConnectionsPerAddress)
+{
+    m_maxConnectionsPerAddress = qMax(0, maxConnectionsPerAddress);
+}
+
+int AdmissionController::maxDeferredConnections() const
+{
+    return m_maxDeferredConnections;
+}
+
+void AdmissionController::setMaxDeferredConnections(int maxDeferredConnections)
+{
+    m_maxDeferredConnections = qMax(0, maxDeferredConnections);
+}
+
+bool AdmissionController::isKnownServerAddress(const QHostAddress &address) const
+{
+    return m_knownServerAddresses.contains(address);
+}
+
+void AdmissionController::addKnownServerAddress(const QHostAddress &address)
+{
+    if (address.isNull())
+        return;
+
+    QHash<QHostAddress, quint64>::iterator it = m_knownServerAddresses.find(address);
+    if (it != m_knownServerAddresses.end()) {
+        m_knownServerAddressesOrder.remove(it.value());
+        m_knownServerAddresses.erase(it);
+    } else if (m_knownServerAddresses.count() >= s_maxKnownServerAddresses) {
+        // Forget the least recently registered address if the list is full
+        QMap<quint64, QHostAddress>::iterator oldestIt = m_knownServerAddressesOrder.begin();
+        m_knownServerAddresses.remove(oldestIt.value());
+        m_knownServerAddressesOrder.erase(oldestIt);
+    }
+
+    quint64 sequence = ++m_knownServerAddressesSequence;
+    m_knownServerAddresses.insert(address, sequence);
+    m_knownServerAddressesOrder.insert(sequence, address);
+}
+
+AdmissionController::Decision AdmissionController::requestAdmission(QTcpSocket *socket)
+{
+    QHostAddress address = socket->peerAddress();
+
+    if (m_maxConnectionsPerAddress > 0 && m_addressConnectionCount.value(address) >= m_maxConnectionsPerAddress) {
+        qCDebug(dcTcpSocketServer()) << "Rejecting connection from" << address.toString() << "because the connection limit per address has been reached" << m_maxConnectionsPerAddress;
+        m_rejectedCount++;
+        return DecisionReject;
+    }
+
+    // Do not overtake connections already waiting with the same or a higher priority
+    bool priority = isKnownServerAddress(address);
+    bool waiting = !m_priorityQueue.isEmpty() || (!priority && !m_queue.isEmpty());
+
+    Connection connection;
+    connection.address = address;
+
+    if (!waiting && canAdmit()) {
+        m_connections.insert(socket, connection);
+        m_addressConnectionCount[address]++;
+        admit(socket);
+        return DecisionAdmit;
+    }
+
+    if (m_priorityQueue.count() + m_queue.count() >= m_maxDeferredConnections) {
+        qCDebug(dcTcpSocketServer()) << "Rejecting connection from" << address.toString() << "because the deferred connection queue is full" << m_maxDeferredConnections;
+        m_rejectedCount++;
+        return DecisionReject;
+    }
+
+    m_connections.insert(socket, connection);
+    m_addressConnectionCount[address]++;
+    if (priority) {
+        m_priorityQueue.enqueue(socket);
+    } else {
+        m_queue.enqueue(socket);
+    }
+
+    m_deferredCount++;
+    qCDebug(dcTcpSocketServer()) << "Deferring connection from" << address.toString() << (priority ? "(known server)" : "") << "Waiting connections:" << deferredConnections();
+
+    if (!m_deferTimer->isActive())
+        m_deferTimer->start();
+
+    return DecisionDefer;
+}
+
+void AdmissionController::finishHandshake(QTcpSocket *socket)
+{
+    if (!m_connections.contains(socket))
+        return;
+
+    Connection &connection = m_connections[socket];
+    if (!connection.handshakeRunning)
+        return;
+
+    connection.handshakeRunning = false;
+    m_pendingHandshakes--;
+    processQueue();
+}
+
+void AdmissionController::removeConnection(QTcpSocket *socket)
+{
+    if (!m_connections.contains(socket))
+        return;
+
+    Connection connection = m_connections.take(socket);
+    if (connection.handshakeRunning)
+        m_pendingHandshakes--;
+
+    m_priorityQueue.removeAll(socket);
+    m_queue.removeAll(socket);
+
+    int count = m_addressConnectionCount.value(connection.address) - 1;
+    if (count > 0) {
+        m_addressConnectionCount.insert(connection.address, count);
+    } else {
+        m_addressConnectionCount.remove(connection.address);
+    }
+
+    processQueue();
+}
+
+int AdmissionController::pendingHandshakes() const
+{
+    return m_pendingHandshakes;
+}
+
+int AdmissionController::deferredConnections() const
+{
+    return m_priorityQueue.count() + m_queue.count();
+}
+
+quint64 AdmissionController::rejectedCount() const
+{
+    return m_rejectedCount;
+}
+
+QVariantMap AdmissionController::statistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("admitted", m_admittedCount);
+    statisticsMap.insert("deferred", m_deferredCount);
+    statisticsMap.insert("rejected", m_rejectedCount);
+    statisticsMap.insert("waiting", deferredConnections());
+    statisticsMap.insert("waitingKnownServers", m_priorityQueue.count());
+    statisticsMap.insert("pendingHandshakes", m_pendingHandshakes);
+    statisticsMap.insert("knownServerAddresses", m_knownServerAddresses.count());
+    return statisticsMap;
+}
+
+void AdmissionController::refillTokens()
+{
+    qint64 now = m_clock.elapsed();
+    if (m_acceptRate > 0) {
+        m_tokens = qMin(static_cast<double>(m_acceptBurst), m_tokens + (now - m_lastRefill) * m_acceptRate / 1000.0);
+    }
+    m_lastRefill = now;
+}
+
+bool AdmissionController::canAdmit()
+{
+    if (m_maxPendingHandshakes > 0 && m_pendingHandshakes >= m_maxPendingHandshakes)
+        return false;
+
+    if (m_acceptRate <= 0)
+        return true;
+
+    refillTokens();
+    return m_tokens >= 1;
+}
+
+void AdmissionController::admit(QTcpSocket *socket)
+{
+    if (m_acceptRate > 0)
+        m_tokens -= 1;
+
+    m_connections[socket].handshakeRunning = true;
+    m_pendingHandshakes++;
+    m_admittedCount++;
+}
+
+void AdmissionController::processQueue()
+{
+    // Admitted connections may finish their handshake synchronously and call back into here
+    if (m_processingQueue)
+        return;
+
+    m_processingQueue = true;
+    while (!m_priorityQueue.isEmpty() || !m_queue.isEmpty()) {
+        if (!canAdmit()) {
+            m_processingQueue = false;
+            return;
+        }
+
+        QTcpSocket *socket = !m_priorityQueue.isEmpty() ? m_priorityQueue.dequeue() : m_queue.dequeue();
+        admit(socket);
+        qCDebug(dcTcpSocketServer()) << "Admitting deferred connection from" << socket->peerAddress().toString();
+        emit connectionAdmitted(socket);
+    }
+
+    m_processingQueue = false;
+    m_deferTimer->stop();
+}
+
+}
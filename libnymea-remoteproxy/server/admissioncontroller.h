@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include <QMap>
+#include <QHash>
+#include <QQueue>
+#include <QTimer>
+#include <QObject>
+#include <QTcpSocket>
+#include <QVariantMap>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+namespace remoteproxy {
+
+class AdmissionController : public QObject
+{
+    Q_OBJECT
+public:
+    enum Decision {
+        DecisionAdmit,
+        DecisionDefer,
+        DecisionReject
+    };
+    Q_ENUM(Decision)
+
+    explicit AdmissionController(QObject *parent = nullptr);
+
+    // Accepted connections per second, 0 means unlimited
+    int acceptRate() const;
+    void setAcceptRate(int acceptRate);
+
+    int acceptBurst() const;
+    void setAcceptBurst(int acceptBurst);
+
+    // Concurrent handshakes in progress, 0 means unlimited
+    int maxPendingHandshakes() const;
+    void setMaxPendingHandshakes(int maxPendingHandshakes);
+
+    // Concurrent connections from one peer address, 0 (default) means unlimited
+    int maxConnectionsPerAddress() const;
+    void setMaxConnectionsPerAddress(int maxConnectionsPerAddress);
+
+    int maxDeferredConnections() const;
+    void setMaxDeferredConnections(int maxDeferredConnections);
+
+    // Peer addresses of registered servers get admitted ahead of anonymous connections
+    bool isKnownServerAddress(const QHostAddress &address) const;
+    void addKnownServerAddress(const QHostAddress &address);
+
+    Decision requestAdmission(QTcpSocket *socket);
+    void finishHandshake(QTcpSocket *socket);
+    void removeConnection(QTcpSocket *socket);
+
+    int pendingHandshakes() const;
+    int deferredConnections() const;
+    quint64 rejectedCount() const;
+
+    QVariantMap statistics() const;
+
+signals:
+    void connectionAdmitted(QTcpSocket *socket);
+
+private:
+    struct Connection {
+        QHostAddress address;
+        bool handshakeRunning = false;
+    };
+
+    int m_acceptRate = 100;
+    int m_acceptBurst = 200;
+    int m_maxPendingHandshakes = 100;
+    int m_maxConnectionsPerAddress = 0;
+    int m_maxDeferredConnections = 1000;
+
+    QTimer *m_deferTimer = nullptr;
+    bool m_processingQueue = false;
+    QElapsedTimer m_clock;
+    qint64 m_lastRefill = 0;
+    double m_tokens = 0;
+
+    int m_pendingHandshakes = 0;
+    QHash<QTcpSocket *, Connection> m_connections;
+    QHash<QHostAddress, int> m_addressConnectionCount;
+    // Registration order for the eviction of the least recently registered address
+    QHash<QHostAddress, quint64> m_knownServerAddresses; // address, registration sequence
+    QMap<quint64, QHostAddress> m_knownServerAddressesOrder; // registration sequence, address
+    quint64 m_knownServerAddressesSequence = 0;
+    QQueue<QTcpSocket *> m_priorityQueue;
+    QQueue<QTcpSocket *> m_queue;
+
+    // Statistic counters
+    quint64 m_admittedCount = 0;
+    quint64 m_deferredCount = 0;
+    quint64 m_rejectedCount = 0;
+
+    void refillTokens();
+    bool canAdmit();
+    void admit(QTcpSocket *socket);
+    void processQueue();
+
+};
+
+}
+
+#endif // ADMISSIONCONTROLLER_H
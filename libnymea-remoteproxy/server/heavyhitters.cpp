@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "heavyhitters.h"
+
+namespace remoteproxy {
+
+HeavyHitters::HeavyHitters(int capacity) :
+    m_capacity(qMax(1, capacity))
+{
+
+}
+
+int HeavyHitters::capacity() const
+{
+    return m_capacity;
+}
+
+int HeavyHitters::count() const
+{
+    return m_counters.count();
+}
+
+void HeavyHitters::decay(double factor)
+{
+    if (factor <= 0) {
+        clear();
+        return;
+    }
+
+    m_scale *= qMin(1.0, factor);
+
+    // Keep the stored counts of new weights in the double range
+    if (m_scale < 1e-100)
+        normalize();
+}
+
+void HeavyHitters::add(const QUuid &key, double weight)
+{
+    if (weight <= 0)
+        return;
+
+    double scaledWeight = weight / m_scale;
+
+    QHash<QUuid, Counter>::iterator it = m_counters.find(key);
+    if (it != m_counters.end()) {
+        m_order.remove(it->count, key);
+        it->count += scaledWeight;
+        m_order.insert(it->count, key);
+        return;
+    }
+
+    Counter counter;
+    if (m_counters.count() >= m_capacity) {
+        // Take over the smallest counter
+        QMultiMap<double, QUuid>::iterator minimumIt = m_order.begin();
+        counter.error = minimumIt.key();
+        m_counters.remove(minimumIt.value());
+        m_order.erase(minimumIt);
+    }
+
+    counter.count = counter.error + scaledWeight;
+    m_counters.insert(key, counter);
+    m_order.insert(counter.count, key);
+}
+
+void HeavyHitters::remove(const QUuid &key)
+{
+    QHash<QUuid, Counter>::iterator it = m_counters.find(key);
+    if (it == m_counters.end())
+        return;
+
+    m_order.remove(it->count, key);
+    m_counters.erase(it);
+}
+
+void HeavyHitters::clear()
+{
+    m_counters.clear();
+    m_order.clear();
+    m_scale = 1.0;
+}
+
+QList<HeavyHitters::Item> HeavyHitters::top(int count) const
+{
+    QList<Item> items;
+    QMultiMap<double, QUuid>::const_iterator it = m_order.constEnd();
+    while (it != m_order.constBegin() && items.count() < count) {
+        --it;
+        Item item;
+        item.key = it.value();
+        item.count = it.key() * m_scale;
+        item.error = m_counters.value(it.value()).error * m_scale;
+        items.append(item);
+    }
+
+    return items;
+}
+
+void HeavyHitters::normalize()
+{
+    m_order.clear();
+    for (QHash<QUuid, Counter>::iterator it = m_counters.begin(); it != m_counters.end(); ++it) {
+        it->count *= m_scale;
+        it->error *= m_scale;
+        m_order.insert(it->count, it.key());
+    }
+
+    m_scale = 1.0;
+}
+
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include <QHash>
+#include <QUuid>
+#include <QList>
+#include <QMultiMap>
+
+namespace remoteproxy {
+
+// Space-saving top-K (Metwally et al.): a fixed number of counters follows the heaviest keys of a
+// weighted stream. A key without counter replaces the smallest counter and inherits its count as
+// error, so every key above count / capacity of the total weight is guaranteed to be monitored.
+// The decay is a shared scale factor, the counts can be used as exponentially weighted rates
+// without touching the counters in each tick.
+class HeavyHitters
+{
+public:
+    struct Item {
+        QUuid key;
+        double count = 0;
+        double error = 0;
+    };
+
+    explicit HeavyHitters(int capacity = 64);
+
+    int capacity() const;
+    int count() const;
+
+    // Multiplies all counts with the factor (0 - 1)
+    void decay(double factor);
+
+    void add(const QUuid &key, double weight);
+    void remove(const QUuid &key);
+    void clear();
+
+    // The monitored keys with the highest counts, descending. A count overestimates the weight of the key by at most its error.
+    QList<Item> top(int count) const;
+
+private:
+    struct Counter {
+        double count = 0;
+        double error = 0;
+    };
+
+    int m_capacity = 64;
+
+    // Stored counts are divided by the scale, decaying only changes the scale
+    double m_scale = 1.0;
+
+    QHash<QUuid, Counter> m_counters;
+    QMultiMap<double, QUuid> m_order;
+
+    void normalize();
+
+};
+
+}
+
+#endif // HEAVYHITTERS_H
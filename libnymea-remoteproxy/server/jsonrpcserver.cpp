@@ -57,6 +57,7 @@ JsonRpcServer::JsonRpcServer(QObject *parent) :
     returns.insert("version", JsonTypes::basicTypeToString(JsonTypes::String));
     returns.insert("apiVersion", JsonTypes::basicTypeToString(JsonTypes::String));
     setReturns("Hello", returns);
+    registerMethod("Hello", &JsonRpcServer::Hello);
 
     params.clear(); returns.clear();
     setDescription("Introspect", "Introspect this API.");
@@ -65,6 +66,7 @@ JsonRpcServer::JsonRpcServer(QObject *parent) :
     returns.insert("types", JsonTypes::basicTypeToString(JsonTypes::Object));
     returns.insert("notifications", JsonTypes::basicTypeToString(JsonTypes::Object));
     setReturns("Introspect", returns);
+    registerMethod("Introspect", &JsonRpcServer::Introspect);
 
     // Notifications
     params.clear(); returns.clear();
@@ -138,6 +140,16 @@ JsonReply *JsonRpcServer::Introspect(const QVariantMap &params, TransportClient
     return createReply("Introspect", data);
 }
 
+void JsonRpcServer::sendPacket(TransportClient *client, const QByteArray &data)
+{
+    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
+    if (client->slipEnabled()) {
+        client->sendDataSlices(SlipDataProcessor::serializeFrameSlices(SlipDataProcessor::SocketAddressJsonRpc, QList<QByteArray>() << data << m_packetDelimiter));
+    } else {
+        client->sendDataSlices(QList<QByteArray>() << data << m_packetDelimiter);
+    }
+}
+
 void JsonRpcServer::sendResponse(TransportClient *client, int commandId, const QVariantMap &params)
 {
     QVariantMap response;
@@ -145,16 +157,7 @@ void JsonRpcServer::sendResponse(TransportClient *client, int commandId, const Q
     response.insert("status", "success");
     response.insert("params", params);
 
-    QByteArray data = QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    if (client->slipEnabled()) {
-        SlipDataProcessor::Frame frame;
-        frame.socketAddress = 0x0000;
-        frame.data = data + "\n";
-        client->sendData(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
-    } else {
-        client->sendData(data + "\n");
-    }
+    sendPacket(client, QJsonDocument::fromVariant(response).toJson(QJsonDocument::Compact));
 }
 
 void JsonRpcServer::sendErrorResponse(TransportClient *client, int commandId, const QString &error)
@@ -164,15 +167,27 @@ void JsonRpcServer::sendErrorResponse(TransportClient *client, int commandId, co
     errorResponse.insert("status", "error");
     errorResponse.insert("error", error);
 
-    QByteArray data = QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact);
-    qCDebug(dcJsonRpcTraffic()) << "Sending data:" << data;
-    if (client->slipEnabled()) {
-        SlipDataProcessor::Frame frame;
-        frame.socketAddress = 0x0000;
-        frame.data = data + "\n";
-        client->sendData(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
-    } else {
-        client->sendData(data + "\n");
+    sendPacket(client, QJsonDocument::fromVariant(errorResponse).toJson(QJsonDocument::Compact));
+}
+
+void JsonRpcServer::updateResponseCache()
+{
+    // The compact JSON output sorts the keys: {"id":<id>,"params":{...},"status":"success"}
+    for (QHash<QString, MethodEntry>::iterator it = m_dispatchTable.begin(); it != m_dispatchTable.end(); ++it) {
+        MethodEntry &entry = it.value();
+        if (!entry.cacheable)
+            continue;
+
+        JsonReply *reply = entry.function(QVariantMap(), nullptr);
+        entry.cachedResponse = ",\"params\":" + QJsonDocument::fromVariant(reply->data()).toJson(QJsonDocument::Compact) + ",\"status\":\"success\"}";
+        reply->deleteLater();
+    }
+}
+
+void JsonRpcServer::clearResponseCache()
+{
+    for (QHash<QString, MethodEntry>::iterator it = m_dispatchTable.begin(); it != m_dispatchTable.end(); ++it) {
+        it.value().cachedResponse.clear();
     }
 }
 
@@ -190,12 +205,47 @@ void JsonRpcServer::registerHandler(JsonHandler *handler)
 {
     qCDebug(dcJsonRpc()) << "Register handler" << handler->name();
     m_handlers.insert(handler->name(), handler);
+
+    // Resolve the methods once, requests get dispatched directly using the full method name
+    QHash<QString, JsonHandler::Method> methods = handler->methods();
+    QHash<QString, JsonHandler::ObjectMethod> objectMethods = handler->objectMethods();
+    QStringList methodNames = methods.keys() + objectMethods.keys();
+    foreach (const QString &method, methodNames) {
+        if (!handler->hasMethod(method)) {
+            qCWarning(dcJsonRpc()) << "Method" << method << "of" << handler->name() << "has no description, params or returns. Not registering it.";
+            continue;
+        }
+
+        MethodEntry entry;
+        entry.handler = handler;
+        entry.method = method;
+        entry.function = methods.value(method);
+        entry.objectFunction = objectMethods.value(method);
+        // The RemoteProxy methods (Hello and Introspect) reply static data
+        entry.cacheable = (handler == this);
+        m_dispatchTable.insert(handler->name() + "." + method, entry);
+    }
+
+    // The introspection changed with the new handler
+    updateResponseCache();
 }
 
 void JsonRpcServer::unregisterHandler(JsonHandler *handler)
 {
     qCDebug(dcJsonRpc()) << "Unregister handler" << handler->name();
     m_handlers.remove(handler->name());
+
+    QHash<QString, MethodEntry>::iterator it = m_dispatchTable.begin();
+    while (it != m_dispatchTable.end()) {
+        if (it.value().handler == handler) {
+            it = m_dispatchTable.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Rebuild on the next call, this might happen while shutting down
+    clearResponseCache();
 }
 
 uint JsonRpcServer::registeredClientCount() const
@@ -203,10 +253,32 @@ uint JsonRpcServer::registeredClientCount() const
     return m_clients.count();
 }
 
-void JsonRpcServer::processDataPacket(TransportClient *transportClient, const QByteArray &data)
+QJsonParseError JsonRpcServer::parseRequest(const QByteArray &data, Request *request)
 {
     QJsonParseError error;
     QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError)
+        return error;
+
+    // Read the well known keys straight from the object, without converting the message into a QVariantMap
+    QJsonObject message = jsonDoc.object();
+    QJsonValue idValue = message.value(QLatin1String("id"));
+    if (idValue.isDouble()) {
+        request->id = idValue.toInt();
+        request->idValid = true;
+    } else if (idValue.isString()) {
+        request->id = idValue.toString().toInt(&request->idValid);
+    }
+
+    request->method = message.value(QLatin1String("method")).toString();
+    request->params = message.value(QLatin1String("params")).toObject();
+    return error;
+}
+
+void JsonRpcServer::processDataPacket(TransportClient *transportClient, const QByteArray &data)
+{
+    Request request;
+    QJsonParseError error = parseRequest(data, &request);
     if(error.error != QJsonParseError::NoError) {
         qCWarning(dcJsonRpc) << "Failed to parse JSON data" << data << ":" << error.errorString();
         sendErrorResponse(transportClient, -1, QString("Failed to parse JSON data: %1").arg(error.errorString()));
@@ -214,68 +286,68 @@ void JsonRpcServer::processDataPacket(TransportClient *transportClient, const QB
         return;
     }
 
-    QVariantMap message = jsonDoc.toVariant().toMap();
-
-    bool success = false;
-    int commandId = message.value("id").toInt(&success);
-    if (!success) {
-        qCWarning(dcJsonRpc()) << "Error parsing command. Missing \"id\":" << message;
+    if (!request.idValid) {
+        qCWarning(dcJsonRpc()) << "Error parsing command. Missing \"id\":" << data;
         sendErrorResponse(transportClient, -1, "Error parsing command. Missing 'id'");
         transportClient->killConnection("The id property is missing in the request.");
         return;
     }
 
-    QStringList commandList = message.value("method").toString().split('.');
-    if (commandList.count() != 2) {
-        qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << message.value("method").toString() << "\nExpected: \"Namespace.method\"";
-        sendErrorResponse(transportClient, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(message.value("method").toString()));
-        transportClient->killConnection("Invalid method passed.");
-        return;
-    }
-
-    QString targetNamespace = commandList.first();
-    QString method = commandList.last();
+    int commandId = request.id;
+    const QString &methodName = request.method;
+    QHash<QString, MethodEntry>::const_iterator entryIt = m_dispatchTable.constFind(methodName);
+    if (entryIt == m_dispatchTable.constEnd()) {
+        QStringList commandList = methodName.split('.');
+        if (commandList.count() != 2) {
+            qCWarning(dcJsonRpc) << "Error parsing method.\nGot:" << methodName << "\nExpected: \"Namespace.method\"";
+            sendErrorResponse(transportClient, commandId, QString("Error parsing method. Got: '%1'', Expected: 'Namespace.method'").arg(methodName));
+            transportClient->killConnection("Invalid method passed.");
+            return;
+        }
 
-    JsonHandler *handler = m_handlers.value(targetNamespace);
-    if (!handler) {
-        sendErrorResponse(transportClient, commandId, "No such namespace");
-        transportClient->killConnection("No such namespace.");
-        return;
-    }
+        if (!m_handlers.contains(commandList.first())) {
+            sendErrorResponse(transportClient, commandId, "No such namespace");
+            transportClient->killConnection("No such namespace.");
+            return;
+        }
 
-    if (!handler->hasMethod(method)) {
         sendErrorResponse(transportClient, commandId, "No such method");
         transportClient->killConnection("No such method.");
         return;
     }
 
-    QVariantMap params = message.value("params").toMap();
-    QPair<bool, QString> validationResult = handler->validateParams(method, params);
-    if (!validationResult.first) {
-        sendErrorResponse(transportClient, commandId,  "Invalid params: " + validationResult.second);
-        transportClient->killConnection("Invalid params passed.");
-        return;
+    JsonHandler *handler = entryIt.value().handler;
+    const QString &method = entryIt.value().method;
+
+    // Validate on the JSON object, only if that fails the generic validation runs in order to report the error
+    if (!handler->validateParams(method, request.params)) {
+        QPair<bool, QString> validationResult = handler->validateParams(method, request.params.toVariantMap());
+        if (!validationResult.first) {
+            sendErrorResponse(transportClient, commandId,  "Invalid params: " + validationResult.second);
+            transportClient->killConnection("Invalid params passed.");
+            return;
+        }
     }
 
 
-    JsonReply *reply = nullptr;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    bool invokedSuccessfully = QMetaObject::invokeMethod(handler, method.toLatin1().constData(),
-                                                         Qt::DirectConnection,
-                                                         qReturnArg(reply),
-                                                         params, transportClient);
-
-    if (!invokedSuccessfully) {
-        qCWarning(dcJsonRpc()) << "Failed to invoke method" << handler << method;
+    if (entryIt.value().cacheable) {
+        if (entryIt.value().cachedResponse.isEmpty()) {
+            updateResponseCache();
+            entryIt = m_dispatchTable.constFind(methodName);
+        }
+
+        qCDebug(dcJsonRpc()) << "Sending cached reply for" << methodName;
+        sendPacket(transportClient, "{\"id\":" + QByteArray::number(commandId) + entryIt.value().cachedResponse);
+        return;
     }
-#else
-    QMetaObject::invokeMethod(handler, method.toLatin1().constData(),
-                              Qt::DirectConnection,
-                              Q_RETURN_ARG(JsonReply *, reply),
-                              Q_ARG(QVariantMap, params),
-                              Q_ARG(TransportClient *, transportClient));
-#endif
 
+    // Only the methods without a JSON object variant get their params converted
+    JsonReply *reply = nullptr;
+    if (entryIt.value().objectFunction) {
+        reply = entryIt.value().objectFunction(request.params, transportClient);
+    } else {
+        reply = entryIt.value().function(request.params.toVariantMap(), transportClient);
+    }
 
     if (!reply) {
         qCWarning(dcJsonRpc()) << "Internal error. No reply, could not invoke method.";
@@ -291,8 +363,8 @@ void JsonRpcServer::processDataPacket(TransportClient *transportClient, const QB
         connect(reply, &remoteproxy::JsonReply::finished, this, &JsonRpcServer::asyncReplyFinished);
         reply->startWait();
     } else {
-        Q_ASSERT_X((targetNamespace == "RemoteProxy" && method == "Introspect") || handler->validateReturns(method, reply->data()).first
-                   ,"validating return value", formatAssertion(targetNamespace, method, handler, reply->data()).toLatin1().data());
+        Q_ASSERT_X((handler == this && method == "Introspect") || handler->validateReturns(method, reply->data()).first
+                   ,"validating return value", formatAssertion(handler->name(), method, handler, reply->data()).toLatin1().data());
 
         reply->setClientId(transportClient->clientId());
         reply->setCommandId(commandId);
@@ -385,45 +457,62 @@ void JsonRpcServer::unregisterClient(TransportClient *transportClient)
     }
 }
 
-void JsonRpcServer::processData(TransportClient *transportClient, const QByteArray &data)
+QByteArray JsonRpcServer::processData(TransportClient *transportClient, const QByteArray &data)
 {
     if (!m_clients.contains(transportClient))
-        return;
+        return QByteArray();
 
     qCDebug(dcJsonRpcTraffic()) << "Incoming data from" << transportClient << ": " << qUtf8Printable(data);
 
-    // Handle packet fragmentation
-    QList<QByteArray> packets = transportClient->processData(data);
+    // Handle packet fragmentation. The packets get processed one by one since a request
+    // (i.e. a registration) can change how the data following in the same read has to be handled.
+    transportClient->appendJsonData(data);
+    QByteArray packet = transportClient->takeJsonPacket();
+    while (!packet.isNull()) {
+        transportClient->addRxFrameCount();
+        processDataPacket(transportClient, packet);
+
+        // Stop if the connection has been closed
+        if (!m_clients.contains(transportClient) || transportClient->killConnectionRequested())
+            return QByteArray();
+
+        // Pipelined data behind the request belongs to the new mode
+        if (!transportClient->jsonStreamEnabled()) {
+            QByteArray remainingData = transportClient->takeRemainingJsonData();
+            if (!remainingData.isEmpty())
+                qCDebug(dcJsonRpc()) << "JSON stream disabled for" << transportClient << "with" << remainingData.size() << "bytes pipelined data";
+
+            return remainingData;
+        }
+
+        packet = transportClient->takeJsonPacket();
+    }
 
     // Make sure the buffer size is in range
     if (transportClient->bufferSize() > 1024 * 10) {
         qCWarning(dcJsonRpc()) << "Data buffer size violation from" << transportClient;
         transportClient->killConnection("Data buffer size violation.");
-        return;
     }
 
-    foreach (const QByteArray &packet, packets) {
-        processDataPacket(transportClient, packet);
-    }
+    return QByteArray();
 }
 
 void JsonRpcServer::sendNotification(const QString &nameSpace, const QString &method, const QVariantMap &params, TransportClient *transportClient)
 {
-    QVariantMap notification;
-    notification.insert("id", m_notificationId++);
-    notification.insert("notification", nameSpace + "." + method);
-    notification.insert("params", params);
+    // The fixed part of a notification gets serialized once: {"id":<id>,"notification":"<name>","params":<params>}
+    QString notificationName = nameSpace + "." + method;
+    QHash<QString, QByteArray>::const_iterator prefixIt = m_notificationPrefixes.constFind(notificationName);
+    if (prefixIt == m_notificationPrefixes.constEnd()) {
+        prefixIt = m_notificationPrefixes.insert(notificationName, ",\"notification\":\"" + notificationName.toUtf8() + "\",\"params\":");
+    }
 
-    QByteArray data = QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact);
+    QByteArray data = "{\"id\":" + QByteArray::number(m_notificationId++) + prefixIt.value() + QJsonDocument::fromVariant(params).toJson(QJsonDocument::Compact) + "}";
     if (transportClient->slipEnabled()) {
-        SlipDataProcessor::Frame frame;
-        frame.socketAddress = 0x0000;
-        frame.data = data + "\n";
-        qCDebug(dcJsonRpcTraffic()) << "Sending notification frame:" <<frame.socketAddress << qUtf8Printable(frame.data);
-        transportClient->sendData(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
+        qCDebug(dcJsonRpcTraffic()) << "Sending notification frame:" << SlipDataProcessor::SocketAddressJsonRpc << qUtf8Printable(data);
+        transportClient->sendDataSlices(SlipDataProcessor::serializeFrameSlices(SlipDataProcessor::SocketAddressJsonRpc, QList<QByteArray>() << data << m_packetDelimiter));
     } else {
         qCDebug(dcJsonRpcTraffic()) << "Sending notification:" << data;
-        transportClient->sendData(data + "\n");
+        transportClient->sendDataSlices(QList<QByteArray>() << data << m_packetDelimiter);
     }
 }
 
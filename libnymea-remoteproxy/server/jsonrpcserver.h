@@ -30,6 +30,8 @@
 
 #include <QObject>
 #include <QVariant>
+#include <QJsonObject>
+#include <QJsonParseError>
 
 #include "transportclient.h"
 #include "jsonrpc/jsonreply.h"
@@ -42,6 +44,13 @@ class JsonRpcServer : public JsonHandler
 {
     Q_OBJECT
 public:
+    struct Request {
+        bool idValid = false;
+        int id = -1;
+        QString method;
+        QJsonObject params;
+    };
+
     explicit JsonRpcServer(QObject *parent = nullptr);
     ~JsonRpcServer() override;
 
@@ -55,19 +64,39 @@ public:
 
     uint registeredClientCount() const;
 
+    static QJsonParseError parseRequest(const QByteArray &data, Request *request);
+
 signals:
     void TunnelEstablished(const QVariantMap &params);
 
 private:
+    struct MethodEntry {
+        JsonHandler *handler = nullptr;
+        QString method;
+        JsonHandler::Method function;
+        JsonHandler::ObjectMethod objectFunction;
+
+        // Static replies get serialized once, only the request id gets spliced in
+        bool cacheable = false;
+        QByteArray cachedResponse;
+    };
+
     QHash<QString, JsonHandler *> m_handlers;
+    QHash<QString, MethodEntry> m_dispatchTable; // Namespace.Method, entry
+    QHash<QString, QByteArray> m_notificationPrefixes; // Namespace.Notification, serialized fixed part
     QHash<JsonReply *, TransportClient *> m_asyncReplies;
     QList<TransportClient *> m_clients;
 
     int m_notificationId = 0;
+    QByteArray m_packetDelimiter = "\n"; // Shared slice appended to every packet
 
+    void sendPacket(TransportClient *client, const QByteArray &data);
     void sendResponse(TransportClient *client, int commandId, const QVariantMap &params = QVariantMap());
     void sendErrorResponse(TransportClient *client, int commandId, const QString &error);
 
+    void updateResponseCache();
+    void clearResponseCache();
+
     QString formatAssertion(const QString &targetNamespace, const QString &method, JsonHandler *handler, const QVariantMap &data) const;
 
 
@@ -81,8 +110,8 @@ public slots:
     void registerClient(TransportClient *transportClient);
     void unregisterClient(TransportClient *transportClient);
 
-    // Process data from client
-    void processData(TransportClient *transportClient, const QByteArray &data);
+    // Process data from client, returns the data following a request which disabled the JSON stream
+    QByteArray processData(TransportClient *transportClient, const QByteArray &data);
     void sendNotification(const QString &nameSpace, const QString &method, const QVariantMap &params, TransportClient *transportClient = nullptr);
 
 };
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "loghistogram.h"
+
+#include <QtAlgorithms>
+
+#include <chrono>
+#include <cmath>
+
+namespace remoteproxy {
+
+// 2^4 sub buckets per power of two, values up to 2^36 us (~19 h), larger values count into the last bucket
+static const int subBucketBits = 4;
+static const int subBucketCount = 1 << subBucketBits;
+static const int maxMagnitude = 36;
+static const int bucketCount = subBucketCount + (maxMagnitude - subBucketBits) * subBucketCount;
+
+LogHistogram::LogHistogram() :
+    m_bucketCounts(bucketCount, 0)
+{
+
+}
+
+qint64 LogHistogram::timestamp()
+{
+    // The steady clock is read from the vDSO without a system call
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LogHistogram::record(qint64 value)
+{
+    if (value < 0)
+        value = 0;
+
+    m_bucketCounts[bucketIndex(value)]++;
+    m_count++;
+    m_sum += value;
+    if (value > m_max) {
+        m_max = value;
+    }
+}
+
+void LogHistogram::clear()
+{
+    m_bucketCounts.fill(0);
+    m_count = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+quint64 LogHistogram::count() const
+{
+    return m_count;
+}
+
+qint64 LogHistogram::sum() const
+{
+    return m_sum;
+}
+
+qint64 LogHistogram::max() const
+{
+    return m_max;
+}
+
+qint64 LogHistogram::percentile(double percentile) const
+{
+    if (m_count == 0)
+        return 0;
+
+    quint64 targetCount = static_cast<quint64>(std::ceil(qBound(0.0, percentile, 100.0) / 100.0 * m_count));
+    if (targetCount == 0)
+        targetCount = 1;
+
+    quint64 cumulativeCount = 0;
+    for (int i = 0; i < m_bucketCounts.count(); i++) {
+        cumulativeCount += m_bucketCounts.at(i);
+        if (cumulativeCount >= targetCount) {
+            return qMin(bucketUpperBound(i), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+QVariantMap LogHistogram::statistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("count", m_count);
+    statisticsMap.insert("max", m_max);
+    statisticsMap.insert("p50", percentile(50));
+    statisticsMap.insert("p99", percentile(99));
+    statisticsMap.insert("p999", percentile(99.9));
+    return statisticsMap;
+}
+
+QList<QPair<qint64, quint64>> LogHistogram::cumulativeCounts() const
+{
+    QList<QPair<qint64, quint64>> counts;
+    if (m_count == 0)
+        return counts;
+
+    int lastIndex = bucketIndex(m_max);
+    quint64 cumulativeCount = 0;
+    for (int i = 0; i < m_bucketCounts.count(); i++) {
+        cumulativeCount += m_bucketCounts.at(i);
+        // The last sub bucket of each power of two range ends at 2^n - 1
+        if ((i + 1) % subBucketCount == 0) {
+            counts.append(qMakePair(bucketUpperBound(i), cumulativeCount));
+            if (i >= lastIndex) {
+                break;
+            }
+        }
+    }
+
+    return counts;
+}
+
+int LogHistogram::bucketIndex(qint64 value)
+{
+    if (value < subBucketCount)
+        return static_cast<int>(qMax(value, static_cast<qint64>(0)));
+
+    int magnitude = 63 - static_cast<int>(qCountLeadingZeroBits(static_cast<quint64>(value)));
+    if (magnitude >= maxMagnitude)
+        return bucketCount - 1;
+
+    // The sub bucket is given by the highest bits of the value below the leading one
+    int shift = magnitude - subBucketBits;
+    int subBucket = static_cast<int>(value >> shift) - subBucketCount;
+    return subBucketCount + shift * subBucketCount + subBucket;
+}
+
+qint64 LogHistogram::bucketUpperBound(int index)
+{
+    if (index < subBucketCount)
+        return index;
+
+    int shift = (index - subBucketCount) / subBucketCount;
+    qint64 subBucket = (index - subBucketCount) % subBucketCount + subBucketCount;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+}
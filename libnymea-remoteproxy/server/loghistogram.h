@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef LOGHISTOGRAM_H
+#define LOGHISTOGRAM_H
+
+#include <QPair>
+#include <QVector>
+#include <QVariantMap>
+
+namespace remoteproxy {
+
+// Log-linear bucketed histogram in the style of HdrHistogram. Every power of two range is split into
+// 16 linear sub buckets, so each recorded value keeps a precision of ~6 % over the whole range.
+// Recording is an index calculation and an increment, percentiles get evaluated when they are read.
+class LogHistogram
+{
+public:
+    LogHistogram();
+
+    // Monotonic timestamp in us for latency measurements
+    static qint64 timestamp();
+
+    void record(qint64 value);
+    void clear();
+
+    quint64 count() const;
+    qint64 sum() const;
+    qint64 max() const;
+
+    // The highest value equivalent to the given percentile (0 - 100) within the histogram precision
+    qint64 percentile(double percentile) const;
+
+    // Count, max and the p50, p99 and p999 values
+    QVariantMap statistics() const;
+
+    // Cumulative counts up to the power of two bounds (2^n - 1) until the largest recorded value,
+    // a coarse view of the buckets for exports which should not list every sub bucket.
+    QList<QPair<qint64, quint64>> cumulativeCounts() const;
+
+    static int bucketIndex(qint64 value);
+    static qint64 bucketUpperBound(int index);
+
+private:
+    QVector<quint64> m_bucketCounts;
+    quint64 m_count = 0;
+    qint64 m_sum = 0;
+    qint64 m_max = 0;
+
+};
+
+}
+
+#endif // LOGHISTOGRAM_H
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "engine.h"
+#include "metricsserver.h"
+#include "loghistogram.h"
+#include "loggingcategories.h"
+
+namespace remoteproxy {
+
+MetricsServer::MetricsServer(const QHostAddress &host, quint16 port, QObject *parent) :
+    QObject(parent),
+    m_host(host),
+    m_port(port)
+{
+
+}
+
+MetricsServer::~MetricsServer()
+{
+    stopServer();
+}
+
+bool MetricsServer::running() const
+{
+    if (!m_server)
+        return false;
+
+    return m_server->isListening();
+}
+
+quint16 MetricsServer::serverPort() const
+{
+    if (!m_server)
+        return m_port;
+
+    return m_server->serverPort();
+}
+
+QByteArray MetricsServer::buildMetrics()
+{
+    QByteArray metrics;
+    TunnelProxyServer *tunnelProxyServer = Engine::instance()->tunnelProxyServer();
+    if (!tunnelProxyServer) {
+        metrics.append("# EOF\n");
+        return metrics;
+    }
+
+    // Counters per transport
+    typedef quint64 (TransportInterface::*TransportCounter)() const;
+    struct TransportCounterFamily {
+        const char *name;
+        const char *help;
+        TransportCounter counter;
+    };
+
+    const TransportCounterFamily transportCounterFamilies[] = {
+        { "nymea_remoteproxy_transport_accepted_connections", "Accepted connections.", &TransportInterface::acceptedCount },
+        { "nymea_remoteproxy_transport_rejected_connections", "Connections rejected by the admission control.", &TransportInterface::rejectedCount },
+        { "nymea_remoteproxy_transport_received_bytes", "Bytes received from the connections.", &TransportInterface::rxBytes },
+        { "nymea_remoteproxy_transport_sent_bytes", "Bytes written to the connections.", &TransportInterface::writtenBytes },
+        { "nymea_remoteproxy_transport_received_frames", "Frames and packets received from the connections.", &TransportInterface::rxFrames },
+        { "nymea_remoteproxy_transport_sent_frames", "Frames and packets sent to the connections.", &TransportInterface::txFrames }
+    };
+
+    QList<TransportInterface *> transportInterfaces = tunnelProxyServer->transportInterfaces();
+    for (const TransportCounterFamily &family : transportCounterFamilies) {
+        appendFamily(&metrics, family.name, "counter", family.help);
+        foreach (TransportInterface *transportInterface, transportInterfaces) {
+            metrics.append(family.name);
+            metrics.append("_total{transport=\"" + transportInterface->serverName().toUtf8() + "\"} ");
+            metrics.append(QByteArray::number((transportInterface->*family.counter)()) + "\n");
+        }
+    }
+
+    // Gauges
+    appendFamily(&metrics, "nymea_remoteproxy_transport_connections", "gauge", "Open connections.");
+    foreach (TransportInterface *transportInterface, transportInterfaces) {
+        metrics.append("nymea_remoteproxy_transport_connections{transport=\"" + transportInterface->serverName().toUtf8() + "\"} ");
+        metrics.append(QByteArray::number(transportInterface->connectionsCount()) + "\n");
+    }
+
+    appendFamily(&metrics, "nymea_remoteproxy_registered_servers", "gauge", "Registered servers.");
+    metrics.append("nymea_remoteproxy_registered_servers " + QByteArray::number(tunnelProxyServer->serverConnectionsCount()) + "\n");
+
+    appendFamily(&metrics, "nymea_remoteproxy_registered_clients", "gauge", "Registered client tunnels.");
+    metrics.append("nymea_remoteproxy_registered_clients " + QByteArray::number(tunnelProxyServer->clientConnectionsCount()) + "\n");
+
+    AdmissionController *admissionController = Engine::instance()->admissionController();
+    appendFamily(&metrics, "nymea_remoteproxy_pending_handshakes", "gauge", "TLS handshakes in progress.");
+    metrics.append("nymea_remoteproxy_pending_handshakes " + QByteArray::number(admissionController ? admissionController->pendingHandshakes() : 0) + "\n");
+
+    appendFamily(&metrics, "nymea_remoteproxy_deferred_connections", "gauge", "Connections waiting for admission.");
+    metrics.append("nymea_remoteproxy_deferred_connections " + QByteArray::number(admissionController ? admissionController->deferredConnections() : 0) + "\n");
+
+    appendFamily(&metrics, "nymea_remoteproxy_buffered_bytes", "gauge", "Received data buffered until a frame or packet is complete.");
+    metrics.append("nymea_remoteproxy_buffered_bytes " + QByteArray::number(tunnelProxyServer->bufferedBytes()) + "\n");
+
+    // Histograms
+    appendFamily(&metrics, "nymea_remoteproxy_registration_latency_seconds", "histogram", "Time from the connection until the registration as server or client.");
+    appendHistogramSeries(&metrics, "nymea_remoteproxy_registration_latency_seconds", QByteArray(), tunnelProxyServer->registrationLatency());
+
+    appendFamily(&metrics, "nymea_remoteproxy_forwarding_latency_seconds", "histogram", "Time from the arrival of tunnel data until it has been written to the target connection.");
+    foreach (TransportInterface *transportInterface, transportInterfaces) {
+        QByteArray transportLabel = "transport=\"" + transportInterface->serverName().toUtf8() + "\"";
+        appendHistogramSeries(&metrics, "nymea_remoteproxy_forwarding_latency_seconds", transportLabel + ",direction=\"client_to_server\"",
+                              transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionClientToServer));
+        appendHistogramSeries(&metrics, "nymea_remoteproxy_forwarding_latency_seconds", transportLabel + ",direction=\"server_to_client\"",
+                              transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionServerToClient));
+    }
+
+    metrics.append("# EOF\n");
+    return metrics;
+}
+
+void MetricsServer::processRequest(QTcpSocket *socket, const QByteArray &request)
+{
+    QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    if (requestLine.count() < 2) {
+        sendResponse(socket, "400 Bad Request", "text/plain", "Bad request\n");
+        return;
+    }
+
+    if (requestLine.at(0) != "GET") {
+        sendResponse(socket, "405 Method Not Allowed", "text/plain", "Method not allowed\n");
+        return;
+    }
+
+    QByteArray path = requestLine.at(1);
+    int queryIndex = path.indexOf('?');
+    if (queryIndex >= 0)
+        path = path.left(queryIndex);
+
+    if (path != "/metrics") {
+        sendResponse(socket, "404 Not Found", "text/plain", "Not found\n");
+        return;
+    }
+
+    qCDebug(dcMetricsServer()) << "Metrics requested from" << socket->peerAddress().toString();
+    sendResponse(socket, "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", buildMetrics());
+}
+
+void MetricsServer::sendResponse(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType, const QByteArray &body)
+{
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response.append("Content-Type: " + contentType + "\r\n");
+    response.append("Content-Length: " + QByteArray::number(body.size()) + "\r\n");
+    response.append("Connection: close\r\n\r\n");
+    response.append(body);
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+void MetricsServer::appendFamily(QByteArray *metrics, const QByteArray &name, const QByteArray &type, const QByteArray &help)
+{
+    metrics->append("# TYPE " + name + " " + type + "\n");
+    metrics->append("# HELP " + name + " " + help + "\n");
+}
+
+void MetricsServer::appendHistogramSeries(QByteArray *metrics, const QByteArray &name, const QByteArray &labels, const LogHistogram &histogram)
+{
+    // The histogram records us. Only the power of two bounds get exported, the sub buckets stay internal for the percentiles.
+    QByteArray bucketLabels = labels.isEmpty() ? QByteArray() : labels + ",";
+    QByteArray seriesLabels = labels.isEmpty() ? QByteArray() : "{" + labels + "}";
+    QList<QPair<qint64, quint64>> cumulativeCounts = histogram.cumulativeCounts();
+    for (int i = 0; i < cumulativeCounts.count(); i++) {
+        metrics->append(name + "_bucket{" + bucketLabels + "le=\"" + QByteArray::number(cumulativeCounts.at(i).first / 1000000.0, 'g', 10) + "\"} ");
+        metrics->append(QByteArray::number(cumulativeCounts.at(i).second) + "\n");
+    }
+
+    metrics->append(name + "_bucket{" + bucketLabels + "le=\"+Inf\"} " + QByteArray::number(histogram.count()) + "\n");
+    metrics->append(name + "_count" + seriesLabels + " " + QByteArray::number(histogram.count()) + "\n");
+    metrics->append(name + "_sum" + seriesLabels + " " + QByteArray::number(histogram.sum() / 1000000.0, 'g', 10) + "\n");
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        m_requestBuffers.insert(socket, QByteArray());
+
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket](){
+            m_requestBuffers.remove(socket);
+            socket->deleteLater();
+        });
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket](){
+            if (!m_requestBuffers.contains(socket))
+                return;
+
+            QByteArray &request = m_requestBuffers[socket];
+            request.append(socket->readAll());
+            if (request.contains("\r\n\r\n") || request.contains("\n\n")) {
+                QByteArray completeRequest = m_requestBuffers.take(socket);
+                processRequest(socket, completeRequest);
+            } else if (request.size() > 8192) {
+                qCWarning(dcMetricsServer()) << "Request header too large from" << socket->peerAddress().toString() << "Closing the connection.";
+                m_requestBuffers.remove(socket);
+                socket->abort();
+            }
+        });
+    }
+}
+
+bool MetricsServer::startServer()
+{
+    qCDebug(dcMetricsServer()) << "Starting server on" << m_host.toString() << m_port;
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+    if (!m_server->listen(m_host, m_port)) {
+        qCWarning(dcMetricsServer()) << "Could not start metrics server on" << m_host.toString() << m_port << m_server->errorString();
+        delete m_server;
+        m_server = nullptr;
+        return false;
+    }
+
+    qCDebug(dcMetricsServer()) << "Started successfully on" << m_host.toString() << m_server->serverPort();
+    return true;
+}
+
+void MetricsServer::stopServer()
+{
+    if (!m_server)
+        return;
+
+    qCDebug(dcMetricsServer()) << "Stop server" << m_host.toString() << m_port;
+    m_requestBuffers.clear();
+
+    // The open sockets get deleted with the server
+    foreach (QTcpSocket *socket, m_server->findChildren<QTcpSocket *>()) {
+        socket->disconnect(this);
+    }
+
+    m_server->close();
+    delete m_server;
+    m_server = nullptr;
+}
+
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QHash>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+
+namespace remoteproxy {
+
+class LogHistogram;
+
+// Minimal HTTP server providing the proxy statistics in the OpenMetrics text format on GET /metrics.
+// The counters get updated on the hot path anyway, they are only formatted once scraped.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(const QHostAddress &host, quint16 port, QObject *parent = nullptr);
+    ~MetricsServer();
+
+    bool running() const;
+    quint16 serverPort() const;
+
+    static QByteArray buildMetrics();
+
+private:
+    QHostAddress m_host;
+    quint16 m_port = 0;
+    QTcpServer *m_server = nullptr;
+    QHash<QTcpSocket *, QByteArray> m_requestBuffers;
+
+    void processRequest(QTcpSocket *socket, const QByteArray &request);
+    void sendResponse(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType, const QByteArray &body);
+
+    static void appendFamily(QByteArray *metrics, const QByteArray &name, const QByteArray &type, const QByteArray &help);
+    static void appendHistogramSeries(QByteArray *metrics, const QByteArray &name, const QByteArray &labels, const LogHistogram &histogram);
+
+private slots:
+    void onNewConnection();
+
+public slots:
+    bool startServer();
+    void stopServer();
+
+};
+
+}
+
+#endif // METRICSSERVER_H
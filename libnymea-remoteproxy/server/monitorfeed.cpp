@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "monitorfeed.h"
+#include "tunnelproxy/tunnelproxyserver.h"
+#include "tunnelproxy/tunnelproxyserverconnection.h"
+#include "tunnelproxy/tunnelproxyclientconnection.h"
+
+namespace remoteproxy {
+
+MonitorFeed::MonitorFeed(TunnelProxyServer *tunnelProxyServer, QObject *parent) :
+    QObject(parent),
+    m_tunnelProxyServer(tunnelProxyServer)
+{
+    connect(m_tunnelProxyServer, &TunnelProxyServer::serverConnectionAdded, this, &MonitorFeed::onServerConnectionAdded);
+    connect(m_tunnelProxyServer, &TunnelProxyServer::serverConnectionRemoved, this, &MonitorFeed::onServerConnectionRemoved);
+    connect(m_tunnelProxyServer, &TunnelProxyServer::clientConnectionAdded, this, &MonitorFeed::onClientConnectionAdded);
+    connect(m_tunnelProxyServer, &TunnelProxyServer::clientConnectionRemoved, this, &MonitorFeed::onClientConnectionRemoved);
+
+    // The feed starts together with a snapshot, the current counters are known to the monitors
+    foreach (TunnelProxyClientConnection *clientConnection, m_tunnelProxyServer->clientConnections()) {
+        m_clientCounters.insert(clientConnection->clientUuid(), clientCounters(clientConnection));
+
+        TunnelProxyServerConnection *serverConnection = clientConnection->serverConnection();
+        if (serverConnection && !m_serverCounters.contains(serverConnection->serverUuid())) {
+            m_serverCounters.insert(serverConnection->serverUuid(), serverCounters(serverConnection));
+        }
+    }
+}
+
+QVariantMap MonitorFeed::takeChanges()
+{
+    QVariantMap changes;
+
+    QVariantList serversRemoved;
+    foreach (const QUuid &serverUuid, m_removedServers)
+        serversRemoved.append(serverUuid);
+
+    QVariantList clientsRemoved;
+    foreach (const QUuid &clientUuid, m_removedClients)
+        clientsRemoved.append(clientUuid);
+
+    // The servers with tunnels get collected from the tunnels, the idle servers are not walked at all.
+    // Only the uuids of tunnels with changed counters get converted.
+    QHash<QUuid, Counters> activeServerCounters;
+    QVariantMap serverCountersMap;
+    QVariantMap clientCountersMap;
+    foreach (TunnelProxyClientConnection *clientConnection, m_tunnelProxyServer->clientConnections()) {
+        Counters counters = clientCounters(clientConnection);
+        QHash<QUuid, Counters>::iterator it = m_clientCounters.find(clientConnection->clientUuid());
+        if (it == m_clientCounters.end() || !(it.value() == counters)) {
+            m_clientCounters.insert(clientConnection->clientUuid(), counters);
+            clientCountersMap.insert(clientConnection->clientUuid().toString(), countersMap(counters, false));
+        }
+
+        TunnelProxyServerConnection *serverConnection = clientConnection->serverConnection();
+        if (!serverConnection || activeServerCounters.contains(serverConnection->serverUuid()))
+            continue;
+
+        QUuid serverUuid = serverConnection->serverUuid();
+        Counters serverConnectionCounters = serverCounters(serverConnection);
+        activeServerCounters.insert(serverUuid, serverConnectionCounters);
+        QHash<QUuid, Counters>::const_iterator serverIt = m_serverCounters.constFind(serverUuid);
+        if (serverIt == m_serverCounters.constEnd()) {
+            // The server got its first tunnel, monitors showing only the active servers do not know it yet
+            if (!m_addedServers.contains(serverUuid))
+                m_addedServers.insert(serverUuid, TunnelProxyServer::serverConnectionStatistics(serverConnection));
+
+            continue;
+        }
+
+        if (!(serverIt.value() == serverConnectionCounters)) {
+            serverCountersMap.insert(serverUuid.toString(), countersMap(serverConnectionCounters, true));
+        }
+    }
+    m_serverCounters = activeServerCounters;
+
+    QVariantList serversAdded;
+    foreach (const QVariantMap &serverMap, m_addedServers)
+        serversAdded.append(serverMap);
+
+    QVariantList clientsAdded;
+    foreach (const QVariantMap &clientMap, m_addedClients)
+        clientsAdded.append(clientMap);
+
+    changes.insert("serversRemoved", serversRemoved);
+    changes.insert("clientsRemoved", clientsRemoved);
+    changes.insert("serversAdded", serversAdded);
+    changes.insert("clientsAdded", clientsAdded);
+    changes.insert("serverCounters", serverCountersMap);
+    changes.insert("clientCounters", clientCountersMap);
+
+    m_removedServers.clear();
+    m_removedClients.clear();
+    m_addedServers.clear();
+    m_addedClients.clear();
+    return changes;
+}
+
+bool MonitorFeed::Counters::operator==(const Counters &other) const
+{
+    return rxDataCount == other.rxDataCount
+            && txDataCount == other.txDataCount
+            && rxFrameCount == other.rxFrameCount
+            && txFrameCount == other.txFrameCount;
+}
+
+MonitorFeed::Counters MonitorFeed::serverCounters(TunnelProxyServerConnection *serverConnection)
+{
+    Counters counters;
+    counters.rxDataCount = serverConnection->transportClient()->rxDataCount();
+    counters.txDataCount = serverConnection->transportClient()->txDataCount();
+    counters.rxFrameCount = serverConnection->transportClient()->rxFrameCount();
+    counters.txFrameCount = serverConnection->transportClient()->txFrameCount();
+    counters.roundTripTime = serverConnection->roundTripTime();
+    counters.hasRates = serverConnection->serverUuid() == serverConnection->transportClient()->uuid();
+    counters.byteRate = qRound64(serverConnection->byteRate());
+    counters.frameRate = qRound64(serverConnection->frameRate());
+    return counters;
+}
+
+MonitorFeed::Counters MonitorFeed::clientCounters(TunnelProxyClientConnection *clientConnection)
+{
+    Counters counters;
+    counters.rxDataCount = clientConnection->transportClient()->rxDataCount();
+    counters.txDataCount = clientConnection->transportClient()->txDataCount();
+    counters.rxFrameCount = clientConnection->transportClient()->rxFrameCount();
+    counters.txFrameCount = clientConnection->transportClient()->txFrameCount();
+    return counters;
+}
+
+QVariantMap MonitorFeed::countersMap(const Counters &counters, bool includeServerValues)
+{
+    QVariantMap countersMap;
+    countersMap.insert("rxDataCount", counters.rxDataCount);
+    countersMap.insert("txDataCount", counters.txDataCount);
+    countersMap.insert("rxFrameCount", counters.rxFrameCount);
+    countersMap.insert("txFrameCount", counters.txFrameCount);
+    if (includeServerValues) {
+        countersMap.insert("rtt", counters.roundTripTime);
+    }
+
+    if (counters.hasRates) {
+        countersMap.insert("byteRate", counters.byteRate);
+        countersMap.insert("frameRate", counters.frameRate);
+    }
+
+    return countersMap;
+}
+
+void MonitorFeed::onServerConnectionAdded(TunnelProxyServerConnection *serverConnection)
+{
+    m_addedServers.insert(serverConnection->serverUuid(), TunnelProxyServer::serverConnectionStatistics(serverConnection));
+}
+
+void MonitorFeed::onServerConnectionRemoved(const QUuid &serverUuid)
+{
+    // A server can disconnect and register again within one update, the removal gets applied first
+    m_addedServers.remove(serverUuid);
+    m_removedServers.append(serverUuid);
+    m_serverCounters.remove(serverUuid);
+}
+
+void MonitorFeed::onClientConnectionAdded(TunnelProxyClientConnection *clientConnection)
+{
+    QVariantMap clientMap = TunnelProxyServer::clientConnectionStatistics(clientConnection);
+    clientMap.insert("serverUuid", clientConnection->serverUuid());
+    m_addedClients.insert(clientConnection->clientUuid(), clientMap);
+    m_clientCounters.insert(clientConnection->clientUuid(), clientCounters(clientConnection));
+}
+
+void MonitorFeed::onClientConnectionRemoved(const QUuid &clientUuid)
+{
+    m_addedClients.remove(clientUuid);
+    m_removedClients.append(clientUuid);
+    m_clientCounters.remove(clientUuid);
+}
+
+}
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef MONITORFEED_H
+#define MONITORFEED_H
+
+#include <QHash>
+#include <QUuid>
+#include <QObject>
+#include <QVariantMap>
+
+namespace remoteproxy {
+
+class TunnelProxyServer;
+class TunnelProxyServerConnection;
+class TunnelProxyClientConnection;
+
+// Collects the changes of the tunnels between two monitor updates. Added and removed tunnels come
+// from the connection events of the tunnel proxy server. Only servers with tunnels carry tunnel traffic,
+// so the counters of those servers and of the tunnels get compared with the values of the previous
+// update. Idle servers with keepalive traffic only never show up in an update.
+class MonitorFeed : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MonitorFeed(TunnelProxyServer *tunnelProxyServer, QObject *parent = nullptr);
+
+    // The changes since the previous call. Added tunnels and counters carry the complete values,
+    // so applying an update twice or on top of a newer snapshot gives the same result.
+    QVariantMap takeChanges();
+
+private:
+    struct Counters {
+        quint64 rxDataCount = 0;
+        quint64 txDataCount = 0;
+        quint64 rxFrameCount = 0;
+        quint64 txFrameCount = 0;
+        int roundTripTime = -1;
+        bool hasRates = false;
+        qint64 byteRate = 0;
+        qint64 frameRate = 0;
+
+        // Compares the traffic only, the round trip time and the rates get sent along with the traffic
+        bool operator==(const Counters &other) const;
+    };
+
+    TunnelProxyServer *m_tunnelProxyServer = nullptr;
+
+    QHash<QUuid, QVariantMap> m_addedServers;
+    QList<QUuid> m_removedServers;
+    QHash<QUuid, QVariantMap> m_addedClients;
+    QList<QUuid> m_removedClients;
+
+    // Counters of the previous update, for the servers with tunnels
+    QHash<QUuid, Counters> m_serverCounters;
+    QHash<QUuid, Counters> m_clientCounters;
+
+    static Counters serverCounters(TunnelProxyServerConnection *serverConnection);
+    static Counters clientCounters(TunnelProxyClientConnection *clientConnection);
+    static QVariantMap countersMap(const Counters &counters, bool includeServerValues);
+
+private slots:
+    void onServerConnectionAdded(TunnelProxyServerConnection *serverConnection);
+    void onServerConnectionRemoved(const QUuid &serverUuid);
+    void onClientConnectionAdded(TunnelProxyClientConnection *clientConnection);
+    void onClientConnectionRemoved(const QUuid &clientUuid);
+
+};
+
+}
+
+#endif // MONITORFEED_H
@@ -26,6 +26,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "engine.h"
+#include "monitorfeed.h"
 #include "monitorserver.h"
 #include "loggingcategories.h"
 
@@ -38,7 +39,9 @@ MonitorServer::MonitorServer(const QString &serverName, QObject *parent) :
     QObject(parent),
     m_serverName(serverName)
 {
-
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(false);
+    connect(m_updateTimer, &QTimer::timeout, this, &MonitorServer::onUpdateTimeout);
 }
 
 MonitorServer::~MonitorServer()
@@ -62,6 +65,62 @@ void MonitorServer::sendMonitorData(QLocalSocket *clientConnection, const QVaria
     clientConnection->flush();
 }
 
+void MonitorServer::subscribe(QLocalSocket *clientConnection, const QVariantMap &params)
+{
+    TunnelProxyServerQuery query;
+    if (!parseQuery(params, &query)) {
+        qCWarning(dcMonitorServer()) << "Invalid monitor query" << params << "Closing connection.";
+        clientConnection->close();
+        return;
+    }
+
+    if (!m_subscribers.contains(clientConnection))
+        m_subscribers.append(clientConnection);
+
+    // printAll alone selects all servers for the snapshot instead of the active ones, it is not a query
+    QVariantMap queryParams = params;
+    bool printAll = queryParams.take("printAll").toBool();
+
+    // Monitors looking at a page of the servers get the page again in each update
+    if (queryParams.isEmpty()) {
+        m_subscriberQueries.remove(clientConnection);
+    } else {
+        m_subscriberQueries.insert(clientConnection, query);
+    }
+
+    // The feed only follows the connection events while someone is listening
+    if (!m_feed) {
+        m_feed = new MonitorFeed(Engine::instance()->tunnelProxyServer(), this);
+        m_updateTimer->start(Engine::instance()->configuration()->monitorUpdateInterval());
+    }
+
+    qCDebug(dcMonitorServer()) << "Monitor subscribed." << m_subscribers.count() << "subscribers";
+    QVariantMap monitorData = queryParams.isEmpty() ? Engine::instance()->buildMonitorData(printAll) : Engine::instance()->buildMonitorData(query);
+    monitorData.insert("type", "snapshot");
+    sendMonitorData(clientConnection, monitorData);
+}
+
+void MonitorServer::unsubscribe(QLocalSocket *clientConnection)
+{
+    m_subscriberQueries.remove(clientConnection);
+    if (!m_subscribers.removeAll(clientConnection) || !m_subscribers.isEmpty())
+        return;
+
+    qCDebug(dcMonitorServer()) << "Last monitor unsubscribed, stop the monitor updates";
+    m_updateTimer->stop();
+    delete m_feed;
+    m_feed = nullptr;
+}
+
+bool MonitorServer::parseQuery(const QVariantMap &params, TunnelProxyServerQuery *query) const
+{
+    if (!TunnelProxyServerQuery::fromVariantMap(params, query))
+        return false;
+
+    query->activeOnly = !params.value("printAll", false).toBool();
+    return true;
+}
+
 void MonitorServer::onMonitorConnected()
 {
     QLocalSocket *clientConnection = m_server->nextPendingConnection();
@@ -76,6 +135,7 @@ void MonitorServer::onMonitorDisconnected()
     qCDebug(dcMonitorServer()) << "Monitor disconnected.";
     QLocalSocket *clientConnection = static_cast<QLocalSocket *>(sender());
     m_clients.removeAll(clientConnection);
+    unsubscribe(clientConnection);
     clientConnection->deleteLater();
 }
 
@@ -98,30 +158,118 @@ void MonitorServer::processRequest(QLocalSocket *clientConnection, const QVarian
 {
     /* Refresh method. If no params, it will return the active list of connections
 
-         TODO: filter for uuid's, ip's, names etc...
+         {
+            "method": "refresh",
+            "params": {
+                "printAll": bool
+            }
+         }
+
+       The servers can be filtered, sorted and paged. All given filters have to match: "uuid" and
+       "name" are prefixes (the name is case insensitive), "address" is an address or a CIDR subnet.
+       "sortBy" sorts descending by "rxDataCount", "txDataCount" or "throughput" (the smoothed byte rate, the same value as "byteRate").
+       With any of these params the result contains the page of servers from "offset" with at most
+       "limit" entries, and "query": { "offset", "limit", "count", "more" } in the tunnel statistics.
 
          {
             "method": "refresh",
+            "params": {
+                "printAll": bool,
+                "uuid": string,
+                "name": string,
+                "address": string,
+                "sortBy": string,
+                "offset": int,
+                "limit": int
+            }
+         }
+
+       Drain method. Stops accepting new registrations and asks the registered servers to reconnect,
+       spread randomly over the given window in ms. If no window is given, the configured drain window will be used.
+       Returns the same data as refresh.
+
+         {
+            "method": "drain",
+            "params": {
+                "window": int
+            }
+         }
+
+       Memory method. Returns the memory report with the process memory, the connection counts
+       and the usage of the slab allocators for the per-connection objects.
+
+         {
+            "method": "memory"
+         }
+
+       Subscribe method. Returns a snapshot like refresh with the active connections, or all of them with
+       "printAll", and "type": "snapshot". In the configured update interval follow updates with "type": "delta",
+       containing the statistics without the tunnel list and the changes since the previous update: "serversAdded"
+       (also servers getting their first tunnel), "clientsAdded" (with the "serverUuid" of the tunnel),
+       "serversRemoved", "clientsRemoved" (uuids) and the "serverCounters" and "clientCounters" of the tunnels
+       with traffic since the previous update (uuid, counters). Idle servers do not show up in the updates.
+
+         {
+            "method": "subscribe",
             "params": {
                 "printAll": bool
             }
          }
 
+       A subscribe with the query params of refresh gets the page of servers with "type": "snapshot"
+       in each update instead of the deltas. Subscribing again replaces the query.
+
      */
 
     // Note: as simple as possible...no error handling, either you know what you do, or you see nothing here.
     if (request.contains("method")) {
+        if (request.value("method").toString() == "drain") {
+            int window = Engine::instance()->configuration()->drainWindow();
+            QVariantMap params = request.value("params").toMap();
+            if (params.contains("window")) {
+                window = params.value("window").toInt();
+            }
+
+            qCDebug(dcMonitorServer()) << "Drain requested with a window of" << window << "ms";
+            Engine::instance()->tunnelProxyServer()->startDrain(window);
+            sendMonitorData(clientConnection, Engine::instance()->buildMonitorData());
+            return;
+        }
+
+        if (request.value("method").toString() == "memory") {
+            QVariantMap monitorData;
+            monitorData.insert("memory", Engine::instance()->buildMemoryReport());
+            sendMonitorData(clientConnection, monitorData);
+            return;
+        }
+
+        if (request.value("method").toString() == "subscribe") {
+            subscribe(clientConnection, request.value("params").toMap());
+            return;
+        }
+
         if (request.value("method").toString() == "refresh") {
             bool printAll = false;
+            QVariantMap params;
             if (request.contains("params")) {
-                QVariantMap params = request.value("params").toMap();
+                params = request.value("params").toMap();
                 if (params.contains("printAll")) {
                     printAll = params.value("printAll").toBool();
+                    params.remove("printAll");
                 }
             }
 
-            sendMonitorData(clientConnection, Engine::instance()->buildMonitorData(printAll));
-            return;
+            if (params.isEmpty()) {
+                sendMonitorData(clientConnection, Engine::instance()->buildMonitorData(printAll));
+                return;
+            }
+
+            TunnelProxyServerQuery query;
+            if (parseQuery(params, &query)) {
+                query.activeOnly = !printAll;
+                sendMonitorData(clientConnection, Engine::instance()->buildMonitorData(query));
+                return;
+            }
         }
     }
 
@@ -164,15 +312,40 @@ void MonitorServer::stopServer()
         clientConnection->close();
     }
 
+    m_updateTimer->stop();
+    m_subscribers.clear();
+    m_subscriberQueries.clear();
+    delete m_feed;
+    m_feed = nullptr;
+
     m_server->close();
     delete m_server;
     m_server = nullptr;
 }
 
+void MonitorServer::onUpdateTimeout()
+{
+    if (!m_feed)
+        return;
+
+    QVariantMap monitorData = Engine::instance()->buildMonitorUpdate(m_feed->takeChanges());
+    monitorData.insert("type", "delta");
+    updateClients(monitorData);
+
+    foreach (QLocalSocket *clientConnection, m_subscriberQueries.keys()) {
+        QVariantMap pageData = Engine::instance()->buildMonitorData(m_subscriberQueries.value(clientConnection));
+        pageData.insert("type", "snapshot");
+        sendMonitorData(clientConnection, pageData);
+    }
+}
+
 void MonitorServer::updateClients(const QVariantMap &dataMap)
 {
-    // Send each monitor the current data
-    foreach (QLocalSocket *clientConnection, m_clients) {
+    // Send each subscribed monitor without a query the data
+    foreach (QLocalSocket *clientConnection, m_subscribers) {
+        if (m_subscriberQueries.contains(clientConnection))
+            continue;
+
         sendMonitorData(clientConnection, dataMap);
     }
 }
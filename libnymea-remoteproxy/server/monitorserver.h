@@ -33,8 +33,12 @@
 #include <QLocalServer>
 #include <QLocalSocket>
 
+#include "tunnelproxy/tunnelproxyserverindex.h"
+
 namespace remoteproxy {
 
+class MonitorFeed;
+
 class MonitorServer : public QObject
 {
     Q_OBJECT
@@ -49,7 +53,16 @@ private:
     QLocalServer *m_server = nullptr;
     QList<QLocalSocket *> m_clients;
 
+    // Subscribed monitors get a snapshot followed by the changes in the update interval
+    QList<QLocalSocket *> m_subscribers;
+    QHash<QLocalSocket *, TunnelProxyServerQuery> m_subscriberQueries;
+    MonitorFeed *m_feed = nullptr;
+    QTimer *m_updateTimer = nullptr;
+
     void sendMonitorData(QLocalSocket *clientConnection, const QVariantMap &dataMap);
+    void subscribe(QLocalSocket *clientConnection, const QVariantMap &params);
+    void unsubscribe(QLocalSocket *clientConnection);
+    bool parseQuery(const QVariantMap &params, TunnelProxyServerQuery *query) const;
 
 private slots:
     void onMonitorConnected();
@@ -57,6 +70,7 @@ private slots:
     void onMonitorReadyRead();
 
     void processRequest(QLocalSocket *clientConnection, const QVariantMap &request);
+    void onUpdateTimeout();
 
 public slots:
     void startServer();
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SLABALLOCATOR_H
+#define SLABALLOCATOR_H
+
+#include <new>
+#include <type_traits>
+
+#include <QList>
+#include <QVariantMap>
+
+namespace remoteproxy {
+
+// Fixed size slot allocator for objects which exist once per connection. The slots are carved
+// out of larger chunks, which saves the malloc overhead per object and keeps the objects of
+// one type together. Released slots get reused, the chunks stay reserved for the next connections.
+// Note: not thread safe, all connection objects live in the engine thread.
+template <typename T, int SlotsPerChunk = 256>
+class SlabAllocator
+{
+public:
+    static SlabAllocator &instance() {
+        static SlabAllocator allocator;
+        return allocator;
+    }
+
+    void *allocate(size_t size) {
+        // Derived classes inherit the class operator new, they do not fit into the slots
+        if (size != sizeof(T))
+            return ::operator new(size);
+
+        if (!m_freeSlots)
+            grow();
+
+        Slot *slot = m_freeSlots;
+        m_freeSlots = slot->next;
+        m_usedSlots++;
+        return slot;
+    }
+
+    void release(void *pointer, size_t size) {
+        if (!pointer)
+            return;
+
+        if (size != sizeof(T)) {
+            ::operator delete(pointer);
+            return;
+        }
+
+        Slot *slot = static_cast<Slot *>(pointer);
+        slot->next = m_freeSlots;
+        m_freeSlots = slot;
+        m_usedSlots--;
+    }
+
+    int slotSize() const { return sizeof(Slot); }
+    int usedSlots() const { return m_usedSlots; }
+    int totalSlots() const { return m_chunks.count() * SlotsPerChunk; }
+    qint64 reservedBytes() const { return static_cast<qint64>(m_chunks.count()) * SlotsPerChunk * sizeof(Slot); }
+
+    QVariantMap statistics() const {
+        QVariantMap statisticsMap;
+        statisticsMap.insert("slotSize", slotSize());
+        statisticsMap.insert("usedSlots", usedSlots());
+        statisticsMap.insert("totalSlots", totalSlots());
+        statisticsMap.insert("reservedBytes", reservedBytes());
+        return statisticsMap;
+    }
+
+private:
+    union Slot {
+        Slot *next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    QList<Slot *> m_chunks;
+    Slot *m_freeSlots = nullptr;
+    int m_usedSlots = 0;
+
+    SlabAllocator() = default;
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    ~SlabAllocator() {
+        // Objects still alive on exit keep their chunk
+        if (m_usedSlots != 0)
+            return;
+
+        foreach (Slot *chunk, m_chunks) {
+            delete[] chunk;
+        }
+    }
+
+    void grow() {
+        Slot *chunk = new Slot[SlotsPerChunk];
+        for (int i = 0; i < SlotsPerChunk - 1; i++) {
+            chunk[i].next = &chunk[i + 1];
+        }
+
+        chunk[SlotsPerChunk - 1].next = m_freeSlots;
+        m_freeSlots = chunk;
+        m_chunks.append(chunk);
+    }
+};
+
+}
+
+#endif // SLABALLOCATOR_H
@@ -52,11 +52,35 @@ void TcpSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     }
 
     qCDebug(dcTcpSocketServerTraffic()) << "Send data to" << clientId.toString() << data;
+    addWrite(data.count());
     if (client->write(data) < 0) {
         qCWarning(dcTcpSocketServer()) << "Could not write data to client socket" << clientId.toString();
     }
 }
 
+void TcpSocketServer::sendDataSlices(const QUuid &clientId, const QList<QByteArray> &slices)
+{
+    QSslSocket *client = m_clientList.value(clientId);
+    if (!client) {
+        qCWarning(dcTcpSocketServer()) << "Client" << clientId << "unknown to this transport";
+        return;
+    }
+
+    // The slices get queued in the socket write buffer and leave within the same flush
+    qCDebug(dcTcpSocketServerTraffic()) << "Send data slices to" << clientId.toString() << slices;
+    int dataCount = 0;
+    foreach (const QByteArray &slice, slices)
+        dataCount += slice.count();
+
+    addWrite(dataCount);
+    foreach (const QByteArray &slice, slices) {
+        if (client->write(slice) < 0) {
+            qCWarning(dcTcpSocketServer()) << "Could not write data to client socket" << clientId.toString();
+            return;
+        }
+    }
+}
+
 void TcpSocketServer::killClientConnection(const QUuid &clientId, const QString &killReason)
 {
     QSslSocket *client = m_clientList.value(clientId);
@@ -75,6 +99,22 @@ uint TcpSocketServer::connectionsCount() const
     return m_clientList.count();
 }
 
+int TcpSocketServer::compact()
+{
+    if (!m_server)
+        return 0;
+
+    return m_server->compactReadBuffers();
+}
+
+quint64 TcpSocketServer::rejectedCount() const
+{
+    if (!m_admissionController)
+        return 0;
+
+    return m_admissionController->rejectedCount();
+}
+
 bool TcpSocketServer::running() const
 {
     if (!m_server)
@@ -83,6 +123,14 @@ bool TcpSocketServer::running() const
     return m_server->isListening();
 }
 
+void TcpSocketServer::setAdmissionController(AdmissionController *admissionController)
+{
+    m_admissionController = admissionController;
+    if (m_server) {
+        m_server->setAdmissionController(m_admissionController);
+    }
+}
+
 bool TcpSocketServer::startServer()
 {
     if (m_server) {
@@ -93,7 +141,7 @@ bool TcpSocketServer::startServer()
 
     qCDebug(dcTcpSocketServer()) << "Starting TCP server" << m_serverUrl.toString();
     m_server = new SslServer(m_sslEnabled, m_sslConfiguration, this);
-    m_server->setMaxPendingConnections(100);
+    m_server->setAdmissionController(m_admissionController);
     if(!m_server->listen(QHostAddress(m_serverUrl.host()), static_cast<quint16>(m_serverUrl.port()))) {
         qCWarning(dcTcpSocketServer()) << "Tcp server error: can not listen on" << m_serverUrl.toString();
         delete m_server;
@@ -168,15 +216,32 @@ SslServer::SslServer(bool sslEnabled, const QSslConfiguration &config, QObject *
     connect(this, &QTcpServer::acceptError, this, [this](QAbstractSocket::SocketError socketError){
         qCWarning(dcTcpSocketServer()) << "Accept error occurred" << socketError << errorString();
     });
+}
 
-    connect(this, &QTcpServer::newConnection, this, [this](){
-        while (hasPendingConnections()) {
-            SslClient *sslSocket = qobject_cast<SslClient *>(nextPendingConnection());
-            if (!m_sslEnabled) {
-                emit socketConnected(sslSocket);
-            }
+SslServer::~SslServer()
+{
+    // The sockets get deleted with this object, make sure the admission controller forgets about them
+    if (m_admissionController) {
+        foreach (SslClient *sslSocket, m_clients) {
+            m_admissionController->removeConnection(sslSocket);
         }
-    });
+    }
+}
+
+int SslServer::compactReadBuffers()
+{
+    return m_readBufferPool.trim();
+}
+
+void SslServer::setAdmissionController(AdmissionController *admissionController)
+{
+    if (m_admissionController)
+        disconnect(m_admissionController, &AdmissionController::connectionAdmitted, this, &SslServer::onConnectionAdmitted);
+
+    m_admissionController = admissionController;
+
+    if (m_admissionController)
+        connect(m_admissionController, &AdmissionController::connectionAdmitted, this, &SslServer::onConnectionAdmitted);
 }
 
 void SslServer::incomingConnection(qintptr socketDescriptor)
@@ -189,6 +254,38 @@ void SslServer::incomingConnection(qintptr socketDescriptor)
         return;
     }
 
+    if (m_admissionController) {
+        switch (m_admissionController->requestAdmission(sslSocket)) {
+        case AdmissionController::DecisionReject:
+            sslSocket->abort();
+            delete sslSocket;
+            return;
+        case AdmissionController::DecisionDefer:
+            // Keep the socket idle and limit what it may buffer until the admission controller lets it through
+            m_clients.append(sslSocket);
+            m_deferredClients.insert(sslSocket);
+            sslSocket->setReadBufferSize(16 * 1024);
+            connect(sslSocket, &SslClient::disconnected, this, [this, sslSocket](){
+                qCDebug(dcTcpSocketServer()) << "Deferred client socket disconnected before admission:" << sslSocket << sslSocket->peerAddress().toString();
+                if (m_admissionController)
+                    m_admissionController->removeConnection(sslSocket);
+
+                m_deferredClients.remove(sslSocket);
+                m_clients.removeAll(sslSocket);
+                sslSocket->deleteLater();
+            });
+            return;
+        case AdmissionController::DecisionAdmit:
+            break;
+        }
+    }
+
+    m_clients.append(sslSocket);
+    setupClient(sslSocket);
+}
+
+void SslServer::setupClient(SslClient *sslSocket)
+{
     connect(sslSocket, &SslClient::disconnected, this, [this, sslSocket](){
         qCDebug(dcTcpSocketServer()) << "Client socket disconnected:" << sslSocket << sslSocket->peerAddress().toString();;
 
@@ -208,23 +305,22 @@ void SslServer::incomingConnection(qintptr socketDescriptor)
             emit socketDisconnected(sslSocket);
         }
 
+        if (m_admissionController)
+            m_admissionController->removeConnection(sslSocket);
+
         m_clients.removeAll(sslSocket);
         sslSocket->deleteLater();
     });
 
     connect(sslSocket, &QSslSocket::readyRead, this, [this, sslSocket](){
-
-        // Only forward data from an encrypted socket if ssl is enabled
-        if (m_sslEnabled && !sslSocket->isEncrypted())
-            return;
-
-        QByteArray data = sslSocket->readAll();
-        qCDebug(dcTcpSocketServerTraffic()) << "Data from socket" << sslSocket->peerAddress().toString() << data;
-        emit dataAvailable(sslSocket, data);
+        readClientData(sslSocket);
     });
 
     connect(sslSocket, &SslClient::encrypted, this, [this, sslSocket](){
         qCDebug(dcTcpSocketServer()) << "SSL encryption established for" << sslSocket;
+        if (m_admissionController)
+            m_admissionController->finishHandshake(sslSocket);
+
         emit socketConnected(sslSocket);
     });
 
@@ -262,28 +358,72 @@ void SslServer::incomingConnection(qintptr socketDescriptor)
         sslSocket->setSslConfiguration(m_config);
         sslSocket->startServerEncryption();
         sslSocket->startWaitingForEncrypted();
+    } else {
+        // There is no handshake for plain connections
+        if (m_admissionController)
+            m_admissionController->finishHandshake(sslSocket);
+
+        emit socketConnected(sslSocket);
+
+        // Forward anything the client sent while the connection was deferred
+        if (sslSocket->bytesAvailable() > 0) {
+            readClientData(sslSocket);
+        }
+    }
+}
+
+void SslServer::readClientData(SslClient *sslSocket)
+{
+    // Only forward data from an encrypted socket if ssl is enabled
+    if (m_sslEnabled && !sslSocket->isEncrypted())
+        return;
+
+    // The data is a slice of a pooled buffer, which is free again once the data has been processed
+    QByteArray data = m_readBufferPool.read(sslSocket);
+    while (!data.isEmpty()) {
+        qCDebug(dcTcpSocketServerTraffic()) << "Data from socket" << sslSocket->peerAddress().toString() << data;
+        emit dataAvailable(sslSocket, data);
+        data = m_readBufferPool.read(sslSocket);
     }
+}
 
-    m_clients.append(sslSocket);
-    addPendingConnection(sslSocket);
+void SslServer::onConnectionAdmitted(QTcpSocket *socket)
+{
+    SslClient *sslSocket = qobject_cast<SslClient *>(socket);
+    if (!sslSocket || !m_deferredClients.remove(sslSocket))
+        return;
+
+    qCDebug(dcTcpSocketServer()) << "Deferred connection admitted" << sslSocket << sslSocket->peerAddress().toString();
+
+    // Replace the disconnect handling of the deferred state and lift the read buffer limit
+    disconnect(sslSocket, &SslClient::disconnected, this, nullptr);
+    sslSocket->setReadBufferSize(0);
+    setupClient(sslSocket);
 }
 
 SslClient::SslClient(QObject *parent) :
     QSslSocket(parent)
 {
-    m_timer.setSingleShot(true);
-    m_timer.setInterval(5000);
-    connect(&m_timer, &QTimer::timeout, this, [this](){
-        qCWarning(dcTcpSocketServer()) << "SSL socket timeout occurred. The client has not encrypted the connection within" << (m_timer.interval() / 1000) << "seconds. Terminate connection";
-        close();
+    connect(this, &SslClient::encrypted, this, [this](){
+        m_encryptionTimer.stop();
     });
-
-    connect(this, &SslClient::encrypted, &m_timer, &QTimer::stop);
 }
 
 void SslClient::startWaitingForEncrypted()
 {
-    m_timer.start();
+    m_encryptionTimer.start(5000, this);
+}
+
+void SslClient::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_encryptionTimer.timerId()) {
+        QSslSocket::timerEvent(event);
+        return;
+    }
+
+    m_encryptionTimer.stop();
+    qCWarning(dcTcpSocketServer()) << "SSL socket timeout occurred. The client has not encrypted the connection within 5 seconds. Terminate connection";
+    close();
 }
 
 }
@@ -29,12 +29,17 @@
 #define TCPSOCKETSERVER_H
 
 #include <QUuid>
-#include <QTimer>
+#include <QTimerEvent>
+#include <QBasicTimer>
 #include <QObject>
+#include <QSet>
+#include <QPointer>
 #include <QTcpServer>
 #include <QSslConfiguration>
 
 #include "transportinterface.h"
+#include "admissioncontroller.h"
+#include "../common/bufferpool.h"
 
 namespace remoteproxy {
 
@@ -47,8 +52,12 @@ public:
 
     void startWaitingForEncrypted();
 
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
 private:
-    QTimer m_timer;
+    // A basic timer instead of a QTimer object per socket
+    QBasicTimer m_encryptionTimer;
 
 };
 
@@ -57,7 +66,11 @@ class SslServer: public QTcpServer
     Q_OBJECT
 public:
     explicit SslServer(bool sslEnabled, const QSslConfiguration &config, QObject *parent = nullptr);
-    ~SslServer() override = default;
+    ~SslServer() override;
+
+    void setAdmissionController(AdmissionController *admissionController);
+
+    int compactReadBuffers();
 
 signals:
     void socketConnected(QSslSocket *socket);
@@ -70,8 +83,17 @@ protected:
 private:
     bool m_sslEnabled = false;
     QSslConfiguration m_config;
+    QPointer<AdmissionController> m_admissionController;
 
     QVector<SslClient *> m_clients;
+    QSet<SslClient *> m_deferredClients;
+    BufferPool m_readBufferPool;
+
+    void setupClient(SslClient *sslSocket);
+    void readClientData(SslClient *sslSocket);
+
+private slots:
+    void onConnectionAdmitted(QTcpSocket *socket);
 
 };
 
@@ -84,12 +106,19 @@ public:
     ~TcpSocketServer() override;
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
+    void sendDataSlices(const QUuid &clientId, const QList<QByteArray> &slices) override;
     void killClientConnection(const QUuid &clientId, const QString &killReason) override;
 
     uint connectionsCount() const override;
+    int compact() override;
+
+    // Connections rejected by the admission control
+    quint64 rejectedCount() const override;
 
     bool running() const override;
 
+    void setAdmissionController(AdmissionController *admissionController);
+
 public slots:
     bool startServer() override;
     bool stopServer() override;
@@ -101,6 +130,7 @@ private:
     QHash<QUuid, QSslSocket *> m_clientList;
 
     SslServer *m_server = nullptr;
+    AdmissionController *m_admissionController = nullptr;
 
 private slots:
     void onDataAvailable(QSslSocket *client, const QByteArray &data);
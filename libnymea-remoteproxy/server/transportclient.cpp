@@ -28,6 +28,7 @@
 #include "transportclient.h"
 #include "server/transportinterface.h"
 
+#include <QTimerEvent>
 #include <QDateTime>
 
 namespace remoteproxy {
@@ -39,6 +40,8 @@ TransportClient::TransportClient(TransportInterface *interface, const QUuid &cli
     m_peerAddress(address)
 {
     m_creationTimeStamp = QDateTime::currentDateTime().toSecsSinceEpoch();
+    m_lastRxTimer.start();
+    m_connectedTimer.start();
 }
 
 QUuid TransportClient::clientId() const
@@ -130,8 +133,12 @@ quint64 TransportClient::rxDataCount() const
 void TransportClient::addRxDataCount(int dataCount)
 {
     m_rxDataCount += dataCount;
+    if (m_interface)
+        m_interface->addRxData(dataCount);
+
     if (dataCount > 0) {
-        emit rxDataCountChanged();
+        m_lastRxTimer.restart();
+        m_compacted = false;
     }
 }
 
@@ -143,14 +150,79 @@ quint64 TransportClient::txDataCount() const
 void TransportClient::addTxDataCount(int dataCount)
 {
     m_txDataCount += dataCount;
-    if (dataCount > 0) {
-        emit txDataCountChanged();
-    }
+}
+
+quint64 TransportClient::rxFrameCount() const
+{
+    return m_rxFrameCount;
+}
+
+void TransportClient::addRxFrameCount(int frameCount)
+{
+    m_rxFrameCount += frameCount;
+    if (m_interface)
+        m_interface->addRxFrames(frameCount);
+}
+
+quint64 TransportClient::txFrameCount() const
+{
+    return m_txFrameCount;
+}
+
+qint64 TransportClient::msecsSinceLastRx() const
+{
+    return m_lastRxTimer.elapsed();
+}
+
+qint64 TransportClient::usecsSinceConnected() const
+{
+    return m_connectedTimer.nsecsElapsed() / 1000;
 }
 
 int TransportClient::bufferSize() const
 {
-    return m_dataBuffer.size();
+    return m_dataBuffer.size() + m_jsonStreamSplitter.size();
+}
+
+int TransportClient::compact()
+{
+    int releasedBytes = m_dataBuffer.capacity();
+    if (m_dataBuffer.isEmpty()) {
+        m_dataBuffer = QByteArray();
+    } else {
+        m_dataBuffer.squeeze();
+    }
+
+    releasedBytes -= m_dataBuffer.capacity();
+    releasedBytes += m_jsonStreamSplitter.squeeze();
+
+    m_compacted = true;
+    return releasedBytes;
+}
+
+bool TransportClient::compacted() const
+{
+    return m_compacted;
+}
+
+void TransportClient::appendJsonData(const QByteArray &data)
+{
+    m_jsonStreamSplitter.append(data);
+}
+
+QByteArray TransportClient::takeJsonPacket()
+{
+    return m_jsonStreamSplitter.takeMessage();
+}
+
+QByteArray TransportClient::takeRemainingJsonData()
+{
+    return m_jsonStreamSplitter.takeAll();
+}
+
+bool TransportClient::jsonStreamEnabled() const
+{
+    return !m_slipEnabled;
 }
 
 int TransportClient::generateMessageId()
@@ -159,13 +231,98 @@ int TransportClient::generateMessageId()
     return m_messageId;
 }
 
+int TransportClient::outputCorkSize() const
+{
+    return m_outputCorkSize;
+}
+
+int TransportClient::outputCorkTime() const
+{
+    return m_outputCorkTime;
+}
+
+void TransportClient::setOutputCork(int corkSize, int corkTime)
+{
+    m_outputCorkSize = corkSize;
+    m_outputCorkTime = corkTime;
+
+    if (m_outputCorkSize <= 0) {
+        flushOutput();
+    }
+}
+
+void TransportClient::flushOutput()
+{
+    // The timer is single shot, also drop it if the output leaves earlier
+    m_outputFlushTimer.stop();
+    if (!m_interface || m_outputSlices.isEmpty())
+        return;
+
+    QList<QByteArray> slices;
+    slices.swap(m_outputSlices);
+    m_outputSize = 0;
+    m_interface->sendDataSlices(m_clientId, slices);
+    recordForwardingLatency();
+}
+
 void TransportClient::sendData(const QByteArray &data)
 {
     if (!m_interface)
         return;
 
     addTxDataCount(data.count());
-    m_interface->sendData(m_clientId, data);
+    m_txFrameCount++;
+    m_interface->addTxFrames(1);
+    if (m_outputCorkSize <= 0) {
+        m_interface->sendData(m_clientId, data);
+        recordForwardingLatency();
+        return;
+    }
+
+    m_outputSlices.append(data);
+    m_outputSize += data.count();
+    scheduleOutput();
+}
+
+void TransportClient::sendDataSlices(const QList<QByteArray> &slices)
+{
+    if (!m_interface)
+        return;
+
+    int dataCount = 0;
+    foreach (const QByteArray &slice, slices)
+        dataCount += slice.count();
+
+    addTxDataCount(dataCount);
+    m_txFrameCount++;
+    m_interface->addTxFrames(1);
+    if (m_outputCorkSize <= 0) {
+        m_interface->sendDataSlices(m_clientId, slices);
+        recordForwardingLatency();
+        return;
+    }
+
+    m_outputSlices.append(slices);
+    m_outputSize += dataCount;
+    scheduleOutput();
+}
+
+void TransportClient::forwardData(const QByteArray &data, qint64 arrivalTime, TransportInterface::ForwardingDirection direction)
+{
+    if (!m_interface)
+        return;
+
+    m_pendingForwards.append({arrivalTime, direction});
+    sendData(data);
+}
+
+void TransportClient::forwardDataSlices(const QList<QByteArray> &slices, qint64 arrivalTime, TransportInterface::ForwardingDirection direction)
+{
+    if (!m_interface)
+        return;
+
+    m_pendingForwards.append({arrivalTime, direction});
+    sendDataSlices(slices);
 }
 
 void TransportClient::killConnection(const QString &reason)
@@ -173,7 +330,46 @@ void TransportClient::killConnection(const QString &reason)
     if (!m_interface)
         return;
 
+    // Make sure corked data leaves before the connection gets closed
+    flushOutput();
     m_interface->killClientConnection(m_clientId, reason);
 }
 
+void TransportClient::scheduleOutput()
+{
+    if (m_outputSize >= m_outputCorkSize) {
+        flushOutput();
+        return;
+    }
+
+    if (m_outputFlushTimer.isActive())
+        return;
+
+    // A zero timeout fires once the event loop has processed the pending events
+    m_outputFlushTimer.start(m_outputCorkTime, this);
+}
+
+void TransportClient::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_outputFlushTimer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    flushOutput();
+}
+
+void TransportClient::recordForwardingLatency()
+{
+    if (m_pendingForwards.isEmpty())
+        return;
+
+    // One timestamp for the whole written batch
+    qint64 writeTime = LogHistogram::timestamp();
+    foreach (const PendingForward &pendingForward, m_pendingForwards)
+        m_interface->forwardingLatency(pendingForward.direction).record(writeTime - pendingForward.arrivalTime);
+
+    m_pendingForwards.clear();
+}
+
 }
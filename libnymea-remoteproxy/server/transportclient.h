@@ -31,11 +31,14 @@
 #include <QObject>
 #include <QUuid>
 #include <QDebug>
+#include <QBasicTimer>
+#include <QElapsedTimer>
 #include <QHostAddress>
 
-namespace remoteproxy {
+#include "transportinterface.h"
+#include "../common/jsonstreamsplitter.h"
 
-class TransportInterface;
+namespace remoteproxy {
 
 class TransportClient : public QObject
 {
@@ -71,26 +74,61 @@ public:
     QString name() const;
     void setName(const QString &name);
 
+    // Traffic accounting, plain counters without signals since they change with every packet
     quint64 rxDataCount() const;
     void addRxDataCount(int dataCount);
 
     quint64 txDataCount() const;
     void addTxDataCount(int dataCount);
 
+    quint64 rxFrameCount() const;
+    void addRxFrameCount(int frameCount = 1);
+
+    quint64 txFrameCount() const;
+
+    // Time since data has been received the last time, for the periodic idle checks
+    qint64 msecsSinceLastRx() const;
+
+    // Time since the connection has been established in us
+    qint64 usecsSinceConnected() const;
+
     int bufferSize() const;
 
+    // Idle compaction: releases the unused buffer capacity, the buffers grow again with the next data.
+    // Returns the released bytes. A connection counts as compacted until data has been received again.
+    virtual int compact();
+    bool compacted() const;
+
+    // Newline delimited JSON data, as long as the JSON stream is enabled
+    void appendJsonData(const QByteArray &data);
+    QByteArray takeJsonPacket();
+    QByteArray takeRemainingJsonData();
+    virtual bool jsonStreamEnabled() const;
+
     int generateMessageId();
 
+    // Output corking: data sent during one event loop pass gets written at once, or as soon as
+    // the cork size has been reached. A cork size of 0 writes every packet immediately.
+    int outputCorkSize() const;
+    int outputCorkTime() const;
+    void setOutputCork(int corkSize, int corkTime);
+    void flushOutput();
+
     virtual void sendData(const QByteArray &data);
+    void sendDataSlices(const QList<QByteArray> &slices);
+
+    // Tunnel data forwarded from another connection. The latency from the arrival time until the data
+    // has been handed to the socket gets recorded on the transport of this connection.
+    void forwardData(const QByteArray &data, qint64 arrivalTime, TransportInterface::ForwardingDirection direction);
+    void forwardDataSlices(const QList<QByteArray> &slices, qint64 arrivalTime, TransportInterface::ForwardingDirection direction);
+
     virtual void killConnection(const QString &reason);
 
     virtual QList<QByteArray> processData(const QByteArray &data) = 0;
 
-signals:
-    void rxDataCountChanged();
-    void txDataCountChanged();
-
 protected:
+    void timerEvent(QTimerEvent *event) override;
+
     TransportInterface *m_interface = nullptr;
 
     QUuid m_clientId;
@@ -102,6 +140,7 @@ protected:
     QUuid m_uuid;
 
     QByteArray m_dataBuffer;
+    JsonStreamSplitter m_jsonStreamSplitter;
 
     bool m_killConnectionRequested = false;
     QString m_killConnectionReason;
@@ -116,6 +155,28 @@ private:
     // Statistics info
     quint64 m_rxDataCount = 0;
     quint64 m_txDataCount = 0;
+    quint64 m_rxFrameCount = 0;
+    quint64 m_txFrameCount = 0;
+    QElapsedTimer m_lastRxTimer;
+    QElapsedTimer m_connectedTimer;
+    bool m_compacted = false;
+
+    // Output cork
+    int m_outputCorkSize = 0;
+    int m_outputCorkTime = 0;
+    QList<QByteArray> m_outputSlices;
+    int m_outputSize = 0;
+    QBasicTimer m_outputFlushTimer;
+
+    // Forwarded data waiting in the output, the latency gets recorded once the output has been written
+    struct PendingForward {
+        qint64 arrivalTime;
+        TransportInterface::ForwardingDirection direction;
+    };
+    QVector<PendingForward> m_pendingForwards;
+
+    void scheduleOutput();
+    void recordForwardingLatency();
 
 };
 
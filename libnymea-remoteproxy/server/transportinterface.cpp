@@ -32,7 +32,9 @@ namespace remoteproxy {
 TransportInterface::TransportInterface(QObject *parent) :
     QObject(parent)
 {
-
+    connect(this, &TransportInterface::clientConnected, this, [this](){
+        m_acceptedCount++;
+    });
 }
 
 TransportInterface::~TransportInterface()
@@ -55,4 +57,113 @@ void TransportInterface::setServerUrl(const QUrl &serverUrl)
     m_serverUrl = serverUrl;
 }
 
+bool TransportInterface::streamTransport() const
+{
+    return true;
+}
+
+int TransportInterface::compact()
+{
+    return 0;
+}
+
+quint64 TransportInterface::writeCount() const
+{
+    return m_writeCount;
+}
+
+quint64 TransportInterface::writtenBytes() const
+{
+    return m_writtenBytes;
+}
+
+double TransportInterface::averageWriteSize() const
+{
+    if (m_writeCount == 0)
+        return 0;
+
+    return static_cast<double>(m_writtenBytes) / m_writeCount;
+}
+
+quint64 TransportInterface::acceptedCount() const
+{
+    return m_acceptedCount;
+}
+
+quint64 TransportInterface::rejectedCount() const
+{
+    return 0;
+}
+
+quint64 TransportInterface::rxBytes() const
+{
+    return m_rxBytes;
+}
+
+void TransportInterface::addRxData(int dataCount)
+{
+    m_rxBytes += dataCount;
+}
+
+quint64 TransportInterface::rxFrames() const
+{
+    return m_rxFrames;
+}
+
+void TransportInterface::addRxFrames(int frameCount)
+{
+    m_rxFrames += frameCount;
+}
+
+quint64 TransportInterface::txFrames() const
+{
+    return m_txFrames;
+}
+
+void TransportInterface::addTxFrames(int frameCount)
+{
+    m_txFrames += frameCount;
+}
+
+LogHistogram &TransportInterface::forwardingLatency(ForwardingDirection direction)
+{
+    if (direction == ForwardingDirectionClientToServer)
+        return m_clientToServerLatency;
+
+    return m_serverToClientLatency;
+}
+
+const LogHistogram &TransportInterface::forwardingLatency(ForwardingDirection direction) const
+{
+    if (direction == ForwardingDirectionClientToServer)
+        return m_clientToServerLatency;
+
+    return m_serverToClientLatency;
+}
+
+void TransportInterface::addWrite(int dataCount)
+{
+    m_writeCount++;
+    m_writtenBytes += dataCount;
+}
+
+void TransportInterface::sendDataSlices(const QUuid &clientId, const QList<QByteArray> &slices)
+{
+    if (slices.count() == 1) {
+        sendData(clientId, slices.first());
+        return;
+    }
+
+    int size = 0;
+    foreach (const QByteArray &slice, slices)
+        size += slice.size();
+
+    QByteArray data;
+    data.reserve(size);
+    foreach (const QByteArray &slice, slices)
+        data.append(slice);
+
+    sendData(clientId, data);
+}
+
 }
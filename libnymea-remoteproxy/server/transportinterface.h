@@ -32,22 +32,63 @@
 #include <QObject>
 #include <QHostAddress>
 
+#include "loghistogram.h"
+
 namespace remoteproxy {
 
 class TransportInterface : public QObject
 {
     Q_OBJECT
 public:
+    enum ForwardingDirection {
+        ForwardingDirectionClientToServer,
+        ForwardingDirectionServerToClient
+    };
+    Q_ENUM(ForwardingDirection)
+
     explicit TransportInterface(QObject *parent = nullptr);
     virtual ~TransportInterface() = 0;
 
     QString serverName() const;
 
     virtual void sendData(const QUuid &clientId, const QByteArray &data) = 0;
+
+    // Vectored send of buffer slices. The default implementation concatenates the slices,
+    // stream based transports queue them one after the other without building a copy.
+    virtual void sendDataSlices(const QUuid &clientId, const QList<QByteArray> &slices);
     virtual void killClientConnection(const QUuid &clientId, const QString &killReason) = 0;
 
     virtual uint connectionsCount() const = 0;
 
+    // Stream transports can write several packets at once, message transports send one message per packet
+    virtual bool streamTransport() const;
+
+    // Releases memory kept for reuse by the transport, i.e. unused read buffers. Returns the released bytes.
+    virtual int compact();
+
+    // Write statistics, one write is one batch of data handed to a socket
+    quint64 writeCount() const;
+    quint64 writtenBytes() const;
+    double averageWriteSize() const;
+
+    // Traffic counters of all connections on this transport. The received data and
+    // the frames get counted by the transport clients while processing them.
+    quint64 acceptedCount() const;
+    virtual quint64 rejectedCount() const;
+
+    quint64 rxBytes() const;
+    void addRxData(int dataCount);
+
+    quint64 rxFrames() const;
+    void addRxFrames(int frameCount);
+
+    quint64 txFrames() const;
+    void addTxFrames(int frameCount);
+
+    // Time from the arrival of tunnel data until it has been written to a connection on this transport, in us
+    LogHistogram &forwardingLatency(ForwardingDirection direction);
+    const LogHistogram &forwardingLatency(ForwardingDirection direction) const;
+
     QUrl serverUrl() const;
     void setServerUrl(const QUrl &serverUrl);
 
@@ -62,6 +103,18 @@ protected:
     QUrl m_serverUrl;
     QString m_serverName;
 
+    void addWrite(int dataCount);
+
+private:
+    quint64 m_writeCount = 0;
+    quint64 m_writtenBytes = 0;
+    quint64 m_acceptedCount = 0;
+    quint64 m_rxBytes = 0;
+    quint64 m_rxFrames = 0;
+    quint64 m_txFrames = 0;
+    LogHistogram m_clientToServerLatency;
+    LogHistogram m_serverToClientLatency;
+
 public slots:
     virtual bool startServer() = 0;
     virtual bool stopServer() = 0;
@@ -55,12 +55,36 @@ void UnixSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     }
 
     qCDebug(dcUnixSocketServerTraffic()) << "Send data to" << clientId.toString() << data;
+    addWrite(data.count());
     if (client->write(data) < 0) {
         qCWarning(dcUnixSocketServer()) << "Could not write data to client socket" << clientId.toString();
     }
     client->flush();
 }
 
+void UnixSocketServer::sendDataSlices(const QUuid &clientId, const QList<QByteArray> &slices)
+{
+    QLocalSocket *client = m_clientList.value(clientId);
+    if (!client) {
+        qCWarning(dcUnixSocketServer()) << "Client" << clientId << "unknown to this transport";
+        return;
+    }
+
+    qCDebug(dcUnixSocketServerTraffic()) << "Send data slices to" << clientId.toString() << slices;
+    int dataCount = 0;
+    foreach (const QByteArray &slice, slices)
+        dataCount += slice.count();
+
+    addWrite(dataCount);
+    foreach (const QByteArray &slice, slices) {
+        if (client->write(slice) < 0) {
+            qCWarning(dcUnixSocketServer()) << "Could not write data to client socket" << clientId.toString();
+            break;
+        }
+    }
+    client->flush();
+}
+
 void UnixSocketServer::killClientConnection(const QUuid &clientId, const QString &killReason)
 {
     QLocalSocket *client = m_clientList.value(clientId);
@@ -78,6 +102,11 @@ uint UnixSocketServer::connectionsCount() const
     return m_clientList.count();
 }
 
+int UnixSocketServer::compact()
+{
+    return m_readBufferPool.trim();
+}
+
 bool UnixSocketServer::running() const
 {
     if (!m_server)
@@ -142,9 +171,12 @@ void UnixSocketServer::onClientConnected()
         }
     });
     connect(client, &QLocalSocket::readyRead, this, [this, client, clientId](){
-        QByteArray data = client->readAll();
-        qCDebug(dcUnixSocketServerTraffic()) << "Incomming data from" << clientId.toString() << data;
-        emit dataAvailable(clientId, data);
+        QByteArray data = m_readBufferPool.read(client);
+        while (!data.isEmpty()) {
+            qCDebug(dcUnixSocketServerTraffic()) << "Incomming data from" << clientId.toString() << data;
+            emit dataAvailable(clientId, data);
+            data = m_readBufferPool.read(client);
+        }
     });
 
     emit clientConnected(clientId, QHostAddress::LocalHost);
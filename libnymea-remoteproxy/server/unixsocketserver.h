@@ -34,6 +34,7 @@
 #include <QLocalSocket>
 
 #include "transportinterface.h"
+#include "../common/bufferpool.h"
 
 namespace remoteproxy {
 
@@ -45,9 +46,11 @@ public:
     ~UnixSocketServer() override;
 
     void sendData(const QUuid &clientId, const QByteArray &data) override;
+    void sendDataSlices(const QUuid &clientId, const QList<QByteArray> &slices) override;
     void killClientConnection(const QUuid &clientId, const QString &killReason) override;
 
     uint connectionsCount() const override;
+    int compact() override;
 
     bool running() const override;
 
@@ -59,6 +62,7 @@ private:
     QString m_socketFileName;
     QLocalServer *m_server = nullptr;
     QHash<QUuid, QLocalSocket *> m_clientList;
+    BufferPool m_readBufferPool;
 
 private slots:
     void onClientConnected();
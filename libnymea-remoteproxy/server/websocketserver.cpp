@@ -64,6 +64,7 @@ void WebSocketServer::sendData(const QUuid &clientId, const QByteArray &data)
     client = m_clientList.value(clientId);
     if (client) {
         qCDebug(dcWebSocketServerTraffic()) << "--> Sending data to client:" << data;
+        addWrite(data.count());
         client->sendTextMessage(data);
     } else {
         qCWarning(dcWebSocketServer()) << "Client" << clientId << "unknown to this transport";
@@ -86,6 +87,11 @@ uint WebSocketServer::connectionsCount() const
     return m_clientList.count();
 }
 
+bool WebSocketServer::streamTransport() const
+{
+    return false;
+}
+
 void WebSocketServer::onClientConnected()
 {
     // Got a new client connected
@@ -55,6 +55,8 @@ public:
 
     uint connectionsCount() const override;
 
+    bool streamTransport() const override;
+
 private:
     QWebSocketServer *m_server = nullptr;
     bool m_sslEnabled;
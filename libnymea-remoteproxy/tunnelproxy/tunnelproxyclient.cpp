@@ -26,11 +26,15 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "tunnelproxyclient.h"
+#include "server/slaballocator.h"
+#include "tunnelproxyclientconnection.h"
 #include "loggingcategories.h"
 #include "server/transportinterface.h"
 #include "../engine.h"
 #include "../common/slipdataprocessor.h"
 
+#include <QtEndian>
+
 namespace remoteproxy {
 
 TunnelProxyClient::TunnelProxyClient(TransportInterface *interface, const QUuid &clientId, const QHostAddress &address, QObject *parent) :
@@ -38,16 +42,25 @@ TunnelProxyClient::TunnelProxyClient(TransportInterface *interface, const QUuid
 {
     // Note: a client is not inactive any more once registered successfully as client or server.
     // This makes sure we have not any inactive sockets connected to the proxy blocking resources.
-    // The tunnelproxy server will call activateClient once registered successfully to stop this timer.
-    m_inactiveTimer = new QTimer(this);
-    m_inactiveTimer->setInterval(Engine::instance()->configuration()->inactiveTimeout());
-    m_inactiveTimer->setSingleShot(true);
+    // The deadline gets checked in checkIdle(), activateClient clears it once registered successfully.
+    m_registrationDeadline.setRemainingTime(Engine::instance()->configuration()->inactiveTimeout());
+
+    m_maxFrameSize = Engine::instance()->configuration()->maxFrameSize();
+
+    // Message based transports keep sending one message per packet
+    if (interface->streamTransport()) {
+        setOutputCork(Engine::instance()->configuration()->outputCorkSize(), Engine::instance()->configuration()->outputCorkTime());
+    }
+}
 
-    connect(m_inactiveTimer, &QTimer::timeout, this, [this](){
-        m_interface->killClientConnection(m_clientId, "Tunnelproxy client timeout occurred. The socket was inactive.");
-    });
+void *TunnelProxyClient::operator new(size_t size)
+{
+    return SlabAllocator<TunnelProxyClient>::instance().allocate(size);
+}
 
-    m_inactiveTimer->start();
+void TunnelProxyClient::operator delete(void *pointer, size_t size)
+{
+    SlabAllocator<TunnelProxyClient>::instance().release(pointer, size);
 }
 
 TunnelProxyClient::Type TunnelProxyClient::type() const
@@ -70,67 +83,305 @@ QList<QByteArray> TunnelProxyClient::processData(const QByteArray &data)
 
     // Parse packets depending on the encoded
     if (m_slipEnabled) {
-        // Read each byte until we get END byte, then unescape the packet
-        for (int i = 0; i < data.length(); i++) {
-            quint8 byte = static_cast<quint8>(data.at(i));
-            if (byte == SlipDataProcessor::ProtocolByteEnd) {
-                // If there is no data...continue since it might be a starting END byte
-                if (m_dataBuffer.isEmpty())
-                    continue;
-
-                QByteArray frame = SlipDataProcessor::deserializeData(m_dataBuffer);
-                if (frame.isNull()) {
-                    qCWarning(dcTunnelProxyServerTraffic()) << "Received inconsistant SLIP encoded message. Ignoring data...";
-                } else {
-                    qCDebug(dcTunnelProxyServerTraffic()) << "Frame received";
-                    packets.append(m_dataBuffer);
-                    m_dataBuffer.clear();
-                }
-            } else {
-                m_dataBuffer.append(data.at(i));
-            }
+        // Note: the tunnel proxy server uses processFrameData directly in order to forward cut-through fragments
+        foreach (const FrameFragment &fragment, processFrameData(data)) {
+            if (fragment.aborted)
+                continue;
+
+            SlipDataProcessor::Frame frame;
+            frame.socketAddress = fragment.socketAddress;
+            frame.data = fragment.data;
+            packets.append(SlipDataProcessor::buildFrame(frame));
         }
     } else {
         // Handle json packet fragmentation
-        m_dataBuffer.append(data);
-        int splitIndex = m_dataBuffer.indexOf("}\n{");
-        while (splitIndex > -1) {
-            packets.append(m_dataBuffer.left(splitIndex + 1));
-            m_dataBuffer = m_dataBuffer.right(m_dataBuffer.length() - splitIndex - 2);
-            splitIndex = m_dataBuffer.indexOf("}\n{");
+        appendJsonData(data);
+        QByteArray packet = takeJsonPacket();
+        while (!packet.isNull()) {
+            packets.append(packet);
+            packet = takeJsonPacket();
+        }
+    }
+
+    return packets;
+}
+
+QList<TunnelProxyClient::FrameFragment> TunnelProxyClient::processFrameData(const QByteArray &data)
+{
+    QList<FrameFragment> fragments;
+
+    // Decode the SLIP data while it arrives. Once the socket address of a frame is known, tunnel
+    // data for a plain client connection does not need to be buffered until the END byte.
+    for (int i = 0; i < data.length(); i++) {
+        quint8 byte = static_cast<quint8>(data.at(i));
+        if (byte == SlipDataProcessor::ProtocolByteEnd) {
+            finishFrame(&fragments);
+            continue;
         }
-        if (m_dataBuffer.endsWith("}\n") || m_dataBuffer.endsWith("}")) {
-            packets.append(m_dataBuffer);
+
+        if (m_frameState == FrameStateDiscard)
+            continue;
+
+        int runLength = 1;
+        if (m_frameEscaped) {
+            m_frameEscaped = false;
+            if (byte == SlipDataProcessor::ProtocolByteTransposedEnd) {
+                byte = SlipDataProcessor::ProtocolByteEnd;
+            } else if (byte == SlipDataProcessor::ProtocolByteTransposedEsc) {
+                byte = SlipDataProcessor::ProtocolByteEsc;
+            } else {
+                qCWarning(dcTunnelProxyServerTraffic()) << "Received inconsistant SLIP encoded message. Ignoring data...";
+                discardFrame(&fragments);
+                continue;
+            }
+        } else if (byte == SlipDataProcessor::ProtocolByteEsc) {
+            m_frameEscaped = true;
+            continue;
+        } else if (m_frameState != FrameStateAddress) {
+            // Copy the plain bytes up to the next protocol byte at once
+            while (i + runLength < data.length()) {
+                quint8 nextByte = static_cast<quint8>(data.at(i + runLength));
+                if (nextByte == SlipDataProcessor::ProtocolByteEnd || nextByte == SlipDataProcessor::ProtocolByteEsc)
+                    break;
+
+                runLength++;
+            }
+        }
+
+        if (runLength > 1) {
+            m_dataBuffer.append(data.constData() + i, runLength);
+            i += runLength - 1;
+        } else {
+            m_dataBuffer.append(static_cast<char>(byte));
+        }
+
+        if (m_frameState == FrameStateAddress) {
+            if (m_dataBuffer.size() < 2)
+                continue;
+
+            m_frameAddress = qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(m_dataBuffer.constData()));
+            m_dataBuffer.clear();
+            selectFrameState();
+        } else if (m_frameState == FrameStateBuffered && m_dataBuffer.size() > m_maxFrameSize) {
+            qCWarning(dcTunnelProxyServer()) << "The frame for socket address" << m_frameAddress << "from" << this << "exceeds the maximum frame size of" << m_maxFrameSize << "bytes. Discarding the frame...";
+            m_frameState = FrameStateDiscard;
             m_dataBuffer.clear();
         }
     }
 
-    return packets;
+    // Forward what we have of a cut-through frame, the rest follows with the next data
+    if (m_frameState == FrameStateCutThrough && !m_dataBuffer.isEmpty()) {
+        FrameFragment fragment;
+        fragment.socketAddress = m_frameAddress;
+        fragment.data = m_dataBuffer;
+        fragment.cutThrough = true;
+        fragments.append(fragment);
+        m_dataBuffer.clear();
+    }
+
+    return fragments;
+}
+
+bool TunnelProxyClient::jsonStreamEnabled() const
+{
+    return TransportClient::jsonStreamEnabled() && m_type != TypeClient;
 }
 
 void TunnelProxyClient::activateClient()
 {
     // This connection has been registered as TypeServer or TypeClient
-    m_inactiveTimer->stop();
+    m_registrationDeadline = QDeadlineTimer(QDeadlineTimer::Forever);
 
-    // We use the inactive timer from now on only for server connections
-    // to see if the connection is still alive. Server connection ping the
-    // tunnelproxy every 30 seconds if no other data has been exchanged to
-    // keep the connection up. If there is no data for more than one minute,
-    // we consider the connection as dead and terminate the connection.
+    // From now on only server connections get checked to see if the connection
+    // is still alive. Server connection ping the tunnelproxy every 30 seconds if
+    // no other data has been exchanged to keep the connection up. If there is no
+    // data for more than one minute, we consider the connection as dead and
+    // terminate the connection. See checkIdle(), called periodically by the server.
 
     Q_ASSERT_X(m_type != TypeNone, "TunnelProxyClient", "Activate client called but the client type is not specified yet. Make sure you activate either a client or a server.");
     if (m_type != TypeServer)
         return;
 
+    m_idleTimeout = 60000;
+}
+
+int TunnelProxyClient::idleTimeout() const
+{
+    return m_idleTimeout;
+}
+
+void TunnelProxyClient::setIdleTimeout(int idleTimeout)
+{
+    m_idleTimeout = idleTimeout;
+}
+
+bool TunnelProxyClient::checkIdle()
+{
+    if (m_type == TypeNone) {
+        if (!m_registrationDeadline.hasExpired())
+            return false;
+
+        killConnection("Tunnelproxy client timeout occurred. The socket was inactive.");
+        return true;
+    }
+
     // We must receive data, transmitt does not mean the socket is not dead
-    connect(this, &TransportClient::rxDataCountChanged, this, [this](){
-        m_inactiveTimer->start();
-    });
+    if (m_idleTimeout <= 0 || msecsSinceLastRx() < m_idleTimeout)
+        return false;
+
+    killConnection("Tunnelproxy client timeout occurred. The socket was inactive.");
+    return true;
+}
+
+int TunnelProxyClient::compact()
+{
+    if (m_clientConnectionsAddresses.isEmpty())
+        m_clientConnectionsAddresses = QHash<quint16, TunnelProxyClientConnection *>();
+
+    return TransportClient::compact();
+}
+
+QList<QUuid> TunnelProxyClient::serverUuids() const
+{
+    return m_serverUuids;
+}
+
+void TunnelProxyClient::addServerUuid(const QUuid &serverUuid)
+{
+    if (!m_serverUuids.contains(serverUuid)) {
+        m_serverUuids.append(serverUuid);
+    }
+}
+
+bool TunnelProxyClient::multiplexed() const
+{
+    return m_multiplexed;
+}
+
+void TunnelProxyClient::setMultiplexed(bool multiplexed)
+{
+    m_multiplexed = multiplexed;
+}
+
+bool TunnelProxyClient::compressionEnabled() const
+{
+    return m_compressionEnabled;
+}
+
+void TunnelProxyClient::setCompressionEnabled(bool compressionEnabled)
+{
+    m_compressionEnabled = compressionEnabled;
+}
+
+bool TunnelProxyClient::controlFramesEnabled() const
+{
+    return m_controlFramesEnabled;
+}
+
+void TunnelProxyClient::setControlFramesEnabled(bool controlFramesEnabled)
+{
+    m_controlFramesEnabled = controlFramesEnabled;
+}
+
+quint16 TunnelProxyClient::registerSocketAddress(TunnelProxyClientConnection *clientConnection)
+{
+    // Returns 0x0000 if there is no free address left, the reserved addresses will never be assigned
+    for (int i = 0; i < 0xFFFF; i++) {
+        m_currentAddressCounter++;
+        quint16 address = m_currentAddressCounter;
+        if (address == SlipDataProcessor::SocketAddressJsonRpc || address == SlipDataProcessor::SocketAddressControl)
+            continue;
+
+        if (m_clientConnectionsAddresses.contains(address))
+            continue;
+
+        m_clientConnectionsAddresses.insert(address, clientConnection);
+        return address;
+    }
+
+    qCWarning(dcTunnelProxyServer()) << "There is no free socket address left on" << this;
+    return SlipDataProcessor::SocketAddressJsonRpc;
+}
+
+void TunnelProxyClient::unregisterSocketAddress(quint16 socketAddress)
+{
+    m_clientConnectionsAddresses.remove(socketAddress);
+}
+
+TunnelProxyClientConnection *TunnelProxyClient::getClientConnection(quint16 socketAddress) const
+{
+    return m_clientConnectionsAddresses.value(socketAddress);
+}
+
+QList<TunnelProxyClientConnection *> TunnelProxyClient::clientConnections() const
+{
+    return m_clientConnectionsAddresses.values();
+}
+
+void TunnelProxyClient::selectFrameState()
+{
+    if (m_frameAddress == SlipDataProcessor::SocketAddressJsonRpc || m_frameAddress == SlipDataProcessor::SocketAddressControl) {
+        m_frameState = FrameStateBuffered;
+        return;
+    }
+
+    TunnelProxyClientConnection *clientConnection = getClientConnection(m_frameAddress);
+    if (!clientConnection) {
+        // Nobody would receive this frame, don't waste memory on it
+        qCWarning(dcTunnelProxyServer()) << "Received frame for unknown socket address" << m_frameAddress << "from" << this << "Discarding the frame...";
+        m_frameState = FrameStateDiscard;
+        return;
+    }
+
+    // Compressed payloads and multiplexed tunnels need the complete frame
+    if (m_type == TypeServer && !m_compressionEnabled && clientConnection->channel() == 0x0000) {
+        m_frameState = FrameStateCutThrough;
+    } else {
+        m_frameState = FrameStateBuffered;
+    }
+}
+
+void TunnelProxyClient::discardFrame(QList<FrameFragment> *fragments)
+{
+    // Parts of a cut-through frame might already be forwarded, the receiver has to know the frame is incomplete
+    if (m_frameState == FrameStateCutThrough) {
+        FrameFragment fragment;
+        fragment.socketAddress = m_frameAddress;
+        fragment.aborted = true;
+        fragments->append(fragment);
+    }
+
+    m_frameState = FrameStateDiscard;
+    m_dataBuffer.clear();
+}
+
+void TunnelProxyClient::finishFrame(QList<FrameFragment> *fragments)
+{
+    if (m_frameEscaped) {
+        qCWarning(dcTunnelProxyServerTraffic()) << "Received inconsistant SLIP encoded message. Ignoring data...";
+        discardFrame(fragments);
+    } else if (m_frameState == FrameStateAddress) {
+        // An empty frame is a starting END byte
+        if (!m_dataBuffer.isEmpty()) {
+            qCWarning(dcTunnelProxyServerTraffic()) << "Received SLIP frame without socket address. Ignoring data...";
+        }
+    } else if (m_frameState != FrameStateDiscard) {
+        qCDebug(dcTunnelProxyServerTraffic()) << "Frame received";
+        addRxFrameCount();
+
+        // The data of a cut-through frame might already be forwarded completely
+        if (m_frameState == FrameStateBuffered || !m_dataBuffer.isEmpty()) {
+            FrameFragment fragment;
+            fragment.socketAddress = m_frameAddress;
+            fragment.data = m_dataBuffer;
+            fragment.cutThrough = (m_frameState == FrameStateCutThrough);
+            fragments->append(fragment);
+        }
+    }
 
-    m_inactiveTimer->setInterval(60000);
-    m_inactiveTimer->setSingleShot(false);
-    m_inactiveTimer->start();
+    m_frameState = FrameStateAddress;
+    m_frameEscaped = false;
+    m_dataBuffer.clear();
 }
 
 QDebug operator<<(QDebug debug, TunnelProxyClient *tunnelProxyClient)
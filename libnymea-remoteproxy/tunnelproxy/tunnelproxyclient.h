@@ -29,12 +29,15 @@
 #define TUNNELPROXYCLIENT_H
 
 #include <QObject>
-#include <QTimer>
+#include <QHash>
+#include <QDeadlineTimer>
 
 #include "server/transportclient.h"
 
 namespace remoteproxy {
 
+class TunnelProxyClientConnection;
+
 class TunnelProxyClient : public TransportClient
 {
     Q_OBJECT
@@ -46,24 +49,101 @@ public:
     };
     Q_ENUM(Type)
 
+    // A decoded piece of a SLIP frame. Tunnel data for plain client connections gets
+    // forwarded while it arrives (cut-through), all other frames are delivered complete.
+    // An aborted fragment carries no data, the rest of a partly forwarded frame got discarded.
+    typedef struct FrameFragment {
+        quint16 socketAddress = 0;
+        QByteArray data;
+        bool cutThrough = false;
+        bool aborted = false;
+    } FrameFragment;
+
     explicit TunnelProxyClient(TransportInterface *interface, const QUuid &clientId, const QHostAddress &address, QObject *parent = nullptr);
 
+    // Connection objects are allocated from a slab, see SlabAllocator
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer, size_t size);
+
     Type type() const;
     void setType(Type type);
 
     // Json server methods
     QList<QByteArray> processData(const QByteArray &data) override;
 
+    // Streaming SLIP decoder for registered server and multiplexed client transports
+    QList<FrameFragment> processFrameData(const QByteArray &data);
+
+    // Registered clients are tunnel endpoints, the data is not JSON any more
+    bool jsonStreamEnabled() const override;
+
     // This method will be called from the proxy server once the client is
     // registered correctly as server or client connection and is now active
     void activateClient();
 
+    // Registered server connections get killed if nothing has been received within the idle timeout,
+    // unregistered connections once the inactive timeout passed. Returns true if the connection has been killed.
+    int idleTimeout() const;
+    void setIdleTimeout(int idleTimeout);
+    bool checkIdle();
+
+    // Also frees the tunnel address table while no tunnel uses it
+    int compact() override;
+
+    // A server transport can register multiple servers (i.e. gateways). The servers
+    // share the socket address space of this transport since the frames carry only the address.
+    QList<QUuid> serverUuids() const;
+    void addServerUuid(const QUuid &serverUuid);
+
+    // A multiplexed client transport carries multiple tunnels in SLIP frames, the socket
+    // address of a frame is the channel of the tunnel on this transport.
+    bool multiplexed() const;
+    void setMultiplexed(bool multiplexed);
+
+    // Tunnel data frames on this transport carry the compression flag byte
+    bool compressionEnabled() const;
+    void setCompressionEnabled(bool compressionEnabled);
+
+    // Set once the transport sent a control frame, so it understands the control probes
+    bool controlFramesEnabled() const;
+    void setControlFramesEnabled(bool controlFramesEnabled);
+
+    quint16 registerSocketAddress(TunnelProxyClientConnection *clientConnection);
+    void unregisterSocketAddress(quint16 socketAddress);
+    TunnelProxyClientConnection *getClientConnection(quint16 socketAddress) const;
+    QList<TunnelProxyClientConnection *> clientConnections() const;
+
 signals:
     void typeChanged(Type type);
 
 private:
-    QTimer *m_inactiveTimer = nullptr;
+    enum FrameState {
+        FrameStateAddress,
+        FrameStateBuffered,
+        FrameStateCutThrough,
+        FrameStateDiscard
+    };
+
+    QDeadlineTimer m_registrationDeadline;
     Type m_type = TypeNone;
+    int m_idleTimeout = 0;
+
+    QList<QUuid> m_serverUuids;
+    bool m_multiplexed = false;
+    bool m_compressionEnabled = false;
+    bool m_controlFramesEnabled = false;
+    QHash<quint16, TunnelProxyClientConnection *> m_clientConnectionsAddresses;
+    quint16 m_currentAddressCounter = 0;
+
+    // SLIP decoder state, the decoded frame data gets collected in the data buffer
+    FrameState m_frameState = FrameStateAddress;
+    bool m_frameEscaped = false;
+    quint16 m_frameAddress = 0;
+    int m_maxFrameSize = 0;
+
+    void selectFrameState();
+    void discardFrame(QList<FrameFragment> *fragments);
+    void finishFrame(QList<FrameFragment> *fragments);
 
 };
 
@@ -26,6 +26,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "tunnelproxyclientconnection.h"
+#include "server/slaballocator.h"
 #include "server/transportclient.h"
 #include "tunnelproxy/tunnelproxyserverconnection.h"
 
@@ -40,6 +41,16 @@ TunnelProxyClientConnection::TunnelProxyClientConnection(TransportClient *transp
 
 }
 
+void *TunnelProxyClientConnection::operator new(size_t size)
+{
+    return SlabAllocator<TunnelProxyClientConnection>::instance().allocate(size);
+}
+
+void TunnelProxyClientConnection::operator delete(void *pointer, size_t size)
+{
+    SlabAllocator<TunnelProxyClientConnection>::instance().release(pointer, size);
+}
+
 TransportClient *TunnelProxyClientConnection::transportClient() const
 {
     return m_transportClient;
@@ -86,6 +97,16 @@ void TunnelProxyClientConnection::setSocketAddress(quint16 socketAddress)
     m_socketAddress = socketAddress;
 }
 
+quint16 TunnelProxyClientConnection::channel() const
+{
+    return m_channel;
+}
+
+void TunnelProxyClientConnection::setChannel(quint16 channel)
+{
+    m_channel = channel;
+}
+
 QDebug operator<<(QDebug debug, TunnelProxyClientConnection *clientConnection)
 {
     QDebugStateSaver saver(debug);
@@ -93,6 +114,9 @@ QDebug operator<<(QDebug debug, TunnelProxyClientConnection *clientConnection)
     debug.nospace() << clientConnection->clientName() << ", ";
     debug.nospace() << clientConnection->clientUuid().toString() << ", ";
     debug.nospace() << "server: " << clientConnection->serverUuid().toString() << ", ";
+    if (clientConnection->channel() != 0x0000)
+        debug.nospace() << "channel: " << clientConnection->channel() << ", ";
+
     debug.nospace() << clientConnection->transportClient() << ")";
     return debug;
 }
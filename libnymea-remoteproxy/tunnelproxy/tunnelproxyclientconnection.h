@@ -43,6 +43,10 @@ class TunnelProxyClientConnection : public QObject
 public:
     explicit TunnelProxyClientConnection(TransportClient *transportClient, const QUuid &clientUuid, const QString &clientName, QObject *parent = nullptr);
 
+    // Connection objects are allocated from a slab, see SlabAllocator
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer, size_t size);
+
     TransportClient *transportClient() const;
 
     TunnelProxyServerConnection *serverConnection() const;
@@ -55,6 +59,10 @@ public:
     quint16 socketAddress() const;
     void setSocketAddress(quint16 socketAddress);
 
+    // The channel of this tunnel on a multiplexed client transport, 0x0000 if not multiplexed
+    quint16 channel() const;
+    void setChannel(quint16 channel);
+
 private:
     TransportClient *m_transportClient = nullptr;
     TunnelProxyServerConnection *m_serverConnection = nullptr;
@@ -63,6 +71,7 @@ private:
     QString m_clientName;
     QUuid m_serverUuid;
     quint16 m_socketAddress = 0xFFFF;
+    quint16 m_channel = 0x0000;
 };
 
 QDebug operator<<(QDebug debug, TunnelProxyClientConnection *clientConnection);
@@ -27,12 +27,21 @@
 
 #include "tunnelproxyserver.h"
 #include "loggingcategories.h"
+#include "../engine.h"
 
 #include "jsonrpc/tunnelproxyhandler.h"
 #include "tunnelproxyserverconnection.h"
 #include "tunnelproxyclientconnection.h"
 
+#include "server/slaballocator.h"
+
 #include "../common/slipdataprocessor.h"
+#include "../common/tunnelcompression.h"
+
+#include <QtMath>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
 
 namespace remoteproxy {
 
@@ -81,7 +90,7 @@ void TunnelProxyServer::registerTransportInterface(TransportInterface *interface
     m_transportInterfaces.append(interface);
 }
 
-TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerServer(const QUuid &clientId, const QUuid &serverUuid, const QString &serverName)
+TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerServer(const QUuid &clientId, const QUuid &serverUuid, const QString &serverName, bool compression)
 {
     qCDebug(dcTunnelProxyServer()) << "Register new server" << m_proxyClients.value(clientId) << serverName << serverUuid.toString();
 
@@ -92,46 +101,76 @@ TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerServer(const QUui
         return TunnelProxyServer::TunnelProxyErrorInternalServerError;
     }
 
-    // Make sure this client has not been registered as client or re-registration has been called...
-    if (tunnelProxyClient->type() != TunnelProxyClient::TypeNone) {
+    // Registered servers can register additional servers on the same transport once SLIP is enabled.
+    // A rejected additional server only gets the error, the servers already on the transport stay connected.
+    bool additionalServer = tunnelProxyClient->type() == TunnelProxyClient::TypeServer && tunnelProxyClient->slipEnabled();
+
+    // While draining we accept no new registrations, the server should connect to another instance
+    if (m_draining) {
+        qCDebug(dcTunnelProxyServer()) << "Rejecting server registration from" << tunnelProxyClient << "because the proxy is draining.";
+        if (!additionalServer)
+            tunnelProxyClient->killConnectionAfterResponse("Proxy server draining");
+
+        return TunnelProxyServer::TunnelProxyErrorDraining;
+    }
+
+    // Make sure this client has not been registered as client
+    if (tunnelProxyClient->type() != TunnelProxyClient::TypeNone && !additionalServer) {
         qCWarning(dcTunnelProxyServer()) << "Client tried to register as server but has already been registerd as" << tunnelProxyClient->type();
         tunnelProxyClient->killConnectionAfterResponse("Already registered");
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
     }
 
-    // Make sure there is no server trying to make multiple server tunnel connections. We allow only one
+    // Make sure there is no server trying to make multiple server tunnel connections with the same uuid. We allow only one
     if (m_tunnelProxyServerConnections.contains(serverUuid)) {
         qCWarning(dcTunnelProxyServer()) << "Client tried to register as server" << tunnelProxyClient << "but there is already a server registered with this server uuid:" << serverUuid.toString();
-        tunnelProxyClient->killConnectionAfterResponse("Already registered");
+        if (!additionalServer)
+            tunnelProxyClient->killConnectionAfterResponse("Already registered");
+
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
     }
 
     // Also make sure this uuid has not been alreay used for any client connections...
     if (m_tunnelProxyClientConnections.contains(serverUuid)) {
         qCWarning(dcTunnelProxyServer()) << "Client tried to register as server" << tunnelProxyClient << "but there is already a client connection using this server uuid:" << serverUuid.toString();
-        tunnelProxyClient->killConnectionAfterResponse("UUID cross registeration");
+        if (!additionalServer)
+            tunnelProxyClient->killConnectionAfterResponse("UUID cross registeration");
+
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
     }
 
-    tunnelProxyClient->setType(TunnelProxyClient::TypeServer);
-    tunnelProxyClient->setUuid(serverUuid);
-    tunnelProxyClient->setName(serverName);
+    if (!additionalServer) {
+        // The first registered server identifies the transport
+        tunnelProxyClient->setType(TunnelProxyClient::TypeServer);
+        tunnelProxyClient->setUuid(serverUuid);
+        tunnelProxyClient->setName(serverName);
 
-    // This client has been registered successfully.
-    // Make sure it does not get disconnected any more because of inactivity.
-    tunnelProxyClient->activateClient();
+        // This client has been registered successfully.
+        // Make sure it does not get disconnected any more because of inactivity.
+        tunnelProxyClient->activateClient();
 
-    // Enable SLIP from now on
-    tunnelProxyClient->enableSlipAfterResponse();
+        // Enable SLIP from now on
+        tunnelProxyClient->enableSlipAfterResponse();
+
+        // The compression applies to the whole transport, additional servers share it
+        tunnelProxyClient->setCompressionEnabled(compression && Engine::instance()->configuration()->tunnelCompressionEnabled());
+
+        m_registrationLatency.record(tunnelProxyClient->usecsSinceConnected());
+    }
+
+    tunnelProxyClient->addServerUuid(serverUuid);
 
     TunnelProxyServerConnection *serverConnection = new TunnelProxyServerConnection(tunnelProxyClient, serverUuid, serverName, tunnelProxyClient);
     m_tunnelProxyServerConnections.insert(serverUuid, serverConnection);
+    m_serverIndex.insert(serverConnection);
     qCDebug(dcTunnelProxyServer()) << "New server connection registered successfully" << serverConnection;
+    emit serverRegistered(serverUuid, tunnelProxyClient->peerAddress());
+    emit serverConnectionAdded(serverConnection);
 
     return TunnelProxyServer::TunnelProxyErrorNoError;
 }
 
-TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerClient(const QUuid &clientId, const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid)
+TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerClient(const QUuid &clientId, const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid, bool multiplexed, bool compression, quint16 *channel)
 {
     TunnelProxyClient *tunnelProxyClient = m_proxyClients.value(clientId);
     if (!tunnelProxyClient) {
@@ -139,8 +178,20 @@ TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerClient(const QUui
         return TunnelProxyServer::TunnelProxyErrorInternalServerError;
     }
 
+    // Multiplexed clients can register additional tunnels on the same connection once SLIP is enabled.
+    // A failing additional registration must not affect the tunnels already running on the connection.
+    bool additionalTunnel = tunnelProxyClient->type() == TunnelProxyClient::TypeClient && tunnelProxyClient->multiplexed() && tunnelProxyClient->slipEnabled();
+
+    if (m_draining) {
+        qCDebug(dcTunnelProxyServer()) << "Rejecting client registration from" << tunnelProxyClient << "because the proxy is draining.";
+        if (!additionalTunnel)
+            tunnelProxyClient->killConnectionAfterResponse("Proxy server draining");
+
+        return TunnelProxyServer::TunnelProxyErrorDraining;
+    }
+
     // Make sure this client has not been registered as client or re-registration has been called...
-    if (tunnelProxyClient->type() != TunnelProxyClient::TypeNone) {
+    if (tunnelProxyClient->type() != TunnelProxyClient::TypeNone && !additionalTunnel) {
         qCWarning(dcTunnelProxyServer()) << "Client tried to register as client but has already been registerd as" << tunnelProxyClient->type();
         tunnelProxyClient->killConnectionAfterResponse("Already registered");
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
@@ -148,14 +199,18 @@ TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerClient(const QUui
 
     if (m_tunnelProxyClientConnections.contains(clientUuid)) {
         qCWarning(dcTunnelProxyServer()) << "There is a client already registered with client uuid" << clientUuid.toString();
-        tunnelProxyClient->killConnectionAfterResponse("Already registered");
+        if (!additionalTunnel)
+            tunnelProxyClient->killConnectionAfterResponse("Already registered");
+
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
     }
 
     // Also make sure this uuid has not been alreay used for any client connections...
     if (m_tunnelProxyServerConnections.contains(clientUuid)) {
         qCWarning(dcTunnelProxyServer()) << "Client tried to register as client" << tunnelProxyClient << "but there is already a server connection using this client uuid:" << clientUuid.toString();
-        tunnelProxyClient->killConnectionAfterResponse("UUID cross registeration");
+        if (!additionalTunnel)
+            tunnelProxyClient->killConnectionAfterResponse("UUID cross registeration");
+
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
     }
 
@@ -164,33 +219,73 @@ TunnelProxyServer::TunnelProxyError TunnelProxyServer::registerClient(const QUui
     TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(serverUuid);
     if (!serverConnection) {
         qCWarning(dcTunnelProxyServer()) << "There is no server registered with server uuid" << serverUuid.toString();
-        tunnelProxyClient->killConnectionAfterResponse("Unknown server");
+        if (!additionalTunnel)
+            tunnelProxyClient->killConnectionAfterResponse("Unknown server");
+
         return TunnelProxyServer::TunnelProxyErrorServerNotFound;
     }
 
 
-    // Not registered yet, we have a connected server for the requested server uuid
-    tunnelProxyClient->setType(TunnelProxyClient::TypeClient);
-    tunnelProxyClient->setUuid(clientUuid);
-    tunnelProxyClient->setName(clientName);
+    if (!additionalTunnel) {
+        // Not registered yet, we have a connected server for the requested server uuid
+        tunnelProxyClient->setType(TunnelProxyClient::TypeClient);
+        tunnelProxyClient->setUuid(clientUuid);
+        tunnelProxyClient->setName(clientName);
+        tunnelProxyClient->setMultiplexed(multiplexed);
+
+        // This client has been registered successfully.
+        // Make sure it does not get disconnected any more because due to inactivity.
+        tunnelProxyClient->activateClient();
 
-    // This client has been registered successfully.
-    // Make sure it does not get disconnected any more because due to inactivity.
-    tunnelProxyClient->activateClient();
+        // Multiplexed tunnels are SLIP encoded from now on. Only framed data can carry the compression flag.
+        if (multiplexed) {
+            tunnelProxyClient->enableSlipAfterResponse();
+            tunnelProxyClient->setCompressionEnabled(compression && Engine::instance()->configuration()->tunnelCompressionEnabled());
+        }
+    }
 
     TunnelProxyClientConnection *clientConnection = new TunnelProxyClientConnection(tunnelProxyClient, clientUuid, clientName, this);
-    clientConnection->setServerConnection(serverConnection);
+    if (!serverConnection->registerClientConnection(clientConnection)) {
+        qCWarning(dcTunnelProxyServer()) << "Could not register client connection on" << serverConnection << "because there is no free socket address left.";
+        delete clientConnection;
+        if (!additionalTunnel)
+            tunnelProxyClient->killConnectionAfterResponse("No free socket address");
+
+        return TunnelProxyServer::TunnelProxyErrorInternalServerError;
+    }
+
+    if (tunnelProxyClient->multiplexed()) {
+        quint16 tunnelChannel = tunnelProxyClient->registerSocketAddress(clientConnection);
+        if (tunnelChannel == SlipDataProcessor::SocketAddressJsonRpc) {
+            qCWarning(dcTunnelProxyServer()) << "Could not register client connection on" << tunnelProxyClient << "because there is no free channel left.";
+            serverConnection->unregisterClientConnection(clientConnection);
+            delete clientConnection;
+            if (!additionalTunnel)
+                tunnelProxyClient->killConnectionAfterResponse("No free channel");
+
+            return TunnelProxyServer::TunnelProxyErrorInternalServerError;
+        }
+
+        clientConnection->setChannel(tunnelChannel);
+        if (channel) {
+            *channel = tunnelChannel;
+        }
+    }
+
     m_tunnelProxyClientConnections.insert(clientUuid, clientConnection);
+    if (!additionalTunnel)
+        m_registrationLatency.record(tunnelProxyClient->usecsSinceConnected());
 
-    serverConnection->registerClientConnection(clientConnection);
     qCDebug(dcTunnelProxyServer()) << "New client connection registered successfully" << clientConnection << "-->" << serverConnection;;
+    emit clientConnectionAdded(clientConnection);
 
     // Tell the server a new client want's to connect
     QVariantMap params;
-    params.insert("clientName", tunnelProxyClient->name());
-    params.insert("clientUuid", tunnelProxyClient->uuid().toString());
+    params.insert("clientName", clientName);
+    params.insert("clientUuid", clientUuid.toString());
     params.insert("clientPeerAddress", tunnelProxyClient->peerAddress().toString());
     params.insert("socketAddress", clientConnection->socketAddress());
+    params.insert("serverUuid", serverUuid.toString());
     m_jsonRpcServer->sendNotification("TunnelProxy", "ClientConnected", params, serverConnection->transportClient());
 
     // Note: check if a confirmation from the server would be needed, for rejection or limit or something. For now they are directly connected.
@@ -212,35 +307,182 @@ TunnelProxyServer::TunnelProxyError TunnelProxyServer::disconnectClient(const QU
         return TunnelProxyServer::TunnelProxyErrorAlreadyRegistered;
     }
 
-    TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(tunnelProxyClient->uuid());
-    if (!serverConnection) {
-        qCWarning(dcTunnelProxyServer()) << "Could not find server connection for" << tunnelProxyClient;
-        tunnelProxyClient->killConnectionAfterResponse("Internal server error");
+    // The socket addresses are unique for all servers registered on this transport
+    TunnelProxyClientConnection *clientConnection = tunnelProxyClient->getClientConnection(socketAddress);
+    if (!clientConnection) {
+        qCWarning(dcTunnelProxyServer()) << "Could not find client connection for socket address" << socketAddress << "on" << tunnelProxyClient;
+        return TunnelProxyServer::TunnelProxyErrorUnknownSocketAddress;
+    }
+
+    if (clientConnection->channel() != 0x0000) {
+        // Close only this tunnel, the multiplexed client connection might carry other tunnels
+        removeClientConnection(clientConnection, true);
+    } else {
+        clientConnection->transportClient()->killConnection("Server requested disconnect.");
+    }
+
+    return TunnelProxyServer::TunnelProxyErrorNoError;
+}
+
+TunnelProxyServer::TunnelProxyError TunnelProxyServer::closeTunnel(const QUuid &clientId, quint16 channel)
+{
+    TunnelProxyClient *tunnelProxyClient = m_proxyClients.value(clientId);
+    if (!tunnelProxyClient) {
+        qCWarning(dcTunnelProxyServer()) << "There is no client with client uuid" << clientId.toString();
         return TunnelProxyServer::TunnelProxyErrorInternalServerError;
     }
 
-    TunnelProxyClientConnection *clientConnection = serverConnection->getClientConnection(socketAddress);
+    if (tunnelProxyClient->type() != TunnelProxyClient::TypeClient || !tunnelProxyClient->multiplexed()) {
+        qCWarning(dcTunnelProxyServer()) << "Client tried to close a tunnel but has not been registered as multiplexed client" << tunnelProxyClient;
+        tunnelProxyClient->killConnectionAfterResponse("Forbidden call");
+        return TunnelProxyServer::TunnelProxyErrorForbiddenCall;
+    }
+
+    TunnelProxyClientConnection *clientConnection = tunnelProxyClient->getClientConnection(channel);
     if (!clientConnection) {
-        qCWarning(dcTunnelProxyServer()) << "Could not find client connection for socket address" << socketAddress << "on" << serverConnection;
+        qCWarning(dcTunnelProxyServer()) << "Could not find tunnel for channel" << channel << "on" << tunnelProxyClient;
         return TunnelProxyServer::TunnelProxyErrorUnknownSocketAddress;
     }
 
-    clientConnection->transportClient()->killConnection("Server requested disconnect.");
+    qCDebug(dcTunnelProxyServer()) << "Closing tunnel as requested by the client" << clientConnection;
+    removeClientConnection(clientConnection, false);
     return TunnelProxyServer::TunnelProxyErrorNoError;
 }
 
-QVariantMap TunnelProxyServer::currentStatistics(bool printAll)
+QVariantMap TunnelProxyServer::compressionStatistics() const
 {
-    QVariantMap statisticsMap;
-    statisticsMap.insert("totalClientCount", m_proxyClients.count());
-    statisticsMap.insert("serverConnectionsCount", m_tunnelProxyServerConnections.count());
-    statisticsMap.insert("clientConnectionsCount", m_tunnelProxyClientConnections.count());
-    QVariantMap transports;
-    foreach (TransportInterface *transportInterface, m_transportInterfaces) {
-        transports.insert(transportInterface->serverName(), transportInterface->connectionsCount());
+    QVariantMap compressionMap;
+    compressionMap.insert("enabled", Engine::instance()->configuration()->tunnelCompressionEnabled());
+    compressionMap.insert("compressedFrames", m_compressedFramesCount);
+    compressionMap.insert("passThroughFrames", m_passThroughFramesCount);
+    compressionMap.insert("decompressedFrames", m_compressedFramesCount - m_passThroughFramesCount);
+    compressionMap.insert("compressedBytes", m_compressedBytes);
+    compressionMap.insert("uncompressedBytes", m_uncompressedBytes);
+    compressionMap.insert("ratio", m_compressedBytes > 0 ? static_cast<double>(m_uncompressedBytes) / m_compressedBytes : 1.0);
+    compressionMap.insert("decompressionTime", m_decompressionTime / 1000); // us
+    return compressionMap;
+}
+
+QVariantMap TunnelProxyServer::memoryStatistics() const
+{
+    int idleServerConnectionsCount = 0;
+    foreach (TunnelProxyServerConnection *serverConnection, m_tunnelProxyServerConnections) {
+        if (serverConnection->clientConnections().isEmpty()) {
+            idleServerConnectionsCount++;
+        }
     }
-    statisticsMap.insert("transports", transports);
-    statisticsMap.insert("troughput", m_troughput);
+
+    QVariantMap slabsMap;
+    slabsMap.insert("TunnelProxyClient", SlabAllocator<TunnelProxyClient>::instance().statistics());
+    slabsMap.insert("TunnelProxyServerConnection", SlabAllocator<TunnelProxyServerConnection>::instance().statistics());
+    slabsMap.insert("TunnelProxyClientConnection", SlabAllocator<TunnelProxyClientConnection>::instance().statistics());
+
+    QVariantMap memoryMap;
+    memoryMap.insert("totalClientCount", m_proxyClients.count());
+    memoryMap.insert("idleServerConnectionsCount", idleServerConnectionsCount);
+    memoryMap.insert("activeTunnelsCount", m_tunnelProxyClientConnections.count());
+    memoryMap.insert("slabs", slabsMap);
+    memoryMap.insert("compaction", compactionStatistics());
+    return memoryMap;
+}
+
+QVariantMap TunnelProxyServer::compactionStatistics() const
+{
+    int compactedConnectionsCount = 0;
+    foreach (TunnelProxyClient *tunnelProxyClient, m_proxyClients) {
+        if (tunnelProxyClient->compacted()) {
+            compactedConnectionsCount++;
+        }
+    }
+
+    QVariantMap compactionMap;
+    compactionMap.insert("idleTime", Engine::instance()->configuration()->idleCompactionTime());
+    compactionMap.insert("compactedConnections", compactedConnectionsCount);
+    compactionMap.insert("compactions", m_compactionsCount);
+    compactionMap.insert("releasedBytes", m_compactionReleasedBytes);
+    return compactionMap;
+}
+
+QList<TransportInterface *> TunnelProxyServer::transportInterfaces() const
+{
+    return m_transportInterfaces;
+}
+
+int TunnelProxyServer::serverConnectionsCount() const
+{
+    return m_tunnelProxyServerConnections.count();
+}
+
+int TunnelProxyServer::clientConnectionsCount() const
+{
+    return m_tunnelProxyClientConnections.count();
+}
+
+qint64 TunnelProxyServer::bufferedBytes() const
+{
+    qint64 bufferedBytes = 0;
+    foreach (TunnelProxyClient *tunnelProxyClient, m_proxyClients) {
+        bufferedBytes += tunnelProxyClient->bufferSize();
+    }
+    return bufferedBytes;
+}
+
+const LogHistogram &TunnelProxyServer::registrationLatency() const
+{
+    return m_registrationLatency;
+}
+
+QList<TunnelProxyServerConnection *> TunnelProxyServer::serverConnections() const
+{
+    return m_tunnelProxyServerConnections.values();
+}
+
+QList<TunnelProxyClientConnection *> TunnelProxyServer::clientConnections() const
+{
+    return m_tunnelProxyClientConnections.values();
+}
+
+QVariantMap TunnelProxyServer::serverConnectionStatistics(TunnelProxyServerConnection *serverConnection)
+{
+    QVariantMap serverMap;
+    serverMap.insert("id", serverConnection->transportClient()->clientId().toString());
+    serverMap.insert("address", serverConnection->transportClient()->peerAddress().toString());
+    serverMap.insert("timestamp", serverConnection->transportClient()->creationTime());
+    serverMap.insert("name", serverConnection->serverName());
+    serverMap.insert("serverUuid", serverConnection->serverUuid());
+    serverMap.insert("rxDataCount", serverConnection->transportClient()->rxDataCount());
+    serverMap.insert("txDataCount", serverConnection->transportClient()->txDataCount());
+    serverMap.insert("rxFrameCount", serverConnection->transportClient()->rxFrameCount());
+    serverMap.insert("txFrameCount", serverConnection->transportClient()->txFrameCount());
+    serverMap.insert("rtt", serverConnection->roundTripTime());
+
+    // The rates belong to the transport, servers sharing it publish them on the first registered server only
+    if (serverConnection->serverUuid() == serverConnection->transportClient()->uuid()) {
+        serverMap.insert("byteRate", qRound64(serverConnection->byteRate()));
+        serverMap.insert("frameRate", qRound64(serverConnection->frameRate()));
+    }
+    return serverMap;
+}
+
+QVariantMap TunnelProxyServer::clientConnectionStatistics(TunnelProxyClientConnection *clientConnection)
+{
+    QVariantMap clientMap;
+    clientMap.insert("id", clientConnection->transportClient()->clientId().toString());
+    clientMap.insert("address", clientConnection->transportClient()->peerAddress().toString());
+    clientMap.insert("timestamp", clientConnection->transportClient()->creationTime());
+    // Multiplexed tunnels share the transport, the tunnel has its own name and uuid
+    clientMap.insert("name", clientConnection->clientName());
+    clientMap.insert("clientUuid", clientConnection->clientUuid());
+    clientMap.insert("rxDataCount", clientConnection->transportClient()->rxDataCount());
+    clientMap.insert("txDataCount", clientConnection->transportClient()->txDataCount());
+    clientMap.insert("rxFrameCount", clientConnection->transportClient()->rxFrameCount());
+    clientMap.insert("txFrameCount", clientConnection->transportClient()->txFrameCount());
+    return clientMap;
+}
+
+QVariantMap TunnelProxyServer::currentStatistics(bool printAll)
+{
+    QVariantMap statisticsMap = summaryStatistics();
 
     QVariantList tunnelConnections;
     foreach (TunnelProxyServerConnection *serverConnection, m_tunnelProxyServerConnections) {
@@ -249,26 +491,34 @@ QVariantMap TunnelProxyServer::currentStatistics(bool printAll)
         if (!printAll && serverConnection->clientConnections().isEmpty())
             continue;
 
-        QVariantMap serverMap;
-        serverMap.insert("id", serverConnection->transportClient()->clientId().toString());
-        serverMap.insert("address", serverConnection->transportClient()->peerAddress().toString());
-        serverMap.insert("timestamp", serverConnection->transportClient()->creationTime());
-        serverMap.insert("name", serverConnection->transportClient()->name());
-        serverMap.insert("serverUuid", serverConnection->transportClient()->uuid());
-        serverMap.insert("rxDataCount", serverConnection->transportClient()->rxDataCount());
-        serverMap.insert("txDataCount", serverConnection->transportClient()->txDataCount());
+        QVariantMap serverMap = serverConnectionStatistics(serverConnection);
+        QVariantList clientList;
+        foreach (TunnelProxyClientConnection *clientConnection, serverConnection->clientConnections()) {
+            clientList.append(clientConnectionStatistics(clientConnection));
+        }
+        serverMap.insert("clientConnections", clientList);
+        tunnelConnections.append(serverMap);
+    }
+
+    statisticsMap.insert("tunnelConnections", tunnelConnections);
+
+    return statisticsMap;
+}
+
+QVariantMap TunnelProxyServer::queryStatistics(const TunnelProxyServerQuery &query) const
+{
+    QVariantMap statisticsMap = summaryStatistics();
+
+    bool more = false;
+    QList<TunnelProxyServerConnection *> serverConnections = m_serverIndex.query(query, &more);
 
+    QVariantList tunnelConnections;
+    foreach (TunnelProxyServerConnection *serverConnection, serverConnections) {
+        QVariantMap serverMap = serverConnectionStatistics(serverConnection);
+        serverMap.insert("throughput", m_serverIndex.throughput(serverConnection));
         QVariantList clientList;
         foreach (TunnelProxyClientConnection *clientConnection, serverConnection->clientConnections()) {
-            QVariantMap clientMap;
-            clientMap.insert("id", clientConnection->transportClient()->clientId().toString());
-            clientMap.insert("address", clientConnection->transportClient()->peerAddress().toString());
-            clientMap.insert("timestamp", clientConnection->transportClient()->creationTime());
-            clientMap.insert("name", clientConnection->transportClient()->name());
-            clientMap.insert("clientUuid", clientConnection->transportClient()->uuid());
-            clientMap.insert("rxDataCount", clientConnection->transportClient()->rxDataCount());
-            clientMap.insert("txDataCount", clientConnection->transportClient()->txDataCount());
-            clientList.append(clientMap);
+            clientList.append(clientConnectionStatistics(clientConnection));
         }
         serverMap.insert("clientConnections", clientList);
         tunnelConnections.append(serverMap);
@@ -276,9 +526,117 @@ QVariantMap TunnelProxyServer::currentStatistics(bool printAll)
 
     statisticsMap.insert("tunnelConnections", tunnelConnections);
 
+    QVariantMap queryMap;
+    queryMap.insert("offset", query.offset);
+    queryMap.insert("limit", query.limit);
+    queryMap.insert("count", serverConnections.count());
+    queryMap.insert("more", more);
+    statisticsMap.insert("query", queryMap);
+
     return statisticsMap;
 }
 
+QVariantMap TunnelProxyServer::summaryStatistics() const
+{
+    QVariantMap statisticsMap;
+    statisticsMap.insert("totalClientCount", m_proxyClients.count());
+    statisticsMap.insert("serverConnectionsCount", m_tunnelProxyServerConnections.count());
+    statisticsMap.insert("clientConnectionsCount", m_tunnelProxyClientConnections.count());
+    QVariantMap transports;
+    foreach (TransportInterface *transportInterface, m_transportInterfaces) {
+        transports.insert(transportInterface->serverName(), transportInterface->connectionsCount());
+    }
+    statisticsMap.insert("transports", transports);
+
+    QVariantMap averageWriteSizes;
+    foreach (TransportInterface *transportInterface, m_transportInterfaces) {
+        averageWriteSizes.insert(transportInterface->serverName(), transportInterface->averageWriteSize());
+    }
+    statisticsMap.insert("averageWriteSize", averageWriteSizes);
+
+    // Forwarding latency percentiles per transport and direction in us
+    QVariantMap forwardingLatencies;
+    foreach (TransportInterface *transportInterface, m_transportInterfaces) {
+        QVariantMap directionsMap;
+        directionsMap.insert("clientToServer", transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionClientToServer).statistics());
+        directionsMap.insert("serverToClient", transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionServerToClient).statistics());
+        forwardingLatencies.insert(transportInterface->serverName(), directionsMap);
+    }
+    statisticsMap.insert("forwardingLatency", forwardingLatencies);
+    statisticsMap.insert("troughput", m_troughput);
+
+    // The transports with the highest smoothed byte rates, from the heavy hitters
+    QVariantList topTunnels;
+    foreach (const HeavyHitters::Item &item, m_heavyHitters.top(10)) {
+        TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(item.key);
+        if (!serverConnection)
+            continue;
+
+        QVariantMap tunnelMap;
+        tunnelMap.insert("serverUuid", serverConnection->serverUuid());
+        tunnelMap.insert("name", serverConnection->serverName());
+        tunnelMap.insert("address", serverConnection->transportClient()->peerAddress().toString());
+        tunnelMap.insert("byteRate", qRound64(serverConnection->byteRate()));
+        tunnelMap.insert("frameRate", qRound64(serverConnection->frameRate()));
+        tunnelMap.insert("clientConnectionsCount", serverConnection->clientConnections().count());
+        tunnelMap.insert("estimatedRate", qRound64(item.count));
+        tunnelMap.insert("error", qRound64(item.error));
+        topTunnels.append(tunnelMap);
+    }
+    statisticsMap.insert("topTunnels", topTunnels);
+    statisticsMap.insert("rateAlertsCount", m_rateAlertsCount);
+    return statisticsMap;
+}
+
+bool TunnelProxyServer::draining() const
+{
+    return m_draining;
+}
+
+void TunnelProxyServer::startDrain(int window)
+{
+    if (m_draining) {
+        qCDebug(dcTunnelProxyServer()) << "The proxy is already draining.";
+        return;
+    }
+
+    m_draining = true;
+    m_drainWindow = qMax(0, window);
+    m_drainStartTime = QDateTime::currentMSecsSinceEpoch();
+    m_drainedServersCount = 0;
+
+    // Spread the reconnect hints over the drain window, otherwise all servers
+    // would hit the remaining instances at the same moment. Transports with multiple
+    // servers get hinted once, using the first registered server.
+    foreach (const QUuid &serverUuid, m_tunnelProxyServerConnections.keys()) {
+        if (m_tunnelProxyServerConnections.value(serverUuid)->transportClient()->uuid() != serverUuid)
+            continue;
+
+        qint64 delay = m_drainWindow > 0 ? QRandomGenerator::global()->bounded(m_drainWindow) : 0;
+        m_pendingReconnectHints.insert(serverUuid, m_drainStartTime + delay);
+    }
+
+    qCDebug(dcTunnelProxyServer()) << "Start draining" << m_pendingReconnectHints.count() << "server connections within" << m_drainWindow << "ms";
+    processDrain();
+}
+
+QVariantMap TunnelProxyServer::drainStatistics() const
+{
+    QVariantMap drainMap;
+    drainMap.insert("draining", m_draining);
+    if (!m_draining)
+        return drainMap;
+
+    drainMap.insert("window", m_drainWindow);
+    drainMap.insert("startTimestamp", m_drainStartTime / 1000);
+    drainMap.insert("pendingHints", m_pendingReconnectHints.count());
+    drainMap.insert("hintedServers", m_hintedServers.count());
+    drainMap.insert("drainedServers", m_drainedServersCount);
+    drainMap.insert("remainingServers", m_tunnelProxyServerConnections.count());
+    drainMap.insert("remainingClients", m_tunnelProxyClientConnections.count());
+    return drainMap;
+}
+
 void TunnelProxyServer::startServer()
 {
     qCDebug(dcTunnelProxyServer()) << "Starting tunnel proxy...";
@@ -301,6 +659,14 @@ void TunnelProxyServer::tick()
 {
     m_troughput = m_troughputCounter;
     m_troughputCounter = 0;
+
+    if (m_draining) {
+        processDrain();
+    }
+
+    processProbes();
+    processIdleConnections();
+    processRates();
 }
 
 void TunnelProxyServer::onClientConnected(const QUuid &clientId, const QHostAddress &address)
@@ -329,34 +695,57 @@ void TunnelProxyServer::onClientDisconnected(const QUuid &clientId)
     }
 
     if (tunnelProxyClient->type() == TunnelProxyClient::TypeServer) {
-        TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.take(tunnelProxyClient->uuid());
-        if (!serverConnection) {
-            qCWarning(dcTunnelProxyServer()) << "Could not find server connection for disconnected tunnel proxy client claiming to be a server.";
-        } else {
-            qCDebug(dcTunnelProxyServer()) << "Server connection disconnected" << interface->serverName() << clientId.toString();
+        // Clean up all servers registered on this transport
+        foreach (const QUuid &serverUuid, tunnelProxyClient->serverUuids()) {
+            TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.take(serverUuid);
+            if (!serverConnection) {
+                qCWarning(dcTunnelProxyServer()) << "Could not find server connection for disconnected tunnel proxy client claiming to be a server.";
+                continue;
+            }
+
+            m_serverIndex.remove(serverConnection);
+            m_heavyHitters.remove(serverConnection->serverUuid());
+            if (serverConnection->rateAlert())
+                m_rateAlertsCount--;
+
+            qCDebug(dcTunnelProxyServer()) << "Server connection disconnected" << interface->serverName() << clientId.toString() << serverUuid.toString();
+            if (m_draining) {
+                int hintCount = m_pendingReconnectHints.remove(serverConnection->serverUuid());
+                if (m_hintedServers.remove(serverConnection->serverUuid()))
+                    hintCount++;
+                if (hintCount > 0) {
+                    m_drainedServersCount++;
+                }
+            }
+
             foreach (TunnelProxyClientConnection *clientConnection, serverConnection->clientConnections()) {
                 serverConnection->unregisterClientConnection(clientConnection);
-                clientConnection->transportClient()->killConnection("Server disconnected");
+                if (clientConnection->channel() != 0x0000) {
+                    // Keep the multiplexed client connection, only this tunnel is gone
+                    removeClientConnection(clientConnection, true);
+                } else {
+                    clientConnection->transportClient()->killConnection("Server disconnected");
+                }
             }
 
+            emit serverConnectionRemoved(serverUuid);
             serverConnection->deleteLater();
         }
     }
 
     if (tunnelProxyClient->type() == TunnelProxyClient::TypeClient) {
-        TunnelProxyClientConnection *clientConnection = m_tunnelProxyClientConnections.take(tunnelProxyClient->uuid());
-        if (!clientConnection) {
-            qCWarning(dcTunnelProxyServer()) << "Could not find client connection for disconnected tunnel proxy client claiming to be a client.";
+        if (tunnelProxyClient->multiplexed()) {
+            // Close all tunnels of this connection
+            foreach (TunnelProxyClientConnection *clientConnection, tunnelProxyClient->clientConnections()) {
+                removeClientConnection(clientConnection, false);
+            }
         } else {
-            TunnelProxyServerConnection *serverConnection = clientConnection->serverConnection();
-            if (serverConnection) {
-                QVariantMap params;
-                params.insert("socketAddress", clientConnection->socketAddress());
-                serverConnection->unregisterClientConnection(clientConnection);
-                m_jsonRpcServer->sendNotification("TunnelProxy", "ClientDisconnected", params, serverConnection->transportClient());
+            TunnelProxyClientConnection *clientConnection = m_tunnelProxyClientConnections.value(tunnelProxyClient->uuid());
+            if (!clientConnection) {
+                qCWarning(dcTunnelProxyServer()) << "Could not find client connection for disconnected tunnel proxy client claiming to be a client.";
+            } else {
+                removeClientConnection(clientConnection, false);
             }
-
-            clientConnection->deleteLater();
         }
     }
 
@@ -378,7 +767,43 @@ void TunnelProxyServer::onClientDataAvailable(const QUuid &clientId, const QByte
     qCDebug(dcTunnelProxyServerTraffic()) << "Client data available" << tunnelProxyClient << qUtf8Printable(data);
     tunnelProxyClient->addRxDataCount(data.count());
 
-    if (tunnelProxyClient->type() == TunnelProxyClient::TypeClient) {
+    // The arrival time of the chunk, all data forwarded from it gets measured against this timestamp
+    m_arrivalTime = LogHistogram::timestamp();
+    processClientData(tunnelProxyClient, data);
+}
+
+void TunnelProxyServer::processClientData(TunnelProxyClient *tunnelProxyClient, const QByteArray &data)
+{
+    if (tunnelProxyClient->type() == TunnelProxyClient::TypeClient && tunnelProxyClient->multiplexed()) {
+        // Unpack SLIP data, the socket address is the channel of the tunnel or 0x0000 for the json rpc server
+        QList<TunnelProxyClient::FrameFragment> frames = tunnelProxyClient->processFrameData(data);
+        foreach (const TunnelProxyClient::FrameFragment &frame, frames) {
+            if (frame.socketAddress == SlipDataProcessor::SocketAddressJsonRpc) {
+                qCDebug(dcTunnelProxyServerTraffic()) << "Received frame for the JSON server" << tunnelProxyClient;
+                m_jsonRpcServer->processDataPacket(tunnelProxyClient, frame.data);
+            } else if (frame.socketAddress == SlipDataProcessor::SocketAddressControl) {
+                processControlFrame(tunnelProxyClient, frame.data);
+            } else {
+                TunnelProxyClientConnection *clientConnection = tunnelProxyClient->getClientConnection(frame.socketAddress);
+                if (!clientConnection || !clientConnection->serverConnection()) {
+                    qCWarning(dcTunnelProxyServer()) << "The client connection wants to send data to a tunnel which has not been registered on channel" << frame.socketAddress;
+                    continue;
+                }
+
+                QByteArray payload;
+                if (!convertPayload(frame.data, tunnelProxyClient->compressionEnabled(), clientConnection->serverConnection()->tunnelProxyClient()->compressionEnabled(), &payload)) {
+                    qCWarning(dcTunnelProxyServer()) << "Received invalid compressed payload on channel" << frame.socketAddress << "from" << tunnelProxyClient << "...ignoring the data";
+                    continue;
+                }
+
+                qCDebug(dcTunnelProxyServerTraffic()) << "--> Tunnel data from channel" << frame.socketAddress << "to server socket address" << clientConnection->socketAddress() << "to" << clientConnection->serverConnection() << "\n" << frame.data;
+                clientConnection->serverConnection()->transportClient()->forwardDataSlices(SlipDataProcessor::serializeFrameSlices(clientConnection->socketAddress(), QList<QByteArray>() << payload),
+                                                                                           m_arrivalTime, TransportInterface::ForwardingDirectionClientToServer);
+                m_troughputCounter += frame.data.count();
+            }
+        }
+
+    } else if (tunnelProxyClient->type() == TunnelProxyClient::TypeClient) {
         // Send the data to the server using slip encoded frame
         TunnelProxyClientConnection *clientConnection = m_tunnelProxyClientConnections.value(tunnelProxyClient->uuid());
         if (!clientConnection) {
@@ -393,53 +818,345 @@ void TunnelProxyServer::onClientDataAvailable(const QUuid &clientId, const QByte
             return;
         }
 
-        SlipDataProcessor::Frame frame;
-        frame.socketAddress = clientConnection->socketAddress();
-        frame.data = data;
+        // The payload is not copied into the frame, a compressing server gets the raw flag as own slice
+        QList<QByteArray> payloadSlices;
+        if (clientConnection->serverConnection()->tunnelProxyClient()->compressionEnabled())
+            payloadSlices.append(QByteArray(1, static_cast<char>(TunnelCompression::PayloadFlagRaw)));
+
+        payloadSlices.append(data);
+        tunnelProxyClient->addRxFrameCount();
         qCDebug(dcTunnelProxyServerTraffic()) << "--> Tunnel data to server socket address" << clientConnection->socketAddress() << "to" << clientConnection->serverConnection() << "\n" << data;
-        QByteArray rawData = SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame));
-        clientConnection->serverConnection()->transportClient()->sendData(rawData);
+        clientConnection->serverConnection()->transportClient()->forwardDataSlices(SlipDataProcessor::serializeFrameSlices(clientConnection->socketAddress(), payloadSlices),
+                                                                                   m_arrivalTime, TransportInterface::ForwardingDirectionClientToServer);
         m_troughputCounter += data.count();
 
     } else if (tunnelProxyClient->type() == TunnelProxyClient::TypeServer) {
         // Data coming from a connected server connection
         if (tunnelProxyClient->slipEnabled()) {
             // Unpack SLIP data, get address, pipe to client or give it to the json rpc server if address 0x0000
-            // Handle packet fragmentation
-            QList<QByteArray> frames = tunnelProxyClient->processData(data);
-            foreach (const QByteArray &frameData, frames) {
-                SlipDataProcessor::Frame frame = SlipDataProcessor::parseFrame(frameData);
-
-                if (frame.socketAddress == 0x0000) {
+            // Handle packet fragmentation, data for plain client connections arrives in cut-through fragments
+            QList<TunnelProxyClient::FrameFragment> frames = tunnelProxyClient->processFrameData(data);
+            foreach (const TunnelProxyClient::FrameFragment &frame, frames) {
+                if (frame.socketAddress == SlipDataProcessor::SocketAddressJsonRpc) {
                     qCDebug(dcTunnelProxyServerTraffic()) << "Received frame for the JSON server" << tunnelProxyClient;
                     m_jsonRpcServer->processDataPacket(tunnelProxyClient, frame.data);
+                } else if (frame.socketAddress == SlipDataProcessor::SocketAddressControl) {
+                    processControlFrame(tunnelProxyClient, frame.data);
                 } else {
-                    // This data seems to be for a client with the given address
-                    TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(tunnelProxyClient->uuid());
-                    if (!serverConnection) {
-                        qCWarning(dcTunnelProxyServer()) << "Could not find server connection for" << tunnelProxyClient;
+                    // This data seems to be for a client with the given address. The addresses
+                    // are unique for all servers registered on this transport.
+                    TunnelProxyClientConnection *clientConnection = tunnelProxyClient->getClientConnection(frame.socketAddress);
+                    if (!clientConnection) {
+                        qCWarning(dcTunnelProxyServer()) << "The server connection wants to send data to a client connection which has not been registered to the server.";
                         continue;
                     }
 
-                    // Get the client and send the data to the client
-                    TunnelProxyClientConnection *clientConnection = serverConnection->getClientConnection(frame.socketAddress);
-                    if (!clientConnection) {
-                        qCWarning(dcTunnelProxyServer()) << "The server connection wants to send data to a client connection which has not been registered to the server.";
+                    if (frame.aborted) {
+                        // The client already got a part of this frame, the tunnel data stream can not continue
+                        qCWarning(dcTunnelProxyServer()) << "Received an inconsistent frame for" << clientConnection << "after parts of it have been forwarded. Closing the client connection...";
+                        clientConnection->transportClient()->killConnection("Inconsistent tunnel data from the server.");
+                        continue;
+                    }
+
+                    if (frame.cutThrough) {
+                        qCDebug(dcTunnelProxyServerTraffic()) << "--> Tunnel data fragment from server socket" << frame.socketAddress << "to" << clientConnection <<  "\n" << frame.data;
+                        sendToClientConnection(clientConnection, frame.data);
+                        m_troughputCounter += frame.data.count();
+                        continue;
+                    }
+
+                    QByteArray payload;
+                    TunnelProxyClient *clientTransport = static_cast<TunnelProxyClient *>(clientConnection->transportClient());
+                    if (!convertPayload(frame.data, tunnelProxyClient->compressionEnabled(), clientTransport->compressionEnabled(), &payload)) {
+                        qCWarning(dcTunnelProxyServer()) << "Received invalid compressed payload on socket address" << frame.socketAddress << "from" << tunnelProxyClient << "...ignoring the data";
                         continue;
                     }
 
                     qCDebug(dcTunnelProxyServerTraffic()) << "--> Tunnel data from server socket" << frame.socketAddress << "to" << clientConnection <<  "\n" << frame.data;
-                    clientConnection->transportClient()->sendData(frame.data);
+                    sendToClientConnection(clientConnection, payload);
                     m_troughputCounter += frame.data.count();
                 }
             }
         } else {
-            m_jsonRpcServer->processData(tunnelProxyClient, data);
+            QByteArray remainingData = m_jsonRpcServer->processData(tunnelProxyClient, data);
+            if (!remainingData.isEmpty()) {
+                processClientData(tunnelProxyClient, remainingData);
+            }
         }
 
     } else {
-        // Not registered yet or doing other stuff...let the JSON RPC server handle this data
-        m_jsonRpcServer->processData(tunnelProxyClient, data);
+        // Not registered yet or doing other stuff...let the JSON RPC server handle this data.
+        // Data pipelined behind a successful registration gets forwarded according to the new type.
+        QByteArray remainingData = m_jsonRpcServer->processData(tunnelProxyClient, data);
+        if (!remainingData.isEmpty()) {
+            processClientData(tunnelProxyClient, remainingData);
+        }
+    }
+}
+
+void TunnelProxyServer::processControlFrame(TunnelProxyClient *tunnelProxyClient, const QByteArray &data)
+{
+    SlipDataProcessor::ControlOpcode opcode;
+    quint64 timestamp = 0;
+    if (!SlipDataProcessor::parseControlFrame(data, &opcode, &timestamp)) {
+        qCWarning(dcTunnelProxyServer()) << "Received invalid control frame from" << tunnelProxyClient << "...ignoring the data";
+        return;
+    }
+
+    // Older client libraries do not know the control address, only transports using it themselves get probed
+    tunnelProxyClient->setControlFramesEnabled(true);
+
+    switch (opcode) {
+    case SlipDataProcessor::ControlOpcodePing:
+        qCDebug(dcTunnelProxyServerTraffic()) << "Control ping received from" << tunnelProxyClient;
+        tunnelProxyClient->sendData(SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePong, timestamp));
+        break;
+    case SlipDataProcessor::ControlOpcodePong: {
+        qint64 roundTripTime = (LogHistogram::timestamp() - static_cast<qint64>(timestamp)) / 1000;
+        if (roundTripTime < 0) {
+            qCWarning(dcTunnelProxyServer()) << "Received control pong with a timestamp from the future from" << tunnelProxyClient;
+            return;
+        }
+
+        // All servers registered on this transport share the link
+        foreach (const QUuid &serverUuid, tunnelProxyClient->serverUuids()) {
+            TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(serverUuid);
+            if (serverConnection) {
+                serverConnection->addRoundTripTimeSample(static_cast<int>(roundTripTime));
+            }
+        }
+
+        qCDebug(dcTunnelProxyServerTraffic()) << "Control pong received from" << tunnelProxyClient << "RTT:" << roundTripTime << "ms";
+        break;
+    }
+    }
+}
+
+bool TunnelProxyServer::convertPayload(const QByteArray &payload, bool sourceCompression, bool targetCompression, QByteArray *result)
+{
+    // The proxy never compresses, the tunnel endpoints do. Raw data only gets flagged for the target.
+    if (!sourceCompression) {
+        *result = targetCompression ? TunnelCompression::encodePayload(payload, false) : payload;
+        return true;
+    }
+
+    bool compressed = TunnelCompression::payloadCompressed(payload);
+    if (compressed) {
+        m_compressedFramesCount++;
+        m_compressedBytes += payload.size() - 1;
+        m_uncompressedBytes += TunnelCompression::decodedSize(payload);
+    }
+
+    // Both ends negotiated compression, pass the payload through as it is
+    if (targetCompression) {
+        if (compressed)
+            m_passThroughFramesCount++;
+
+        *result = payload;
+        return true;
+    }
+
+    if (!compressed)
+        return TunnelCompression::decodePayload(payload, result);
+
+    // Decompressed frames may not exceed the frame size limit either
+    int maxFrameSize = Engine::instance()->configuration()->maxFrameSize();
+    if (TunnelCompression::decodedSize(payload) > maxFrameSize) {
+        qCWarning(dcTunnelProxyServer()) << "Compressed payload would decode to" << TunnelCompression::decodedSize(payload) << "bytes, more than the maximum frame size of" << maxFrameSize << "bytes";
+        return false;
+    }
+
+    QElapsedTimer decompressionTimer;
+    decompressionTimer.start();
+    bool success = TunnelCompression::decodePayload(payload, result, maxFrameSize);
+    m_decompressionTime += decompressionTimer.nsecsElapsed();
+    return success;
+}
+
+void TunnelProxyServer::sendToClientConnection(TunnelProxyClientConnection *clientConnection, const QByteArray &data)
+{
+    if (clientConnection->channel() == 0x0000) {
+        clientConnection->transportClient()->forwardData(data, m_arrivalTime, TransportInterface::ForwardingDirectionServerToClient);
+        return;
+    }
+
+    // Multiplexed client connection, frame the data using the channel of the tunnel
+    clientConnection->transportClient()->forwardDataSlices(SlipDataProcessor::serializeFrameSlices(clientConnection->channel(), QList<QByteArray>() << data),
+                                                           m_arrivalTime, TransportInterface::ForwardingDirectionServerToClient);
+}
+
+void TunnelProxyServer::removeClientConnection(TunnelProxyClientConnection *clientConnection, bool notifyClient)
+{
+    m_tunnelProxyClientConnections.remove(clientConnection->clientUuid());
+    emit clientConnectionRemoved(clientConnection->clientUuid());
+
+    TunnelProxyServerConnection *serverConnection = clientConnection->serverConnection();
+    if (serverConnection) {
+        QVariantMap params;
+        params.insert("socketAddress", clientConnection->socketAddress());
+        serverConnection->unregisterClientConnection(clientConnection);
+        m_jsonRpcServer->sendNotification("TunnelProxy", "ClientDisconnected", params, serverConnection->transportClient());
+    }
+
+    if (clientConnection->channel() != 0x0000) {
+        TunnelProxyClient *tunnelProxyClient = static_cast<TunnelProxyClient *>(clientConnection->transportClient());
+        tunnelProxyClient->unregisterSocketAddress(clientConnection->channel());
+        if (notifyClient) {
+            QVariantMap params;
+            params.insert("channel", clientConnection->channel());
+            m_jsonRpcServer->sendNotification("TunnelProxy", "TunnelClosed", params, tunnelProxyClient);
+        }
+    }
+
+    clientConnection->deleteLater();
+}
+
+void TunnelProxyServer::processIdleConnections()
+{
+    int compactionTime = Engine::instance()->configuration()->idleCompactionTime();
+    quint64 compactionsCount = m_compactionsCount;
+
+    // The kill might remove clients from the hash, iterate over a copy
+    foreach (TunnelProxyClient *tunnelProxyClient, m_proxyClients.values()) {
+        if (tunnelProxyClient->checkIdle()) {
+            qCDebug(dcTunnelProxyServer()) << "Killed idle connection" << tunnelProxyClient;
+            continue;
+        }
+
+        // Release the buffers of connections which did not receive anything for a while, once per idle period
+        if (compactionTime <= 0 || tunnelProxyClient->compacted() || tunnelProxyClient->msecsSinceLastRx() < compactionTime)
+            continue;
+
+        m_compactionReleasedBytes += tunnelProxyClient->compact();
+        m_compactionsCount++;
+        foreach (const QUuid &serverUuid, tunnelProxyClient->serverUuids()) {
+            TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(serverUuid);
+            if (serverConnection) {
+                serverConnection->compact();
+            }
+        }
+    }
+
+    // The unused read buffers of the transports only matter once connections went idle
+    if (m_compactionsCount != compactionsCount) {
+        foreach (TransportInterface *interface, m_transportInterfaces) {
+            m_compactionReleasedBytes += interface->compact();
+        }
+
+        qCDebug(dcTunnelProxyServer()) << "Compacted" << m_compactionsCount - compactionsCount << "idle connections, released" << m_compactionReleasedBytes << "bytes in total";
+    }
+}
+
+void TunnelProxyServer::processProbes()
+{
+    int probeInterval = Engine::instance()->configuration()->probeInterval();
+    if (probeInterval <= 0)
+        return;
+
+    // The servers get probed individually since their registration, this spreads the probes over the interval.
+    // The timestamps are monotonic in us, a wall clock jump does not disturb the round trip time.
+    quint64 currentTimestamp = static_cast<quint64>(LogHistogram::timestamp());
+    foreach (TunnelProxyServerConnection *serverConnection, m_tunnelProxyServerConnections) {
+        // Probe each transport only once, using the first registered server
+        if (serverConnection->serverUuid() != serverConnection->transportClient()->uuid())
+            continue;
+
+        // A server with an older client library would drop the probe and delay its own keepalive
+        if (!serverConnection->tunnelProxyClient()->controlFramesEnabled())
+            continue;
+
+        if (currentTimestamp - serverConnection->lastPingTimestamp() < static_cast<quint64>(probeInterval) * 1000)
+            continue;
+
+        serverConnection->setLastPingTimestamp(currentTimestamp);
+        serverConnection->transportClient()->sendData(SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePing, currentTimestamp));
+    }
+}
+
+void TunnelProxyServer::processDrain()
+{
+    qint64 currentTimestamp = QDateTime::currentMSecsSinceEpoch();
+
+    QVariantMap params;
+    params.insert("reason", "The proxy server is draining. Please reconnect.");
+
+    foreach (const QUuid &serverUuid, m_pendingReconnectHints.keys()) {
+        if (m_pendingReconnectHints.value(serverUuid) > currentTimestamp)
+            continue;
+
+        m_pendingReconnectHints.remove(serverUuid);
+        TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(serverUuid);
+        if (!serverConnection)
+            continue;
+
+        qCDebug(dcTunnelProxyServer()) << "Request reconnect from" << serverConnection;
+        m_jsonRpcServer->sendNotification("TunnelProxy", "ReconnectRequested", params, serverConnection->transportClient());
+        m_hintedServers.insert(serverUuid);
+    }
+
+    // Close the hinted servers once the last tunnel of any server on the transport is gone
+    foreach (const QUuid &serverUuid, m_hintedServers) {
+        TunnelProxyServerConnection *serverConnection = m_tunnelProxyServerConnections.value(serverUuid);
+        if (!serverConnection)
+            continue;
+
+        bool idle = true;
+        foreach (const QUuid &transportServerUuid, serverConnection->tunnelProxyClient()->serverUuids()) {
+            TunnelProxyServerConnection *transportServerConnection = m_tunnelProxyServerConnections.value(transportServerUuid);
+            if (transportServerConnection && !transportServerConnection->clientConnections().isEmpty()) {
+                idle = false;
+                break;
+            }
+        }
+
+        if (idle) {
+            qCDebug(dcTunnelProxyServer()) << "Closing drained" << serverConnection;
+            serverConnection->transportClient()->killConnection("Proxy server draining");
+        }
+    }
+}
+
+void TunnelProxyServer::processRates()
+{
+    qint64 currentTimestamp = QDateTime::currentMSecsSinceEpoch();
+    if (m_lastRatesTimestamp == 0 || currentTimestamp <= m_lastRatesTimestamp) {
+        m_lastRatesTimestamp = currentTimestamp;
+        return;
+    }
+
+    // Smoothing with a time constant of 10 s, independent of the tick accuracy
+    double interval = (currentTimestamp - m_lastRatesTimestamp) / 1000.0;
+    double weight = 1.0 - qExp(-interval / 10.0);
+    m_lastRatesTimestamp = currentTimestamp;
+
+    // The heavy hitter counts decay like the rates, so they estimate the rates of the top transports
+    m_heavyHitters.decay(1.0 - weight);
+
+    qint64 rateAlertThreshold = Engine::instance()->configuration()->rateAlertThreshold();
+    foreach (TunnelProxyServerConnection *serverConnection, m_tunnelProxyServerConnections) {
+        // Servers sharing a transport would have the same rates, the transport gets accounted once on the first registered server
+        bool transportServer = serverConnection->serverUuid() == serverConnection->transportClient()->uuid();
+        quint64 dataDelta = transportServer ? serverConnection->updateRates(interval, weight) : 0;
+        m_serverIndex.update(serverConnection);
+        if (!transportServer)
+            continue;
+
+        if (dataDelta > 0)
+            m_heavyHitters.add(serverConnection->serverUuid(), weight * dataDelta / interval);
+
+        bool rateAlert = rateAlertThreshold > 0 && serverConnection->byteRate() > rateAlertThreshold;
+        if (rateAlert == serverConnection->rateAlert())
+            continue;
+
+        serverConnection->setRateAlert(rateAlert);
+        if (rateAlert) {
+            m_rateAlertsCount++;
+            qCWarning(dcTunnelProxyServer()) << "Rate alert:" << serverConnection << "from" << serverConnection->transportClient()->peerAddress().toString()
+                                             << "is at" << qRound64(serverConnection->byteRate()) << "B/s, above the threshold of" << rateAlertThreshold << "B/s";
+        } else {
+            m_rateAlertsCount--;
+            qCDebug(dcTunnelProxyServer()) << "Rate alert cleared:" << serverConnection << "is at" << qRound64(serverConnection->byteRate()) << "B/s";
+        }
     }
 }
 
@@ -28,11 +28,15 @@
 #ifndef TUNNELPROXYSERVER_H
 #define TUNNELPROXYSERVER_H
 
+#include <QSet>
 #include <QObject>
 
 #include "server/jsonrpcserver.h"
 #include "server/transportinterface.h"
+#include "server/loghistogram.h"
+#include "server/heavyhitters.h"
 #include "tunnelproxyclient.h"
+#include "tunnelproxyserverindex.h"
 
 namespace remoteproxy {
 
@@ -51,7 +55,8 @@ public:
         TunnelProxyErrorForbiddenCall,
         TunnelProxyErrorAlreadyRegistered,
         TunnelProxyErrorNotRegistered,
-        TunnelProxyErrorUnknownSocketAddress
+        TunnelProxyErrorUnknownSocketAddress,
+        TunnelProxyErrorDraining
     };
     Q_ENUM(TunnelProxyError)
 
@@ -63,12 +68,40 @@ public:
 
     void registerTransportInterface(TransportInterface *interface);
 
-    TunnelProxyServer::TunnelProxyError registerServer(const QUuid &clientId, const QUuid &serverUuid, const QString &serverName);
-    TunnelProxyServer::TunnelProxyError registerClient(const QUuid &clientId, const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid);
+    TunnelProxyServer::TunnelProxyError registerServer(const QUuid &clientId, const QUuid &serverUuid, const QString &serverName, bool compression = false);
+    TunnelProxyServer::TunnelProxyError registerClient(const QUuid &clientId, const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid, bool multiplexed = false, bool compression = false, quint16 *channel = nullptr);
     TunnelProxyServer::TunnelProxyError disconnectClient(const QUuid &clientId, quint16 socketAddress);
+    TunnelProxyServer::TunnelProxyError closeTunnel(const QUuid &clientId, quint16 channel);
 
     QVariantMap currentStatistics(bool printAll = false);
 
+    // The counts, transports, latencies and top tunnels of currentStatistics() without the list of tunnels
+    QVariantMap summaryStatistics() const;
+
+    // The page of the servers matching the query, with the query offset, limit, count and if there are more
+    QVariantMap queryStatistics(const TunnelProxyServerQuery &query) const;
+
+    QList<TunnelProxyServerConnection *> serverConnections() const;
+    QList<TunnelProxyClientConnection *> clientConnections() const;
+    static QVariantMap serverConnectionStatistics(TunnelProxyServerConnection *serverConnection);
+    static QVariantMap clientConnectionStatistics(TunnelProxyClientConnection *clientConnection);
+    QVariantMap compressionStatistics() const;
+
+    // Connection counts and the slab allocator usage of the per-connection objects
+    QVariantMap memoryStatistics() const;
+    QVariantMap compactionStatistics() const;
+
+    // Metrics
+    QList<TransportInterface *> transportInterfaces() const;
+    int serverConnectionsCount() const;
+    int clientConnectionsCount() const;
+    qint64 bufferedBytes() const;
+    const LogHistogram &registrationLatency() const;
+
+    bool draining() const;
+    void startDrain(int window);
+    QVariantMap drainStatistics() const;
+
 public slots:
     void startServer();
     void stopServer();
@@ -77,6 +110,13 @@ public slots:
 
 signals:
     void runningChanged(bool running);
+    void serverRegistered(const QUuid &serverUuid, const QHostAddress &address);
+
+    // Connection events for the monitor subscriptions
+    void serverConnectionAdded(TunnelProxyServerConnection *serverConnection);
+    void serverConnectionRemoved(const QUuid &serverUuid);
+    void clientConnectionAdded(TunnelProxyClientConnection *clientConnection);
+    void clientConnectionRemoved(const QUuid &clientUuid);
 
 private slots:
     void onClientConnected(const QUuid &clientId, const QHostAddress &address);
@@ -84,6 +124,16 @@ private slots:
     void onClientDataAvailable(const QUuid &clientId, const QByteArray &data);
 
 private:
+    void processClientData(TunnelProxyClient *tunnelProxyClient, const QByteArray &data);
+    void processControlFrame(TunnelProxyClient *tunnelProxyClient, const QByteArray &data);
+    bool convertPayload(const QByteArray &payload, bool sourceCompression, bool targetCompression, QByteArray *result);
+    void sendToClientConnection(TunnelProxyClientConnection *clientConnection, const QByteArray &data);
+    void removeClientConnection(TunnelProxyClientConnection *clientConnection, bool notifyClient);
+    void processProbes();
+    void processIdleConnections();
+    void processDrain();
+    void processRates();
+
     JsonRpcServer *m_jsonRpcServer = nullptr;
     QList<TransportInterface *> m_transportInterfaces;
 
@@ -94,10 +144,41 @@ private:
     // Server connections
     QHash<QUuid, TunnelProxyServerConnection *> m_tunnelProxyServerConnections; // server uuid, object
     QHash<QUuid, TunnelProxyClientConnection *> m_tunnelProxyClientConnections; // client uuid, object
+    TunnelProxyServerIndex m_serverIndex;
+
+    // Drain
+    bool m_draining = false;
+    int m_drainWindow = 0;
+    qint64 m_drainStartTime = 0;
+    QHash<QUuid, qint64> m_pendingReconnectHints; // server uuid, due timestamp
+    QSet<QUuid> m_hintedServers;
+    int m_drainedServersCount = 0;
+
+    // Keepalive probes
 
     // Statistic measurments
     int m_troughput = 0;
     int m_troughputCounter = 0;
+
+    // Per transport rates, the heavy hitters follow the transports with the highest byte rates
+    qint64 m_lastRatesTimestamp = 0;
+    HeavyHitters m_heavyHitters;
+    int m_rateAlertsCount = 0;
+
+    // Compression measurments
+    quint64 m_compressedFramesCount = 0;
+    quint64 m_passThroughFramesCount = 0;
+    quint64 m_compressedBytes = 0;
+    quint64 m_uncompressedBytes = 0;
+    qint64 m_decompressionTime = 0; // ns
+
+    // Idle compaction measurments
+    quint64 m_compactionsCount = 0;
+    quint64 m_compactionReleasedBytes = 0;
+
+    // Latencies in us
+    LogHistogram m_registrationLatency;
+    qint64 m_arrivalTime = 0; // Monotonic arrival time of the data being processed
 };
 
 }
@@ -26,23 +26,44 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "tunnelproxyserverconnection.h"
+#include "server/slaballocator.h"
+#include "server/loghistogram.h"
 #include "server/transportclient.h"
+#include "tunnelproxyclient.h"
 #include "tunnelproxyclientconnection.h"
+#include "../common/slipdataprocessor.h"
 
 namespace remoteproxy {
 
-TunnelProxyServerConnection::TunnelProxyServerConnection(TransportClient *transportClient, const QUuid &serverUuid, const QString &serverName, QObject *parent) :
+TunnelProxyServerConnection::TunnelProxyServerConnection(TunnelProxyClient *tunnelProxyClient, const QUuid &serverUuid, const QString &serverName, QObject *parent) :
     QObject(parent),
-    m_transportClient(transportClient),
+    m_tunnelProxyClient(tunnelProxyClient),
     m_serverUuid(serverUuid),
     m_serverName(serverName)
 {
+    m_lastPingTimestamp = static_cast<quint64>(LogHistogram::timestamp());
+    m_rateDataCount = m_tunnelProxyClient->rxDataCount() + m_tunnelProxyClient->txDataCount();
+    m_rateFrameCount = m_tunnelProxyClient->rxFrameCount() + m_tunnelProxyClient->txFrameCount();
+}
 
+void *TunnelProxyServerConnection::operator new(size_t size)
+{
+    return SlabAllocator<TunnelProxyServerConnection>::instance().allocate(size);
+}
+
+void TunnelProxyServerConnection::operator delete(void *pointer, size_t size)
+{
+    SlabAllocator<TunnelProxyServerConnection>::instance().release(pointer, size);
 }
 
 TransportClient *TunnelProxyServerConnection::transportClient() const
 {
-    return m_transportClient;
+    return m_tunnelProxyClient;
+}
+
+TunnelProxyClient *TunnelProxyServerConnection::tunnelProxyClient() const
+{
+    return m_tunnelProxyClient;
 }
 
 QUuid TunnelProxyServerConnection::serverUuid() const
@@ -60,42 +81,100 @@ QList<TunnelProxyClientConnection *> TunnelProxyServerConnection::clientConnecti
     return m_clientConnections.values();
 }
 
-void TunnelProxyServerConnection::registerClientConnection(TunnelProxyClientConnection *clientConnection)
+bool TunnelProxyServerConnection::registerClientConnection(TunnelProxyClientConnection *clientConnection)
 {
-    quint16 socketAddress = getFreeAddress();
+    // The socket address space is shared between all servers registered on the transport
+    quint16 socketAddress = m_tunnelProxyClient->registerSocketAddress(clientConnection);
+    if (socketAddress == SlipDataProcessor::SocketAddressJsonRpc)
+        return false;
+
     clientConnection->setSocketAddress(socketAddress);
     clientConnection->setServerConnection(this);
-    m_clientConnectionsAddresses.insert(socketAddress, clientConnection);
     m_clientConnections.insert(clientConnection->clientUuid(), clientConnection);
+    return true;
 }
 
 void TunnelProxyServerConnection::unregisterClientConnection(TunnelProxyClientConnection *clientConnection)
 {
     m_clientConnections.remove(clientConnection->clientUuid());
-    m_clientConnectionsAddresses.remove(clientConnection->socketAddress());
+    m_tunnelProxyClient->unregisterSocketAddress(clientConnection->socketAddress());
     clientConnection->setSocketAddress(0xFFFF);
     clientConnection->setServerConnection(nullptr);
 }
 
 TunnelProxyClientConnection *TunnelProxyServerConnection::getClientConnection(quint16 socketAddress)
 {
-    return m_clientConnectionsAddresses.value(socketAddress);
+    TunnelProxyClientConnection *clientConnection = m_tunnelProxyClient->getClientConnection(socketAddress);
+    if (!clientConnection || clientConnection->serverConnection() != this)
+        return nullptr;
+
+    return clientConnection;
+}
+
+void TunnelProxyServerConnection::compact()
+{
+    if (m_clientConnections.isEmpty())
+        m_clientConnections = QHash<QUuid, TunnelProxyClientConnection *>();
+}
+
+quint64 TunnelProxyServerConnection::lastPingTimestamp() const
+{
+    return m_lastPingTimestamp;
+}
+
+void TunnelProxyServerConnection::setLastPingTimestamp(quint64 lastPingTimestamp)
+{
+    m_lastPingTimestamp = lastPingTimestamp;
 }
 
-quint16 TunnelProxyServerConnection::getFreeAddress()
+int TunnelProxyServerConnection::roundTripTime() const
 {
-    m_currentAddressCounter += 1;
-    quint16 address = m_currentAddressCounter;
-    for (int i = 0; i < m_connectionLimit; i++) {
-        if (m_clientConnectionsAddresses.contains(address) || address == 0x0000 || address == 0xFFFF) {
-            address++;
-        } else {
-            break;
-        }
+    return qRound(m_roundTripTime);
+}
+
+void TunnelProxyServerConnection::addRoundTripTimeSample(int roundTripTime)
+{
+    // Smoothed like the TCP SRTT (RFC 6298): srtt = 7/8 srtt + 1/8 sample
+    if (m_roundTripTime < 0) {
+        m_roundTripTime = roundTripTime;
+    } else {
+        m_roundTripTime = 0.875 * m_roundTripTime + 0.125 * roundTripTime;
     }
+}
+
+double TunnelProxyServerConnection::byteRate() const
+{
+    return m_byteRate;
+}
+
+double TunnelProxyServerConnection::frameRate() const
+{
+    return m_frameRate;
+}
+
+quint64 TunnelProxyServerConnection::updateRates(double interval, double weight)
+{
+    quint64 dataCount = m_tunnelProxyClient->rxDataCount() + m_tunnelProxyClient->txDataCount();
+    quint64 frameCount = m_tunnelProxyClient->rxFrameCount() + m_tunnelProxyClient->txFrameCount();
+    quint64 dataDelta = dataCount - m_rateDataCount;
+    quint64 frameDelta = frameCount - m_rateFrameCount;
+    m_rateDataCount = dataCount;
+    m_rateFrameCount = frameCount;
+
+    // rate = (1 - w) rate + w sample
+    m_byteRate += weight * (dataDelta / interval - m_byteRate);
+    m_frameRate += weight * (frameDelta / interval - m_frameRate);
+    return dataDelta;
+}
 
-    Q_ASSERT_X(!m_clientConnectionsAddresses.contains(address), "TunnelProxyServerConnection", "no free address but the maximum of connections has been reached.");
-    return address;
+bool TunnelProxyServerConnection::rateAlert() const
+{
+    return m_rateAlert;
+}
+
+void TunnelProxyServerConnection::setRateAlert(bool rateAlert)
+{
+    m_rateAlert = rateAlert;
 }
 
 QDebug operator<<(QDebug debug, TunnelProxyServerConnection *serverConnection)
@@ -35,40 +35,69 @@
 namespace remoteproxy {
 
 class TransportClient;
+class TunnelProxyClient;
 class TunnelProxyClientConnection;
 
 class TunnelProxyServerConnection : public QObject
 {
     Q_OBJECT
 public:
-    explicit TunnelProxyServerConnection(TransportClient *transportClient, const QUuid &serverUuid, const QString &serverName, QObject *parent = nullptr);
+    explicit TunnelProxyServerConnection(TunnelProxyClient *tunnelProxyClient, const QUuid &serverUuid, const QString &serverName, QObject *parent = nullptr);
+
+    // Connection objects are allocated from a slab, see SlabAllocator
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer, size_t size);
 
     TransportClient *transportClient() const;
+    TunnelProxyClient *tunnelProxyClient() const;
 
     QUuid serverUuid() const;
     QString serverName() const;
 
     QList<TunnelProxyClientConnection *> clientConnections() const;
 
-    void registerClientConnection(TunnelProxyClientConnection *clientConnection);
+    bool registerClientConnection(TunnelProxyClientConnection *clientConnection);
     void unregisterClientConnection(TunnelProxyClientConnection *clientConnection);
 
     TunnelProxyClientConnection *getClientConnection(quint16 socketAddress);
 
+    // Frees the client connection table of an idle server, it gets rebuilt with the next client
+    void compact();
+
+    // Keepalive probes using control frames, monotonic timestamp in us (see LogHistogram::timestamp())
+    quint64 lastPingTimestamp() const;
+    void setLastPingTimestamp(quint64 lastPingTimestamp);
+
+    // Smoothed round trip time in ms, -1 if not measured yet
+    int roundTripTime() const;
+    void addRoundTripTimeSample(int roundTripTime);
+
+    // Exponentially weighted rates of the transport in B/s and frames/s, rx and tx together.
+    // The update takes the counter deltas since the previous update and returns the byte delta.
+    // Only the first registered server of a transport gets updated, the others stay at 0.
+    double byteRate() const;
+    double frameRate() const;
+    quint64 updateRates(double interval, double weight);
+
+    // Set while the byte rate is above the alert threshold, the alert gets logged once
+    bool rateAlert() const;
+    void setRateAlert(bool rateAlert);
+
 private:
-    TransportClient *m_transportClient = nullptr;
+    TunnelProxyClient *m_tunnelProxyClient = nullptr;
     QUuid m_serverUuid;
     QString m_serverName;
-    quint16 m_connectionLimit = 100;
-
-    quint16 m_currentAddressCounter = 0;
 
     QHash<QUuid, TunnelProxyClientConnection *> m_clientConnections;
-    QHash<quint16, TunnelProxyClientConnection *> m_clientConnectionsAddresses;
 
     quint64 m_lastPingTimestamp = 0;
+    double m_roundTripTime = -1;
 
-    quint16 getFreeAddress();
+    quint64 m_rateDataCount = 0;
+    quint64 m_rateFrameCount = 0;
+    double m_byteRate = 0;
+    double m_frameRate = 0;
+    bool m_rateAlert = false;
 
 };
 
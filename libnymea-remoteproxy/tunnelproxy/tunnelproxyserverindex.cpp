@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "tunnelproxyserverindex.h"
+#include "tunnelproxyserverconnection.h"
+#include "server/transportclient.h"
+
+#include <algorithm>
+
+namespace remoteproxy {
+
+bool TunnelProxyServerQuery::hasFilter() const
+{
+    return !uuidPrefix.isEmpty() || !namePrefix.isEmpty() || subnetPrefixLength >= 0;
+}
+
+bool TunnelProxyServerQuery::fromVariantMap(const QVariantMap &params, TunnelProxyServerQuery *query)
+{
+    query->uuidPrefix = params.value("uuid").toString();
+    query->namePrefix = params.value("name").toString();
+
+    if (params.contains("address")) {
+        QString address = params.value("address").toString();
+        if (!address.contains('/')) {
+            QHostAddress hostAddress(address);
+            address += QString("/%1").arg(hostAddress.protocol() == QAbstractSocket::IPv6Protocol ? 128 : 32);
+        }
+
+        QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(address);
+        if (subnet.first.isNull())
+            return false;
+
+        query->subnet = subnet.first;
+        query->subnetPrefixLength = subnet.second;
+    }
+
+    if (params.contains("sortBy")) {
+        QString sortBy = params.value("sortBy").toString();
+        if (sortBy == "rxDataCount") {
+            query->sortOrder = SortOrderRxData;
+        } else if (sortBy == "txDataCount") {
+            query->sortOrder = SortOrderTxData;
+        } else if (sortBy == "throughput") {
+            query->sortOrder = SortOrderThroughput;
+        } else {
+            return false;
+        }
+    }
+
+    query->offset = qMax(0, params.value("offset", 0).toInt());
+    query->limit = params.value("limit", -1).toInt();
+    return true;
+}
+
+void TunnelProxyServerIndex::insert(TunnelProxyServerConnection *serverConnection)
+{
+    quintptr key = reinterpret_cast<quintptr>(serverConnection);
+
+    Entry entry;
+    entry.uuidKey = uuidKey(serverConnection->serverUuid());
+    entry.nameKey = qMakePair(serverConnection->serverName().toLower(), key);
+    entry.addressKey = qMakePair(addressKey(serverConnection->transportClient()->peerAddress()), key);
+    entry.rxDataCount = serverConnection->transportClient()->rxDataCount();
+    entry.txDataCount = serverConnection->transportClient()->txDataCount();
+
+    m_entries.insert(serverConnection, entry);
+    m_uuidIndex.insert(entry.uuidKey, serverConnection);
+    m_nameIndex.insert(entry.nameKey, serverConnection);
+    m_addressIndex.insert(entry.addressKey, serverConnection);
+    m_rxDataIndex.insert(qMakePair(entry.rxDataCount, key), serverConnection);
+    m_txDataIndex.insert(qMakePair(entry.txDataCount, key), serverConnection);
+    m_throughputIndex.insert(qMakePair(entry.throughput, key), serverConnection);
+}
+
+void TunnelProxyServerIndex::remove(TunnelProxyServerConnection *serverConnection)
+{
+    QHash<TunnelProxyServerConnection *, Entry>::iterator it = m_entries.find(serverConnection);
+    if (it == m_entries.end())
+        return;
+
+    quintptr key = reinterpret_cast<quintptr>(serverConnection);
+    m_uuidIndex.remove(it->uuidKey);
+    m_nameIndex.remove(it->nameKey);
+    m_addressIndex.remove(it->addressKey);
+    m_rxDataIndex.remove(qMakePair(it->rxDataCount, key));
+    m_txDataIndex.remove(qMakePair(it->txDataCount, key));
+    m_throughputIndex.remove(qMakePair(it->throughput, key));
+    m_entries.erase(it);
+}
+
+void TunnelProxyServerIndex::update(TunnelProxyServerConnection *serverConnection)
+{
+    QHash<TunnelProxyServerConnection *, Entry>::iterator it = m_entries.find(serverConnection);
+    if (it == m_entries.end())
+        return;
+
+    // Only changed values move in the indexes
+    quintptr key = reinterpret_cast<quintptr>(serverConnection);
+    quint64 rxDataCount = serverConnection->transportClient()->rxDataCount();
+    quint64 txDataCount = serverConnection->transportClient()->txDataCount();
+    quint64 throughput = static_cast<quint64>(qRound64(serverConnection->byteRate()));
+
+    if (rxDataCount != it->rxDataCount) {
+        m_rxDataIndex.remove(qMakePair(it->rxDataCount, key));
+        m_rxDataIndex.insert(qMakePair(rxDataCount, key), serverConnection);
+        it->rxDataCount = rxDataCount;
+    }
+
+    if (txDataCount != it->txDataCount) {
+        m_txDataIndex.remove(qMakePair(it->txDataCount, key));
+        m_txDataIndex.insert(qMakePair(txDataCount, key), serverConnection);
+        it->txDataCount = txDataCount;
+    }
+
+    if (throughput != it->throughput) {
+        m_throughputIndex.remove(qMakePair(it->throughput, key));
+        m_throughputIndex.insert(qMakePair(throughput, key), serverConnection);
+        it->throughput = throughput;
+    }
+}
+
+quint64 TunnelProxyServerIndex::throughput(TunnelProxyServerConnection *serverConnection) const
+{
+    return m_entries.value(serverConnection).throughput;
+}
+
+QList<TunnelProxyServerConnection *> TunnelProxyServerIndex::query(const TunnelProxyServerQuery &query, bool *more) const
+{
+    Criteria criteria;
+    criteria.query = &query;
+    criteria.uuidPrefix = query.uuidPrefix.toLower().remove('{').remove('}');
+    criteria.namePrefix = query.namePrefix.toLower();
+    if (query.subnetPrefixLength >= 0) {
+        // Subnets are ranges of the IPv6 (or IPv4-mapped) address keys
+        int prefixLength = query.subnetPrefixLength;
+        if (query.subnet.protocol() == QAbstractSocket::IPv4Protocol)
+            prefixLength += 96;
+
+        criteria.lowAddress = addressKey(query.subnet);
+        criteria.highAddress = criteria.lowAddress;
+        for (int bit = qMax(0, prefixLength); bit < 128; bit++) {
+            char mask = static_cast<char>(0x80 >> (bit % 8));
+            criteria.lowAddress[bit / 8] = static_cast<char>(criteria.lowAddress.at(bit / 8) & ~mask);
+            criteria.highAddress[bit / 8] = static_cast<char>(criteria.highAddress.at(bit / 8) | mask);
+        }
+    }
+
+    QList<TunnelProxyServerConnection *> results;
+    bool moreResults = false;
+    int skipped = 0;
+    auto collect = [&](TunnelProxyServerConnection *serverConnection) -> bool {
+        if (skipped < query.offset) {
+            skipped++;
+            return true;
+        }
+
+        if (query.limit >= 0 && results.count() >= query.limit) {
+            moreResults = true;
+            return false;
+        }
+
+        results.append(serverConnection);
+        return true;
+    };
+
+    if (query.sortOrder == TunnelProxyServerQuery::SortOrderNone) {
+        forEachCandidate(criteria, collect);
+    } else if (!query.hasFilter()) {
+        // Top servers: walk the traffic index from the highest value
+        const QMap<CounterKey, TunnelProxyServerConnection *> *index = counterIndex(query.sortOrder);
+        QMap<CounterKey, TunnelProxyServerConnection *>::const_iterator it = index->constEnd();
+        while (it != index->constBegin()) {
+            --it;
+            if (query.activeOnly && !matches(it.value(), m_entries.value(it.value()), criteria))
+                continue;
+
+            if (!collect(it.value()))
+                break;
+        }
+    } else {
+        // Filtered top servers: sort the matches of the filter
+        QList<TunnelProxyServerConnection *> matchingServers;
+        forEachCandidate(criteria, [&matchingServers](TunnelProxyServerConnection *serverConnection) {
+            matchingServers.append(serverConnection);
+            return true;
+        });
+
+        std::sort(matchingServers.begin(), matchingServers.end(), [this, &query](TunnelProxyServerConnection *a, TunnelProxyServerConnection *b) {
+            return counterValue(m_entries.value(a), query.sortOrder) > counterValue(m_entries.value(b), query.sortOrder);
+        });
+
+        foreach (TunnelProxyServerConnection *serverConnection, matchingServers) {
+            if (!collect(serverConnection))
+                break;
+        }
+    }
+
+    if (more)
+        *more = moreResults;
+
+    return results;
+}
+
+QString TunnelProxyServerIndex::uuidKey(const QUuid &uuid)
+{
+    return uuid.toString().mid(1, 36).toLower();
+}
+
+QByteArray TunnelProxyServerIndex::addressKey(const QHostAddress &address)
+{
+    // IPv4 addresses get mapped into the IPv6 range, the byte order keeps the numeric order
+    QByteArray key(16, 0);
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        quint32 ipv4Address = address.toIPv4Address();
+        key[10] = static_cast<char>(0xff);
+        key[11] = static_cast<char>(0xff);
+        key[12] = static_cast<char>((ipv4Address >> 24) & 0xff);
+        key[13] = static_cast<char>((ipv4Address >> 16) & 0xff);
+        key[14] = static_cast<char>((ipv4Address >> 8) & 0xff);
+        key[15] = static_cast<char>(ipv4Address & 0xff);
+    } else if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+        Q_IPV6ADDR ipv6Address = address.toIPv6Address();
+        for (int i = 0; i < 16; i++)
+            key[i] = static_cast<char>(ipv6Address[i]);
+    }
+
+    return key;
+}
+
+const QMap<TunnelProxyServerIndex::CounterKey, TunnelProxyServerConnection *> *TunnelProxyServerIndex::counterIndex(TunnelProxyServerQuery::SortOrder sortOrder) const
+{
+    switch (sortOrder) {
+    case TunnelProxyServerQuery::SortOrderRxData:
+        return &m_rxDataIndex;
+    case TunnelProxyServerQuery::SortOrderTxData:
+        return &m_txDataIndex;
+    default:
+        return &m_throughputIndex;
+    }
+}
+
+quint64 TunnelProxyServerIndex::counterValue(const Entry &entry, TunnelProxyServerQuery::SortOrder sortOrder) const
+{
+    switch (sortOrder) {
+    case TunnelProxyServerQuery::SortOrderRxData:
+        return entry.rxDataCount;
+    case TunnelProxyServerQuery::SortOrderTxData:
+        return entry.txDataCount;
+    default:
+        return entry.throughput;
+    }
+}
+
+bool TunnelProxyServerIndex::matches(TunnelProxyServerConnection *serverConnection, const Entry &entry, const Criteria &criteria) const
+{
+    if (criteria.query->activeOnly && serverConnection->clientConnections().isEmpty())
+        return false;
+
+    if (!criteria.uuidPrefix.isEmpty() && !entry.uuidKey.startsWith(criteria.uuidPrefix))
+        return false;
+
+    if (!criteria.namePrefix.isEmpty() && !entry.nameKey.first.startsWith(criteria.namePrefix))
+        return false;
+
+    if (!criteria.lowAddress.isEmpty() && (entry.addressKey.first < criteria.lowAddress || entry.addressKey.first > criteria.highAddress))
+        return false;
+
+    return true;
+}
+
+void TunnelProxyServerIndex::forEachCandidate(const Criteria &criteria, const std::function<bool(TunnelProxyServerConnection *)> &visitor) const
+{
+    // The uuid prefix is the most selective criteria, the name is the least one
+    if (!criteria.uuidPrefix.isEmpty()) {
+        QMap<QString, TunnelProxyServerConnection *>::const_iterator it = m_uuidIndex.lowerBound(criteria.uuidPrefix);
+        for (; it != m_uuidIndex.constEnd() && it.key().startsWith(criteria.uuidPrefix); ++it) {
+            if (matches(it.value(), m_entries.value(it.value()), criteria) && !visitor(it.value()))
+                return;
+        }
+    } else if (!criteria.lowAddress.isEmpty()) {
+        QMap<AddressKey, TunnelProxyServerConnection *>::const_iterator it = m_addressIndex.lowerBound(qMakePair(criteria.lowAddress, static_cast<quintptr>(0)));
+        for (; it != m_addressIndex.constEnd() && it.key().first <= criteria.highAddress; ++it) {
+            if (matches(it.value(), m_entries.value(it.value()), criteria) && !visitor(it.value()))
+                return;
+        }
+    } else if (!criteria.namePrefix.isEmpty()) {
+        QMap<NameKey, TunnelProxyServerConnection *>::const_iterator it = m_nameIndex.lowerBound(qMakePair(criteria.namePrefix, static_cast<quintptr>(0)));
+        for (; it != m_nameIndex.constEnd() && it.key().first.startsWith(criteria.namePrefix); ++it) {
+            if (matches(it.value(), m_entries.value(it.value()), criteria) && !visitor(it.value()))
+                return;
+        }
+    } else {
+        for (QMap<QString, TunnelProxyServerConnection *>::const_iterator it = m_uuidIndex.constBegin(); it != m_uuidIndex.constEnd(); ++it) {
+            if (matches(it.value(), m_entries.value(it.value()), criteria) && !visitor(it.value()))
+                return;
+        }
+    }
+}
+
+}
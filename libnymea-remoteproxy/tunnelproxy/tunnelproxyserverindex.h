@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef TUNNELPROXYSERVERINDEX_H
+#define TUNNELPROXYSERVERINDEX_H
+
+#include <QMap>
+#include <QHash>
+#include <QPair>
+#include <QUuid>
+#include <QString>
+#include <QVariantMap>
+#include <QHostAddress>
+
+#include <functional>
+
+namespace remoteproxy {
+
+class TunnelProxyServerConnection;
+
+// Query for the registered servers, all given criteria have to match
+class TunnelProxyServerQuery
+{
+public:
+    enum SortOrder {
+        SortOrderNone,
+        SortOrderRxData,
+        SortOrderTxData,
+        SortOrderThroughput
+    };
+
+    QString uuidPrefix;
+    QString namePrefix;
+    QHostAddress subnet;
+    int subnetPrefixLength = -1;
+
+    // Only servers with client connections
+    bool activeOnly = false;
+
+    // Descending, for the top servers by traffic
+    SortOrder sortOrder = SortOrderNone;
+
+    int offset = 0;
+    int limit = -1;
+
+    bool hasFilter() const;
+
+    // The monitor request params: uuid, name, address (address or CIDR subnet), sortBy (rxDataCount,
+    // txDataCount or throughput), offset and limit. Returns false if a value could not be parsed.
+    static bool fromVariantMap(const QVariantMap &params, TunnelProxyServerQuery *query);
+};
+
+// Indexes of the registered servers for the monitor queries. The uuid, name and address indexes are
+// ordered, so prefix and subnet lookups are a range in the index. The traffic indexes get updated
+// once per second together with the rates, the queries do not have to walk all registered servers.
+class TunnelProxyServerIndex
+{
+public:
+    TunnelProxyServerIndex() = default;
+
+    void insert(TunnelProxyServerConnection *serverConnection);
+    void remove(TunnelProxyServerConnection *serverConnection);
+
+    // Updates the traffic indexes of the server from its counters and its smoothed byte rate
+    void update(TunnelProxyServerConnection *serverConnection);
+
+    // The smoothed byte rate in B/s as of the last update, see TunnelProxyServerConnection::byteRate()
+    quint64 throughput(TunnelProxyServerConnection *serverConnection) const;
+
+    // The page of the servers matching the query, more gets set if there are further matches after the page
+    QList<TunnelProxyServerConnection *> query(const TunnelProxyServerQuery &query, bool *more = nullptr) const;
+
+private:
+    typedef QPair<QString, quintptr> NameKey;
+    typedef QPair<QByteArray, quintptr> AddressKey;
+    typedef QPair<quint64, quintptr> CounterKey;
+
+    struct Entry {
+        QString uuidKey;
+        NameKey nameKey;
+        AddressKey addressKey;
+        quint64 rxDataCount = 0;
+        quint64 txDataCount = 0;
+        quint64 throughput = 0;
+    };
+
+    // The parsed query with the subnet as range of address keys
+    struct Criteria {
+        const TunnelProxyServerQuery *query = nullptr;
+        QString uuidPrefix;
+        QString namePrefix;
+        QByteArray lowAddress;
+        QByteArray highAddress;
+    };
+
+    QHash<TunnelProxyServerConnection *, Entry> m_entries;
+    QMap<QString, TunnelProxyServerConnection *> m_uuidIndex;
+    QMap<NameKey, TunnelProxyServerConnection *> m_nameIndex;
+    QMap<AddressKey, TunnelProxyServerConnection *> m_addressIndex;
+    QMap<CounterKey, TunnelProxyServerConnection *> m_rxDataIndex;
+    QMap<CounterKey, TunnelProxyServerConnection *> m_txDataIndex;
+    QMap<CounterKey, TunnelProxyServerConnection *> m_throughputIndex;
+
+    static QString uuidKey(const QUuid &uuid);
+    static QByteArray addressKey(const QHostAddress &address);
+
+    const QMap<CounterKey, TunnelProxyServerConnection *> *counterIndex(TunnelProxyServerQuery::SortOrder sortOrder) const;
+    quint64 counterValue(const Entry &entry, TunnelProxyServerQuery::SortOrder sortOrder) const;
+
+    bool matches(TunnelProxyServerConnection *serverConnection, const Entry &entry, const Criteria &criteria) const;
+
+    // Visits the candidates of the most selective index until the visitor returns false
+    void forEachCandidate(const Criteria &criteria, const std::function<bool(TunnelProxyServerConnection *)> &visitor) const;
+};
+
+}
+
+#endif // TUNNELPROXYSERVERINDEX_H
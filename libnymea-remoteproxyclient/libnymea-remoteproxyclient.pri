@@ -3,6 +3,7 @@ include(../common/common.pri)
 INCLUDEPATH += $$PWD
 
 HEADERS += \
+    $$PWD/tunnelproxy/reconnectbackoff.h \
     $$PWD/tunnelproxy/tunnelproxyremoteconnection.h \
     $$PWD/tunnelproxy/tunnelproxysocket.h \
     $$PWD/tunnelproxy/tunnelproxysocketserver.h \
@@ -13,6 +14,7 @@ HEADERS += \
     $$PWD/websocketconnection.h
 
 SOURCES += \
+    $$PWD/tunnelproxy/reconnectbackoff.cpp \
     $$PWD/tunnelproxy/tunnelproxyremoteconnection.cpp \
     $$PWD/tunnelproxy/tunnelproxysocket.cpp \
     $$PWD/tunnelproxy/tunnelproxysocketserver.cpp \
@@ -9,7 +9,8 @@ include(libnymea-remoteproxyclient.pri)
 installheaders.files = remoteproxyconnection.h
 installheaders.path = $$[QT_INSTALL_PREFIX]/include/nymea-remoteproxyclient/
 
-installtunnelheaders.files = tunnelproxy/tunnelproxyremoteconnection.h \
+installtunnelheaders.files = tunnelproxy/reconnectbackoff.h \
+                             tunnelproxy/tunnelproxyremoteconnection.h \
                              tunnelproxy/tunnelproxysocket.h \
                              tunnelproxy/tunnelproxysocketserver.h
 installtunnelheaders.path = $$[QT_INSTALL_PREFIX]/include/nymea-remoteproxyclient/tunnelproxy
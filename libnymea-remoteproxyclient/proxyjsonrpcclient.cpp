@@ -29,6 +29,7 @@
 #include "proxyconnection.h"
 #include "../common/slipdataprocessor.h"
 
+#include <QJsonObject>
 #include <QJsonDocument>
 
 Q_LOGGING_CATEGORY(dcRemoteProxyClientJsonRpc, "RemoteProxyClientJsonRpc")
@@ -52,29 +53,48 @@ JsonReply *JsonRpcClient::callHello()
     return reply;
 }
 
-JsonReply *JsonRpcClient::callRegisterServer(const QUuid &serverUuid, const QString &serverName)
+JsonReply *JsonRpcClient::callRegisterServer(const QUuid &serverUuid, const QString &serverName, bool slipEnabled, bool compression)
 {
     QVariantMap params;
     params.insert("serverName", serverName);
     params.insert("serverUuid", serverUuid.toString());
+    if (compression)
+        params.insert("compression", true);
 
     JsonReply *reply = new JsonReply(m_commandId, "TunnelProxy", "RegisterServer", params, this);
     qCDebug(dcRemoteProxyClientJsonRpc()) << "Calling" << QString("%1.%2").arg(reply->nameSpace()).arg(reply->method());
-    sendRequest(reply->requestMap());
+    sendRequest(reply->requestMap(), slipEnabled);
     m_replies.insert(m_commandId, reply);
     return reply;
 }
 
-JsonReply *JsonRpcClient::callRegisterClient(const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid)
+JsonReply *JsonRpcClient::callRegisterClient(const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid, bool multiplexed, bool slipEnabled, bool compression)
 {
     QVariantMap params;
     params.insert("clientUuid", clientUuid);
     params.insert("clientName", clientName);
     params.insert("serverUuid", serverUuid.toString());
+    if (multiplexed)
+        params.insert("multiplexed", true);
+
+    if (compression)
+        params.insert("compression", true);
 
     JsonReply *reply = new JsonReply(m_commandId, "TunnelProxy", "RegisterClient", params, this);
     qCDebug(dcRemoteProxyClientJsonRpc()) << "Calling" << QString("%1.%2").arg(reply->nameSpace()).arg(reply->method());
-    sendRequest(reply->requestMap());
+    sendRequest(reply->requestMap(), slipEnabled);
+    m_replies.insert(m_commandId, reply);
+    return reply;
+}
+
+JsonReply *JsonRpcClient::callCloseTunnel(quint16 channel)
+{
+    QVariantMap params;
+    params.insert("channel", channel);
+
+    JsonReply *reply = new JsonReply(m_commandId, "TunnelProxy", "CloseTunnel", params, this);
+    qCDebug(dcRemoteProxyClientJsonRpc()) << "Calling" << QString("%1.%2").arg(reply->nameSpace()).arg(reply->method());
+    sendRequest(reply->requestMap(), true);
     m_replies.insert(m_commandId, reply);
     return reply;
 }
@@ -103,6 +123,16 @@ JsonReply *JsonRpcClient::callPing(uint timestamp)
     return reply;
 }
 
+void JsonRpcClient::interruptProcessing()
+{
+    m_processingInterrupted = true;
+}
+
+QByteArray JsonRpcClient::takeRemainingData()
+{
+    return m_jsonStreamSplitter.takeAll();
+}
+
 void JsonRpcClient::sendRequest(const QVariantMap &request, bool slipEnabled)
 {
     QByteArray data = QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n";
@@ -127,48 +157,53 @@ void JsonRpcClient::processDataPacket(const QByteArray &data)
         return;
     }
 
-    QVariantMap dataMap = jsonDoc.toVariant().toMap();
+    // Read the well known keys straight from the object, only replies get converted for the JsonReply
+    QJsonObject message = jsonDoc.object();
 
     qCDebug(dcRemoteProxyClientJsonRpcTraffic()) << "Data received" << qUtf8Printable(data);
 
     // check if this is a reply to a request
-    int commandId = dataMap.value("id").toInt();
+    int commandId = message.value(QLatin1String("id")).toInt();
     JsonReply *reply = m_replies.take(commandId);
     if (reply) {
         qCDebug(dcRemoteProxyClientJsonRpcTraffic()) << QString("Got response for %1.%2: %3").arg(reply->nameSpace(), reply->method(), QString::fromUtf8(jsonDoc.toJson(QJsonDocument::Indented)));
 
-        if (dataMap.value("status").toString() == "error") {
-            qCWarning(dcRemoteProxyClientJsonRpc()) << "Api error happend" << dataMap.value("error").toString();
+        if (message.value(QLatin1String("status")).toString() == QLatin1String("error")) {
+            qCWarning(dcRemoteProxyClientJsonRpc()) << "Api error happend" << message.value(QLatin1String("error")).toString();
             // FIMXME: handle json layer errors
         }
 
-        reply->setResponse(dataMap);
+        reply->setResponse(message.toVariantMap());
         emit reply->finished();
         return;
     }
 
     // check if this is a notification
-    if (dataMap.contains("notification")) {
-        QStringList notification = dataMap.value("notification").toString().split(".");
-        QString nameSpace = notification.first();
-        QString notificationName = notification.last();
-        QVariantMap notificationParams = dataMap.value("params").toMap();
+    QJsonObject::const_iterator notificationIt = message.constFind(QLatin1String("notification"));
+    if (notificationIt != message.constEnd()) {
+        QString notification = notificationIt.value().toString();
+        QJsonObject notificationParams = message.value(QLatin1String("params")).toObject();
 
-        qCDebug(dcRemoteProxyClientJsonRpc()) << "Notification received" << nameSpace << notificationName;
+        qCDebug(dcRemoteProxyClientJsonRpc()) << "Notification received" << notification;
 
-        if (nameSpace == "RemoteProxy" && notificationName == "TunnelEstablished") {
-            QString clientName = notificationParams.value("name").toString();
-            QString clientUuid = notificationParams.value("uuid").toString();
+        if (notification == QLatin1String("RemoteProxy.TunnelEstablished")) {
+            QString clientName = notificationParams.value(QLatin1String("name")).toString();
+            QString clientUuid = notificationParams.value(QLatin1String("uuid")).toString();
             emit tunnelEstablished(clientName, clientUuid);
-        } else if (nameSpace == "TunnelProxy" && notificationName == "ClientConnected") {
-            QString clientName = notificationParams.value("clientName").toString();
-            QUuid clientUuid = notificationParams.value("clientUuid").toUuid();
-            QString clientPeerAddress = notificationParams.value("clientPeerAddress").toString();
-            quint16 socketAddress = static_cast<quint16>(notificationParams.value("socketAddress").toUInt());
-            emit tunnelProxyClientConnected(clientName, clientUuid, clientPeerAddress, socketAddress);
-        } else if (nameSpace == "TunnelProxy" && notificationName == "ClientDisconnected") {
-            quint16 socketAddress = static_cast<quint16>(notificationParams.value("socketAddress").toUInt());
+        } else if (notification == QLatin1String("TunnelProxy.ClientConnected")) {
+            QString clientName = notificationParams.value(QLatin1String("clientName")).toString();
+            QUuid clientUuid = QUuid(notificationParams.value(QLatin1String("clientUuid")).toString());
+            QString clientPeerAddress = notificationParams.value(QLatin1String("clientPeerAddress")).toString();
+            quint16 socketAddress = static_cast<quint16>(notificationParams.value(QLatin1String("socketAddress")).toInt());
+            QUuid serverUuid = QUuid(notificationParams.value(QLatin1String("serverUuid")).toString());
+            emit tunnelProxyClientConnected(clientName, clientUuid, clientPeerAddress, socketAddress, serverUuid);
+        } else if (notification == QLatin1String("TunnelProxy.ClientDisconnected")) {
+            quint16 socketAddress = static_cast<quint16>(notificationParams.value(QLatin1String("socketAddress")).toInt());
             emit tunnelProxyClientDisonnected(socketAddress);
+        } else if (notification == QLatin1String("TunnelProxy.ReconnectRequested")) {
+            emit tunnelProxyReconnectRequested(notificationParams.value(QLatin1String("reason")).toString());
+        } else if (notification == QLatin1String("TunnelProxy.TunnelClosed")) {
+            emit tunnelProxyTunnelClosed(static_cast<quint16>(notificationParams.value(QLatin1String("channel")).toInt()));
         }
     }
 }
@@ -178,16 +213,15 @@ void JsonRpcClient::processData(const QByteArray &data)
     qCDebug(dcRemoteProxyClientJsonRpcTraffic()) << "Received data:" << data;
 
     // Handle packet fragmentation
-    m_dataBuffer.append(data);
-    int splitIndex = m_dataBuffer.indexOf("}\n{");
-    while (splitIndex > -1) {
-        processDataPacket(m_dataBuffer.left(splitIndex + 1));
-        m_dataBuffer = m_dataBuffer.right(m_dataBuffer.length() - splitIndex - 2);
-        splitIndex = m_dataBuffer.indexOf("}\n{");
-    }
-    if (m_dataBuffer.endsWith("}\n") || m_dataBuffer.endsWith("}")) {
-        processDataPacket(m_dataBuffer);
-        m_dataBuffer.clear();
+    m_processingInterrupted = false;
+    m_jsonStreamSplitter.append(data);
+    QByteArray packet = m_jsonStreamSplitter.takeMessage();
+    while (!packet.isNull()) {
+        processDataPacket(packet);
+        if (m_processingInterrupted)
+            break;
+
+        packet = m_jsonStreamSplitter.takeMessage();
     }
 }
 
@@ -35,6 +35,7 @@
 
 #include "jsonreply.h"
 #include "proxyconnection.h"
+#include "../common/jsonstreamsplitter.h"
 
 Q_DECLARE_LOGGING_CATEGORY(dcRemoteProxyClientJsonRpc)
 Q_DECLARE_LOGGING_CATEGORY(dcRemoteProxyClientJsonRpcTraffic)
@@ -51,16 +52,23 @@ public:
     JsonReply *callHello();
 
     // Tunnel proxy
-    JsonReply *callRegisterServer(const QUuid &serverUuid, const QString &serverName);
-    JsonReply *callRegisterClient(const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid);
+    JsonReply *callRegisterServer(const QUuid &serverUuid, const QString &serverName, bool slipEnabled = false, bool compression = false);
+    JsonReply *callRegisterClient(const QUuid &clientUuid, const QString &clientName, const QUuid &serverUuid, bool multiplexed = false, bool slipEnabled = false, bool compression = false);
+    JsonReply *callCloseTunnel(quint16 channel);
     JsonReply *callDisconnectClient(quint16 socketAddress);
     JsonReply *callPing(uint timestamp);
 
+    // Stop processing the current data, i.e. once the registration changed the data format.
+    // The unprocessed data can be taken using takeRemainingData().
+    void interruptProcessing();
+    QByteArray takeRemainingData();
+
 private:
     ProxyConnection *m_connection = nullptr;
 
     int m_commandId = 0;
-    QByteArray m_dataBuffer;
+    JsonStreamSplitter m_jsonStreamSplitter;
+    bool m_processingInterrupted = false;
 
     QHash<int, JsonReply *> m_replies;
 
@@ -69,8 +77,10 @@ private:
 
 signals:
     void tunnelEstablished(const QString clientName, const QString &clientUuid);
-    void tunnelProxyClientConnected(const QString &clientName, const QUuid &clientUuid, const QString &clientPeerAddress, quint16 socketAddress);
+    void tunnelProxyClientConnected(const QString &clientName, const QUuid &clientUuid, const QString &clientPeerAddress, quint16 socketAddress, const QUuid &serverUuid);
     void tunnelProxyClientDisonnected(quint16 socketAddress);
+    void tunnelProxyReconnectRequested(const QString &reason);
+    void tunnelProxyTunnelClosed(quint16 channel);
 
 public slots:
     void processData(const QByteArray &data);
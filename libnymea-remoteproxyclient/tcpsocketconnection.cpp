@@ -114,7 +114,11 @@ void TcpSocketConnection::onStateChanged(QAbstractSocket::SocketState state)
 
 void TcpSocketConnection::onReadyRead()
 {
-    emit dataReceived(m_tcpSocket->readAll());
+    QByteArray data = m_readBufferPool.read(m_tcpSocket);
+    while (!data.isEmpty()) {
+        emit dataReceived(data);
+        data = m_readBufferPool.read(m_tcpSocket);
+    }
 }
 
 void TcpSocketConnection::connectServer(const QUrl &serverUrl)
@@ -34,6 +34,7 @@
 #include <QLoggingCategory>
 
 #include "proxyconnection.h"
+#include "../common/bufferpool.h"
 
 Q_DECLARE_LOGGING_CATEGORY(dcRemoteProxyClientTcpSocket)
 
@@ -55,6 +56,7 @@ public:
 private:
     QSslSocket *m_tcpSocket = nullptr;
     bool m_ssl = false;
+    BufferPool m_readBufferPool;
 
 private slots:
     void onDisconnected();
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "reconnectbackoff.h"
+
+#include <QtMath>
+
+namespace remoteproxyclient {
+
+ReconnectBackoff::ReconnectBackoff() :
+    m_random(QRandomGenerator::global()->generate())
+{
+
+}
+
+ReconnectBackoff::ReconnectBackoff(int initialDelay, int maximumDelay, double multiplier) :
+    m_initialDelay(qMax(0, initialDelay)),
+    m_maximumDelay(qMax(0, maximumDelay)),
+    m_multiplier(qMax(1.0, multiplier)),
+    m_random(QRandomGenerator::global()->generate())
+{
+
+}
+
+int ReconnectBackoff::initialDelay() const
+{
+    return m_initialDelay;
+}
+
+void ReconnectBackoff::setInitialDelay(int initialDelay)
+{
+    m_initialDelay = qMax(0, initialDelay);
+}
+
+int ReconnectBackoff::maximumDelay() const
+{
+    return m_maximumDelay;
+}
+
+void ReconnectBackoff::setMaximumDelay(int maximumDelay)
+{
+    m_maximumDelay = qMax(0, maximumDelay);
+}
+
+double ReconnectBackoff::multiplier() const
+{
+    return m_multiplier;
+}
+
+void ReconnectBackoff::setMultiplier(double multiplier)
+{
+    m_multiplier = qMax(1.0, multiplier);
+}
+
+int ReconnectBackoff::attempts() const
+{
+    return m_attempts;
+}
+
+int ReconnectBackoff::currentCeiling() const
+{
+    double ceiling = m_initialDelay * qPow(m_multiplier, m_attempts);
+    if (ceiling >= m_maximumDelay)
+        return m_maximumDelay;
+
+    return static_cast<int>(ceiling);
+}
+
+int ReconnectBackoff::nextDelay()
+{
+    int ceiling = currentCeiling();
+
+    // Stop counting once the ceiling can not grow any more: capped at the maximum,
+    // or with an initial delay of 0 or a multiplier of 1 it stays where it is
+    if (ceiling < m_maximumDelay && m_initialDelay > 0 && m_multiplier > 1.0)
+        m_attempts++;
+
+    // Full jitter: anything between 0 and the ceiling
+    return static_cast<int>(m_random.bounded(static_cast<quint32>(ceiling) + 1));
+}
+
+void ReconnectBackoff::reset()
+{
+    m_attempts = 0;
+}
+
+void ReconnectBackoff::setSeed(quint32 seed)
+{
+    m_random.seed(seed);
+}
+
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef RECONNECTBACKOFF_H
+#define RECONNECTBACKOFF_H
+
+#include <QRandomGenerator>
+
+namespace remoteproxyclient {
+
+// Capped exponential backoff with full jitter. Each attempt waits a random
+// time between 0 and min(maximumDelay, initialDelay * multiplier ^ attempts),
+// so a fleet disconnected at the same moment does not reconnect in lockstep.
+class ReconnectBackoff
+{
+public:
+    ReconnectBackoff();
+    ReconnectBackoff(int initialDelay, int maximumDelay, double multiplier = 2.0);
+
+    int initialDelay() const;
+    void setInitialDelay(int initialDelay);
+
+    int maximumDelay() const;
+    void setMaximumDelay(int maximumDelay);
+
+    double multiplier() const;
+    void setMultiplier(double multiplier);
+
+    int attempts() const;
+
+    // The upper bound for the next delay in ms
+    int currentCeiling() const;
+
+    // Returns the delay for the next reconnect attempt in ms and advances the backoff
+    int nextDelay();
+
+    // Call once connected and registered successfully
+    void reset();
+
+    // Make the jitter reproducible, i.e. for tests
+    void setSeed(quint32 seed);
+
+private:
+    int m_initialDelay = 1000;
+    int m_maximumDelay = 60000;
+    double m_multiplier = 2.0;
+
+    int m_attempts = 0;
+    QRandomGenerator m_random;
+
+};
+
+}
+
+#endif // RECONNECTBACKOFF_H
@@ -30,6 +30,8 @@
 #include "tcpsocketconnection.h"
 #include "websocketconnection.h"
 #include "proxyjsonrpcclient.h"
+#include "../../common/slipdataprocessor.h"
+#include "../../common/tunnelcompression.h"
 
 Q_LOGGING_CATEGORY(dcTunnelProxyRemoteConnection, "TunnelProxyRemoteConnection")
 
@@ -40,7 +42,7 @@ TunnelProxyRemoteConnection::TunnelProxyRemoteConnection(const QUuid &clientUuid
     m_clientUuid(clientUuid),
     m_clientName(clientName)
 {
-
+    setupTimers();
 }
 
 TunnelProxyRemoteConnection::TunnelProxyRemoteConnection(const QUuid &clientUuid, const QString &clientName, ConnectionType connectionType, QObject *parent) :
@@ -49,7 +51,7 @@ TunnelProxyRemoteConnection::TunnelProxyRemoteConnection(const QUuid &clientUuid
     m_clientName(clientName),
     m_connectionType(connectionType)
 {
-
+    setupTimers();
 }
 
 TunnelProxyRemoteConnection::~TunnelProxyRemoteConnection()
@@ -107,8 +109,77 @@ QString TunnelProxyRemoteConnection::remoteProxyApiVersion() const
     return m_remoteProxyApiVersion;
 }
 
+bool TunnelProxyRemoteConnection::autoReconnect() const
+{
+    return m_autoReconnect;
+}
+
+void TunnelProxyRemoteConnection::setAutoReconnect(bool autoReconnect)
+{
+    m_autoReconnect = autoReconnect;
+    if (!m_autoReconnect) {
+        m_reconnectTimer.stop();
+    }
+}
+
+bool TunnelProxyRemoteConnection::helloEnabled() const
+{
+    return m_helloEnabled;
+}
+
+void TunnelProxyRemoteConnection::setHelloEnabled(bool helloEnabled)
+{
+    m_helloEnabled = helloEnabled;
+}
+
+ReconnectBackoff TunnelProxyRemoteConnection::reconnectBackoff() const
+{
+    return m_reconnectBackoff;
+}
+
+void TunnelProxyRemoteConnection::setReconnectBackoff(const ReconnectBackoff &reconnectBackoff)
+{
+    m_reconnectBackoff = reconnectBackoff;
+}
+
+bool TunnelProxyRemoteConnection::multiplexingEnabled() const
+{
+    return m_multiplexingEnabled;
+}
+
+void TunnelProxyRemoteConnection::setMultiplexingEnabled(bool multiplexingEnabled)
+{
+    m_multiplexingEnabled = multiplexingEnabled;
+}
+
+QList<quint16> TunnelProxyRemoteConnection::tunnelChannels() const
+{
+    return m_tunnels.keys();
+}
+
+QUuid TunnelProxyRemoteConnection::tunnelServerUuid(quint16 channel) const
+{
+    return m_tunnels.value(channel);
+}
+
+bool TunnelProxyRemoteConnection::compressionEnabled() const
+{
+    return m_compressionEnabled;
+}
+
+void TunnelProxyRemoteConnection::setCompressionEnabled(bool compressionEnabled)
+{
+    m_compressionEnabled = compressionEnabled;
+}
+
+bool TunnelProxyRemoteConnection::compressionActive() const
+{
+    return m_compressionActive;
+}
+
 bool TunnelProxyRemoteConnection::connectServer(const QUrl &url, const QUuid &serverUuid)
 {
+    m_reconnectEnabled = true;
     m_serverUrl = url;
     m_serverUuid = serverUuid;
     m_error = QAbstractSocket::UnknownSocketError;
@@ -133,6 +204,7 @@ bool TunnelProxyRemoteConnection::connectServer(const QUrl &url, const QUuid &se
     connect(m_connection, &ProxyConnection::sslErrors, this, &TunnelProxyRemoteConnection::sslErrors);
 
     m_jsonClient = new JsonRpcClient(m_connection, this);
+    connect(m_jsonClient, &JsonRpcClient::tunnelProxyTunnelClosed, this, &TunnelProxyRemoteConnection::onTunnelProxyTunnelClosed);
 
     qCDebug(dcTunnelProxyRemoteConnection()) << "Connecting to" << m_serverUrl.toString();
     m_connection->connectServer(m_serverUrl);
@@ -142,6 +214,10 @@ bool TunnelProxyRemoteConnection::connectServer(const QUrl &url, const QUuid &se
 
 void TunnelProxyRemoteConnection::disconnectServer()
 {
+    m_reconnectEnabled = false;
+    m_reconnectTimer.stop();
+    m_reconnectBackoff.reset();
+
     if (m_connection) {
         qCDebug(dcTunnelProxyRemoteConnection()) << "Disconnecting from" << m_connection->serverUrl().toString();
         m_connection->disconnectServer();
@@ -150,6 +226,18 @@ void TunnelProxyRemoteConnection::disconnectServer()
 
 bool TunnelProxyRemoteConnection::sendData(const QByteArray &data)
 {
+    if (m_multiplexingEnabled) {
+        qCWarning(dcTunnelProxyRemoteConnection()) << "Could not send data. The connection is multiplexed, please use sendTunnelData().";
+        return false;
+    }
+
+    // Data sent behind the pending registration will be forwarded by the proxy once the registration succeeded
+    if (m_state == StateRegister) {
+        qCDebug(dcTunnelProxyRemoteConnection()) << "Sending early data while the registration is pending.";
+        m_connection->sendData(data);
+        return true;
+    }
+
     if (!remoteConnected()) {
         qCWarning(dcTunnelProxyRemoteConnection()) << "Could not send data. Not connected.";
         return false;
@@ -159,14 +247,94 @@ bool TunnelProxyRemoteConnection::sendData(const QByteArray &data)
     return true;
 }
 
+bool TunnelProxyRemoteConnection::openTunnel(const QUuid &serverUuid)
+{
+    if (!m_multiplexingEnabled || !remoteConnected()) {
+        qCWarning(dcTunnelProxyRemoteConnection()) << "Could not open tunnel. The multiplexed connection is not established.";
+        return false;
+    }
+
+    if (m_tunnels.values().contains(serverUuid) || m_pendingTunnels.contains(serverUuid)) {
+        qCWarning(dcTunnelProxyRemoteConnection()) << "Could not open tunnel. There is already a tunnel to" << serverUuid.toString();
+        return false;
+    }
+
+    // Each tunnel needs its own client uuid, derive a stable one for this server
+    QUuid tunnelClientUuid = QUuid::createUuidV5(m_clientUuid, serverUuid.toString());
+    qCDebug(dcTunnelProxyRemoteConnection()) << "Opening tunnel to" << serverUuid.toString();
+    m_pendingTunnels.append(serverUuid);
+
+    JsonReply *reply = m_jsonClient->callRegisterClient(tunnelClientUuid, m_clientName, serverUuid, true, true);
+    connect(reply, &JsonReply::finished, this, [=](){
+        reply->deleteLater();
+        m_pendingTunnels.removeAll(serverUuid);
+
+        QVariantMap response = reply->response();
+        QVariantMap responseParams = response.value("params").toMap();
+        quint16 channel = static_cast<quint16>(responseParams.value("channel").toUInt());
+        if (response.value("status").toString() != "success" || responseParams.value("tunnelProxyError").toString() != "TunnelProxyErrorNoError" || channel == 0) {
+            qCWarning(dcTunnelProxyRemoteConnection()) << "Failed to open tunnel to" << serverUuid.toString() << response;
+            emit tunnelOpenFailed(serverUuid);
+            return;
+        }
+
+        qCDebug(dcTunnelProxyRemoteConnection()) << "Tunnel opened to" << serverUuid.toString() << "on channel" << channel;
+        m_tunnels.insert(channel, serverUuid);
+        emit tunnelOpened(channel, serverUuid);
+    });
+
+    return true;
+}
+
+bool TunnelProxyRemoteConnection::sendTunnelData(quint16 channel, const QByteArray &data)
+{
+    if (!m_tunnels.contains(channel)) {
+        qCWarning(dcTunnelProxyRemoteConnection()) << "Could not send data. There is no tunnel open on channel" << channel;
+        return false;
+    }
+
+    SlipDataProcessor::Frame frame;
+    frame.socketAddress = channel;
+    frame.data = m_compressionActive ? TunnelCompression::encodePayload(data) : data;
+    m_connection->sendData(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
+    return true;
+}
+
+bool TunnelProxyRemoteConnection::closeTunnel(quint16 channel)
+{
+    if (!m_tunnels.contains(channel)) {
+        qCWarning(dcTunnelProxyRemoteConnection()) << "Could not close tunnel. There is no tunnel open on channel" << channel;
+        return false;
+    }
+
+    qCDebug(dcTunnelProxyRemoteConnection()) << "Closing tunnel on channel" << channel;
+    JsonReply *reply = m_jsonClient->callCloseTunnel(channel);
+    connect(reply, &JsonReply::finished, this, [=](){
+        reply->deleteLater();
+        qCDebug(dcTunnelProxyRemoteConnection()) << "Close tunnel finished" << reply->response();
+    });
+
+    // The channel is gone right away, no more data will be sent or emitted for it
+    m_tunnels.remove(channel);
+    emit tunnelClosed(channel);
+    return true;
+}
+
 void TunnelProxyRemoteConnection::onConnectionChanged(bool connected)
 {
     if (connected) {
         qCDebug(dcTunnelProxyRemoteConnection()) << "Connected to remote proxy server.";
         setState(StateConnected);
         setState(StateInitializing);
-        JsonReply *reply = m_jsonClient->callHello();
-        connect(reply, &JsonReply::finished, this, &TunnelProxyRemoteConnection::onHelloFinished);
+        if (m_helloEnabled) {
+            JsonReply *reply = m_jsonClient->callHello();
+            connect(reply, &JsonReply::finished, this, &TunnelProxyRemoteConnection::onHelloFinished);
+        }
+
+        // Pipeline the registration, no need to wait for the hello response
+        JsonReply *registerReply = m_jsonClient->callRegisterClient(m_clientUuid, m_clientName, m_serverUuid, m_multiplexingEnabled, false, m_multiplexingEnabled && m_compressionEnabled);
+        connect(registerReply, &JsonReply::finished, this, &TunnelProxyRemoteConnection::onClientRegistrationFinished);
+        setState(StateRegister);
     } else {
         qCDebug(dcTunnelProxyRemoteConnection()) << "Disconnected from remote proxy server.";
         setState(StateDisconnected);
@@ -178,12 +346,75 @@ void TunnelProxyRemoteConnection::onConnectionDataAvailable(const QByteArray &da
 {
     if (m_state != StateRemoteConnected) {
         m_jsonClient->processData(data);
+        if (m_state != StateRemoteConnected || !m_jsonClient)
+            return;
+
+        // The remote side might have sent data right behind the registration response
+        QByteArray remainingData = m_jsonClient->takeRemainingData();
+        if (remainingData.isEmpty())
+            return;
+
+        if (m_multiplexingEnabled) {
+            processSlipData(remainingData);
+        } else {
+            emit dataReady(remainingData);
+        }
+
+        return;
+    }
+
+    if (m_multiplexingEnabled) {
+        processSlipData(data);
         return;
     }
 
     emit dataReady(data);
 }
 
+void TunnelProxyRemoteConnection::processSlipData(const QByteArray &data)
+{
+    for (int i = 0; i < data.length(); i++) {
+        quint8 byte = static_cast<quint8>(data.at(i));
+        if (byte == SlipDataProcessor::ProtocolByteEnd) {
+            // If there is no data...continue since it might be a starting END byte
+            if (m_dataBuffer.isEmpty())
+                continue;
+
+            QByteArray frameData = SlipDataProcessor::deserializeData(m_dataBuffer);
+            m_dataBuffer.clear();
+            if (frameData.isNull()) {
+                qCWarning(dcTunnelProxyRemoteConnection()) << "Received inconsistant SLIP encoded message. Ignoring data...";
+                continue;
+            }
+
+            SlipDataProcessor::Frame frame = SlipDataProcessor::parseFrame(frameData);
+            if (frame.socketAddress == SlipDataProcessor::SocketAddressJsonRpc) {
+                m_jsonClient->processData(frame.data);
+                // The notifications might have closed the connection
+                if (!m_jsonClient)
+                    return;
+
+            } else if (frame.socketAddress == SlipDataProcessor::SocketAddressControl) {
+                qCDebug(dcTunnelProxyRemoteConnection()) << "Ignoring control frame on the client connection.";
+            } else if (!m_tunnels.contains(frame.socketAddress)) {
+                qCWarning(dcTunnelProxyRemoteConnection()) << "Received data for unknown channel" << frame.socketAddress << "...ignoring the data";
+            } else if (m_compressionActive) {
+                QByteArray payload;
+                if (!TunnelCompression::decodePayload(frame.data, &payload)) {
+                    qCWarning(dcTunnelProxyRemoteConnection()) << "Received invalid compressed payload on channel" << frame.socketAddress << "...ignoring the data";
+                    continue;
+                }
+
+                emit tunnelDataReady(frame.socketAddress, payload);
+            } else {
+                emit tunnelDataReady(frame.socketAddress, frame.data);
+            }
+        } else {
+            m_dataBuffer.append(data.at(i));
+        }
+    }
+}
+
 void TunnelProxyRemoteConnection::onConnectionSocketError(QAbstractSocket::SocketError error)
 {
     setError(error);
@@ -204,6 +435,7 @@ void TunnelProxyRemoteConnection::onConnectionStateChanged(QAbstractSocket::Sock
         break;
     case QAbstractSocket::ConnectedState:
         setState(StateConnected);
+        m_reconnectTimer.stop();
         break;
     case QAbstractSocket::ClosingState:
         setState(StateDiconnecting);
@@ -233,11 +465,6 @@ void TunnelProxyRemoteConnection::onHelloFinished()
     m_remoteProxyServerName = responseParams.value("name").toString();
     m_remoteProxyServerVersion = responseParams.value("version").toString();
     m_remoteProxyApiVersion = responseParams.value("apiVersion").toString();
-
-    setState(StateRegister);
-
-    JsonReply *registerReply = m_jsonClient->callRegisterClient(m_clientUuid, m_clientName, m_serverUuid);
-    connect(registerReply, &JsonReply::finished, this, &TunnelProxyRemoteConnection::onClientRegistrationFinished);
 }
 
 void TunnelProxyRemoteConnection::onClientRegistrationFinished()
@@ -261,8 +488,52 @@ void TunnelProxyRemoteConnection::onClientRegistrationFinished()
         return;
     }
 
-    qCDebug(dcTunnelProxyRemoteConnection()) << "Registered successfully as tunnel client on the remote proxy server.";
+    quint16 channel = static_cast<quint16>(responseParams.value("channel").toUInt());
+    if (m_multiplexingEnabled && channel == 0) {
+        qCWarning(dcTunnelProxyRemoteConnection()) << "The remote proxy server does not support multiplexed connections.";
+        m_connection->disconnectServer();
+        return;
+    }
+
+    m_compressionActive = m_multiplexingEnabled && responseParams.value("compression", false).toBool();
+    qCDebug(dcTunnelProxyRemoteConnection()) << "Registered successfully as tunnel client on the remote proxy server." << (m_compressionActive ? "Compression active." : "");
+    m_reconnectBackoff.reset();
+
+    // Any data following this response belongs to the tunnel
+    m_jsonClient->interruptProcessing();
     setState(StateRemoteConnected);
+
+    if (m_multiplexingEnabled) {
+        qCDebug(dcTunnelProxyRemoteConnection()) << "Tunnel opened to" << m_serverUuid.toString() << "on channel" << channel;
+        m_tunnels.insert(channel, m_serverUuid);
+        emit tunnelOpened(channel, m_serverUuid);
+    }
+}
+
+void TunnelProxyRemoteConnection::onTunnelProxyTunnelClosed(quint16 channel)
+{
+    if (!m_tunnels.remove(channel)) {
+        qCDebug(dcTunnelProxyRemoteConnection()) << "Tunnel on channel" << channel << "closed by the server but it has already been closed.";
+        return;
+    }
+
+    qCDebug(dcTunnelProxyRemoteConnection()) << "Tunnel on channel" << channel << "closed by the server.";
+    emit tunnelClosed(channel);
+}
+
+void TunnelProxyRemoteConnection::setupTimers()
+{
+    // The interval will be set from the reconnect backoff for each attempt
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, [this](){
+        if (!m_autoReconnect || !m_reconnectEnabled)
+            return;
+
+        if (m_state == StateDisconnected) {
+            qCDebug(dcTunnelProxyRemoteConnection()) << "Trying to reconnect to the remote proxy...";
+            connectServer(m_serverUrl, m_serverUuid);
+        }
+    });
 }
 
 void TunnelProxyRemoteConnection::setState(State state)
@@ -280,6 +551,12 @@ void TunnelProxyRemoteConnection::setState(State state)
     if (remoteConnected != stillRemoteConnected) {
         emit remoteConnectedChanged(m_state == StateRemoteConnected);
     }
+
+    if (m_state == StateDisconnected && m_autoReconnect && m_reconnectEnabled) {
+        int reconnectDelay = m_reconnectBackoff.nextDelay();
+        qCDebug(dcTunnelProxyRemoteConnection()) << "Starting reconnect timer. Next attempt in" << reconnectDelay << "ms";
+        m_reconnectTimer.start(reconnectDelay);
+    }
 }
 
 
@@ -310,6 +587,14 @@ void TunnelProxyRemoteConnection::cleanUp()
     m_remoteProxyServerVersion.clear();
     m_remoteProxyApiVersion.clear();
 
+    m_pendingTunnels.clear();
+    m_dataBuffer.clear();
+    m_compressionActive = false;
+    foreach (quint16 channel, m_tunnels.keys()) {
+        m_tunnels.remove(channel);
+        emit tunnelClosed(channel);
+    }
+
     setState(StateDisconnected);
 }
 
@@ -29,12 +29,16 @@
 #define TUNNELPROXYREMOTECONNECTION_H
 
 #include <QUrl>
+#include <QHash>
 #include <QUuid>
+#include <QTimer>
 #include <QObject>
 #include <QSslError>
 #include <QAbstractSocket>
 #include <QLoggingCategory>
 
+#include "reconnectbackoff.h"
+
 Q_DECLARE_LOGGING_CATEGORY(dcTunnelProxyRemoteConnection)
 
 namespace remoteproxyclient {
@@ -85,11 +89,43 @@ public:
     QString remoteProxyServerVersion() const;
     QString remoteProxyApiVersion() const;
 
+    // If enabled, the connection will be reestablished using the reconnect backoff
+    // until disconnectServer() gets called. Disabled by default.
+    bool autoReconnect() const;
+    void setAutoReconnect(bool autoReconnect);
+
+    // The Hello request only fetches the proxy server information and gets pipelined
+    // with the registration. If disabled, the registration gets sent right away. Enabled by default.
+    bool helloEnabled() const;
+    void setHelloEnabled(bool helloEnabled);
+
+    ReconnectBackoff reconnectBackoff() const;
+    void setReconnectBackoff(const ReconnectBackoff &reconnectBackoff);
+
+    // Multiplexing carries multiple tunnels over this connection using SLIP frames. The tunnel to the
+    // server given in connectServer() becomes the first channel, further tunnels can be opened using
+    // openTunnel(). The tunnel data is exchanged using the channel methods only. Disabled by default.
+    bool multiplexingEnabled() const;
+    void setMultiplexingEnabled(bool multiplexingEnabled);
+
+    QList<quint16> tunnelChannels() const;
+    QUuid tunnelServerUuid(quint16 channel) const;
+
+    // Requests compressed tunnel data frames for the multiplexed connection. The compression
+    // is active only if the proxy server accepted it. Disabled by default.
+    bool compressionEnabled() const;
+    void setCompressionEnabled(bool compressionEnabled);
+    bool compressionActive() const;
+
 public slots:
     bool connectServer(const QUrl &url, const QUuid &serverUuid);
     void disconnectServer();
     bool sendData(const QByteArray &data);
 
+    bool openTunnel(const QUuid &serverUuid);
+    bool sendTunnelData(quint16 channel, const QByteArray &data);
+    bool closeTunnel(quint16 channel);
+
 signals:
     void stateChanged(TunnelProxyRemoteConnection::State state);
     void errorOccurred(QAbstractSocket::SocketError error);
@@ -99,6 +135,11 @@ signals:
 
     void dataReady(const QByteArray &data);
 
+    void tunnelOpened(quint16 channel, const QUuid &serverUuid);
+    void tunnelOpenFailed(const QUuid &serverUuid);
+    void tunnelClosed(quint16 channel);
+    void tunnelDataReady(quint16 channel, const QByteArray &data);
+
 private slots:
     void onConnectionChanged(bool connected);
     void onConnectionDataAvailable(const QByteArray &data);
@@ -110,6 +151,9 @@ private slots:
     void onHelloFinished();
     void onClientRegistrationFinished();
 
+    // Multiplexing notifications
+    void onTunnelProxyTunnelClosed(quint16 channel);
+
 private:
     // This server information
     QUuid m_clientUuid;
@@ -131,6 +175,21 @@ private:
     ProxyConnection *m_connection = nullptr;
     JsonRpcClient *m_jsonClient = nullptr;
 
+    bool m_helloEnabled = true;
+    bool m_multiplexingEnabled = false;
+    bool m_compressionEnabled = false;
+    bool m_compressionActive = false;
+    QHash<quint16, QUuid> m_tunnels; // channel, server uuid
+    QList<QUuid> m_pendingTunnels;
+    QByteArray m_dataBuffer;
+    bool m_autoReconnect = false;
+    bool m_reconnectEnabled = false;
+    QTimer m_reconnectTimer;
+    ReconnectBackoff m_reconnectBackoff;
+
+    void processSlipData(const QByteArray &data);
+    void setupTimers();
+
     void setState(State state);
     void setRemoteConnected(bool remoteConnected);
     void setError(QAbstractSocket::SocketError error);
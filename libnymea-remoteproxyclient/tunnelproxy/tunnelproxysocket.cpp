@@ -29,17 +29,19 @@
 #include "proxyconnection.h"
 #include "tunnelproxysocketserver.h"
 #include "../common/slipdataprocessor.h"
+#include "../common/tunnelcompression.h"
 
 namespace remoteproxyclient {
 
-TunnelProxySocket::TunnelProxySocket(ProxyConnection *connection, TunnelProxySocketServer *socketServer, const QString &clientName, const QUuid &clientUuid, const QHostAddress &clientPeerAddress, quint16 socketAddress, QObject *parent) :
+TunnelProxySocket::TunnelProxySocket(ProxyConnection *connection, TunnelProxySocketServer *socketServer, const QString &clientName, const QUuid &clientUuid, const QHostAddress &clientPeerAddress, quint16 socketAddress, const QUuid &serverUuid, QObject *parent) :
     QObject(parent),
     m_connection(connection),
     m_socketServer(socketServer),
     m_clientName(clientName),
     m_clientUuid(clientUuid),
     m_clientPeerAddress(clientPeerAddress),
-    m_socketAddress(socketAddress)
+    m_socketAddress(socketAddress),
+    m_serverUuid(serverUuid)
 {
 
 }
@@ -64,6 +66,11 @@ quint16 TunnelProxySocket::socketAddress() const
     return m_socketAddress;
 }
 
+QUuid TunnelProxySocket::serverUuid() const
+{
+    return m_serverUuid;
+}
+
 bool TunnelProxySocket::connected() const
 {
     return m_connected;
@@ -73,7 +80,7 @@ void TunnelProxySocket::writeData(const QByteArray &data)
 {
     SlipDataProcessor::Frame frame;
     frame.socketAddress = m_socketAddress;
-    frame.data = data;
+    frame.data = m_socketServer->compressionActive() ? TunnelCompression::encodePayload(data) : data;
     m_connection->sendData(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
 }
 
@@ -96,7 +103,8 @@ QDebug operator<<(QDebug debug, TunnelProxySocket *tunnelProxySocket)
     debug.nospace() << tunnelProxySocket->clientName() << ", ";
     debug.nospace() << tunnelProxySocket->clientUuid().toString() << ", ";
     debug.nospace() << tunnelProxySocket->clientPeerAddress().toString() << ", ";
-    debug.nospace() << tunnelProxySocket->socketAddress() << ")";
+    debug.nospace() << tunnelProxySocket->socketAddress() << ", ";
+    debug.nospace() << tunnelProxySocket->serverUuid().toString() << ")";
     return debug;
 }
 
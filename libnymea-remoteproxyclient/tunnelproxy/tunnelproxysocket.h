@@ -48,6 +48,9 @@ public:
     QHostAddress clientPeerAddress() const;
     quint16 socketAddress() const;
 
+    // The registered server this client connected to
+    QUuid serverUuid() const;
+
     bool connected() const;
 
     void writeData(const QByteArray &data);
@@ -61,7 +64,7 @@ signals:
     void disconnected();
 
 private:
-    explicit TunnelProxySocket(ProxyConnection *connection, TunnelProxySocketServer *socketServer, const QString &clientName, const QUuid &clientUuid, const QHostAddress &clientPeerAddress, quint16 socketAddress, QObject *parent = nullptr);
+    explicit TunnelProxySocket(ProxyConnection *connection, TunnelProxySocketServer *socketServer, const QString &clientName, const QUuid &clientUuid, const QHostAddress &clientPeerAddress, quint16 socketAddress, const QUuid &serverUuid, QObject *parent = nullptr);
     ~TunnelProxySocket() = default;
 
     ProxyConnection *m_connection = nullptr;
@@ -72,6 +75,7 @@ private:
     QUuid m_clientUuid;
     QHostAddress m_clientPeerAddress;
     quint16 m_socketAddress = 0xFFFF;
+    QUuid m_serverUuid;
 
     void setDisconnected();
 
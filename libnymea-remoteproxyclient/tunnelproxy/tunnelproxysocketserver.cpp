@@ -31,6 +31,7 @@
 #include "websocketconnection.h"
 #include "proxyjsonrpcclient.h"
 #include "../../common/slipdataprocessor.h"
+#include "../../common/tunnelcompression.h"
 
 Q_LOGGING_CATEGORY(dcTunnelProxySocketServer, "TunnelProxySocketServer")
 Q_LOGGING_CATEGORY(dcTunnelProxySocketServerTraffic, "TunnelProxySocketServerTraffic")
@@ -114,6 +115,74 @@ QString TunnelProxySocketServer::remoteProxyApiVersion() const
     return m_remoteProxyApiVersion;
 }
 
+bool TunnelProxySocketServer::helloEnabled() const
+{
+    return m_helloEnabled;
+}
+
+void TunnelProxySocketServer::setHelloEnabled(bool helloEnabled)
+{
+    m_helloEnabled = helloEnabled;
+}
+
+bool TunnelProxySocketServer::controlFramesSupported() const
+{
+    return m_controlFramesSupported;
+}
+
+int TunnelProxySocketServer::roundTripTime() const
+{
+    return m_roundTripTime;
+}
+
+void TunnelProxySocketServer::addServer(const QUuid &serverUuid, const QString &serverName)
+{
+    if (serverUuid == m_serverUuid || m_additionalServers.contains(serverUuid)) {
+        qCWarning(dcTunnelProxySocketServer()) << "The server" << serverUuid.toString() << "has already been added.";
+        return;
+    }
+
+    m_additionalServers.insert(serverUuid, serverName);
+
+    // Already running, register right away. Otherwise it will be registered once the primary server is up.
+    if (m_state == StateRunning) {
+        registerAdditionalServer(serverUuid, serverName);
+    }
+}
+
+QList<QUuid> TunnelProxySocketServer::serverUuids() const
+{
+    QList<QUuid> serverUuids;
+    serverUuids.append(m_serverUuid);
+    serverUuids.append(m_additionalServers.keys());
+    return serverUuids;
+}
+
+bool TunnelProxySocketServer::compressionEnabled() const
+{
+    return m_compressionEnabled;
+}
+
+void TunnelProxySocketServer::setCompressionEnabled(bool compressionEnabled)
+{
+    m_compressionEnabled = compressionEnabled;
+}
+
+bool TunnelProxySocketServer::compressionActive() const
+{
+    return m_compressionActive;
+}
+
+ReconnectBackoff TunnelProxySocketServer::reconnectBackoff() const
+{
+    return m_reconnectBackoff;
+}
+
+void TunnelProxySocketServer::setReconnectBackoff(const ReconnectBackoff &reconnectBackoff)
+{
+    m_reconnectBackoff = reconnectBackoff;
+}
+
 bool TunnelProxySocketServer::startServer(const QUrl &serverUrl)
 {
     if (!serverUrl.isValid() || serverUrl.isEmpty()) {
@@ -146,6 +215,7 @@ bool TunnelProxySocketServer::startServer(const QUrl &serverUrl)
     m_jsonClient = new JsonRpcClient(m_connection, this);
     connect(m_jsonClient, &JsonRpcClient::tunnelProxyClientConnected, this, &TunnelProxySocketServer::onTunnelProxyClientConnected);
     connect(m_jsonClient, &JsonRpcClient::tunnelProxyClientDisonnected, this, &TunnelProxySocketServer::onTunnelProxyClientDisconnected);
+    connect(m_jsonClient, &JsonRpcClient::tunnelProxyReconnectRequested, this, &TunnelProxySocketServer::onTunnelProxyReconnectRequested);
 
     qCDebug(dcTunnelProxySocketServer()) << "Connecting to" << m_serverUrl.toString();
     m_connection->connectServer(m_serverUrl);
@@ -158,6 +228,7 @@ void TunnelProxySocketServer::stopServer()
 {
     m_enabled = false;
     m_reconnectTimer.stop();
+    m_reconnectBackoff.reset();
 
     qCDebug(dcTunnelProxySocketServer()) << "Stopping the server.";
 
@@ -175,8 +246,15 @@ void TunnelProxySocketServer::onConnectionChanged(bool connected)
         m_serverError = TunnelProxySocketServer::ErrorNoError;
 
         setState(StateInitializing);
-        JsonReply *reply = m_jsonClient->callHello();
-        connect(reply, &JsonReply::finished, this, &TunnelProxySocketServer::onHelloFinished);
+        if (m_helloEnabled) {
+            JsonReply *reply = m_jsonClient->callHello();
+            connect(reply, &JsonReply::finished, this, &TunnelProxySocketServer::onHelloFinished);
+        }
+
+        // Pipeline the registration, no need to wait for the hello response
+        JsonReply *registerReply = m_jsonClient->callRegisterServer(m_serverUuid, m_serverName, false, m_compressionEnabled);
+        connect(registerReply, &JsonReply::finished, this, &TunnelProxySocketServer::onServerRegistrationFinished);
+        setState(StateRegister);
     } else {
         qCDebug(dcTunnelProxySocketServer()) << "Disconnected from remote proxy server.";
         setState(StateDisconnected);
@@ -195,9 +273,22 @@ void TunnelProxySocketServer::onConnectionDataAvailable(const QByteArray &data)
     if (m_state != StateRunning) {
         m_jsonClient->processData(data);
         m_dataBuffer.clear();
+        if (m_state != StateRunning || !m_jsonClient)
+            return;
+
+        // The registration response might be followed by SLIP frames within the same data
+        QByteArray remainingData = m_jsonClient->takeRemainingData();
+        if (!remainingData.isEmpty())
+            processSlipData(remainingData);
+
         return;
     }
 
+    processSlipData(data);
+}
+
+void TunnelProxySocketServer::processSlipData(const QByteArray &data)
+{
     // Parse SLIP frame
     for (int i = 0; i < data.length(); i++) {
         quint8 byte = static_cast<quint8>(data.at(i));
@@ -212,15 +303,20 @@ void TunnelProxySocketServer::onConnectionDataAvailable(const QByteArray &data)
             } else {
                 SlipDataProcessor::Frame frame = SlipDataProcessor::parseFrame(frameData);
                 qCDebug(dcTunnelProxySocketServerTraffic()) << "Frame received" << frame.socketAddress << qUtf8Printable(frame.data);
-                if (frame.socketAddress == 0x0000) {
+                if (frame.socketAddress == SlipDataProcessor::SocketAddressJsonRpc) {
                     m_jsonClient->processData(frame.data);
+                } else if (frame.socketAddress == SlipDataProcessor::SocketAddressControl) {
+                    processControlFrame(frame.data);
                 } else {
                     // Find the socket and emit the data received signal
                     TunnelProxySocket *tunnlProxySocket = m_tunnelProxySockets.value(frame.socketAddress);
+                    QByteArray payload = frame.data;
                     if (!tunnlProxySocket) {
                         qCWarning(dcTunnelProxySocketServer()) << "Received data from unknown tunnel proxy client with address" << frame.socketAddress << "...ignoring the data";
+                    } else if (m_compressionActive && !TunnelCompression::decodePayload(frame.data, &payload)) {
+                        qCWarning(dcTunnelProxySocketServer()) << "Received invalid compressed payload from tunnel proxy client with address" << frame.socketAddress << "...ignoring the data";
                     } else {
-                        emit tunnlProxySocket->dataReceived(frame.data);
+                        emit tunnlProxySocket->dataReceived(payload);
                     }
                 }
             }
@@ -232,6 +328,29 @@ void TunnelProxySocketServer::onConnectionDataAvailable(const QByteArray &data)
     }
 }
 
+void TunnelProxySocketServer::processControlFrame(const QByteArray &data)
+{
+    SlipDataProcessor::ControlOpcode opcode;
+    quint64 timestamp = 0;
+    if (!SlipDataProcessor::parseControlFrame(data, &opcode, &timestamp)) {
+        qCWarning(dcTunnelProxySocketServer()) << "Received invalid control frame...ignoring the data";
+        return;
+    }
+
+    m_controlFramesSupported = true;
+
+    switch (opcode) {
+    case SlipDataProcessor::ControlOpcodePing:
+        qCDebug(dcTunnelProxySocketServerTraffic()) << "Control ping received from the proxy server";
+        m_connection->sendData(SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePong, timestamp));
+        break;
+    case SlipDataProcessor::ControlOpcodePong:
+        m_roundTripTime = static_cast<int>(QDateTime::currentMSecsSinceEpoch() - static_cast<qint64>(timestamp));
+        qCDebug(dcTunnelProxySocketServer()) << "Control pong received. RTT:" << m_roundTripTime << "ms";
+        break;
+    }
+}
+
 void TunnelProxySocketServer::onConnectionSocketError(QAbstractSocket::SocketError error)
 {
     setError(error);
@@ -284,11 +403,6 @@ void TunnelProxySocketServer::onHelloFinished()
     m_remoteProxyServerName = responseParams.value("name").toString();
     m_remoteProxyServerVersion = responseParams.value("version").toString();
     m_remoteProxyApiVersion = responseParams.value("apiVersion").toString();
-
-    setState(StateRegister);
-
-    JsonReply *registerReply = m_jsonClient->callRegisterServer(m_serverUuid, m_serverName);
-    connect(registerReply, &JsonReply::finished, this, &TunnelProxySocketServer::onServerRegistrationFinished);
 }
 
 void TunnelProxySocketServer::onServerRegistrationFinished()
@@ -314,14 +428,25 @@ void TunnelProxySocketServer::onServerRegistrationFinished()
         return;
     }
 
-    qCDebug(dcTunnelProxySocketServer()) << "Registered successfully as tunnel server on the remote proxy server.";
+    m_compressionActive = responseParams.value("compression", false).toBool();
+    qCDebug(dcTunnelProxySocketServer()) << "Registered successfully as tunnel server on the remote proxy server." << (m_compressionActive ? "Compression active." : "");
+    m_reconnectBackoff.reset();
+
+    // From now on the data is SLIP encoded
+    m_jsonClient->interruptProcessing();
     setState(StateRunning);
     m_serverError = ErrorNoError;
+
+    foreach (const QUuid &serverUuid, m_additionalServers.keys()) {
+        registerAdditionalServer(serverUuid, m_additionalServers.value(serverUuid));
+    }
 }
 
-void TunnelProxySocketServer::onTunnelProxyClientConnected(const QString &clientName, const QUuid &clientUuid, const QString &clientPeerAddress, quint16 socketAddress)
+void TunnelProxySocketServer::onTunnelProxyClientConnected(const QString &clientName, const QUuid &clientUuid, const QString &clientPeerAddress, quint16 socketAddress, const QUuid &serverUuid)
 {
-    TunnelProxySocket *tunnelProxySocket = new TunnelProxySocket(m_connection, this, clientName, clientUuid, QHostAddress(clientPeerAddress), socketAddress, this);
+    // Proxy servers not knowing about multiple registrations do not send the server uuid
+    QUuid connectedServerUuid = serverUuid.isNull() ? m_serverUuid : serverUuid;
+    TunnelProxySocket *tunnelProxySocket = new TunnelProxySocket(m_connection, this, clientName, clientUuid, QHostAddress(clientPeerAddress), socketAddress, connectedServerUuid, this);
     qCDebug(dcTunnelProxySocketServer()) << "--> New client connected" << tunnelProxySocket;
     m_tunnelProxySockets.insert(socketAddress, tunnelProxySocket);
     emit clientConnected(tunnelProxySocket);
@@ -339,6 +464,37 @@ void TunnelProxySocketServer::onTunnelProxyClientDisconnected(quint16 socketAddr
     tunnelProxySocket->setDisconnected();
     emit clientDisconnected(tunnelProxySocket);
     tunnelProxySocket->deleteLater();
+
+    if (m_reconnectRequested) {
+        reconnectIfIdle();
+    }
+}
+
+void TunnelProxySocketServer::onTunnelProxyReconnectRequested(const QString &reason)
+{
+    qCDebug(dcTunnelProxySocketServer()) << "The remote proxy server requested a reconnect:" << reason;
+    m_reconnectRequested = true;
+    reconnectIfIdle();
+}
+
+void TunnelProxySocketServer::registerAdditionalServer(const QUuid &serverUuid, const QString &serverName)
+{
+    qCDebug(dcTunnelProxySocketServer()) << "Registering additional server" << serverName << serverUuid.toString();
+
+    // The connection is SLIP encoded already, the registration goes through the JSON RPC frames
+    JsonReply *reply = m_jsonClient->callRegisterServer(serverUuid, serverName, true);
+    connect(reply, &JsonReply::finished, this, [=](){
+        reply->deleteLater();
+
+        QVariantMap response = reply->response();
+        QString tunnelProxyError = response.value("params").toMap().value("tunnelProxyError").toString();
+        if (response.value("status").toString() != "success" || tunnelProxyError != "TunnelProxyErrorNoError") {
+            qCWarning(dcTunnelProxySocketServer()) << "Failed to register additional server" << serverName << serverUuid.toString() << response;
+            return;
+        }
+
+        qCDebug(dcTunnelProxySocketServer()) << "Registered successfully additional server" << serverName << serverUuid.toString();
+    });
 }
 
 void TunnelProxySocketServer::requestSocketDisconnect(quint16 socketAddress)
@@ -354,14 +510,23 @@ void TunnelProxySocketServer::requestSocketDisconnect(quint16 socketAddress)
     });
 }
 
+void TunnelProxySocketServer::reconnectIfIdle()
+{
+    // Keep the connected clients alive, we reconnect once the last one is gone
+    if (m_state != StateRunning || !m_tunnelProxySockets.isEmpty())
+        return;
+
+    qCDebug(dcTunnelProxySocketServer()) << "No clients connected any more. Reconnecting as requested by the remote proxy server.";
+    m_connection->disconnectServer();
+}
+
 void TunnelProxySocketServer::setupTimers()
 {
-    m_reconnectTimer.setInterval(5000);
-    m_reconnectTimer.setSingleShot(false);
+    // The interval will be set from the reconnect backoff for each attempt
+    m_reconnectTimer.setSingleShot(true);
     connect(&m_reconnectTimer, &QTimer::timeout, this, [this](){
         if (!m_enabled) {
             qCDebug(dcTunnelProxySocketServer()) << "Stopping reconnect timer. The server has been disabled.";
-            m_reconnectTimer.stop();
             return;
         }
 
@@ -375,6 +540,11 @@ void TunnelProxySocketServer::setupTimers()
     m_keepAliveTimer.setSingleShot(false);
     connect(&m_keepAliveTimer, &QTimer::timeout, this, [this](){
         if (m_state == StateRunning) {
+            // Probe with a control frame, once the proxy answered no JSON Ping is needed any more
+            m_connection->sendData(SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePing, QDateTime::currentMSecsSinceEpoch()));
+            if (m_controlFramesSupported)
+                return;
+
             qCDebug(dcTunnelProxySocketServer()) << "Ping the proxy server to keep the connection alive";
             quint64 requestTimestamp = QDateTime::currentMSecsSinceEpoch();
             JsonReply *reply = m_jsonClient->callPing(QDateTime::currentMSecsSinceEpoch() / 1000);
@@ -402,8 +572,9 @@ void TunnelProxySocketServer::setState(State state)
     setRunning(m_state == StateRunning);
 
     if (m_state == StateDisconnected && m_enabled) {
-        qCDebug(dcTunnelProxySocketServer()) << "Starting reconnect timer...";
-        m_reconnectTimer.start();
+        int reconnectDelay = m_reconnectBackoff.nextDelay();
+        qCDebug(dcTunnelProxySocketServer()) << "Starting reconnect timer. Next attempt in" << reconnectDelay << "ms";
+        m_reconnectTimer.start(reconnectDelay);
         m_keepAliveTimer.stop();
     }
 }
@@ -465,6 +636,10 @@ void TunnelProxySocketServer::cleanUp()
     m_remoteProxyServerName.clear();
     m_remoteProxyServerVersion.clear();
     m_remoteProxyApiVersion.clear();
+    m_reconnectRequested = false;
+    m_controlFramesSupported = false;
+    m_compressionActive = false;
+    m_roundTripTime = -1;
 
     setState(StateDisconnected);
 }
@@ -36,6 +36,7 @@
 #include <QLoggingCategory>
 
 #include "tunnelproxysocket.h"
+#include "reconnectbackoff.h"
 
 Q_DECLARE_LOGGING_CATEGORY(dcTunnelProxySocketServer)
 Q_DECLARE_LOGGING_CATEGORY(dcTunnelProxySocketServerTraffic)
@@ -100,6 +101,30 @@ public:
     QString remoteProxyServerVersion() const;
     QString remoteProxyApiVersion() const;
 
+    // The Hello request only fetches the proxy server information and gets pipelined
+    // with the registration. If disabled, the registration gets sent right away. Enabled by default.
+    bool helloEnabled() const;
+    void setHelloEnabled(bool helloEnabled);
+
+    ReconnectBackoff reconnectBackoff() const;
+    void setReconnectBackoff(const ReconnectBackoff &reconnectBackoff);
+
+    // Keepalive control frames are used once the proxy server has been seen supporting them,
+    // otherwise the keepalive falls back to the JSON Ping.
+    bool controlFramesSupported() const;
+    int roundTripTime() const;
+
+    // Requests compressed tunnel data frames during the registration. The compression
+    // is active only if the proxy server accepted it. Disabled by default.
+    bool compressionEnabled() const;
+    void setCompressionEnabled(bool compressionEnabled);
+    bool compressionActive() const;
+
+    // Gateways can register additional servers on the same connection. They get registered
+    // once the primary server is running and share the connection and the keepalive.
+    void addServer(const QUuid &serverUuid, const QString &serverName);
+    QList<QUuid> serverUuids() const;
+
 public slots:
     bool startServer(const QUrl &serverUrl);
     void stopServer();
@@ -127,14 +152,16 @@ private slots:
     void onServerRegistrationFinished();
 
     // Client notifications
-    void onTunnelProxyClientConnected(const QString &clientName, const QUuid &clientUuid, const QString &clientPeerAddress, quint16 socketAddress);
+    void onTunnelProxyClientConnected(const QString &clientName, const QUuid &clientUuid, const QString &clientPeerAddress, quint16 socketAddress, const QUuid &serverUuid);
     void onTunnelProxyClientDisconnected(quint16 socketAddress);
+    void onTunnelProxyReconnectRequested(const QString &reason);
 
 private:
     // This server information
     QUuid m_serverUuid;
     QString m_serverName;
     ConnectionType m_connectionType = ConnectionTypeTcpSocket;
+    QHash<QUuid, QString> m_additionalServers;
 
     // Remote proxy server information
     QString m_remoteProxyServer;
@@ -149,8 +176,15 @@ private:
     State m_state = StateDisconnected;
 
     QTimer m_reconnectTimer;
+    ReconnectBackoff m_reconnectBackoff;
     QTimer m_keepAliveTimer;
     bool m_enabled = false;
+    bool m_helloEnabled = true;
+    bool m_controlFramesSupported = false;
+    bool m_compressionEnabled = false;
+    bool m_compressionActive = false;
+    int m_roundTripTime = -1;
+    bool m_reconnectRequested = false;
 
     ProxyConnection *m_connection = nullptr;
     JsonRpcClient *m_jsonClient = nullptr;
@@ -159,7 +193,11 @@ private:
 
     QByteArray m_dataBuffer;
 
+    void registerAdditionalServer(const QUuid &serverUuid, const QString &serverName);
+    void processSlipData(const QByteArray &data);
+    void processControlFrame(const QByteArray &data);
     void requestSocketDisconnect(quint16 socketAddress);
+    void reconnectIfIdle();
     void setupTimers();
 
     void setState(State state);
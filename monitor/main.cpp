@@ -67,8 +67,52 @@ int main(int argc, char *argv[])
     QCommandLineOption jsonOption(QStringList() << "j" << "json", "Connect to the server and print the raw json data.");
     parser.addOption(jsonOption);
 
+    QCommandLineOption drainOption(QStringList() << "d" << "drain", "Drain the server: stop accepting new registrations and ask the registered servers "
+                                                                    "to reconnect, spread over the given window in milliseconds. A negative window uses the server configuration.", "window");
+    parser.addOption(drainOption);
+
+    QCommandLineOption memoryOption(QStringList() << "m" << "memory", "Print the memory report of the server: the process memory, the memory per connection and the slab allocator usage of the per-connection objects.");
+    parser.addOption(memoryOption);
+
+    QCommandLineOption uuidOption(QStringList() << "uuid", "Show only the servers with a uuid starting with the given prefix. Only available with the non-interactive mode.", "uuid");
+    parser.addOption(uuidOption);
+
+    QCommandLineOption nameOption(QStringList() << "name", "Show only the servers with a name starting with the given prefix (case insensitive). Only available with the non-interactive mode.", "name");
+    parser.addOption(nameOption);
+
+    QCommandLineOption addressOption(QStringList() << "address", "Show only the servers connected from the given address or CIDR subnet, i.e. 10.0.0.0/8. Only available with the non-interactive mode.", "address");
+    parser.addOption(addressOption);
+
+    QCommandLineOption sortOption(QStringList() << "sort", "Sort the servers descending by \"rxDataCount\", \"txDataCount\" or \"throughput\". Only available with the non-interactive mode.", "sort");
+    parser.addOption(sortOption);
+
+    QCommandLineOption offsetOption(QStringList() << "offset", "Skip the given number of servers. Only available with the non-interactive mode.", "offset");
+    parser.addOption(offsetOption);
+
+    QCommandLineOption limitOption(QStringList() << "limit", "Show at most the given number of servers. Only available with the non-interactive mode.", "limit");
+    parser.addOption(limitOption);
+
     parser.process(application);
 
+    QVariantMap query;
+    if (parser.isSet(uuidOption))
+        query.insert("uuid", parser.value(uuidOption));
+
+    if (parser.isSet(nameOption))
+        query.insert("name", parser.value(nameOption));
+
+    if (parser.isSet(addressOption))
+        query.insert("address", parser.value(addressOption));
+
+    if (parser.isSet(sortOption))
+        query.insert("sortBy", parser.value(sortOption));
+
+    if (parser.isSet(offsetOption))
+        query.insert("offset", parser.value(offsetOption).toInt());
+
+    if (parser.isSet(limitOption))
+        query.insert("limit", parser.value(limitOption).toInt());
+
     // Check socket file
     QFileInfo fileInfo(parser.value(socketOption));
     if (!fileInfo.exists()) {
@@ -81,15 +125,33 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    if (parser.isSet(noninteractiveOption) || parser.isSet(jsonOption)) {
+    if (parser.isSet(memoryOption)) {
+        NonInteractiveMonitor *monitor = new NonInteractiveMonitor(parser.value(socketOption), parser.isSet(jsonOption), false, &application);
+        monitor->requestMemoryReport();
+    } else if (parser.isSet(drainOption)) {
+        bool windowValueOk = false;
+        int window = parser.value(drainOption).toInt(&windowValueOk);
+        if (!windowValueOk) {
+            qWarning() << "Error: Invalid drain window" << parser.value(drainOption);
+            exit(EXIT_FAILURE);
+        }
+
         NonInteractiveMonitor *monitor = new NonInteractiveMonitor(parser.value(socketOption), parser.isSet(jsonOption), parser.isSet(allOption), &application);
-        Q_UNUSED(monitor);
+        monitor->requestDrain(window);
+    } else if (parser.isSet(noninteractiveOption) || parser.isSet(jsonOption)) {
+        NonInteractiveMonitor *monitor = new NonInteractiveMonitor(parser.value(socketOption), parser.isSet(jsonOption), parser.isSet(allOption), &application);
+        monitor->setQuery(query);
     } else {
         if (parser.isSet(allOption)) {
             qWarning() << "Error: The \"all\" option is only available with the non-interavtice mode.";
             exit(EXIT_FAILURE);
         }
 
+        if (!query.isEmpty()) {
+            qWarning() << "Error: The server filter options are only available with the non-interactive mode.";
+            exit(EXIT_FAILURE);
+        }
+
         Monitor *monitor = new Monitor(parser.value(socketOption), parser.isSet(jsonOption), &application);
         Q_UNUSED(monitor);
     }
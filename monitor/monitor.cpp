@@ -33,10 +33,6 @@ Monitor::Monitor(const QString &serverName, bool jsonMode, QObject *parent) :
     connect(m_monitorClient, &MonitorClient::connected, this, &Monitor::onConnected);
     connect(m_monitorClient, &MonitorClient::disconnected, this, &Monitor::onDisconnected);
 
-    m_timer.setInterval(1000);
-    m_timer.setSingleShot(false);
-    connect(&m_timer, &QTimer::timeout, m_monitorClient, &MonitorClient::refresh);
-
     m_monitorClient->connectMonitor();
 }
 
@@ -45,16 +41,16 @@ void Monitor::onConnected()
     if (!m_jsonMode) {
         m_terminal = new TerminalWindow(this);
         connect(m_monitorClient, &MonitorClient::dataReady, m_terminal, &TerminalWindow::refreshWindow);
+        connect(m_terminal, &TerminalWindow::queryChanged, m_monitorClient, &MonitorClient::subscribe);
     }
 
-    refresh();
-    m_timer.start();
+    // The server pushes a snapshot followed by the changes in its update interval. The terminal
+    // shows one page of servers, so it subscribes to that page instead of fetching all servers.
+    m_monitorClient->subscribe(m_terminal ? m_terminal->currentQuery() : QVariantMap());
 }
 
 void Monitor::onDisconnected()
 {
-    m_timer.stop();
-
     if (!m_terminal)
         return;
 
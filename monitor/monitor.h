@@ -26,7 +26,6 @@
 #define MONITOR_H
 
 #include <QObject>
-#include <QTimer>
 
 #include "monitorclient.h"
 #include "terminalwindow.h"
@@ -41,7 +40,6 @@ private:
     TerminalWindow *m_terminal = nullptr;
     MonitorClient *m_monitorClient = nullptr;
     bool m_jsonMode = false;
-    QTimer m_timer;
 
 private slots:
     void onConnected();
@@ -25,6 +25,7 @@
 #include "monitorclient.h"
 #include "utils.h"
 
+#include <QHash>
 #include <QJsonDocument>
 
 MonitorClient::MonitorClient(const QString &serverName, bool jsonMode, QObject *parent) :
@@ -50,10 +51,10 @@ void MonitorClient::setPrintAll(bool printAll)
     m_printAll = printAll;
 }
 
-void MonitorClient::processBufferData()
+void MonitorClient::processMessage(const QByteArray &message)
 {
     QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(m_dataBuffer, &error);
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(message, &error);
     if(error.error != QJsonParseError::NoError) {
         qWarning() << "Failed to parse JSON data:" << error.errorString();
         return;
@@ -67,7 +68,118 @@ void MonitorClient::processBufferData()
     }
 
     QVariantMap dataMap = jsonDoc.toVariant().toMap();
-    emit dataReady(dataMap);
+    if (dataMap.value("type").toString() == "snapshot") {
+        processSnapshot(dataMap);
+        emit dataReady(buildSubscriptionData());
+    } else if (dataMap.value("type").toString() == "delta") {
+        processDelta(dataMap);
+        emit dataReady(buildSubscriptionData());
+    } else {
+        emit dataReady(dataMap);
+    }
+}
+
+void MonitorClient::processSnapshot(const QVariantMap &dataMap)
+{
+    m_servers.clear();
+    m_clients.clear();
+    m_serverOrder.clear();
+
+    QVariantMap tunnelProxyMap = dataMap.value("tunnelProxyStatistic").toMap();
+    foreach (const QVariant &serverVariant, tunnelProxyMap.value("tunnelConnections").toList()) {
+        QVariantMap serverMap = serverVariant.toMap();
+        foreach (const QVariant &clientVariant, serverMap.take("clientConnections").toList()) {
+            QVariantMap clientMap = clientVariant.toMap();
+            clientMap.insert("serverUuid", serverMap.value("serverUuid"));
+            m_clients.insert(QUuid(clientMap.value("clientUuid").toString()), clientMap);
+        }
+
+        m_servers.insert(QUuid(serverMap.value("serverUuid").toString()), serverMap);
+        m_serverOrder.append(QUuid(serverMap.value("serverUuid").toString()));
+    }
+
+    tunnelProxyMap.remove("tunnelConnections");
+    m_subscriptionData = dataMap;
+    m_subscriptionData.insert("tunnelProxyStatistic", tunnelProxyMap);
+}
+
+void MonitorClient::processDelta(const QVariantMap &dataMap)
+{
+    QStringList tunnelKeys;
+    tunnelKeys << "serversRemoved" << "clientsRemoved" << "serversAdded" << "clientsAdded" << "serverCounters" << "clientCounters";
+    foreach (const QString &key, dataMap.keys()) {
+        if (!tunnelKeys.contains(key)) {
+            m_subscriptionData.insert(key, dataMap.value(key));
+        }
+    }
+
+    // Removals first, a tunnel can be removed and added again within one update
+    foreach (const QVariant &serverUuid, dataMap.value("serversRemoved").toList())
+        m_servers.remove(QUuid(serverUuid.toString()));
+
+    foreach (const QVariant &clientUuid, dataMap.value("clientsRemoved").toList())
+        m_clients.remove(QUuid(clientUuid.toString()));
+
+    foreach (const QVariant &serverVariant, dataMap.value("serversAdded").toList()) {
+        QVariantMap serverMap = serverVariant.toMap();
+        m_servers.insert(QUuid(serverMap.value("serverUuid").toString()), serverMap);
+    }
+
+    foreach (const QVariant &clientVariant, dataMap.value("clientsAdded").toList()) {
+        QVariantMap clientMap = clientVariant.toMap();
+        m_clients.insert(QUuid(clientMap.value("clientUuid").toString()), clientMap);
+    }
+
+    QVariantMap serverCounters = dataMap.value("serverCounters").toMap();
+    foreach (const QString &serverUuid, serverCounters.keys()) {
+        QMap<QUuid, QVariantMap>::iterator it = m_servers.find(QUuid(serverUuid));
+        if (it == m_servers.end())
+            continue;
+
+        QVariantMap counters = serverCounters.value(serverUuid).toMap();
+        foreach (const QString &key, counters.keys()) {
+            it.value().insert(key, counters.value(key));
+        }
+    }
+
+    QVariantMap clientCounters = dataMap.value("clientCounters").toMap();
+    foreach (const QString &clientUuid, clientCounters.keys()) {
+        QMap<QUuid, QVariantMap>::iterator it = m_clients.find(QUuid(clientUuid));
+        if (it == m_clients.end())
+            continue;
+
+        QVariantMap counters = clientCounters.value(clientUuid).toMap();
+        foreach (const QString &key, counters.keys()) {
+            it.value().insert(key, counters.value(key));
+        }
+    }
+}
+
+QVariantMap MonitorClient::buildSubscriptionData() const
+{
+    // Same layout as the refresh data, so the views do not care where it comes from
+    QHash<QUuid, QVariantList> serverClients;
+    foreach (const QVariantMap &clientMap, m_clients) {
+        serverClients[QUuid(clientMap.value("serverUuid").toString())].append(clientMap);
+    }
+
+    QVariantList tunnelConnections;
+    foreach (const QUuid &serverUuid, m_query.isEmpty() ? m_servers.keys() : m_serverOrder) {
+        QVariantList clientList = serverClients.value(serverUuid);
+        if (!m_printAll && clientList.isEmpty())
+            continue;
+
+        QVariantMap serverMap = m_servers.value(serverUuid);
+        serverMap.insert("clientConnections", clientList);
+        tunnelConnections.append(serverMap);
+    }
+
+    QVariantMap dataMap = m_subscriptionData;
+    QVariantMap tunnelProxyMap = dataMap.value("tunnelProxyStatistic").toMap();
+    tunnelProxyMap.insert("tunnelConnections", tunnelConnections);
+    dataMap.insert("tunnelProxyStatistic", tunnelProxyMap);
+    dataMap.remove("type");
+    return dataMap;
 }
 
 void MonitorClient::onConnected()
@@ -84,19 +196,15 @@ void MonitorClient::onDisconnected()
 
 void MonitorClient::onReadyRead()
 {
-    // Note: the server sends the data compact with "\n" at the end
-    QByteArray data = m_socket->readAll();
+    // Note: the server sends the data compact with "\n" at the end, subscriptions send several messages
+    m_dataBuffer.append(m_socket->readAll());
 
-    int index = data.indexOf("}\n");
-    if (index < 0) {
-        // Append the entire data and continue
-        m_dataBuffer.append(data);
-        return;
-    } else {
-        m_dataBuffer.append(data.left(index + 1));
-        processBufferData();
-        m_dataBuffer.clear();
-        m_dataBuffer.append(data.right(data.length() - index - 2));
+    int index = m_dataBuffer.indexOf('\n');
+    while (index >= 0) {
+        QByteArray message = m_dataBuffer.left(index);
+        m_dataBuffer.remove(0, index + 1);
+        processMessage(message);
+        index = m_dataBuffer.indexOf('\n');
     }
 }
 
@@ -133,3 +241,50 @@ void MonitorClient::refresh()
 
     m_socket->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
 }
+
+void MonitorClient::subscribe(const QVariantMap &query)
+{
+    if (m_socket->state() != QLocalSocket::ConnectedState)
+        return;
+
+    m_query = query;
+
+    QVariantMap request;
+    request.insert("method", "subscribe");
+    QVariantMap params = query;
+    if (m_printAll) {
+        params.insert("printAll", m_printAll);
+    }
+
+    if (!params.isEmpty()) {
+        request.insert("params", params);
+    }
+
+    m_socket->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
+}
+
+void MonitorClient::drain(int window)
+{
+    if (m_socket->state() != QLocalSocket::ConnectedState)
+        return;
+
+    QVariantMap request;
+    request.insert("method", "drain");
+    if (window >= 0) {
+        QVariantMap params;
+        params.insert("window", window);
+        request.insert("params", params);
+    }
+
+    m_socket->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
+}
+
+void MonitorClient::requestMemoryReport()
+{
+    if (m_socket->state() != QLocalSocket::ConnectedState)
+        return;
+
+    QVariantMap request;
+    request.insert("method", "memory");
+    m_socket->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
+}
@@ -25,6 +25,8 @@
 #ifndef MONITORCLIENT_H
 #define MONITORCLIENT_H
 
+#include <QMap>
+#include <QUuid>
 #include <QObject>
 #include <QLocalSocket>
 
@@ -48,7 +50,19 @@ private:
     bool m_printAll = false;
     QByteArray m_dataBuffer;
 
-    void processBufferData();
+    // Subscription state: the last snapshot with the updates applied
+    QVariantMap m_subscriptionData;
+    QMap<QUuid, QVariantMap> m_servers;
+    QMap<QUuid, QVariantMap> m_clients;
+
+    // With a query the server sends the page of servers sorted, keep its order
+    QVariantMap m_query;
+    QList<QUuid> m_serverOrder;
+
+    void processMessage(const QByteArray &message);
+    void processSnapshot(const QVariantMap &dataMap);
+    void processDelta(const QVariantMap &dataMap);
+    QVariantMap buildSubscriptionData() const;
 
 signals:
     void connected();
@@ -66,6 +80,9 @@ public slots:
     void disconnectMonitor();
 
     void refresh();
+    void subscribe(const QVariantMap &query = QVariantMap());
+    void drain(int window = -1);
+    void requestMemoryReport();
 };
 
 #endif // MONITORCLIENT_H
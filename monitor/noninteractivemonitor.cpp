@@ -40,10 +40,58 @@ NonInteractiveMonitor::NonInteractiveMonitor(const QString &serverName, bool jso
     m_monitorClient->connectMonitor();
 }
 
+void NonInteractiveMonitor::requestDrain(int window)
+{
+    m_drainRequested = true;
+    m_drainWindow = window;
+}
+
+void NonInteractiveMonitor::requestMemoryReport()
+{
+    m_memoryReportRequested = true;
+}
+
+void NonInteractiveMonitor::setQuery(const QVariantMap &query)
+{
+    m_query = query;
+}
+
+void NonInteractiveMonitor::printMemoryReport(const QVariantMap &memoryMap)
+{
+    qint64 bytesPerConnection = memoryMap.value("bytesPerConnection", -1).toLongLong();
+
+    qStdOut() << "---------------------------------------------------------------------\n";
+    qStdOut() << "Resident memory:" << Utils::humanReadableTraffic(memoryMap.value("residentBytes", 0).toLongLong()) << "\n";
+    qStdOut() << "Heap in use:" << Utils::humanReadableTraffic(memoryMap.value("heapInUse", 0).toLongLong()) << "\n";
+    qStdOut() << "Connections:" << memoryMap.value("totalClientCount", 0).toInt() << "("
+              << (bytesPerConnection < 0 ? QString("-") : QString("%1 B").arg(bytesPerConnection)) << "per connection)" << "\n";
+    qStdOut() << "Idle server connections:" << memoryMap.value("idleServerConnectionsCount", 0).toInt() << "\n";
+    qStdOut() << "Active tunnels:" << memoryMap.value("activeTunnelsCount", 0).toInt() << "\n";
+    QVariantMap compactionMap = memoryMap.value("compaction").toMap();
+    qStdOut() << "Idle compaction:" << compactionMap.value("compactedConnections", 0).toInt() << "connections compacted,"
+              << Utils::humanReadableTraffic(compactionMap.value("releasedBytes", 0).toLongLong()) << "released" << "\n";
+    qStdOut() << "---------------------------------------------------------------------" << "\n";
+    QVariantMap slabsMap = memoryMap.value("slabs").toMap();
+    foreach (const QString &typeName, slabsMap.keys()) {
+        QVariantMap slabMap = slabsMap.value(typeName).toMap();
+        qStdOut() << QString("%1 %2 B slots: %3 used / %4 total, %5 reserved")
+                     .arg(typeName, -28)
+                     .arg(slabMap.value("slotSize").toInt(), 5)
+                     .arg(slabMap.value("usedSlots").toInt())
+                     .arg(slabMap.value("totalSlots").toInt())
+                     .arg(Utils::humanReadableTraffic(slabMap.value("reservedBytes").toLongLong())) << "\n";
+    }
+}
+
 void NonInteractiveMonitor::onConnected()
 {
     connect(m_monitorClient, &MonitorClient::dataReady, this, [](const QVariantMap &dataMap){
 
+        if (dataMap.contains("memory")) {
+            printMemoryReport(dataMap.value("memory").toMap());
+            exit(0);
+        }
+
         QVariantMap tunnelProxyMap = dataMap.value("tunnelProxyStatistic").toMap();
 
         qStdOut() << "---------------------------------------------------------------------\n";
@@ -54,10 +102,69 @@ void NonInteractiveMonitor::onConnected()
         qStdOut() << "Server connections:" << tunnelProxyMap.value("serverConnectionsCount", 0).toInt() << "\n";
         qStdOut() << "Client connections:" << tunnelProxyMap.value("clientConnectionsCount", 0).toInt() << "\n";
         qStdOut() << "Data troughput:" << Utils::humanReadableTraffic(tunnelProxyMap.value("troughput", 0).toInt()) + " / s" << "\n";
+        QVariantMap drainMap = dataMap.value("drain").toMap();
+        if (drainMap.value("draining").toBool()) {
+            qStdOut() << "Draining:" << drainMap.value("drainedServers", 0).toInt() << "servers drained,"
+                      << drainMap.value("pendingHints", 0).toInt() << "hints pending,"
+                      << drainMap.value("remainingServers", 0).toInt() << "servers remaining" << "\n";
+        }
+        QVariantMap compressionMap = dataMap.value("compression").toMap();
+        if (compressionMap.value("enabled").toBool()) {
+            qStdOut() << "Compression:" << compressionMap.value("compressedFrames", 0).toULongLong() << "compressed frames,"
+                      << compressionMap.value("passThroughFrames", 0).toULongLong() << "passed through,"
+                      << "ratio" << QString::number(compressionMap.value("ratio", 1.0).toDouble(), 'f', 2) << ","
+                      << "CPU" << QString::number(compressionMap.value("decompressionTime", 0).toLongLong() / 1000.0, 'f', 1) << "ms" << "\n";
+        }
+        QVariantMap compactionMap = dataMap.value("compaction").toMap();
+        if (compactionMap.value("compactions", 0).toULongLong() > 0) {
+            qStdOut() << "Idle compaction:" << compactionMap.value("compactedConnections", 0).toInt() << "connections compacted,"
+                      << Utils::humanReadableTraffic(compactionMap.value("releasedBytes", 0).toLongLong()) << "released" << "\n";
+        }
+        QVariantMap admissionMap = dataMap.value("admission").toMap();
+        qStdOut() << "Admission:" << admissionMap.value("admitted", 0).toInt() << "admitted,"
+                  << admissionMap.value("deferred", 0).toInt() << "deferred,"
+                  << admissionMap.value("rejected", 0).toInt() << "rejected,"
+                  << admissionMap.value("waiting", 0).toInt() << "waiting" << "\n";
         qStdOut() << "---------------------------------------------------------------------" << "\n";
         QVariantMap transportsMap = tunnelProxyMap.value("transports").toMap();
+        QVariantMap averageWriteSizeMap = tunnelProxyMap.value("averageWriteSize").toMap();
         foreach(const QString &transportInterface, transportsMap.keys()) {
-            qStdOut() << "Connections on " << transportInterface << ": " << transportsMap.value(transportInterface).toInt() << "\n";
+            qStdOut() << "Connections on " << transportInterface << ": " << transportsMap.value(transportInterface).toInt()
+                      << " (average write " << QString::number(averageWriteSizeMap.value(transportInterface, 0).toDouble(), 'f', 0) << " B)" << "\n";
+        }
+        QVariantMap forwardingLatencyMap = tunnelProxyMap.value("forwardingLatency").toMap();
+        foreach(const QString &transportInterface, forwardingLatencyMap.keys()) {
+            QVariantMap directionsMap = forwardingLatencyMap.value(transportInterface).toMap();
+            foreach (const QString &direction, QStringList() << "clientToServer" << "serverToClient") {
+                QVariantMap latencyMap = directionsMap.value(direction).toMap();
+                if (latencyMap.value("count", 0).toULongLong() == 0)
+                    continue;
+
+                qStdOut() << "Forwarding latency on " << transportInterface << (direction == "clientToServer" ? " client -> server:" : " server -> client:")
+                          << " p50 " << Utils::humanReadableLatency(latencyMap.value("p50").toLongLong())
+                          << " p99 " << Utils::humanReadableLatency(latencyMap.value("p99").toLongLong())
+                          << " p999 " << Utils::humanReadableLatency(latencyMap.value("p999").toLongLong())
+                          << " (" << latencyMap.value("count").toULongLong() << " frames)" << "\n";
+            }
+        }
+        QVariantList topTunnels = tunnelProxyMap.value("topTunnels").toList();
+        if (!topTunnels.isEmpty()) {
+            qStdOut() << "---------------------------------------------------------------------" << "\n";
+            qStdOut() << "Top tunnels (" << tunnelProxyMap.value("rateAlertsCount", 0).toInt() << " rate alerts):" << "\n";
+            foreach (const QVariant &tunnelVariant, topTunnels) {
+                QVariantMap tunnelMap = tunnelVariant.toMap();
+                qStdOut() << QString("%1 / s %2 frames / s | %3 | %4 | %5")
+                             .arg(Utils::humanReadableTraffic(tunnelMap.value("byteRate").toLongLong()), 10)
+                             .arg(tunnelMap.value("frameRate").toLongLong(), 6)
+                             .arg(tunnelMap.value("serverUuid").toString())
+                             .arg(tunnelMap.value("address").toString(), - 15)
+                             .arg(tunnelMap.value("name").toString()) << "\n";
+            }
+        }
+        QVariantMap queryMap = tunnelProxyMap.value("query").toMap();
+        if (!queryMap.isEmpty()) {
+            qStdOut() << "Servers" << queryMap.value("offset").toInt() + 1 << "-" << queryMap.value("offset").toInt() + queryMap.value("count").toInt()
+                      << (queryMap.value("more").toBool() ? "(more available)" : "") << "\n";
         }
         qStdOut() << "---------------------------------------------------------------------" << "\n";
 
@@ -74,12 +181,14 @@ void NonInteractiveMonitor::onConnected()
                 serverLinePrint.prepend("├┬─");
             }
 
-            serverLinePrint += QString("%1 | %2 | %3 RX: %4 TX: %5 | %6")
+            int roundTripTime = serverMap.value("rtt", -1).toInt();
+            serverLinePrint += QString("%1 | %2 | %3 RX: %4 TX: %5 RTT: %6 | %7")
                     .arg(serverConnectionTime)
                     .arg(serverMap.value("serverUuid").toString())
                     .arg(serverMap.value("address").toString(), - 15)
                     .arg(Utils::humanReadableTraffic(serverMap.value("rxDataCount").toInt()), - 9)
                     .arg(Utils::humanReadableTraffic(serverMap.value("txDataCount").toInt()), - 9)
+                    .arg(roundTripTime < 0 ? QString("-") : QString("%1 ms").arg(roundTripTime), - 8)
                     .arg(serverMap.value("name").toString());
 
             qStdOut() << serverLinePrint << "\n";
@@ -108,5 +217,11 @@ void NonInteractiveMonitor::onConnected()
         exit(0);
     });
 
-    m_monitorClient->refresh();
+    if (m_memoryReportRequested) {
+        m_monitorClient->requestMemoryReport();
+    } else if (m_drainRequested) {
+        m_monitorClient->drain(m_drainWindow);
+    } else {
+        m_monitorClient->subscribe(m_query);
+    }
 }
@@ -34,9 +34,24 @@ class NonInteractiveMonitor : public QObject
 public:
     explicit NonInteractiveMonitor(const QString &serverName, bool jsonMode, bool printAll = false, QObject *parent = nullptr);
 
+    // Request a drain instead of a refresh once connected. A negative window uses the server configuration.
+    void requestDrain(int window);
+
+    // Request the memory report instead of a refresh once connected
+    void requestMemoryReport();
+
+    // Filter, sort and page the listed servers, see the refresh method of the monitor server
+    void setQuery(const QVariantMap &query);
+
 private:
     MonitorClient *m_monitorClient = nullptr;
     bool m_jsonMode = false;
+    bool m_drainRequested = false;
+    int m_drainWindow = -1;
+    bool m_memoryReportRequested = false;
+    QVariantMap m_query;
+
+    static void printMemoryReport(const QVariantMap &memoryMap);
 
 private slots:
     void onConnected();
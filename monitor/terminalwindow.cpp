@@ -36,6 +36,9 @@ TerminalWindow::TerminalWindow(QObject *parent) :
     // Init view tabs
     m_tabs << ViewTunnelProxy;
 
+    // The empty sort order keeps the server order
+    m_sortOrders << QString() << "throughput" << "rxDataCount" << "txDataCount";
+
     // Create main window
     m_mainWindow = initscr();
 
@@ -93,6 +96,17 @@ TerminalWindow::~TerminalWindow()
     cleanup();
 }
 
+QVariantMap TerminalWindow::currentQuery() const
+{
+    QVariantMap query;
+    query.insert("offset", m_pageOffset);
+    query.insert("limit", pageSize());
+    if (!m_sortOrders.at(m_sortIndex).isEmpty())
+        query.insert("sortBy", m_sortOrders.at(m_sortIndex));
+
+    return query;
+}
+
 void TerminalWindow::resizeWindow()
 {
     int terminalSizeX;
@@ -101,10 +115,16 @@ void TerminalWindow::resizeWindow()
 
     // Resize the window if size has changed
     if (m_terminalSizeX != terminalSizeX || m_terminalSizeY != terminalSizeY) {
+        bool pageSizeChanged = m_terminalSizeY != terminalSizeY;
         m_terminalSizeX = terminalSizeX;
         m_terminalSizeY = terminalSizeY;
         wresize(m_headerWindow, m_headerHeight, m_terminalSizeX);
         wresize(m_contentWindow, m_terminalSizeY - m_headerHeight, m_terminalSizeX);
+
+        // Ask for a page matching the new window height
+        if (pageSizeChanged) {
+            emit queryChanged(currentQuery());
+        }
     }
 }
 
@@ -152,6 +172,33 @@ void TerminalWindow::moveTabLeft()
     }
 }
 
+void TerminalWindow::movePage(int pages)
+{
+    QVariantMap queryMap = m_dataMap.value("tunnelProxyStatistic").toMap().value("query").toMap();
+    if (pages > 0 && !queryMap.isEmpty() && !queryMap.value("more").toBool())
+        return;
+
+    int pageOffset = qMax(0, m_pageOffset + pages * pageSize());
+    if (pageOffset == m_pageOffset && !queryMap.isEmpty())
+        return;
+
+    m_pageOffset = pageOffset;
+    emit queryChanged(currentQuery());
+}
+
+void TerminalWindow::cycleSortOrder()
+{
+    m_sortIndex = (m_sortIndex + 1) % m_sortOrders.count();
+    m_pageOffset = 0;
+    emit queryChanged(currentQuery());
+}
+
+int TerminalWindow::pageSize() const
+{
+    // One server line per content row, the clients of the servers may scroll
+    return qMax(1, m_terminalSizeY - m_headerHeight - 2);
+}
+
 void TerminalWindow::paintHeader()
 {
     QString windowName;
@@ -159,7 +206,7 @@ void TerminalWindow::paintHeader()
     switch (m_view) {
     case ViewTunnelProxy:
         windowName = "-- TunnelProxy --";
-        headerString = QString(" Server: %1 (%2) | API: %3 | Total: %4 | Servers: %5 | Clients: %6 | %7 | %8")
+        headerString = QString(" Server: %1 (%2) | API: %3 | Total: %4 | Servers: %5 | Clients: %6 | %7 | Compression: %8 (CPU %9 ms) | %10")
                 .arg(m_dataMap.value("serverName", "-").toString())
                 .arg(m_dataMap.value("serverVersion", "-").toString())
                 .arg(m_dataMap.value("apiVersion", "-").toString())
@@ -167,7 +214,27 @@ void TerminalWindow::paintHeader()
                 .arg(m_dataMap.value("tunnelProxyStatistic").toMap().value("serverConnectionsCount", 0).toInt())
                 .arg(m_dataMap.value("tunnelProxyStatistic").toMap().value("clientConnectionsCount", 0).toInt())
                 .arg(Utils::humanReadableTraffic(m_dataMap.value("tunnelProxyStatistic").toMap().value("troughput", 0).toInt()) + " / s", - 13)
+                .arg(QString::number(m_dataMap.value("compression").toMap().value("ratio", 1.0).toDouble(), 'f', 2))
+                .arg(QString::number(m_dataMap.value("compression").toMap().value("decompressionTime", 0).toLongLong() / 1000.0, 'f', 1))
                 .arg(windowName);
+
+        QVariantList topTunnels = m_dataMap.value("tunnelProxyStatistic").toMap().value("topTunnels").toList();
+        if (!topTunnels.isEmpty()) {
+            QVariantMap tunnelMap = topTunnels.first().toMap();
+            headerString += QString(" | Top: %1 %2 / s")
+                    .arg(tunnelMap.value("name").toString())
+                    .arg(Utils::humanReadableTraffic(tunnelMap.value("byteRate").toLongLong()));
+        }
+
+        QVariantMap queryMap = m_dataMap.value("tunnelProxyStatistic").toMap().value("query").toMap();
+        if (!queryMap.isEmpty()) {
+            int offset = queryMap.value("offset").toInt();
+            headerString += QString(" | Servers %1 - %2%3 | Sort: %4")
+                    .arg(offset + 1)
+                    .arg(offset + queryMap.value("count").toInt())
+                    .arg(queryMap.value("more").toBool() ? "+" : "")
+                    .arg(m_sortOrders.at(m_sortIndex).isEmpty() ? QString("uuid") : m_sortOrders.at(m_sortIndex));
+        }
         break;
     }
 
@@ -252,11 +319,13 @@ void TerminalWindow::paintContentTunnelProxy()
         QString serverConnectionTime = QDateTime::fromMSecsSinceEpoch(timeStamp * 1000).toString("dd.MM.yyyy hh:mm:ss");
         int rxDataCountBytes = serverMap.value("rxDataCount").toInt();
         int txDataCountBytes = serverMap.value("txDataCount").toInt();
-        QString serverLinePrint = QString("%1 | %2 | RX: %3 | TX: %4 | %5")
+        int roundTripTime = serverMap.value("rtt", -1).toInt();
+        QString serverLinePrint = QString("%1 | %2 | RX: %3 | TX: %4 | RTT: %5 | %6")
                 .arg(serverConnectionTime)
                 .arg(serverMap.value("address").toString(), - 16)
                 .arg(Utils::humanReadableTraffic(rxDataCountBytes), - 10)
                 .arg(Utils::humanReadableTraffic(txDataCountBytes), - 10)
+                .arg(roundTripTime < 0 ? QString("-") : QString("%1 ms").arg(roundTripTime), - 8)
                 .arg(serverMap.value("name").toString(), -30);
 
         QVariantList clientList = serverMap.value("clientConnections").toList();
@@ -321,6 +390,15 @@ void TerminalWindow::eventLoop()
     case KEY_RIGHT:
         moveTabRight();
         break;
+    case KEY_NPAGE:
+        movePage(1);
+        break;
+    case KEY_PPAGE:
+        movePage(-1);
+        break;
+    case 's':
+        cycleSortOrder();
+        break;
     case 27: // Esc
         cleanup();
         qDebug() << "Closing window monitor. Have a nice day!";
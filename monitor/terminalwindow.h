@@ -27,6 +27,7 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QStringList>
 #include <QVariantMap>
 
 #include <ncurses.h>
@@ -44,6 +45,9 @@ public:
     explicit TerminalWindow(QObject *parent = nullptr);
     ~TerminalWindow();
 
+    // The page of servers fitting into the window with the current sort order
+    QVariantMap currentQuery() const;
+
 private:
     WINDOW *m_mainWindow = nullptr;
     WINDOW *m_headerWindow = nullptr;
@@ -56,6 +60,11 @@ private:
     View m_view = ViewTunnelProxy;
     int m_tunnelProxyScollIndex = 0;
 
+    // Server side paging and sorting of the tunnel proxy view
+    int m_pageOffset = 0;
+    int m_sortIndex = 0;
+    QStringList m_sortOrders;
+
 
     // Tabs
     QList<View> m_tabs;
@@ -69,6 +78,9 @@ private:
     void drawWindowBorder(WINDOW *window);
     void moveTabRight();
     void moveTabLeft();
+    void movePage(int pages);
+    void cycleSortOrder();
+    int pageSize() const;
 
     void paintHeader();
     void paintContentClients();
@@ -80,6 +92,9 @@ private:
 private slots:
     void eventLoop();
 
+signals:
+    void queryChanged(const QVariantMap &query);
+
 public slots:
     void refreshWindow(const QVariantMap &dataMap);
 
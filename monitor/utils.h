@@ -49,7 +49,7 @@ public:
         return QString::asprintf("%02d:%02d:%02d", hours, minutes, seconds);
     }
 
-    inline static QString humanReadableTraffic(int bytes) {
+    inline static QString humanReadableTraffic(qint64 bytes) {
         double dataCount = bytes;
         QStringList list;
         list << "KB" << "MB" << "GB" << "TB";
@@ -63,6 +63,16 @@ public:
         }
         return QString().setNum(dataCount,'f',2) + " " + unit;
     }
+
+    inline static QString humanReadableLatency(qint64 microSeconds) {
+        if (microSeconds < 1000)
+            return QString::number(microSeconds) + " us";
+
+        if (microSeconds < 1000000)
+            return QString().setNum(microSeconds / 1000.0, 'f', 2) + " ms";
+
+        return QString().setNum(microSeconds / 1000000.0, 'f', 2) + " s";
+    }
 };
 
 #endif // UTILS_H
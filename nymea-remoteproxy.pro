@@ -3,7 +3,7 @@ include(nymea-remoteproxy.pri)
 # Define versions
 SERVER_NAME=nymea-remoteproxy
 API_VERSION_MAJOR=0
-API_VERSION_MINOR=6
+API_VERSION_MINOR=7
 COPYRIGHT_YEAR=2023
 
 # Parse and export SERVER_VERSION
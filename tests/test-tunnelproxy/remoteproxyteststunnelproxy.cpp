@@ -26,19 +26,34 @@
 
 #include "engine.h"
 #include "loggingcategories.h"
+#include "jsonrpc/tunnelproxyhandler.h"
+#include "server/slaballocator.h"
+#include "server/loghistogram.h"
+#include "server/heavyhitters.h"
+#include "tunnelproxy/tunnelproxyserverconnection.h"
+#include "allocationcounter.h"
+#include "../common/bufferpool.h"
+#include "../common/jsonstreamsplitter.h"
 #include "../common/slipdataprocessor.h"
+#include "../common/tunnelcompression.h"
 #include "../../version.h"
 
 // Client
 #include "tunnelproxy/tunnelproxysocketserver.h"
 #include "tunnelproxy/tunnelproxyremoteconnection.h"
+#include "tunnelproxy/reconnectbackoff.h"
 
+#include <QBuffer>
 #include <QMetaType>
+#include <QRandomGenerator>
 #include <QSignalSpy>
+#include <QTcpSocket>
 #include <QWebSocket>
 #include <QJsonDocument>
 #include <QWebSocketServer>
 
+#include <limits>
+
 using namespace remoteproxyclient;
 
 RemoteProxyTestsTunnelProxy::RemoteProxyTestsTunnelProxy(QObject *parent) :
@@ -67,6 +82,7 @@ void RemoteProxyTestsTunnelProxy::apiBasicCallsTcp_data()
     QTest::addColumn<QString>("responseStatus");
 
     QTest::newRow("valid call") << QByteArray("{\"id\":42, \"method\":\"RemoteProxy.Hello\"}") << 42 << "success";
+    QTest::newRow("valid tunnel proxy call") << QByteArray("{\"id\":42, \"method\":\"TunnelProxy.Ping\", \"params\":{\"timestamp\":1234}}") << 42 << "success";
     QTest::newRow("missing id") << QByteArray("{\"method\":\"RemoteProxy.Hello\"}") << -1 << "error";
     QTest::newRow("missing method") << QByteArray("{\"id\":42}") << 42 << "error";
     //QTest::newRow("invalid json") << QByteArray("{\"id\":42, \"method\":\"RemoteProx") << -1 << "error";
@@ -118,6 +134,13 @@ void RemoteProxyTestsTunnelProxy::getIntrospect()
     QVERIFY(response.value("params").toMap().contains("notifications"));
     QVERIFY(response.value("params").toMap().contains("types"));
 
+    // Every method in the dispatch table shows up in the introspection
+    QStringList methods = response.value("params").toMap().value("methods").toMap().keys();
+    QStringList expectedMethods;
+    expectedMethods << "RemoteProxy.Hello" << "RemoteProxy.Introspect";
+    expectedMethods << "TunnelProxy.DisconnectClient" << "TunnelProxy.Ping" << "TunnelProxy.RegisterClient" << "TunnelProxy.RegisterServer";
+    QCOMPARE(methods, expectedMethods);
+
     // Tcp
     response.clear();
     response = invokeTcpSocketTunnelProxyApiCall("RemoteProxy.Introspect").toMap();
@@ -1313,5 +1336,2413 @@ void RemoteProxyTestsTunnelProxy::tunnelProxyEndToEndTest()
 
 }
 
+void RemoteProxyTestsTunnelProxy::drainServer()
+{
+    // Start the server
+    startServer();
+
+    resetDebugCategories();
+    addDebugCategory("TunnelProxyServer.debug=true");
+    addDebugCategory("TunnelProxySocketServer.debug=true");
+
+    // Tunnel proxy socket server
+    QString serverName = "Draining server";
+    QUuid serverUuid = QUuid::createUuid();
+
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, serverName, this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+    QVERIFY(tunnelProxyServer->running());
+
+    // Tunnel proxy client connection
+    QUuid clientUuid = QUuid::createUuid();
+    TunnelProxyRemoteConnection *clientConnection = new TunnelProxyRemoteConnection(clientUuid, "Draining client", this);
+    connect(clientConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        clientConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    clientConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(clientConnectedSpy.wait());
+
+    // Without a window the reconnect hint will be sent right away
+    Engine::instance()->tunnelProxyServer()->startDrain(0);
+    QVERIFY(Engine::instance()->tunnelProxyServer()->draining());
+
+    // New registrations must be rejected while draining
+    QVariantMap params;
+    params.insert("serverName", "Late server");
+    params.insert("serverUuid", QUuid::createUuid().toString());
+    QVariantMap response = invokeTcpSocketTunnelProxyApiCall("TunnelProxy.RegisterServer", params).toMap();
+    QVERIFY(response.value("status").toString() == "success");
+    verifyTunnelProxyError(response, TunnelProxyServer::TunnelProxyErrorDraining);
+
+    // The server stays as long as the client is connected
+    QVERIFY(tunnelProxyServer->running());
+    QVariantMap drainMap = Engine::instance()->buildMonitorData().value("drain").toMap();
+    QVERIFY(drainMap.value("draining").toBool());
+    QCOMPARE(drainMap.value("pendingHints").toInt(), 0);
+    QCOMPARE(drainMap.value("hintedServers").toInt(), 1);
+
+    // Once the last client is gone the server reconnects
+    QSignalSpy serverNotRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    clientConnection->disconnectServer();
+    QVERIFY(serverNotRunningSpy.wait());
+    QVERIFY(serverNotRunningSpy.first().at(0).toBool() == false);
+
+    QTest::qWait(100);
+
+    drainMap = Engine::instance()->tunnelProxyServer()->drainStatistics();
+    QCOMPARE(drainMap.value("drainedServers").toInt(), 1);
+    QCOMPARE(drainMap.value("remainingServers").toInt(), 0);
+
+    // Clean up
+    tunnelProxyServer->stopServer();
+    tunnelProxyServer->deleteLater();
+    clientConnection->deleteLater();
+
+    resetDebugCategories();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::reconnectBackoff()
+{
+    ReconnectBackoff backoff(1000, 30000, 2.0);
+    backoff.setSeed(42);
+
+    // The ceiling grows exponentially and stays at the maximum
+    QCOMPARE(backoff.currentCeiling(), 1000);
+    for (int i = 0; i < 20; i++) {
+        int ceiling = backoff.currentCeiling();
+        int delay = backoff.nextDelay();
+        QVERIFY(delay >= 0 && delay <= ceiling);
+    }
+    QCOMPARE(backoff.currentCeiling(), 30000);
+
+    backoff.reset();
+    QCOMPARE(backoff.attempts(), 0);
+    QCOMPARE(backoff.currentCeiling(), 1000);
+
+    // A ceiling that can not grow does not count the attempts
+    ReconnectBackoff zeroBackoff(0, 30000, 2.0);
+    for (int i = 0; i < 2000; i++) {
+        QCOMPARE(zeroBackoff.nextDelay(), 0);
+    }
+    QCOMPARE(zeroBackoff.attempts(), 0);
+    QCOMPARE(zeroBackoff.currentCeiling(), 0);
+
+    // The constructor clamps like the setters
+    ReconnectBackoff clampedBackoff(-1000, 30000, 0.5);
+    QCOMPARE(clampedBackoff.initialDelay(), 0);
+    QCOMPARE(clampedBackoff.multiplier(), 1.0);
+    clampedBackoff.setInitialDelay(500);
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(clampedBackoff.nextDelay() <= 500);
+    }
+    QCOMPARE(clampedBackoff.attempts(), 0);
+    QCOMPARE(clampedBackoff.currentCeiling(), 500);
+
+    // Simulate a fleet losing the connection at the same moment and retrying for
+    // 10 minutes of simulated time. With a fixed interval every client would hit the
+    // proxy within the same 100 ms slot, with jitter the attempts spread over time.
+    const int clientCount = 1000;
+    const qint64 simulatedDuration = 600000;
+    QHash<qint64, int> attemptsPerSlot; // 100 ms slots
+    for (int i = 0; i < clientCount; i++) {
+        ReconnectBackoff clientBackoff(1000, 30000, 2.0);
+        clientBackoff.setSeed(static_cast<quint32>(i + 1));
+
+        qint64 simulatedTime = 0;
+        while (true) {
+            simulatedTime += clientBackoff.nextDelay();
+            if (simulatedTime > simulatedDuration)
+                break;
+
+            attemptsPerSlot[simulatedTime / 100] += 1;
+        }
+    }
+
+    int peakAttempts = 0;
+    foreach (int attempts, attemptsPerSlot) {
+        peakAttempts = qMax(peakAttempts, attempts);
+    }
+
+    qDebug() << "Peak reconnect attempts per 100 ms of" << clientCount << "clients:" << peakAttempts;
+    QVERIFY(peakAttempts < clientCount / 3);
+
+    // Once capped, the attempts of the fleet should be close to evenly distributed
+    int lateAttempts = 0;
+    int latePeak = 0;
+    for (qint64 second = 120; second < simulatedDuration / 1000; second++) {
+        int attempts = 0;
+        for (qint64 slot = second * 10; slot < second * 10 + 10; slot++) {
+            attempts += attemptsPerSlot.value(slot);
+        }
+        lateAttempts += attempts;
+        latePeak = qMax(latePeak, attempts);
+    }
+    int lateAverage = lateAttempts / static_cast<int>(simulatedDuration / 1000 - 120);
+    qDebug() << "Capped phase: average" << lateAverage << "peak" << latePeak << "attempts per second";
+    QVERIFY(lateAverage > 0);
+    QVERIFY(latePeak < lateAverage * 3);
+}
+
+
+void RemoteProxyTestsTunnelProxy::admissionControl()
+{
+    resetDebugCategories();
+    addDebugCategory("TcpSocketServer.debug=true");
+
+    startServer();
+
+    AdmissionController *admissionController = Engine::instance()->admissionController();
+    QVERIFY(admissionController);
+
+    QString host = Engine::instance()->tcpSocketServerTunnelProxy()->serverUrl().host();
+    quint16 port = static_cast<quint16>(Engine::instance()->tcpSocketServerTunnelProxy()->serverUrl().port());
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+
+    // Registered servers make their address known to the admission controller
+    QVERIFY(!admissionController->isKnownServerAddress(QHostAddress::LocalHost));
+    QVariantMap params;
+    params.insert("serverName", "Known server");
+    params.insert("serverUuid", QUuid::createUuid().toString());
+    QVariantMap response = invokeTcpSocketTunnelProxyApiCall("TunnelProxy.RegisterServer", params).toMap();
+    verifyTunnelProxyError(response);
+    QVERIFY(admissionController->isKnownServerAddress(QHostAddress::LocalHost));
+
+    // Give the server time to clean up the closed api call connection
+    QTest::qWait(100);
+
+    // Allow only one connection per address, the second one gets rejected
+    admissionController->setMaxConnectionsPerAddress(1);
+
+    QSslSocket *firstSocket = new QSslSocket(this);
+    connect(firstSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy firstEncryptedSpy(firstSocket, &QSslSocket::encrypted);
+    firstSocket->connectToHostEncrypted(host, port);
+    QVERIFY(firstEncryptedSpy.wait());
+
+    QSslSocket *secondSocket = new QSslSocket(this);
+    connect(secondSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy secondDisconnectedSpy(secondSocket, &QSslSocket::disconnected);
+    secondSocket->connectToHostEncrypted(host, port);
+    QVERIFY(secondDisconnectedSpy.wait());
+    QCOMPARE(admissionController->statistics().value("rejected").toInt(), 1);
+
+    firstSocket->close();
+    secondSocket->deleteLater();
+    QTest::qWait(100);
+
+    // With one accept per second the second connection has to wait for the next token
+    admissionController->setMaxConnectionsPerAddress(0);
+    admissionController->setAcceptRate(1);
+    admissionController->setAcceptBurst(1);
+
+    QSslSocket *thirdSocket = new QSslSocket(this);
+    connect(thirdSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy thirdEncryptedSpy(thirdSocket, &QSslSocket::encrypted);
+    thirdSocket->connectToHostEncrypted(host, port);
+
+    QSslSocket *fourthSocket = new QSslSocket(this);
+    connect(fourthSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy fourthEncryptedSpy(fourthSocket, &QSslSocket::encrypted);
+    fourthSocket->connectToHostEncrypted(host, port);
+
+    if (thirdEncryptedSpy.isEmpty())
+        QVERIFY(thirdEncryptedSpy.wait());
+
+    if (fourthEncryptedSpy.isEmpty())
+        QVERIFY(fourthEncryptedSpy.wait());
+
+    // The deferred and rejected counts are part of the monitor data
+    QVariantMap admissionMap = Engine::instance()->buildMonitorData().value("admission").toMap();
+    QVERIFY(admissionMap.value("deferred").toInt() >= 1);
+    QCOMPARE(admissionMap.value("rejected").toInt(), 1);
+    QCOMPARE(admissionMap.value("waiting").toInt(), 0);
+
+    thirdSocket->close();
+    fourthSocket->close();
+    firstSocket->deleteLater();
+    thirdSocket->deleteLater();
+    fourthSocket->deleteLater();
+
+    resetDebugCategories();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::compiledValidators()
+{
+    QVariantMap templateMap;
+    templateMap.insert("name", JsonTypes::basicTypeToString(JsonTypes::String));
+    templateMap.insert("o:count", JsonTypes::basicTypeToString(JsonTypes::UInt));
+    templateMap.insert("error", JsonTypes::tunnelProxyErrorRef());
+    QVariantList listTemplate;
+    listTemplate.append(JsonTypes::basicTypeToString(JsonTypes::Uuid));
+    templateMap.insert("o:uuids", listTemplate);
+
+    JsonValidator validator = JsonTypes::compileValidator(templateMap);
+    QCOMPARE(validator.type, JsonValidator::TypeMap);
+    QCOMPARE(validator.children.count(), 4);
+
+    QVariantMap map;
+    map.insert("name", "test");
+    map.insert("error", JsonTypes::tunnelProxyErrorToString(TunnelProxyServer::TunnelProxyErrorNoError));
+    QVERIFY(JsonTypes::validateMap(validator, map).first);
+
+    // Optional values
+    map.insert("count", 5);
+    map.insert("uuids", QVariantList() << QUuid::createUuid().toString());
+    QVERIFY(JsonTypes::validateMap(validator, map).first);
+
+    // Invalid enum value
+    QVariantMap invalidMap = map;
+    invalidMap.insert("error", "NotAnError");
+    QVERIFY(!JsonTypes::validateMap(validator, invalidMap).first);
+
+    // Missing key
+    invalidMap = map;
+    invalidMap.remove("name");
+    QVERIFY(!JsonTypes::validateMap(validator, invalidMap).first);
+
+    // Forbidden key
+    invalidMap = map;
+    invalidMap.insert("forbidden", true);
+    QVERIFY(!JsonTypes::validateMap(validator, invalidMap).first);
+
+    // The compiled validators must agree with the template validation
+    QCOMPARE(JsonTypes::validateMap(validator, map).first, JsonTypes::validateMap(templateMap, map).first);
+    QCOMPARE(JsonTypes::validateMap(validator, invalidMap).first, JsonTypes::validateMap(templateMap, invalidMap).first);
+}
+
+void RemoteProxyTestsTunnelProxy::validateParamsBenchmark_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<QVariantMap>("params");
+
+    QVariantMap registerServerParams;
+    registerServerParams.insert("serverName", "Benchmark server");
+    registerServerParams.insert("serverUuid", QUuid::createUuid().toString());
+
+    QVariantMap registerClientParams;
+    registerClientParams.insert("clientName", "Benchmark client");
+    registerClientParams.insert("clientUuid", QUuid::createUuid().toString());
+    registerClientParams.insert("serverUuid", QUuid::createUuid().toString());
+
+    QTest::newRow("RegisterServer") << "RegisterServer" << registerServerParams;
+    QTest::newRow("RegisterClient") << "RegisterClient" << registerClientParams;
+}
+
+void RemoteProxyTestsTunnelProxy::validateParamsBenchmark()
+{
+    QFETCH(QString, method);
+    QFETCH(QVariantMap, params);
+
+    TunnelProxyHandler handler;
+    QVERIFY(handler.validateParams(method, params).first);
+
+    QBENCHMARK {
+        handler.validateParams(method, params);
+    }
+}
+
+
+void RemoteProxyTestsTunnelProxy::requestParsingAllocations_data()
+{
+    QTest::addColumn<bool>("fastPath");
+
+    QTest::newRow("QVariant") << false;
+    QTest::newRow("QJsonObject") << true;
+}
+
+void RemoteProxyTestsTunnelProxy::requestParsingAllocations()
+{
+    QFETCH(bool, fastPath);
+
+    QVariantMap params;
+    params.insert("clientName", "Allocation client");
+    params.insert("clientUuid", QUuid::createUuid().toString());
+    params.insert("serverUuid", QUuid::createUuid().toString());
+
+    QVariantMap requestMap;
+    requestMap.insert("id", 42);
+    requestMap.insert("method", "TunnelProxy.RegisterClient");
+    requestMap.insert("params", params);
+    QByteArray data = QJsonDocument::fromVariant(requestMap).toJson(QJsonDocument::Compact);
+
+    TunnelProxyHandler handler;
+    const int iterations = 1000;
+    const QString methodName("TunnelProxy.RegisterClient");
+    const QString method("RegisterClient");
+
+    // Both paths parse the request and validate the params, the way the server did before and does now
+    quint64 variantAllocations = 0;
+    AllocationCounter::start();
+    for (int i = 0; i < iterations; i++) {
+        QVariantMap message = QJsonDocument::fromJson(data).toVariant().toMap();
+        QStringList commandList = message.value("method").toString().split('.');
+        QVERIFY(message.value("id").toInt() == 42 && commandList.count() == 2);
+        QVERIFY(handler.validateParams(commandList.last(), message.value("params").toMap()).first);
+    }
+    variantAllocations = AllocationCounter::stop();
+
+    quint64 jsonAllocations = 0;
+    AllocationCounter::start();
+    for (int i = 0; i < iterations; i++) {
+        JsonRpcServer::Request request;
+        JsonRpcServer::parseRequest(data, &request);
+        QVERIFY(request.idValid && request.id == 42 && request.method == methodName);
+        QVERIFY(handler.validateParams(method, request.params));
+    }
+    jsonAllocations = AllocationCounter::stop();
+
+    if (!AllocationCounter::supported())
+        QSKIP("Counting allocations is not supported on this platform.");
+
+    qDebug() << "Allocations per request:" << (variantAllocations / iterations) << "QVariant," << (jsonAllocations / iterations) << "QJsonObject";
+    QVERIFY(jsonAllocations < variantAllocations);
+    QTest::setBenchmarkResult(static_cast<qreal>(fastPath ? jsonAllocations : variantAllocations) / iterations, QTest::Events);
+}
+
+
+void RemoteProxyTestsTunnelProxy::cachedResponses()
+{
+    startServer();
+
+    // The static replies are cached, make sure only the id differs between calls
+    QVariantMap firstResponse = invokeTcpSocketTunnelProxyApiCall("RemoteProxy.Hello").toMap();
+    QVariantMap secondResponse = invokeTcpSocketTunnelProxyApiCall("RemoteProxy.Hello").toMap();
+    QCOMPARE(firstResponse.value("status").toString(), QString("success"));
+    QCOMPARE(secondResponse.value("status").toString(), QString("success"));
+    QVERIFY(firstResponse.value("id").toInt() != secondResponse.value("id").toInt());
+    QCOMPARE(firstResponse.value("params"), secondResponse.value("params"));
+    QCOMPARE(secondResponse.value("params").toMap().value("name").toString(), Engine::instance()->configuration()->serverName());
+    QCOMPARE(secondResponse.value("params").toMap().value("apiVersion").toString(), QString(API_VERSION_STRING));
+
+    firstResponse = invokeTcpSocketTunnelProxyApiCall("RemoteProxy.Introspect").toMap();
+    secondResponse = invokeTcpSocketTunnelProxyApiCall("RemoteProxy.Introspect").toMap();
+    QCOMPARE(firstResponse.value("status").toString(), QString("success"));
+    QVERIFY(firstResponse.value("id").toInt() != secondResponse.value("id").toInt());
+    QCOMPARE(firstResponse.value("params"), secondResponse.value("params"));
+    QVERIFY(secondResponse.value("params").toMap().value("methods").toMap().contains("TunnelProxy.RegisterServer"));
+    QVERIFY(secondResponse.value("params").toMap().value("notifications").toMap().contains("TunnelProxy.ClientConnected"));
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::jsonStreamSplitter_data()
+{
+    QTest::addColumn<QList<QByteArray>>("chunks");
+    QTest::addColumn<QList<QByteArray>>("messages");
+    QTest::addColumn<int>("remainingSize");
+
+    QTest::newRow("single message") << (QList<QByteArray>() << "{\"id\":1}\n") << (QList<QByteArray>() << "{\"id\":1}") << 0;
+    QTest::newRow("single message without delimiter") << (QList<QByteArray>() << "{\"id\":1}") << (QList<QByteArray>() << "{\"id\":1}") << 0;
+    QTest::newRow("pipelined messages") << (QList<QByteArray>() << "{\"id\":1}\n{\"id\":2}\n{\"id\":3}\n")
+                                        << (QList<QByteArray>() << "{\"id\":1}" << "{\"id\":2}" << "{\"id\":3}") << 0;
+    QTest::newRow("fragmented message") << (QList<QByteArray>() << "{\"id\"" << ":1,\"params\":{\"a\":" << "2}}\n")
+                                        << (QList<QByteArray>() << "{\"id\":1,\"params\":{\"a\":2}}") << 0;
+    QTest::newRow("fragment after message") << (QList<QByteArray>() << "{\"id\":1}\n{\"id\"" << ":2}\n")
+                                            << (QList<QByteArray>() << "{\"id\":1}" << "{\"id\":2}") << 0;
+    QTest::newRow("empty lines") << (QList<QByteArray>() << "\n{\"id\":1}\n\n\n{\"id\":2}\n\n")
+                                 << (QList<QByteArray>() << "{\"id\":1}" << "{\"id\":2}") << 0;
+    QTest::newRow("incomplete message") << (QList<QByteArray>() << "{\"id\":1}\n{\"id\":2,")
+                                        << (QList<QByteArray>() << "{\"id\":1}") << 8;
+    QTest::newRow("delimiter sequence in payload") << (QList<QByteArray>() << "{\"data\":\"}\\n{\"}\n{\"id\":2}\n")
+                                                   << (QList<QByteArray>() << "{\"data\":\"}\\n{\"}" << "{\"id\":2}") << 0;
+}
+
+void RemoteProxyTestsTunnelProxy::jsonStreamSplitter()
+{
+    QFETCH(QList<QByteArray>, chunks);
+    QFETCH(QList<QByteArray>, messages);
+    QFETCH(int, remainingSize);
+
+    JsonStreamSplitter splitter;
+    QList<QByteArray> receivedMessages;
+    foreach (const QByteArray &chunk, chunks) {
+        splitter.append(chunk);
+        QByteArray message = splitter.takeMessage();
+        while (!message.isNull()) {
+            receivedMessages.append(message);
+            message = splitter.takeMessage();
+        }
+    }
+
+    QCOMPARE(receivedMessages, messages);
+    QCOMPARE(splitter.size(), remainingSize);
+
+    splitter.clear();
+    QVERIFY(splitter.isEmpty());
+    QVERIFY(splitter.takeMessage().isNull());
+}
+
+void RemoteProxyTestsTunnelProxy::jsonStreamSplitterBenchmark_data()
+{
+    QTest::addColumn<bool>("legacy");
+
+    QTest::newRow("indexOf") << true;
+    QTest::newRow("JsonStreamSplitter") << false;
+}
+
+void RemoteProxyTestsTunnelProxy::jsonStreamSplitterBenchmark()
+{
+    QFETCH(bool, legacy);
+
+    // 1000 pipelined requests received in one chunk
+    const int requestCount = 1000;
+    QByteArray chunk;
+    for (int i = 0; i < requestCount; i++) {
+        chunk.append("{\"id\":" + QByteArray::number(i) + ",\"method\":\"TunnelProxy.Ping\",\"params\":{\"timestamp\":1234}}\n");
+    }
+
+    int count = 0;
+    QBENCHMARK {
+        count = 0;
+        if (legacy) {
+            // The previous implementation, kept for comparison
+            QByteArray dataBuffer;
+            dataBuffer.append(chunk);
+            int splitIndex = dataBuffer.indexOf("}\n{");
+            while (splitIndex > -1) {
+                count++;
+                dataBuffer = dataBuffer.right(dataBuffer.length() - splitIndex - 2);
+                splitIndex = dataBuffer.indexOf("}\n{");
+            }
+            if (dataBuffer.endsWith("}\n") || dataBuffer.endsWith("}")) {
+                count++;
+                dataBuffer.clear();
+            }
+        } else {
+            JsonStreamSplitter splitter;
+            splitter.append(chunk);
+            while (!splitter.takeMessage().isNull()) {
+                count++;
+            }
+        }
+    }
+
+    QCOMPARE(count, requestCount);
+}
+
+void RemoteProxyTestsTunnelProxy::pipelinedRequests()
+{
+    startServer();
+
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    QObject::connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+
+    QSignalSpy connectedSpy(socket, &QSslSocket::encrypted);
+    socket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(connectedSpy.wait());
+
+    // Send all requests in one write and make sure every single one gets answered in order
+    const int requestCount = 100;
+    QByteArray data;
+    for (int i = 0; i < requestCount; i++) {
+        data.append("{\"id\":" + QByteArray::number(i) + ",\"method\":\"TunnelProxy.Ping\",\"params\":{\"timestamp\":" + QByteArray::number(i) + "}}\n");
+    }
+    socket->write(data);
+
+    JsonStreamSplitter splitter;
+    QList<QVariantMap> responses;
+    QSignalSpy dataSpy(socket, &QSslSocket::readyRead);
+    while (responses.count() < requestCount) {
+        if (socket->bytesAvailable() == 0)
+            QVERIFY(dataSpy.wait());
+
+        splitter.append(socket->readAll());
+        QByteArray message = splitter.takeMessage();
+        while (!message.isNull()) {
+            responses.append(QJsonDocument::fromJson(message).toVariant().toMap());
+            message = splitter.takeMessage();
+        }
+    }
+
+    QCOMPARE(responses.count(), requestCount);
+    for (int i = 0; i < requestCount; i++) {
+        QCOMPARE(responses.at(i).value("id").toInt(), i);
+        QCOMPARE(responses.at(i).value("status").toString(), QString("success"));
+        QCOMPARE(responses.at(i).value("params").toMap().value("timestamp").toInt(), i);
+    }
+
+    socket->close();
+    socket->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::pipelinedRegistration()
+{
+    startServer();
+
+    resetDebugCategories();
+    addDebugCategory("TunnelProxyServer.debug=true");
+    addDebugCategory("JsonRpc.debug=true");
+
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    QUuid serverUuid = QUuid::createUuid();
+
+    // Server: Hello and RegisterServer within one write
+    QSslSocket *serverSocket = new QSslSocket(this);
+    QObject::connect(serverSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy serverEncryptedSpy(serverSocket, &QSslSocket::encrypted);
+    serverSocket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(serverEncryptedSpy.wait());
+
+    QByteArray serverRequests;
+    serverRequests.append("{\"id\":1,\"method\":\"RemoteProxy.Hello\"}\n");
+    serverRequests.append("{\"id\":2,\"method\":\"TunnelProxy.RegisterServer\",\"params\":{\"serverName\":\"Pipelined server\",\"serverUuid\":\"" + serverUuid.toString().toUtf8() + "\"}}\n");
+    serverSocket->write(serverRequests);
+
+    JsonStreamSplitter serverSplitter;
+    QList<QVariantMap> serverResponses;
+    QSignalSpy serverDataSpy(serverSocket, &QSslSocket::readyRead);
+    while (serverResponses.count() < 2) {
+        if (serverSocket->bytesAvailable() == 0)
+            QVERIFY(serverDataSpy.wait());
+
+        serverSplitter.append(serverSocket->readAll());
+        QByteArray message = serverSplitter.takeMessage();
+        while (!message.isNull()) {
+            serverResponses.append(QJsonDocument::fromJson(message).toVariant().toMap());
+            message = serverSplitter.takeMessage();
+        }
+    }
+
+    QCOMPARE(serverResponses.at(0).value("id").toInt(), 1);
+    QCOMPARE(serverResponses.at(0).value("status").toString(), QString("success"));
+    QCOMPARE(serverResponses.at(1).value("id").toInt(), 2);
+    QCOMPARE(serverResponses.at(1).value("status").toString(), QString("success"));
+    verifyTunnelProxyError(serverResponses.at(1));
+    QVERIFY(serverResponses.at(1).value("params").toMap().value("slipEnabled").toBool());
+
+    // Client: Hello, RegisterClient and application data within one write
+    QByteArray earlyData = "{\"id\":0,\"method\":\"JSONRPC.Hello\"}\n";
+    QSslSocket *clientSocket = new QSslSocket(this);
+    QObject::connect(clientSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy clientEncryptedSpy(clientSocket, &QSslSocket::encrypted);
+    clientSocket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(clientEncryptedSpy.wait());
+
+    QByteArray clientRequests;
+    clientRequests.append("{\"id\":1,\"method\":\"RemoteProxy.Hello\"}\n");
+    clientRequests.append("{\"id\":2,\"method\":\"TunnelProxy.RegisterClient\",\"params\":{\"clientName\":\"Pipelined client\",\"clientUuid\":\"" + QUuid::createUuid().toString().toUtf8() + "\",\"serverUuid\":\"" + serverUuid.toString().toUtf8() + "\"}}\n");
+    clientRequests.append(earlyData);
+    clientSocket->write(clientRequests);
+
+    JsonStreamSplitter clientSplitter;
+    QList<QVariantMap> clientResponses;
+    QSignalSpy clientDataSpy(clientSocket, &QSslSocket::readyRead);
+    while (clientResponses.count() < 2) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        clientSplitter.append(clientSocket->readAll());
+        QByteArray message = clientSplitter.takeMessage();
+        while (!message.isNull()) {
+            clientResponses.append(QJsonDocument::fromJson(message).toVariant().toMap());
+            message = clientSplitter.takeMessage();
+        }
+    }
+
+    QCOMPARE(clientResponses.at(0).value("status").toString(), QString("success"));
+    QCOMPARE(clientResponses.at(1).value("id").toInt(), 2);
+    verifyTunnelProxyError(clientResponses.at(1));
+
+    // The server gets the ClientConnected notification followed by the early data
+    QList<SlipDataProcessor::Frame> frames;
+    QByteArray slipBuffer;
+    while (frames.count() < 2) {
+        if (serverSocket->bytesAvailable() == 0)
+            QVERIFY(serverDataSpy.wait());
+
+        QByteArray data = serverSocket->readAll();
+        for (int i = 0; i < data.length(); i++) {
+            if (static_cast<quint8>(data.at(i)) == SlipDataProcessor::ProtocolByteEnd) {
+                if (!slipBuffer.isEmpty())
+                    frames.append(SlipDataProcessor::parseFrame(SlipDataProcessor::deserializeData(slipBuffer)));
+
+                slipBuffer.clear();
+            } else {
+                slipBuffer.append(data.at(i));
+            }
+        }
+    }
+
+    QCOMPARE(frames.at(0).socketAddress, static_cast<quint16>(0x0000));
+    QVariantMap notification = QJsonDocument::fromJson(frames.at(0).data).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("TunnelProxy.ClientConnected"));
+    quint16 socketAddress = static_cast<quint16>(notification.value("params").toMap().value("socketAddress").toUInt());
+
+    QCOMPARE(frames.at(1).socketAddress, socketAddress);
+    QCOMPARE(frames.at(1).data, earlyData);
+
+    clientSocket->close();
+    serverSocket->close();
+    clientSocket->deleteLater();
+    serverSocket->deleteLater();
+
+    resetDebugCategories();
+
+    stopServer();
+}
+
+void RemoteProxyTestsTunnelProxy::pipelinedEarlyData()
+{
+    startServer();
+
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Pipelined server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+    QVERIFY(tunnelProxyServer->running());
+
+    // Skip the hello and send data right behind the registration request
+    QByteArray earlyData = "Early data sent before the registration response";
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Pipelined client", this);
+    remoteConnection->setHelloEnabled(false);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+    connect(remoteConnection, &TunnelProxyRemoteConnection::stateChanged, this, [=](TunnelProxyRemoteConnection::State state){
+        if (state == TunnelProxyRemoteConnection::StateRegister) {
+            QVERIFY(remoteConnection->sendData(earlyData));
+        }
+    });
+
+    // The early data arrives within the same read as the notification, connect right away
+    QByteArray receivedData;
+    QMetaObject::Connection clientConnectedConnection = connect(tunnelProxyServer, &TunnelProxySocketServer::clientConnected, this, [&receivedData](TunnelProxySocket *tunnelProxySocket){
+        connect(tunnelProxySocket, &TunnelProxySocket::dataReceived, tunnelProxySocket, [&receivedData](const QByteArray &data){
+            receivedData.append(data);
+        });
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(clientConnectedSpy.wait());
+    if (remoteConnectedSpy.isEmpty())
+        QVERIFY(remoteConnectedSpy.wait());
+
+    QVERIFY(remoteConnection->remoteConnected());
+    QVERIFY(remoteConnection->remoteProxyServer().isEmpty());
+
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+    QVERIFY(tunnelProxySocket);
+    QTRY_COMPARE(receivedData, earlyData);
+
+    // Send a reply and make sure it reaches the remote connection
+    QSignalSpy remoteDataSpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    tunnelProxySocket->writeData("Reply");
+    QVERIFY(remoteDataSpy.wait());
+    QCOMPARE(remoteDataSpy.at(0).at(0).toByteArray(), QByteArray("Reply"));
+
+    disconnect(clientConnectedConnection);
+    remoteConnection->disconnectServer();
+    tunnelProxyServer->stopServer();
+    remoteConnection->deleteLater();
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::controlFrames()
+{
+    // Build and parse
+    quint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    QByteArray controlFrameData = SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePing, timestamp);
+    SlipDataProcessor::Frame controlFrame = SlipDataProcessor::parseFrame(SlipDataProcessor::deserializeData(controlFrameData));
+    QCOMPARE(controlFrame.socketAddress, static_cast<quint16>(SlipDataProcessor::SocketAddressControl));
+
+    SlipDataProcessor::ControlOpcode opcode;
+    quint64 parsedTimestamp = 0;
+    QVERIFY(SlipDataProcessor::parseControlFrame(controlFrame.data, &opcode, &parsedTimestamp));
+    QCOMPARE(opcode, SlipDataProcessor::ControlOpcodePing);
+    QCOMPARE(parsedTimestamp, timestamp);
+    QVERIFY(!SlipDataProcessor::parseControlFrame(QByteArray("ping"), &opcode, &parsedTimestamp));
+
+    startServer();
+
+    // Register a server, SLIP is enabled afterwards
+    QUuid serverUuid = QUuid::createUuid();
+    QVariantMap params;
+    params.insert("serverName", "Control frame server");
+    params.insert("serverUuid", serverUuid.toString());
+    QPair<QVariant, QSslSocket *> result = invokeTcpSocketTunnelProxyApiCallPersistant("TunnelProxy.RegisterServer", params);
+    QSslSocket *socket = result.second;
+    QVERIFY(socket);
+    verifyTunnelProxyError(result.first.toMap());
+
+    QList<SlipDataProcessor::Frame> frames;
+    QByteArray slipBuffer;
+    QSignalSpy dataSpy(socket, &QSslSocket::readyRead);
+    auto waitForFrame = [&]() -> bool {
+        while (frames.isEmpty()) {
+            if (socket->bytesAvailable() == 0 && !dataSpy.wait())
+                return false;
+
+            QByteArray data = socket->readAll();
+            for (int i = 0; i < data.length(); i++) {
+                if (static_cast<quint8>(data.at(i)) == SlipDataProcessor::ProtocolByteEnd) {
+                    if (!slipBuffer.isEmpty())
+                        frames.append(SlipDataProcessor::parseFrame(SlipDataProcessor::deserializeData(slipBuffer)));
+
+                    slipBuffer.clear();
+                } else {
+                    slipBuffer.append(data.at(i));
+                }
+            }
+        }
+        return true;
+    };
+
+    // Ping the proxy, the pong carries the same timestamp
+    socket->write(SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePing, timestamp));
+    QVERIFY(waitForFrame());
+    SlipDataProcessor::Frame frame = frames.takeFirst();
+    QCOMPARE(frame.socketAddress, static_cast<quint16>(SlipDataProcessor::SocketAddressControl));
+    QVERIFY(SlipDataProcessor::parseControlFrame(frame.data, &opcode, &parsedTimestamp));
+    QCOMPARE(opcode, SlipDataProcessor::ControlOpcodePong);
+    QCOMPARE(parsedTimestamp, timestamp);
+
+    // Let the proxy probe the server and answer it
+    Engine::instance()->configuration()->setProbeInterval(500);
+    QVERIFY(waitForFrame());
+    frame = frames.takeFirst();
+    QCOMPARE(frame.socketAddress, static_cast<quint16>(SlipDataProcessor::SocketAddressControl));
+    QVERIFY(SlipDataProcessor::parseControlFrame(frame.data, &opcode, &parsedTimestamp));
+    QCOMPARE(opcode, SlipDataProcessor::ControlOpcodePing);
+    socket->write(SlipDataProcessor::buildControlFrame(SlipDataProcessor::ControlOpcodePong, parsedTimestamp));
+
+    auto roundTripTimeMeasured = [&]() -> bool {
+        QVariantList tunnelConnections = Engine::instance()->tunnelProxyServer()->currentStatistics(true).value("tunnelConnections").toList();
+        foreach (const QVariant &serverVariant, tunnelConnections) {
+            if (serverVariant.toMap().value("serverUuid").toUuid() == serverUuid)
+                return serverVariant.toMap().value("rtt").toInt() >= 0;
+        }
+        return false;
+    };
+    QTRY_VERIFY_WITH_TIMEOUT(roundTripTimeMeasured(), 2000);
+
+    // The JSON ping is still available
+    Engine::instance()->configuration()->setProbeInterval(30000);
+    result = invokeTcpSocketTunnelProxyApiCallPersistant("TunnelProxy.Ping", QVariantMap({{"timestamp", 1234}}), true, socket);
+    QCOMPARE(result.first.toMap().value("status").toString(), QString("success"));
+
+    socket->close();
+    socket->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::controlFramesLegacyServer()
+{
+    startServer();
+
+    // A server with an older client library never sends control frames and drops unknown socket addresses
+    QUuid serverUuid = QUuid::createUuid();
+    QVariantMap params;
+    params.insert("serverName", "Legacy server");
+    params.insert("serverUuid", serverUuid.toString());
+    QPair<QVariant, QSslSocket *> result = invokeTcpSocketTunnelProxyApiCallPersistant("TunnelProxy.RegisterServer", params);
+    QSslSocket *socket = result.second;
+    QVERIFY(socket);
+    verifyTunnelProxyError(result.first.toMap());
+
+    // It does not get probed, a probe would delay its own JSON keepalive
+    Engine::instance()->configuration()->setProbeInterval(100);
+    QSignalSpy dataSpy(socket, &QSslSocket::readyRead);
+    QVERIFY(!dataSpy.wait(1500));
+    QCOMPARE(socket->bytesAvailable(), 0);
+
+    // The JSON ping keeps it alive
+    result = invokeTcpSocketTunnelProxyApiCallPersistant("TunnelProxy.Ping", QVariantMap({{"timestamp", 1234}}), true, socket);
+    QCOMPARE(result.first.toMap().value("status").toString(), QString("success"));
+    QCOMPARE(socket->state(), QAbstractSocket::ConnectedState);
+
+    Engine::instance()->configuration()->setProbeInterval(30000);
+    socket->close();
+    socket->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::multiServerRegistration()
+{
+    startServer();
+
+    // One gateway connection serving two servers
+    QUuid serverUuid = QUuid::createUuid();
+    QUuid additionalServerUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Gateway server", this);
+    tunnelProxyServer->addServer(additionalServerUuid, "Gateway additional server");
+    QCOMPARE(tunnelProxyServer->serverUuids(), QList<QUuid>({serverUuid, additionalServerUuid}));
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+    QVERIFY(tunnelProxyServer->running());
+
+    // Both servers are registered on the proxy, sharing the same transport
+    auto registeredServers = [&]() -> int {
+        return Engine::instance()->tunnelProxyServer()->currentStatistics().value("serverConnectionsCount").toInt();
+    };
+    QTRY_COMPARE(registeredServers(), 2);
+
+    // Connect one client to each server
+    QList<TunnelProxyRemoteConnection *> remoteConnections;
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    foreach (const QUuid &targetServerUuid, tunnelProxyServer->serverUuids()) {
+        TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Gateway client", this);
+        connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+            remoteConnection->ignoreSslErrors(errors);
+        });
+
+        QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+        remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, targetServerUuid);
+        QVERIFY(remoteConnectedSpy.wait());
+        QVERIFY(remoteConnection->remoteConnected());
+        remoteConnections.append(remoteConnection);
+    }
+
+    QTRY_COMPARE(clientConnectedSpy.count(), 2);
+    TunnelProxySocket *firstSocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+    TunnelProxySocket *secondSocket = clientConnectedSpy.at(1).at(0).value<TunnelProxySocket *>();
+    QCOMPARE(firstSocket->serverUuid(), serverUuid);
+    QCOMPARE(secondSocket->serverUuid(), additionalServerUuid);
+
+    // The socket addresses are unique on the shared transport
+    QVERIFY(firstSocket->socketAddress() != secondSocket->socketAddress());
+
+    // Data gets routed to the right client
+    QSignalSpy firstDataSpy(remoteConnections.at(0), &TunnelProxyRemoteConnection::dataReady);
+    QSignalSpy secondDataSpy(remoteConnections.at(1), &TunnelProxyRemoteConnection::dataReady);
+    secondSocket->writeData("Additional server");
+    QVERIFY(secondDataSpy.wait());
+    QCOMPARE(secondDataSpy.at(0).at(0).toByteArray(), QByteArray("Additional server"));
+    QVERIFY(firstDataSpy.isEmpty());
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    foreach (TunnelProxyRemoteConnection *remoteConnection, remoteConnections) {
+        remoteConnection->disconnectServer();
+        remoteConnection->deleteLater();
+    }
+
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    QTRY_COMPARE(registeredServers(), 0);
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::multiServerRegistrationTakenUuid()
+{
+    startServer();
+
+    auto registeredServers = [&]() -> int {
+        return Engine::instance()->tunnelProxyServer()->currentStatistics().value("serverConnectionsCount").toInt();
+    };
+
+    // A standalone server owning the uuid
+    QUuid takenServerUuid = QUuid::createUuid();
+    TunnelProxySocketServer *standaloneServer = new TunnelProxySocketServer(takenServerUuid, "Standalone server", this);
+    connect(standaloneServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        standaloneServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy standaloneRunningSpy(standaloneServer, &TunnelProxySocketServer::runningChanged);
+    standaloneServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(standaloneRunningSpy.wait());
+    QTRY_COMPARE(registeredServers(), 1);
+
+    // A gateway whose additional server reuses the taken uuid
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Gateway server", this);
+    tunnelProxyServer->addServer(takenServerUuid, "Gateway taken server");
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+    QTRY_COMPARE(registeredServers(), 2);
+
+    // The rejected additional registration went over the transport before this tunnel, the first server stays reachable
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Gateway client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QVERIFY(remoteConnection->remoteConnected());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+    QCOMPARE(tunnelProxySocket->serverUuid(), serverUuid);
+
+    QSignalSpy dataReadySpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    tunnelProxySocket->writeData("Still connected");
+    QVERIFY(dataReadySpy.wait());
+    QCOMPARE(dataReadySpy.at(0).at(0).toByteArray(), QByteArray("Still connected"));
+    QVERIFY(tunnelProxyServer->running());
+    QVERIFY(standaloneServer->running());
+    QCOMPARE(registeredServers(), 2);
+
+    remoteConnection->disconnectServer();
+    remoteConnection->deleteLater();
+
+    foreach (TunnelProxySocketServer *server, QList<TunnelProxySocketServer *>({tunnelProxyServer, standaloneServer})) {
+        QSignalSpy serverDisconnectedSpy(server, &TunnelProxySocketServer::runningChanged);
+        server->stopServer();
+        QVERIFY(serverDisconnectedSpy.wait());
+        server->deleteLater();
+    }
+
+    QTRY_COMPARE(registeredServers(), 0);
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::multiplexedTunnels()
+{
+    startServer();
+
+    // Two servers the client wants to reach
+    QUuid serverUuid = QUuid::createUuid();
+    QUuid secondServerUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Multiplexed server", this);
+    tunnelProxyServer->addServer(secondServerUuid, "Multiplexed second server");
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+    QTRY_COMPARE(Engine::instance()->tunnelProxyServer()->currentStatistics().value("serverConnectionsCount").toInt(), 2);
+
+    // One multiplexed client connection carrying a tunnel to each server
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Multiplexed client", this);
+    remoteConnection->setMultiplexingEnabled(true);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy tunnelOpenedSpy(remoteConnection, &TunnelProxyRemoteConnection::tunnelOpened);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(tunnelOpenedSpy.wait());
+    QVERIFY(remoteConnection->remoteConnected());
+    quint16 channel = tunnelOpenedSpy.at(0).at(0).value<quint16>();
+    QCOMPARE(tunnelOpenedSpy.at(0).at(1).toUuid(), serverUuid);
+
+    // Single tunnel data methods are not available on a multiplexed connection
+    QVERIFY(!remoteConnection->sendData("Not multiplexed"));
+
+    QVERIFY(remoteConnection->openTunnel(secondServerUuid));
+    QVERIFY(!remoteConnection->openTunnel(secondServerUuid));
+    QVERIFY(tunnelOpenedSpy.wait());
+    quint16 secondChannel = tunnelOpenedSpy.at(1).at(0).value<quint16>();
+    QCOMPARE(tunnelOpenedSpy.at(1).at(1).toUuid(), secondServerUuid);
+    QVERIFY(channel != secondChannel);
+    QCOMPARE(remoteConnection->tunnelServerUuid(secondChannel), secondServerUuid);
+
+    // Unknown servers get rejected without affecting the open tunnels
+    QSignalSpy tunnelOpenFailedSpy(remoteConnection, &TunnelProxyRemoteConnection::tunnelOpenFailed);
+    QVERIFY(remoteConnection->openTunnel(QUuid::createUuid()));
+    QVERIFY(tunnelOpenFailedSpy.wait());
+    QVERIFY(remoteConnection->remoteConnected());
+
+    QTRY_COMPARE(clientConnectedSpy.count(), 2);
+    QCOMPARE(Engine::instance()->tunnelProxyServer()->currentStatistics().value("clientConnectionsCount").toInt(), 2);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+    TunnelProxySocket *secondTunnelProxySocket = clientConnectedSpy.at(1).at(0).value<TunnelProxySocket *>();
+    QCOMPARE(tunnelProxySocket->serverUuid(), serverUuid);
+    QCOMPARE(secondTunnelProxySocket->serverUuid(), secondServerUuid);
+
+    // Client to server, routed by channel
+    QSignalSpy socketDataSpy(secondTunnelProxySocket, &TunnelProxySocket::dataReceived);
+    QVERIFY(remoteConnection->sendTunnelData(secondChannel, "Hello second server"));
+    QVERIFY(socketDataSpy.wait());
+    QCOMPARE(socketDataSpy.at(0).at(0).toByteArray(), QByteArray("Hello second server"));
+
+    // Server to client, framed with the channel
+    QSignalSpy tunnelDataSpy(remoteConnection, &TunnelProxyRemoteConnection::tunnelDataReady);
+    tunnelProxySocket->writeData("Hello client");
+    QVERIFY(tunnelDataSpy.wait());
+    QCOMPARE(tunnelDataSpy.at(0).at(0).value<quint16>(), channel);
+    QCOMPARE(tunnelDataSpy.at(0).at(1).toByteArray(), QByteArray("Hello client"));
+
+    // Closing a tunnel from the client side keeps the other one open
+    QSignalSpy clientDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientDisconnected);
+    QVERIFY(remoteConnection->closeTunnel(secondChannel));
+    QVERIFY(clientDisconnectedSpy.wait());
+    QCOMPARE(clientDisconnectedSpy.at(0).at(0).value<TunnelProxySocket *>(), secondTunnelProxySocket);
+    QVERIFY(!remoteConnection->sendTunnelData(secondChannel, "Gone"));
+
+    // Closing a tunnel from the server side keeps the client connection
+    QSignalSpy tunnelClosedSpy(remoteConnection, &TunnelProxyRemoteConnection::tunnelClosed);
+    tunnelProxySocket->disconnectSocket();
+    QVERIFY(tunnelClosedSpy.wait());
+    QCOMPARE(tunnelClosedSpy.at(0).at(0).value<quint16>(), channel);
+    QVERIFY(remoteConnection->tunnelChannels().isEmpty());
+    QVERIFY(remoteConnection->remoteConnected());
+    QTRY_COMPARE(Engine::instance()->tunnelProxyServer()->currentStatistics().value("clientConnectionsCount").toInt(), 0);
+
+    // The connection can open new tunnels afterwards
+    QVERIFY(remoteConnection->openTunnel(serverUuid));
+    QVERIFY(tunnelOpenedSpy.wait());
+    QCOMPARE(tunnelOpenedSpy.count(), 3);
+
+    remoteConnection->disconnectServer();
+    tunnelProxyServer->stopServer();
+    remoteConnection->deleteLater();
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::tunnelCompression_data()
+{
+    QByteArray json;
+    for (int i = 0; i < 50; i++)
+        json.append(QString("{\"id\":%1,\"method\":\"Integrations.GetThings\",\"params\":{}}\n").arg(i).toUtf8());
+
+    QByteArray randomData;
+    for (int i = 0; i < 1024; i++)
+        randomData.append(static_cast<char>(QRandomGenerator::global()->bounded(256)));
+
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("compressed");
+
+    QTest::newRow("small") << QByteArray("{\"id\":1,\"method\":\"JSONRPC.Hello\"}\n") << false;
+    QTest::newRow("json") << json << true;
+    QTest::newRow("random") << randomData << false;
+}
+
+void RemoteProxyTestsTunnelProxy::tunnelCompression()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(bool, compressed);
+
+    QByteArray payload = TunnelCompression::encodePayload(data);
+    QCOMPARE(TunnelCompression::payloadCompressed(payload), compressed);
+    QCOMPARE(TunnelCompression::decodedSize(payload), data.size());
+    if (compressed)
+        QVERIFY(payload.size() < data.size());
+
+    QByteArray decodedData;
+    QVERIFY(TunnelCompression::decodePayload(payload, &decodedData));
+    QCOMPARE(decodedData, data);
+
+    // Disabled compression only flags the data
+    payload = TunnelCompression::encodePayload(data, false);
+    QVERIFY(!TunnelCompression::payloadCompressed(payload));
+    QCOMPARE(payload.size(), data.size() + 1);
+
+    // Invalid payloads
+    QVERIFY(!TunnelCompression::decodePayload(QByteArray(), &decodedData));
+    QVERIFY(!TunnelCompression::decodePayload(QByteArray(1, 0x02) + data, &decodedData));
+    QVERIFY(!TunnelCompression::decodePayload(QByteArray(1, static_cast<char>(TunnelCompression::PayloadFlagCompressed)) + QByteArray(16, 'x'), &decodedData));
+
+    // The size header gets checked against the limit before decompressing
+    QVERIFY(!TunnelCompression::decodePayload(TunnelCompression::encodePayload(data), &decodedData, data.size() - 1));
+    QVERIFY(TunnelCompression::decodePayload(TunnelCompression::encodePayload(data), &decodedData, data.size()));
+    QByteArray forgedPayload = TunnelCompression::encodePayload(QByteArray(4096, 'x'));
+    forgedPayload[1] = static_cast<char>(0xff);
+    QCOMPARE(TunnelCompression::decodedSize(forgedPayload), std::numeric_limits<int>::max());
+    QVERIFY(!TunnelCompression::decodePayload(forgedPayload, &decodedData, 4 * 1024 * 1024));
+}
+
+void RemoteProxyTestsTunnelProxy::compressedTunnels()
+{
+    startServer();
+
+    QByteArray json;
+    for (int i = 0; i < 50; i++)
+        json.append(QString("{\"id\":%1,\"notification\":\"Integrations.StateChanged\",\"params\":{}}\n").arg(i).toUtf8());
+
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Compressed server", this);
+    tunnelProxyServer->setCompressionEnabled(true);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QVariantMap initialCompressionMap = Engine::instance()->tunnelProxyServer()->compressionStatistics();
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+    QVERIFY(tunnelProxyServer->compressionActive());
+
+    // A multiplexed client negotiating compression as well, the proxy passes the frames through
+    TunnelProxyRemoteConnection *compressedConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Compressed client", this);
+    compressedConnection->setMultiplexingEnabled(true);
+    compressedConnection->setCompressionEnabled(true);
+    connect(compressedConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        compressedConnection->ignoreSslErrors(errors);
+    });
+
+    // A plain client, the proxy decompresses for it
+    TunnelProxyRemoteConnection *plainConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Plain client", this);
+    connect(plainConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        plainConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy tunnelOpenedSpy(compressedConnection, &TunnelProxyRemoteConnection::tunnelOpened);
+    compressedConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(tunnelOpenedSpy.wait());
+    QVERIFY(compressedConnection->compressionActive());
+    quint16 channel = tunnelOpenedSpy.at(0).at(0).value<quint16>();
+
+    QSignalSpy plainConnectedSpy(plainConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    plainConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(plainConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 2);
+
+    TunnelProxySocket *compressedSocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+    TunnelProxySocket *plainSocket = clientConnectedSpy.at(1).at(0).value<TunnelProxySocket *>();
+
+    // Server to compressed client
+    QByteArray receivedData;
+    connect(compressedConnection, &TunnelProxyRemoteConnection::tunnelDataReady, this, [&receivedData](quint16, const QByteArray &data){
+        receivedData.append(data);
+    });
+    compressedSocket->writeData(json);
+    QTRY_COMPARE(receivedData, json);
+
+    // Compressed client to server
+    QByteArray socketData;
+    connect(compressedSocket, &TunnelProxySocket::dataReceived, this, [&socketData](const QByteArray &data){
+        socketData.append(data);
+    });
+    QVERIFY(compressedConnection->sendTunnelData(channel, json));
+    QTRY_COMPARE(socketData, json);
+
+    // Server to plain client, the proxy decompresses
+    QByteArray plainData;
+    connect(plainConnection, &TunnelProxyRemoteConnection::dataReady, this, [&plainData](const QByteArray &data){
+        plainData.append(data);
+    });
+    plainSocket->writeData(json);
+    QTRY_COMPARE(plainData, json);
+
+    // Plain client to server, the proxy only flags the data
+    QByteArray plainSocketData;
+    connect(plainSocket, &TunnelProxySocket::dataReceived, this, [&plainSocketData](const QByteArray &data){
+        plainSocketData.append(data);
+    });
+    QVERIFY(plainConnection->sendData(json));
+    QTRY_COMPARE(plainSocketData, json);
+
+    QVariantMap compressionMap = Engine::instance()->tunnelProxyServer()->compressionStatistics();
+    QCOMPARE(compressionMap.value("compressedFrames").toInt() - initialCompressionMap.value("compressedFrames").toInt(), 3);
+    QCOMPARE(compressionMap.value("passThroughFrames").toInt() - initialCompressionMap.value("passThroughFrames").toInt(), 2);
+    QCOMPARE(compressionMap.value("decompressedFrames").toInt() - initialCompressionMap.value("decompressedFrames").toInt(), 1);
+    QCOMPARE(compressionMap.value("uncompressedBytes").toInt() - initialCompressionMap.value("uncompressedBytes").toInt(), 3 * json.size());
+    QVERIFY(compressionMap.value("ratio").toDouble() > 1.0);
+
+    compressedConnection->disconnectServer();
+    plainConnection->disconnectServer();
+    tunnelProxyServer->stopServer();
+    compressedConnection->deleteLater();
+    plainConnection->deleteLater();
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::cutThroughForwarding()
+{
+    startServer();
+
+    // Tunnel data is forwarded without buffering, only complete frames are limited
+    int maxFrameSize = Engine::instance()->configuration()->maxFrameSize();
+    Engine::instance()->configuration()->setMaxFrameSize(4096);
+
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    QUuid serverUuid = QUuid::createUuid();
+
+    QSslSocket *serverSocket = new QSslSocket(this);
+    QObject::connect(serverSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy serverEncryptedSpy(serverSocket, &QSslSocket::encrypted);
+    serverSocket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(serverEncryptedSpy.wait());
+
+    QByteArray serverRequests;
+    serverRequests.append("{\"id\":1,\"method\":\"RemoteProxy.Hello\"}\n");
+    serverRequests.append("{\"id\":2,\"method\":\"TunnelProxy.RegisterServer\",\"params\":{\"serverName\":\"Cut-through server\",\"serverUuid\":\"" + serverUuid.toString().toUtf8() + "\"}}\n");
+    serverSocket->write(serverRequests);
+
+    JsonStreamSplitter serverSplitter;
+    int serverResponsesCount = 0;
+    QSignalSpy serverDataSpy(serverSocket, &QSslSocket::readyRead);
+    while (serverResponsesCount < 2) {
+        if (serverSocket->bytesAvailable() == 0)
+            QVERIFY(serverDataSpy.wait());
+
+        serverSplitter.append(serverSocket->readAll());
+        QByteArray message = serverSplitter.takeMessage();
+        while (!message.isNull()) {
+            QCOMPARE(QJsonDocument::fromJson(message).toVariant().toMap().value("status").toString(), QString("success"));
+            serverResponsesCount++;
+            message = serverSplitter.takeMessage();
+        }
+    }
+
+    QSslSocket *clientSocket = new QSslSocket(this);
+    QObject::connect(clientSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy clientEncryptedSpy(clientSocket, &QSslSocket::encrypted);
+    clientSocket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(clientEncryptedSpy.wait());
+
+    QByteArray clientRequests;
+    clientRequests.append("{\"id\":1,\"method\":\"RemoteProxy.Hello\"}\n");
+    clientRequests.append("{\"id\":2,\"method\":\"TunnelProxy.RegisterClient\",\"params\":{\"clientName\":\"Cut-through client\",\"clientUuid\":\"" + QUuid::createUuid().toString().toUtf8() + "\",\"serverUuid\":\"" + serverUuid.toString().toUtf8() + "\"}}\n");
+    clientSocket->write(clientRequests);
+
+    JsonStreamSplitter clientSplitter;
+    int clientResponsesCount = 0;
+    QSignalSpy clientDataSpy(clientSocket, &QSslSocket::readyRead);
+    while (clientResponsesCount < 2) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        clientSplitter.append(clientSocket->readAll());
+        QByteArray message = clientSplitter.takeMessage();
+        while (!message.isNull()) {
+            QCOMPARE(QJsonDocument::fromJson(message).toVariant().toMap().value("status").toString(), QString("success"));
+            clientResponsesCount++;
+            message = clientSplitter.takeMessage();
+        }
+    }
+
+    QList<SlipDataProcessor::Frame> frames;
+    QByteArray slipBuffer;
+    auto waitForFrame = [&]() -> bool {
+        while (frames.isEmpty()) {
+            if (serverSocket->bytesAvailable() == 0 && !serverDataSpy.wait())
+                return false;
+
+            QByteArray data = serverSocket->readAll();
+            for (int i = 0; i < data.length(); i++) {
+                if (static_cast<quint8>(data.at(i)) == SlipDataProcessor::ProtocolByteEnd) {
+                    if (!slipBuffer.isEmpty())
+                        frames.append(SlipDataProcessor::parseFrame(SlipDataProcessor::deserializeData(slipBuffer)));
+
+                    slipBuffer.clear();
+                } else {
+                    slipBuffer.append(data.at(i));
+                }
+            }
+        }
+        return true;
+    };
+
+    QVERIFY(waitForFrame());
+    SlipDataProcessor::Frame frame = frames.takeFirst();
+    QVariantMap notification = QJsonDocument::fromJson(frame.data).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("TunnelProxy.ClientConnected"));
+    quint16 socketAddress = static_cast<quint16>(notification.value("params").toMap().value("socketAddress").toUInt());
+
+    // A frame much larger than the maximum frame size, containing bytes which need to be escaped
+    QByteArray payload;
+    for (int i = 0; i < 65536; i++) {
+        payload.append(static_cast<char>(i % 256));
+    }
+
+    frame.socketAddress = socketAddress;
+    frame.data = payload;
+    QByteArray serializedFrame = SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame));
+
+    // The client receives data before the frame has been completed
+    QByteArray receivedData;
+    serverSocket->write(serializedFrame.left(serializedFrame.size() / 2));
+    while (receivedData.isEmpty()) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        receivedData.append(clientSocket->readAll());
+    }
+    QVERIFY(receivedData.size() < payload.size());
+    QVERIFY(payload.startsWith(receivedData));
+
+    serverSocket->write(serializedFrame.mid(serializedFrame.size() / 2));
+    while (receivedData.size() < payload.size()) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        receivedData.append(clientSocket->readAll());
+    }
+    QCOMPARE(receivedData, payload);
+
+    // Frames exceeding the maximum frame size and frames without destination get discarded
+    frame.socketAddress = SlipDataProcessor::SocketAddressJsonRpc;
+    frame.data = QByteArray(8192, '{');
+    serverSocket->write(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
+    frame.socketAddress = static_cast<quint16>(socketAddress + 1);
+    frame.data = payload;
+    serverSocket->write(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
+
+    // ...and the stream continues with the next frame
+    frame.socketAddress = SlipDataProcessor::SocketAddressJsonRpc;
+    frame.data = "{\"id\":3,\"method\":\"TunnelProxy.Ping\",\"params\":{\"timestamp\":1234}}\n";
+    serverSocket->write(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
+
+    QVERIFY(waitForFrame());
+    frame = frames.takeFirst();
+    QCOMPARE(frame.socketAddress, static_cast<quint16>(SlipDataProcessor::SocketAddressJsonRpc));
+    QVariantMap response = QJsonDocument::fromJson(frame.data).toVariant().toMap();
+    QCOMPARE(response.value("id").toInt(), 3);
+    QCOMPARE(response.value("status").toString(), QString("success"));
+
+    // An inconsistent escape after parts of a frame have been forwarded closes the client connection
+    frame.socketAddress = socketAddress;
+    frame.data = "Partial tunnel data";
+    serializedFrame = SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame));
+    serializedFrame.chop(1);
+    serverSocket->write(serializedFrame);
+    receivedData.clear();
+    while (receivedData.size() < frame.data.size()) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        receivedData.append(clientSocket->readAll());
+    }
+    QCOMPARE(receivedData, frame.data);
+
+    QByteArray brokenData;
+    brokenData.append(static_cast<char>(SlipDataProcessor::ProtocolByteEsc));
+    brokenData.append("Broken tunnel data");
+    brokenData.append(static_cast<char>(SlipDataProcessor::ProtocolByteEnd));
+    serverSocket->write(brokenData);
+    QTRY_COMPARE(clientSocket->state(), QAbstractSocket::UnconnectedState);
+
+    QVERIFY(waitForFrame());
+    notification = QJsonDocument::fromJson(frames.takeFirst().data).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("TunnelProxy.ClientDisconnected"));
+    QCOMPARE(notification.value("params").toMap().value("socketAddress").toUInt(), static_cast<uint>(socketAddress));
+
+    Engine::instance()->configuration()->setMaxFrameSize(maxFrameSize);
+
+    clientSocket->close();
+    serverSocket->close();
+    clientSocket->deleteLater();
+    serverSocket->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::slipFrameSlices_data()
+{
+    QTest::addColumn<quint16>("socketAddress");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("shared");
+
+    QTest::newRow("json") << static_cast<quint16>(0x0000) << QByteArray("{\"id\":1,\"status\":\"success\"}") << true;
+    QTest::newRow("escaped data") << static_cast<quint16>(0x0001) << QByteArray::fromHex("01c002db03c0db") << false;
+    QTest::newRow("escaped address") << static_cast<quint16>(0xc0db) << QByteArray("tunnel data") << true;
+    QTest::newRow("empty") << static_cast<quint16>(0x0002) << QByteArray() << true;
+}
+
+void RemoteProxyTestsTunnelProxy::slipFrameSlices()
+{
+    QFETCH(quint16, socketAddress);
+    QFETCH(QByteArray, data);
+    QFETCH(bool, shared);
+
+    SlipDataProcessor::Frame frame;
+    frame.socketAddress = socketAddress;
+    frame.data = data + "\n";
+    QByteArray expectedData = SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame));
+
+    QByteArray delimiter = "\n";
+    QList<QByteArray> slices = SlipDataProcessor::serializeFrameSlices(socketAddress, QList<QByteArray>() << data << delimiter);
+    QByteArray serializedData;
+    foreach (const QByteArray &slice, slices)
+        serializedData.append(slice);
+
+    QCOMPARE(serializedData, expectedData);
+
+    // Slices which don't need escaping are not copied
+    if (!data.isEmpty()) {
+        QCOMPARE(slices.at(1).constData() == data.constData(), shared);
+    }
+
+    // The receiving side decodes the frame again
+    frame = SlipDataProcessor::parseFrame(SlipDataProcessor::deserializeData(serializedData));
+    QCOMPARE(frame.socketAddress, socketAddress);
+    QCOMPARE(frame.data, data + "\n");
+}
+
+
+void RemoteProxyTestsTunnelProxy::outputCorking()
+{
+    startServer();
+
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    QUuid serverUuid = QUuid::createUuid();
+
+    QSslSocket *serverSocket = new QSslSocket(this);
+    QObject::connect(serverSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy serverEncryptedSpy(serverSocket, &QSslSocket::encrypted);
+    serverSocket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(serverEncryptedSpy.wait());
+
+    QByteArray serverRequests;
+    serverRequests.append("{\"id\":1,\"method\":\"RemoteProxy.Hello\"}\n");
+    serverRequests.append("{\"id\":2,\"method\":\"TunnelProxy.RegisterServer\",\"params\":{\"serverName\":\"Cork server\",\"serverUuid\":\"" + serverUuid.toString().toUtf8() + "\"}}\n");
+    serverSocket->write(serverRequests);
+
+    // Both responses are written within one event loop pass
+    JsonStreamSplitter serverSplitter;
+    int serverResponsesCount = 0;
+    QSignalSpy serverDataSpy(serverSocket, &QSslSocket::readyRead);
+    while (serverResponsesCount < 2) {
+        if (serverSocket->bytesAvailable() == 0)
+            QVERIFY(serverDataSpy.wait());
+
+        serverSplitter.append(serverSocket->readAll());
+        QByteArray message = serverSplitter.takeMessage();
+        while (!message.isNull()) {
+            QCOMPARE(QJsonDocument::fromJson(message).toVariant().toMap().value("status").toString(), QString("success"));
+            serverResponsesCount++;
+            message = serverSplitter.takeMessage();
+        }
+    }
+
+    QSslSocket *clientSocket = new QSslSocket(this);
+    QObject::connect(clientSocket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &BaseTest::sslSocketSslErrors);
+    QSignalSpy clientEncryptedSpy(clientSocket, &QSslSocket::encrypted);
+    clientSocket->connectToHostEncrypted(m_serverUrlTunnelProxyTcp.host(), static_cast<quint16>(m_serverUrlTunnelProxyTcp.port()));
+    QVERIFY(clientEncryptedSpy.wait());
+
+    QByteArray clientRequests;
+    clientRequests.append("{\"id\":1,\"method\":\"RemoteProxy.Hello\"}\n");
+    clientRequests.append("{\"id\":2,\"method\":\"TunnelProxy.RegisterClient\",\"params\":{\"clientName\":\"Cork client\",\"clientUuid\":\"" + QUuid::createUuid().toString().toUtf8() + "\",\"serverUuid\":\"" + serverUuid.toString().toUtf8() + "\"}}\n");
+    clientSocket->write(clientRequests);
+
+    JsonStreamSplitter clientSplitter;
+    int clientResponsesCount = 0;
+    QSignalSpy clientDataSpy(clientSocket, &QSslSocket::readyRead);
+    while (clientResponsesCount < 2) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        clientSplitter.append(clientSocket->readAll());
+        QByteArray message = clientSplitter.takeMessage();
+        while (!message.isNull()) {
+            QCOMPARE(QJsonDocument::fromJson(message).toVariant().toMap().value("status").toString(), QString("success"));
+            clientResponsesCount++;
+            message = clientSplitter.takeMessage();
+        }
+    }
+
+    QByteArray slipBuffer;
+    SlipDataProcessor::Frame frame;
+    while (slipBuffer.isEmpty() || static_cast<quint8>(slipBuffer.at(slipBuffer.size() - 1)) != SlipDataProcessor::ProtocolByteEnd) {
+        if (serverSocket->bytesAvailable() == 0)
+            QVERIFY(serverDataSpy.wait());
+
+        slipBuffer.append(serverSocket->readAll());
+    }
+    frame = SlipDataProcessor::parseFrame(SlipDataProcessor::deserializeData(slipBuffer));
+    QVariantMap notification = QJsonDocument::fromJson(frame.data).toVariant().toMap();
+    QCOMPARE(notification.value("notification").toString(), QString("TunnelProxy.ClientConnected"));
+    quint16 socketAddress = static_cast<quint16>(notification.value("params").toMap().value("socketAddress").toUInt());
+
+    // 100 small frames in one chunk end up in far less writes to the client socket
+    TransportInterface *transportInterface = Engine::instance()->tcpSocketServerTunnelProxy();
+    quint64 writeCount = transportInterface->writeCount();
+
+    QByteArray expectedData;
+    QByteArray frames;
+    frame.socketAddress = socketAddress;
+    for (int i = 0; i < 100; i++) {
+        frame.data = QByteArray::number(i).rightJustified(10, '0');
+        expectedData.append(frame.data);
+        frames.append(SlipDataProcessor::serializeData(SlipDataProcessor::buildFrame(frame)));
+    }
+    serverSocket->write(frames);
+
+    QByteArray receivedData;
+    while (receivedData.size() < expectedData.size()) {
+        if (clientSocket->bytesAvailable() == 0)
+            QVERIFY(clientDataSpy.wait());
+
+        receivedData.append(clientSocket->readAll());
+    }
+    QCOMPARE(receivedData, expectedData);
+    QVERIFY2(transportInterface->writeCount() - writeCount < 10, QString("Writes: %1").arg(transportInterface->writeCount() - writeCount).toUtf8());
+
+    QVariantMap averageWriteSizes = Engine::instance()->tunnelProxyServer()->currentStatistics().value("averageWriteSize").toMap();
+    QVERIFY(averageWriteSizes.value(transportInterface->serverName()).toDouble() > 0);
+
+    clientSocket->close();
+    serverSocket->close();
+    clientSocket->deleteLater();
+    serverSocket->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::readBufferPool()
+{
+    // One socket read per forwarded packet
+    const int iterations = 1000;
+    QList<QBuffer *> devices;
+    for (int i = 0; i < iterations; i++) {
+        QBuffer *device = new QBuffer(this);
+        device->setData(QByteArray(1024, static_cast<char>(i % 256)));
+        QVERIFY(device->open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+        devices.append(device);
+    }
+
+    int checksum = 0;
+    quint64 readAllAllocations = 0;
+    AllocationCounter::start();
+    foreach (QBuffer *device, devices) {
+        QByteArray data = device->readAll();
+        checksum += data.at(0);
+    }
+    readAllAllocations = AllocationCounter::stop();
+
+    foreach (QBuffer *device, devices)
+        device->seek(0);
+
+    BufferPool bufferPool(16384, 4);
+    int pooledChecksum = 0;
+    quint64 poolAllocations = 0;
+    AllocationCounter::start();
+    foreach (QBuffer *device, devices) {
+        QByteArray data = bufferPool.read(device);
+        pooledChecksum += data.at(0);
+    }
+    poolAllocations = AllocationCounter::stop();
+
+    QCOMPARE(pooledChecksum, checksum);
+    QCOMPARE(bufferPool.buffersCount(), 1);
+    QCOMPARE(bufferPool.allocationsCount(), static_cast<quint64>(1));
+
+    // Buffers still referenced by a slice are not reused
+    foreach (QBuffer *device, devices)
+        device->seek(0);
+
+    QList<QByteArray> slices;
+    for (int i = 0; i < 6; i++) {
+        slices.append(bufferPool.read(devices.at(i)));
+        QCOMPARE(slices.last(), devices.at(i)->data());
+    }
+    QCOMPARE(bufferPool.buffersCount(), 4);
+    QCOMPARE(bufferPool.freeBuffersCount(), 0);
+    QCOMPARE(bufferPool.allocationsCount(), static_cast<quint64>(6));
+
+    slices.clear();
+    QCOMPARE(bufferPool.freeBuffersCount(), 4);
+
+    qDeleteAll(devices);
+
+    if (!AllocationCounter::supported())
+        QSKIP("Counting allocations is not supported on this platform.");
+
+    qDebug() << "Allocations per packet:" << (static_cast<double>(readAllAllocations) / iterations) << "readAll(),"
+             << (static_cast<double>(poolAllocations) / iterations) << "buffer pool";
+    QVERIFY(poolAllocations < readAllAllocations);
+}
+
+
+void RemoteProxyTestsTunnelProxy::trafficCounters()
+{
+    startServer();
+
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Counter server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Counter client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+
+    auto serverStatistics = [&]() -> QVariantMap {
+        foreach (const QVariant &serverVariant, Engine::instance()->tunnelProxyServer()->currentStatistics(true).value("tunnelConnections").toList()) {
+            if (serverVariant.toMap().value("serverUuid").toUuid() == serverUuid)
+                return serverVariant.toMap();
+        }
+        return QVariantMap();
+    };
+
+    QVariantMap serverMap = serverStatistics();
+    quint64 serverRxFrames = serverMap.value("rxFrameCount").toULongLong();
+    quint64 serverRxBytes = serverMap.value("rxDataCount").toULongLong();
+    QVERIFY(serverRxFrames > 0);
+    QCOMPARE(serverMap.value("clientConnections").toList().count(), 1);
+    quint64 clientTxFrames = serverMap.value("clientConnections").toList().first().toMap().value("txFrameCount").toULongLong();
+
+    // Every frame from the server is counted on the server transport and forwarded as one packet to the client
+    QSignalSpy dataReadySpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    for (int i = 0; i < 3; i++) {
+        tunnelProxySocket->writeData("Frame " + QByteArray::number(i));
+        QVERIFY(dataReadySpy.wait());
+    }
+
+    serverMap = serverStatistics();
+    QCOMPARE(serverMap.value("rxFrameCount").toULongLong(), serverRxFrames + 3);
+    QVERIFY(serverMap.value("rxDataCount").toULongLong() > serverRxBytes);
+    QCOMPARE(serverMap.value("clientConnections").toList().first().toMap().value("txFrameCount").toULongLong(), clientTxFrames + 3);
+
+    remoteConnection->disconnectServer();
+    remoteConnection->deleteLater();
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::slabAllocator()
+{
+    struct SlabTestObject {
+        quint64 values[5];
+    };
+
+    typedef SlabAllocator<SlabTestObject, 4> TestAllocator;
+    TestAllocator &allocator = TestAllocator::instance();
+    QCOMPARE(allocator.usedSlots(), 0);
+    QCOMPARE(allocator.totalSlots(), 0);
+    QVERIFY(allocator.slotSize() >= static_cast<int>(sizeof(SlabTestObject)));
+
+    // Allocating more objects than fit into one chunk reserves the next chunk
+    QList<void *> objects;
+    for (int i = 0; i < 5; i++) {
+        objects.append(allocator.allocate(sizeof(SlabTestObject)));
+    }
+
+    QCOMPARE(allocator.usedSlots(), 5);
+    QCOMPARE(allocator.totalSlots(), 8);
+    QCOMPARE(allocator.reservedBytes(), static_cast<qint64>(8 * allocator.slotSize()));
+
+    // A released slot gets reused without growing
+    void *releasedObject = objects.takeAt(1);
+    allocator.release(releasedObject, sizeof(SlabTestObject));
+    QCOMPARE(allocator.usedSlots(), 4);
+    void *reusedObject = allocator.allocate(sizeof(SlabTestObject));
+    QVERIFY(reusedObject == releasedObject);
+    objects.append(reusedObject);
+    QCOMPARE(allocator.totalSlots(), 8);
+
+    // Other sizes (i.e. derived classes) do not use the slots
+    void *largerObject = allocator.allocate(sizeof(SlabTestObject) + 8);
+    QVERIFY(largerObject);
+    QCOMPARE(allocator.usedSlots(), 5);
+    allocator.release(largerObject, sizeof(SlabTestObject) + 8);
+    QCOMPARE(allocator.usedSlots(), 5);
+
+    foreach (void *object, objects) {
+        allocator.release(object, sizeof(SlabTestObject));
+    }
+
+    QCOMPARE(allocator.usedSlots(), 0);
+    QCOMPARE(allocator.totalSlots(), 8);
+}
+
+void RemoteProxyTestsTunnelProxy::memoryReport()
+{
+    startServer();
+
+    int serverConnectionSlots = SlabAllocator<TunnelProxyServerConnection>::instance().usedSlots();
+
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Memory server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    QVariantMap memoryReport = Engine::instance()->buildMemoryReport();
+    QCOMPARE(memoryReport.value("idleServerConnectionsCount").toInt(), 1);
+    QCOMPARE(memoryReport.value("activeTunnelsCount").toInt(), 0);
+    QVERIFY(memoryReport.value("totalClientCount").toInt() >= 1);
+#ifdef Q_OS_LINUX
+    QVERIFY(memoryReport.value("residentBytes").toLongLong() > 0);
+#endif
+
+    // The registered server lives in the slab of its type
+    QVariantMap slabsMap = memoryReport.value("slabs").toMap();
+    QCOMPARE(slabsMap.value("TunnelProxyServerConnection").toMap().value("usedSlots").toInt(), serverConnectionSlots + 1);
+    QVERIFY(slabsMap.value("TunnelProxyClient").toMap().value("usedSlots").toInt() >= 1);
+    QVERIFY(slabsMap.value("TunnelProxyClient").toMap().value("totalSlots").toInt() >= slabsMap.value("TunnelProxyClient").toMap().value("usedSlots").toInt());
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    // The slot gets released with the connection
+    QTRY_COMPARE(SlabAllocator<TunnelProxyServerConnection>::instance().usedSlots(), serverConnectionSlots);
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::idleCompaction()
+{
+    // Squeezing keeps the unconsumed data
+    JsonStreamSplitter splitter;
+    splitter.append(QByteArray(64 * 1024, 'a') + "\n{\"id\":1");
+    QCOMPARE(splitter.takeMessage().size(), 64 * 1024);
+    QVERIFY(splitter.squeeze() > 0);
+    QCOMPARE(splitter.size(), 7);
+    splitter.append("}\n");
+    QCOMPARE(splitter.takeMessage(), QByteArray("{\"id\":1}"));
+
+    startServer();
+    Engine::instance()->configuration()->setIdleCompactionTime(1000);
+
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Compaction server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    // The idle server gets compacted by the engine tick
+    QTRY_VERIFY_WITH_TIMEOUT(Engine::instance()->tunnelProxyServer()->compactionStatistics().value("compactedConnections").toInt() >= 1, 5000);
+    QVariantMap compactionMap = Engine::instance()->buildMonitorData().value("compaction").toMap();
+    QVERIFY(compactionMap.value("compactions").toULongLong() >= 1);
+    QCOMPARE(compactionMap.value("idleTime").toInt(), 1000);
+
+    // The compacted server still accepts tunnels and forwards data
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Compaction client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+
+    QByteArray receivedData;
+    connect(remoteConnection, &TunnelProxyRemoteConnection::dataReady, this, [&receivedData](const QByteArray &data){
+        receivedData.append(data);
+    });
+
+    QByteArray data(32 * 1024, 'c');
+    tunnelProxySocket->writeData(data);
+    QTRY_COMPARE(receivedData, data);
+
+    remoteConnection->disconnectServer();
+    remoteConnection->deleteLater();
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::metricsEndpoint()
+{
+    // The exported buckets are cumulative up to the power of two bounds
+    LogHistogram histogram;
+    histogram.record(50);
+    histogram.record(100);
+    histogram.record(101);
+    histogram.record(20000000);
+    QList<QPair<qint64, quint64>> cumulativeCounts = histogram.cumulativeCounts();
+    QVERIFY(cumulativeCounts.contains(qMakePair(static_cast<qint64>(63), static_cast<quint64>(1))));
+    QVERIFY(cumulativeCounts.contains(qMakePair(static_cast<qint64>(127), static_cast<quint64>(3))));
+    QCOMPARE(cumulativeCounts.last().second, static_cast<quint64>(4));
+    QCOMPARE(histogram.count(), static_cast<quint64>(4));
+    QCOMPARE(histogram.sum(), static_cast<qint64>(20000251));
+
+    startServer();
+
+    QVERIFY(Engine::instance()->metricsServer());
+    QVERIFY(Engine::instance()->metricsServer()->running());
+
+    // Create a tunnel and send some data through it
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Metrics server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Metrics client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+
+    QSignalSpy dataReadySpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    tunnelProxySocket->writeData("Metrics data");
+    QVERIFY(dataReadySpy.wait());
+
+    auto httpGet = [](const QByteArray &path) -> QByteArray {
+        QTcpSocket socket;
+        connect(&socket, &QTcpSocket::connected, &socket, [&socket, path](){
+            socket.write("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        });
+
+        QSignalSpy disconnectedSpy(&socket, &QTcpSocket::disconnected);
+        socket.connectToHost(QHostAddress::LocalHost, Engine::instance()->metricsServer()->serverPort());
+        disconnectedSpy.wait();
+        return socket.readAll();
+    };
+
+    QByteArray response = httpGet("/metrics");
+    QVERIFY2(response.startsWith("HTTP/1.1 200 OK\r\n"), response.constData());
+    QVERIFY(response.contains("Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"));
+    QVERIFY(response.endsWith("# EOF\n"));
+
+    QByteArray metrics = response.mid(response.indexOf("\r\n\r\n") + 4);
+    QVERIFY(metrics.contains("# TYPE nymea_remoteproxy_transport_accepted_connections counter\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_transport_accepted_connections_total{transport=\"TCP\"} 2\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_transport_received_frames_total{transport=\"TCP\"} "));
+    QVERIFY(metrics.contains("nymea_remoteproxy_transport_connections{transport=\"TCP\"} 2\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_registered_servers 1\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_registered_clients 1\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_pending_handshakes "));
+    QVERIFY(metrics.contains("nymea_remoteproxy_buffered_bytes "));
+    QVERIFY(metrics.contains("# TYPE nymea_remoteproxy_registration_latency_seconds histogram\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_registration_latency_seconds_count 2\n"));
+    QVERIFY(metrics.contains("# TYPE nymea_remoteproxy_forwarding_latency_seconds histogram\n"));
+    QVERIFY(metrics.contains("nymea_remoteproxy_forwarding_latency_seconds_bucket{transport=\"TCP\",direction=\"server_to_client\",le=\"+Inf\"} "));
+    QVERIFY(!metrics.contains("nymea_remoteproxy_forwarding_latency_seconds_count{transport=\"TCP\",direction=\"server_to_client\"} 0\n"));
+
+    QVERIFY(httpGet("/other").startsWith("HTTP/1.1 404 Not Found\r\n"));
+
+    remoteConnection->disconnectServer();
+    remoteConnection->deleteLater();
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::forwardingLatency()
+{
+    // Small values are exact, larger ones keep the sub bucket precision
+    QCOMPARE(LogHistogram::bucketIndex(0), 0);
+    QCOMPARE(LogHistogram::bucketIndex(15), 15);
+    QCOMPARE(LogHistogram::bucketIndex(16), 16);
+    QCOMPARE(LogHistogram::bucketUpperBound(LogHistogram::bucketIndex(32)), static_cast<qint64>(33));
+    QCOMPARE(LogHistogram::bucketUpperBound(LogHistogram::bucketIndex(1000)), static_cast<qint64>(1023));
+    for (qint64 value = 1; value < 100000000; value = value * 3 + 1) {
+        qint64 upperBound = LogHistogram::bucketUpperBound(LogHistogram::bucketIndex(value));
+        QVERIFY(upperBound >= value);
+        QVERIFY(upperBound - value <= value / 16);
+    }
+
+    LogHistogram histogram;
+    QCOMPARE(histogram.percentile(50), static_cast<qint64>(0));
+    for (int i = 1; i <= 1000; i++)
+        histogram.record(i);
+
+    QCOMPARE(histogram.count(), static_cast<quint64>(1000));
+    QCOMPARE(histogram.max(), static_cast<qint64>(1000));
+    QVERIFY(qAbs(histogram.percentile(50) - 500) <= 500 / 16);
+    QVERIFY(qAbs(histogram.percentile(99) - 990) <= 990 / 16);
+    QCOMPARE(histogram.percentile(100), static_cast<qint64>(1000));
+    QCOMPARE(histogram.cumulativeCounts().last().second, static_cast<quint64>(1000));
+
+    startServer();
+
+    TransportInterface *transportInterface = Engine::instance()->tcpSocketServerTunnelProxy();
+    quint64 clientToServerCount = transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionClientToServer).count();
+    quint64 serverToClientCount = transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionServerToClient).count();
+
+    // Create a tunnel and send data in both directions
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Latency server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Latency client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+
+    QSignalSpy dataReadySpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    tunnelProxySocket->writeData("Server data");
+    QVERIFY(dataReadySpy.wait());
+
+    QSignalSpy dataReceivedSpy(tunnelProxySocket, &TunnelProxySocket::dataReceived);
+    QVERIFY(remoteConnection->sendData("Client data"));
+    QVERIFY(dataReceivedSpy.wait());
+
+    QVERIFY(transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionClientToServer).count() > clientToServerCount);
+    QVERIFY(transportInterface->forwardingLatency(TransportInterface::ForwardingDirectionServerToClient).count() > serverToClientCount);
+
+    // The percentiles are part of the monitor data
+    QVariantMap forwardingLatencies = Engine::instance()->tunnelProxyServer()->currentStatistics().value("forwardingLatency").toMap();
+    QVariantMap latencyMap = forwardingLatencies.value(transportInterface->serverName()).toMap().value("serverToClient").toMap();
+    QVERIFY(latencyMap.value("count").toULongLong() > 0);
+    QVERIFY(latencyMap.contains("p50"));
+    QVERIFY(latencyMap.contains("p99"));
+    QVERIFY(latencyMap.contains("p999"));
+    QVERIFY(latencyMap.value("p50").toLongLong() <= latencyMap.value("p999").toLongLong());
+
+    remoteConnection->disconnectServer();
+    remoteConnection->deleteLater();
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::monitorSubscription()
+{
+    startServer();
+    Engine::instance()->configuration()->setMonitorUpdateInterval(100);
+
+    QUuid serverUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Subscription server", this);
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    QLocalSocket *monitor = new QLocalSocket(this);
+    QSignalSpy connectedSpy(monitor, &QLocalSocket::connected);
+    monitor->connectToServer(m_configuration->monitorSocketFileName());
+    if (connectedSpy.count() < 1) connectedSpy.wait();
+    QVERIFY(connectedSpy.count() == 1);
+
+    QByteArray monitorBuffer;
+    auto nextMessage = [&]() -> QVariantMap {
+        QSignalSpy readyReadSpy(monitor, &QLocalSocket::readyRead);
+        monitorBuffer.append(monitor->readAll());
+        while (!monitorBuffer.contains('\n')) {
+            if (!readyReadSpy.wait())
+                return QVariantMap();
+
+            monitorBuffer.append(monitor->readAll());
+        }
+
+        int index = monitorBuffer.indexOf('\n');
+        QVariantMap message = QJsonDocument::fromJson(monitorBuffer.left(index)).toVariant().toMap();
+        monitorBuffer.remove(0, index + 1);
+        return message;
+    };
+
+    // Skip the updates until one contains the given change
+    auto nextChange = [&](const QString &key) -> QVariantMap {
+        for (int i = 0; i < 50; i++) {
+            QVariantMap message = nextMessage();
+            if (message.isEmpty())
+                break;
+
+            if (!message.value(key).toList().isEmpty() || !message.value(key).toMap().isEmpty())
+                return message;
+        }
+        return QVariantMap();
+    };
+
+    // With printAll the snapshot contains all servers, also the ones without clients
+    QVariantMap request;
+    request.insert("method", "subscribe");
+    request.insert("params", QVariantMap({{"printAll", true}}));
+    monitor->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
+
+    QVariantMap snapshot = nextMessage();
+    QCOMPARE(snapshot.value("type").toString(), QString("snapshot"));
+    QVariantList tunnelConnections = snapshot.value("tunnelProxyStatistic").toMap().value("tunnelConnections").toList();
+    QCOMPARE(tunnelConnections.count(), 1);
+    QCOMPARE(QUuid(tunnelConnections.first().toMap().value("serverUuid").toString()), serverUuid);
+
+    // Without it only the active servers
+    request.remove("params");
+    monitor->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
+    snapshot = nextMessage();
+    for (int i = 0; i < 50 && !snapshot.isEmpty() && snapshot.value("type").toString() != "snapshot"; i++)
+        snapshot = nextMessage();
+
+    QCOMPARE(snapshot.value("type").toString(), QString("snapshot"));
+    QVERIFY(snapshot.value("tunnelProxyStatistic").toMap().value("tunnelConnections").toList().isEmpty());
+
+    // A new tunnel shows up as added client with the server it belongs to
+    QUuid clientUuid = QUuid::createUuid();
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(clientUuid, "Subscription client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+
+    QVariantMap update = nextChange("clientsAdded");
+    QCOMPARE(update.value("type").toString(), QString("delta"));
+    QVERIFY(!update.value("tunnelProxyStatistic").toMap().contains("tunnelConnections"));
+    QCOMPARE(update.value("tunnelProxyStatistic").toMap().value("clientConnectionsCount").toInt(), 1);
+    QVariantMap clientMap = update.value("clientsAdded").toList().first().toMap();
+    QCOMPARE(QUuid(clientMap.value("clientUuid").toString()), clientUuid);
+    QCOMPARE(QUuid(clientMap.value("serverUuid").toString()), serverUuid);
+
+    // The server got its first tunnel, monitors showing only the active servers get it as added server
+    QCOMPARE(update.value("serversAdded").toList().count(), 1);
+    QCOMPARE(QUuid(update.value("serversAdded").toList().first().toMap().value("serverUuid").toString()), serverUuid);
+
+    // Traffic updates only the counters of the tunnel
+    QSignalSpy dataReadySpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    tunnelProxySocket->writeData("Subscription data");
+    QVERIFY(dataReadySpy.wait());
+
+    update = nextChange("clientCounters");
+    QVERIFY(update.value("clientsAdded").toList().isEmpty());
+    QVariantMap clientCounters = update.value("clientCounters").toMap();
+    QCOMPARE(clientCounters.count(), 1);
+    QCOMPARE(QUuid(clientCounters.keys().first()), clientUuid);
+    QVERIFY(clientCounters.first().toMap().value("txDataCount").toULongLong() > 0);
+
+    // ...and of its server, the traffic of the server transport might be counted in the next update
+    QVariantMap serverCounters = update.value("serverCounters").toMap();
+    if (serverCounters.isEmpty())
+        serverCounters = nextChange("serverCounters").value("serverCounters").toMap();
+
+    QVERIFY(serverCounters.contains(serverUuid.toString()));
+
+    // Closing the tunnel removes the client
+    remoteConnection->disconnectServer();
+    update = nextChange("clientsRemoved");
+    QCOMPARE(update.value("clientsRemoved").toList().count(), 1);
+    QCOMPARE(QUuid(update.value("clientsRemoved").toList().first().toString()), clientUuid);
+    remoteConnection->deleteLater();
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    update = nextChange("serversRemoved");
+    QCOMPARE(QUuid(update.value("serversRemoved").toList().first().toString()), serverUuid);
+
+    monitor->disconnectFromServer();
+    monitor->deleteLater();
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::monitorQuery()
+{
+    startServer();
+
+    QList<TunnelProxySocketServer *> tunnelProxyServers;
+    QList<QUuid> serverUuids;
+    foreach (const QString &serverName, QStringList() << "Query alpha" << "Query beta" << "Other gamma") {
+        QUuid serverUuid = QUuid::createUuid();
+        TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, serverName, this);
+        connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+            tunnelProxyServer->ignoreSslErrors(errors);
+        });
+
+        QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+        tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+        QVERIFY(serverRunningSpy.wait());
+        tunnelProxyServers.append(tunnelProxyServer);
+        serverUuids.append(serverUuid);
+    }
+
+    QLocalSocket *monitor = new QLocalSocket(this);
+    QSignalSpy connectedSpy(monitor, &QLocalSocket::connected);
+    monitor->connectToServer(m_configuration->monitorSocketFileName());
+    if (connectedSpy.count() < 1) connectedSpy.wait();
+    QVERIFY(connectedSpy.count() == 1);
+
+    auto query = [&](const QVariantMap &params) -> QVariantMap {
+        QVariantMap request;
+        request.insert("method", "refresh");
+        QVariantMap requestParams = params;
+        requestParams.insert("printAll", true);
+        request.insert("params", requestParams);
+
+        QSignalSpy readyReadSpy(monitor, &QLocalSocket::readyRead);
+        monitor->write(QJsonDocument::fromVariant(request).toJson(QJsonDocument::Compact) + "\n");
+        QByteArray data;
+        while (!data.contains('\n')) {
+            if (readyReadSpy.isEmpty() && !readyReadSpy.wait())
+                return QVariantMap();
+
+            readyReadSpy.clear();
+            data.append(monitor->readAll());
+        }
+
+        return QJsonDocument::fromJson(data).toVariant().toMap().value("tunnelProxyStatistic").toMap();
+    };
+
+    auto resultUuids = [](const QVariantMap &statistics) -> QList<QUuid> {
+        QList<QUuid> uuids;
+        foreach (const QVariant &serverVariant, statistics.value("tunnelConnections").toList())
+            uuids.append(QUuid(serverVariant.toMap().value("serverUuid").toString()));
+
+        return uuids;
+    };
+
+    // Name prefix, case insensitive
+    QVariantMap params;
+    params.insert("name", "query");
+    QVariantMap statistics = query(params);
+    QList<QUuid> uuids = resultUuids(statistics);
+    QCOMPARE(uuids.count(), 2);
+    QVERIFY(uuids.contains(serverUuids.at(0)));
+    QVERIFY(uuids.contains(serverUuids.at(1)));
+    QCOMPARE(statistics.value("query").toMap().value("count").toInt(), 2);
+    QCOMPARE(statistics.value("query").toMap().value("more").toBool(), false);
+
+    // Uuid prefix
+    params.clear();
+    params.insert("uuid", serverUuids.at(2).toString().mid(1, 8));
+    uuids = resultUuids(query(params));
+    QCOMPARE(uuids.count(), 1);
+    QCOMPARE(uuids.first(), serverUuids.at(2));
+
+    // Subnet
+    params.clear();
+    params.insert("address", "127.0.0.0/8");
+    QCOMPARE(resultUuids(query(params)).count(), 3);
+    params.insert("address", "10.0.0.0/8");
+    QCOMPARE(resultUuids(query(params)).count(), 0);
+
+    // Pages
+    params.clear();
+    params.insert("limit", 2);
+    statistics = query(params);
+    QList<QUuid> firstPage = resultUuids(statistics);
+    QCOMPARE(firstPage.count(), 2);
+    QCOMPARE(statistics.value("query").toMap().value("more").toBool(), true);
+
+    params.insert("offset", 2);
+    statistics = query(params);
+    QList<QUuid> secondPage = resultUuids(statistics);
+    QCOMPARE(secondPage.count(), 1);
+    QCOMPARE(statistics.value("query").toMap().value("more").toBool(), false);
+    QVERIFY(!firstPage.contains(secondPage.first()));
+
+    // Sorted descending by the received data
+    params.clear();
+    params.insert("sortBy", "rxDataCount");
+    QVariantList tunnelConnections = query(params).value("tunnelConnections").toList();
+    QCOMPARE(tunnelConnections.count(), 3);
+    for (int i = 1; i < tunnelConnections.count(); i++) {
+        QVERIFY(tunnelConnections.at(i - 1).toMap().value("rxDataCount").toULongLong() >= tunnelConnections.at(i).toMap().value("rxDataCount").toULongLong());
+    }
+
+    monitor->disconnectFromServer();
+    monitor->deleteLater();
+
+    foreach (TunnelProxySocketServer *tunnelProxyServer, tunnelProxyServers) {
+        QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+        tunnelProxyServer->stopServer();
+        QVERIFY(serverDisconnectedSpy.wait());
+        tunnelProxyServer->deleteLater();
+    }
+
+    stopServer();
+}
+
+
+void RemoteProxyTestsTunnelProxy::tunnelRates()
+{
+    // Space-saving: the heavy keys survive a stream of light keys
+    HeavyHitters heavyHitters(3);
+    QUuid heavyKey = QUuid::createUuid();
+    for (int i = 0; i < 100; i++) {
+        heavyHitters.add(heavyKey, 10);
+        heavyHitters.add(QUuid::createUuid(), 1);
+    }
+
+    QCOMPARE(heavyHitters.count(), 3);
+    QList<HeavyHitters::Item> items = heavyHitters.top(1);
+    QCOMPARE(items.count(), 1);
+    QCOMPARE(items.first().key, heavyKey);
+    QVERIFY(items.first().count >= 1000);
+    QVERIFY(items.first().count - items.first().error <= 1000);
+
+    // Decay scales all counts and keeps the order
+    heavyHitters.decay(0.5);
+    items = heavyHitters.top(3);
+    QCOMPARE(items.first().key, heavyKey);
+    QVERIFY(items.at(0).count >= items.at(1).count);
+    QVERIFY(items.first().count <= 600);
+    heavyHitters.remove(heavyKey);
+    QCOMPARE(heavyHitters.count(), 2);
+
+    // Per tunnel rates on a live tunnel, with an alert threshold of 1 B/s
+    startServer();
+    Engine::instance()->configuration()->setRateAlertThreshold(1);
+
+    // The additional server shares the transport, the rates get published on the first server only
+    QUuid serverUuid = QUuid::createUuid();
+    QUuid additionalServerUuid = QUuid::createUuid();
+    TunnelProxySocketServer *tunnelProxyServer = new TunnelProxySocketServer(serverUuid, "Rate server", this);
+    tunnelProxyServer->addServer(additionalServerUuid, "Rate additional server");
+    connect(tunnelProxyServer, &TunnelProxySocketServer::sslErrors, this, [=](const QList<QSslError> &errors){
+        tunnelProxyServer->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy serverRunningSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->startServer(m_serverUrlTunnelProxyTcp);
+    QVERIFY(serverRunningSpy.wait());
+
+    TunnelProxyRemoteConnection *remoteConnection = new TunnelProxyRemoteConnection(QUuid::createUuid(), "Rate client", this);
+    connect(remoteConnection, &TunnelProxyRemoteConnection::sslErrors, this, [=](const QList<QSslError> &errors){
+        remoteConnection->ignoreSslErrors(errors);
+    });
+
+    QSignalSpy clientConnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::clientConnected);
+    QSignalSpy remoteConnectedSpy(remoteConnection, &TunnelProxyRemoteConnection::remoteConnectedChanged);
+    remoteConnection->connectServer(m_serverUrlTunnelProxyTcp, serverUuid);
+    QVERIFY(remoteConnectedSpy.wait());
+    QTRY_COMPARE(clientConnectedSpy.count(), 1);
+    TunnelProxySocket *tunnelProxySocket = clientConnectedSpy.at(0).at(0).value<TunnelProxySocket *>();
+
+    // The rates get updated in the one second tick, keep the traffic going for some ticks
+    QSignalSpy dataReadySpy(remoteConnection, &TunnelProxyRemoteConnection::dataReady);
+    QVariantList topTunnels;
+    for (int i = 0; i < 40 && topTunnels.isEmpty(); i++) {
+        tunnelProxySocket->writeData(QByteArray(1024, 'r'));
+        dataReadySpy.wait(100);
+        topTunnels = Engine::instance()->tunnelProxyServer()->summaryStatistics().value("topTunnels").toList();
+    }
+
+    QCOMPARE(topTunnels.count(), 1);
+    QVariantMap tunnelMap = topTunnels.first().toMap();
+    QCOMPARE(QUuid(tunnelMap.value("serverUuid").toString()), serverUuid);
+    QCOMPARE(tunnelMap.value("name").toString(), QString("Rate server"));
+    QVERIFY(tunnelMap.value("byteRate").toLongLong() > 0);
+    QVERIFY(tunnelMap.value("frameRate").toLongLong() > 0);
+    QCOMPARE(Engine::instance()->tunnelProxyServer()->summaryStatistics().value("rateAlertsCount").toInt(), 1);
+
+    QVariantList tunnelConnections = Engine::instance()->tunnelProxyServer()->currentStatistics(true).value("tunnelConnections").toList();
+    QCOMPARE(tunnelConnections.count(), 2);
+    foreach (const QVariant &tunnelConnection, tunnelConnections) {
+        QVariantMap serverMap = tunnelConnection.toMap();
+        if (QUuid(serverMap.value("serverUuid").toString()) == serverUuid) {
+            QVERIFY(serverMap.value("byteRate").toLongLong() > 0);
+        } else {
+            QCOMPARE(QUuid(serverMap.value("serverUuid").toString()), additionalServerUuid);
+            QVERIFY(!serverMap.contains("byteRate"));
+            QVERIFY(!serverMap.contains("frameRate"));
+        }
+    }
+
+    // Disconnected servers leave the top list and the alerts
+    remoteConnection->disconnectServer();
+    remoteConnection->deleteLater();
+
+    QSignalSpy serverDisconnectedSpy(tunnelProxyServer, &TunnelProxySocketServer::runningChanged);
+    tunnelProxyServer->stopServer();
+    QVERIFY(serverDisconnectedSpy.wait());
+    tunnelProxyServer->deleteLater();
+
+    QTRY_COMPARE(Engine::instance()->tunnelProxyServer()->serverConnectionsCount(), 0);
+    QVERIFY(Engine::instance()->tunnelProxyServer()->summaryStatistics().value("topTunnels").toList().isEmpty());
+    QCOMPARE(Engine::instance()->tunnelProxyServer()->summaryStatistics().value("rateAlertsCount").toInt(), 0);
+
+    Engine::instance()->configuration()->setRateAlertThreshold(0);
+    stopServer();
+}
+
+
 
 QTEST_MAIN(RemoteProxyTestsTunnelProxy)
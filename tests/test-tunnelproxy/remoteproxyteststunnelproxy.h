@@ -80,6 +80,50 @@ private slots:
 
     void tunnelProxyEndToEndTest();
 
+    void drainServer();
+    void reconnectBackoff();
+    void admissionControl();
+    void compiledValidators();
+    void validateParamsBenchmark_data();
+    void validateParamsBenchmark();
+    void requestParsingAllocations_data();
+    void requestParsingAllocations();
+    void cachedResponses();
+    void jsonStreamSplitter_data();
+    void jsonStreamSplitter();
+    void jsonStreamSplitterBenchmark_data();
+    void jsonStreamSplitterBenchmark();
+    void pipelinedRequests();
+    void pipelinedRegistration();
+    void pipelinedEarlyData();
+    void controlFrames();
+    void controlFramesLegacyServer();
+    void multiServerRegistration();
+    void multiServerRegistrationTakenUuid();
+    void multiplexedTunnels();
+    void tunnelCompression_data();
+    void tunnelCompression();
+    void compressedTunnels();
+    void cutThroughForwarding();
+    void slipFrameSlices_data();
+    void slipFrameSlices();
+    void outputCorking();
+    void readBufferPool();
+    void trafficCounters();
+
+    // Memory
+    void slabAllocator();
+    void memoryReport();
+    void idleCompaction();
+
+    // Metrics
+    void metricsEndpoint();
+    void forwardingLatency();
+
+    // Monitor
+    void monitorSubscription();
+    void monitorQuery();
+    void tunnelRates();
 
 };
 
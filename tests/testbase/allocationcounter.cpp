@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* nymea-remoteproxy
+* Tunnel proxy server for the nymea remote access
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-remoteproxy.
+*
+* nymea-remoteproxy is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* as published by the Free Software Foundation, either version 3
+* of the License, or (at your option) any later version.
+*
+* nymea-remoteproxy is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with nymea-remoteproxy. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "allocationcounter.h"
+
+#include <stdlib.h>
+
+static bool s_counting = false;
+static quint64 s_allocationCount = 0;
+
+#if defined(__GLIBC__)
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) __THROW
+{
+    if (s_counting)
+        s_allocationCount++;
+
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    if (s_counting)
+        s_allocationCount++;
+
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) __THROW
+{
+    if (s_counting)
+        s_allocationCount++;
+
+    return __libc_realloc(pointer, size);
+}
+
+}
+
+bool AllocationCounter::supported()
+{
+    return true;
+}
+
+#else
+
+bool AllocationCounter::supported()
+{
+    return false;
+}
+
+#endif
+
+void AllocationCounter::start()
+{
+    s_allocationCount = 0;
+    s_counting = true;
+}
+
+quint64 AllocationCounter::stop()
+{
+    s_counting = false;
+    return s_allocationCount;
+}
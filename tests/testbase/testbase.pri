@@ -13,8 +13,10 @@ LIBS += -L$$top_builddir/libnymea-remoteproxy/ -lnymea-remoteproxy \
         -L$$top_builddir/libnymea-remoteproxyclient/ -lnymea-remoteproxyclient \
 
 HEADERS += \
+    $${PWD}/allocationcounter.h \
     $${PWD}/basetest.h
 
 SOURCES += \
+    $${PWD}/allocationcounter.cpp \
     $${PWD}/basetest.cpp
 